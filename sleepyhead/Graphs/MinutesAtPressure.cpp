@@ -8,12 +8,14 @@
 
 #include <cmath>
 #include <QApplication>
+#include <QThread>
 #include <QThreadPool>
 #include <QMutexLocker>
 
 #include "MinutesAtPressure.h"
 #include "Graphs/gGraph.h"
 #include "Graphs/gGraphView.h"
+#include "Graphs/gFlagBins.h"
 #include "SleepLib/profiles.h"
 
 #include "Graphs/gXAxis.h"
@@ -22,28 +24,45 @@
 
 MinutesAtPressure::MinutesAtPressure() :Layer(NoChannel)
 {
-    m_remap = nullptr;
+    m_graph = nullptr;
     m_minpressure = 3;
     m_maxpressure = 30;
     m_minimum_height = 0;
+    m_rangeIPAPcode = m_rangeEPAPcode = 0;
+    m_rangeMinx = m_rangeMaxx = 0;
+    m_rangeValid = false;
 }
 MinutesAtPressure::~MinutesAtPressure()
 {
-    while (recalculating()) {};
+    cancelRecalc();
+    while (m_jobs.load() > 0) { QThread::yieldCurrentThread(); }
 }
 
 RecalcMAP::~RecalcMAP()
 {
 }
-void RecalcMAP::quit() {
-    map->mutex.lock();
-    m_quit = true;
-    map->mutex.unlock();
+
+bool RecalcMAP::cancelled() const
+{
+    return map->m_generation.load() != m_generation;
+}
+
+void MinutesAtPressure::cancelRecalc()
+{
+    m_generation.ref();
 }
 
 
 void MinutesAtPressure::SetDay(Day *day)
 {
+    // Stale jobs notice the generation change within a few thousand samples, so this won't block for long
+    cancelRecalc();
+    QMutexLocker locker(&mutex);
+
+    m_sessionCache.clear();
+    m_cacheChans.clear();
+    m_rangeValid = false;
+
     Layer::SetDay(day);
 
     // look at session summaryValues.
@@ -852,116 +871,219 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
 }
 
 
-//! \brief Updates Time At Pressure from session *sess
-void RecalcMAP::updateTimes(PressureInfo & info, Session * sess)
+void PressureHistogram::reset(const QList<ChannelID> & chans)
 {
-    qint64 d1,d2;
-    EventDataType gain;
-    EventStoreType data, lastdata;
-    qint64 time, lasttime;
-    int ELsize, duration;
-    bool first;
-    int key;
-    EventDataType val = 0;
+    times.fill(0, 300);
+    events.clear();
+
+    for (const auto & cod : chans) {
+        events[cod].fill(0, 300);
+    }
+}
+
+void PressureHistogram::add(const PressureHistogram & other, int sign)
+{
+    int size = qMin(times.size(), other.times.size());
+    for (int i = 0; i < size; ++i) {
+        times[i] += sign * other.times.at(i);
+    }
+
+    for (auto it = other.events.begin(), end = other.events.end(); it != end; ++it) {
+        auto ei = events.find(it.key());
+        if (ei == events.end()) continue;
+
+        QVector<double> & dest = ei.value();
+        const QVector<double> & src = it.value();
+
+        int esize = qMin(dest.size(), src.size());
+        for (int i = 0; i < esize; ++i) {
+            dest[i] += sign * src.at(i);
+        }
+    }
+}
 
-    ChannelID code = info.code;
-    qint64 minx = info.minx;
-    qint64 maxx = info.maxx;
+//! \brief A run of constant pressure, clipped to the range being scanned
+struct PressureSegment
+{
+    qint64 start, end;
+    int key;
+};
 
-    if (code == 0) return;
+//! \brief Updates Time At Pressure from session *sess, over start to end
+bool RecalcMAP::updateTimes(PressureHistogram & hist, Session * sess, ChannelID code, const QList<ChannelID> & chans, qint64 start, qint64 end, int sign)
+{
+    if (code == 0) return true;
 
     // Find pressure channel
     auto ei = sess->eventlist.find(code);
 
     // Done already if no channel
     if (ei == sess->eventlist.end())
-        return;
+        return true;
 
     pressureMult = (sess->machine()->loaderName() == "PRS1") ? 2 : 5;
-    // Loop through event lists
 
+    QVector<PressureSegment> segments;
+    int steps = 0;
+
+    // Loop through event lists
     for (const auto & EL : ei.value()) {
-        gain = EL->gain();
+        EventDataType gain = EL->gain();
 
-        // Don't bother with short sessions
-        ELsize = EL->count();
+        quint32 ELsize = EL->count();
         if (ELsize < 1) continue;
 
-        lasttime = 0;
-        lastdata = 0;
-
-        first = true;
-
         // Skip if outside of range
-        if ((EL->first() > maxx) || (EL->last() < minx)) {
+        if ((EL->first() >= end) || (EL->last() <= start)) {
             continue;
         }
 
-        // Scan through pressure samples
-        for (int e = 0; e < ELsize; ++e) {
-            if (m_quit) {
-                m_done = true;
-                return;
+        // Start at the sample in effect at start instead of scanning from the beginning
+        quint32 e = FlagBins::firstIndex(EL, start);
+        if ((e > 0) && ((e == ELsize) || (EL->time(e) > start))) {
+            --e;
+        }
+
+        segments.resize(0);
+
+        // Scan through pressure samples, a run of the same pressure at a time
+        while (e < ELsize) {
+            if (((++steps & 0xfff) == 0) && cancelled()) {
+                return false;
             }
 
-            time = EL->time(e);
-            data = floor(float(EL->raw(e)) * gain * pressureMult);  // pressure times ten, so can look at .1 intervals in an integer
+            qint64 time = EL->time(e);
+            if (time >= end) break;
+
+            int key = floor(float(EL->raw(e)) * gain * pressureMult);  // pressure times ten, so can look at .1 intervals in an integer
 
-            if (data>=300) {
+            if (key >= 300) {
                 qWarning() << "data >= 300 in RecalcMAP::updateTimes!";
-                return;
+                return true;
             }
 
-            if ((time < minx) || first) {
-                lasttime = time;
-                lastdata = data;
+            quint32 next = e + 1;
+            while ((next < ELsize) && (int(floor(float(EL->raw(next)) * gain * pressureMult)) == key)) {
+                ++next;
+            }
 
-                first = false;
-                continue;
+            qint64 d1 = qMax(start, time);
+            qint64 d2 = qMin(end, (next < ELsize) ? EL->time(next) : EL->last());
+
+            if (d2 > d1) {
+                hist.times[key] += sign * (d2 - d1);
+
+                PressureSegment seg = { d1, d2, key };
+                segments.append(seg);
             }
+            e = next;
+        }
 
-            if (lastdata != data) {
-                d1 = qMax(minx, lasttime);
-                d2 = qMin(maxx, time);
+        if (segments.isEmpty()) continue;
 
-                duration = (d2 - d1) / 1000L;
-                key = lastdata;
-                info.times[key] += duration;
+        qint64 segstart = segments.first().start;
+        qint64 segend = segments.last().end;
+        int nsegs = segments.size();
+
+        for (const auto & cod : chans) {
+            auto ci = sess->eventlist.find(cod);
+            if (ci == sess->eventlist.end()) continue;
 
+            bool span = (schema::channel[cod].type() == schema::SPAN);
+            QVector<double> & evcounts = hist.events[cod];
 
-                for (const auto & cod : info.chans) {
-                    schema::Channel & chan = schema::channel[cod];
-                    if (chan.type() == schema::SPAN) {
-                        info.events[cod][key] += val = sess->rangeSum(cod, d1, d2);
-                    } else {
-                        info.events[cod][key] += val = sess->rangeCount(cod, d1, d2);
+            for (const auto & CL : ci.value()) {
+                quint32 cnt = CL->count();
+                if ((cnt == 0) || (CL->type() == EVL_Waveform)) continue;
+                if ((CL->first() >= segend) || (CL->last() < segstart)) continue;
+
+                EventDataType cgain = CL->gain();
+                int s = 0;
+
+                // Flags and pressure runs are both in time order, so walk them together
+                for (quint32 i = FlagBins::firstIndex(CL, segstart); i < cnt; ++i) {
+                    qint64 t = CL->time(i);
+                    if (t >= segend) break;
+
+                    while ((s < nsegs) && (segments.at(s).end <= t)) {
+                        ++s;
                     }
-                }
+                    if (s >= nsegs) break;
 
-                lasttime = time;
-                lastdata = data;
-            }
-            if (time > maxx) {
-                break;
+                    const PressureSegment & seg = segments.at(s);
+                    if (t < seg.start) continue;
+
+                    evcounts[seg.key] += sign * (span ? double(CL->raw(i)) * cgain : 1.0);
+                }
             }
+        }
+    }
+    return true;
+}
 
+//! \brief Adds (or subtracts) every session's contribution between start and end, using whole-session histograms where it can
+bool RecalcMAP::accumulate(PressureHistogram & hist, ChannelID code, const QList<ChannelID> & chans, qint64 start, qint64 end, int sign)
+{
+    if ((code == 0) || (start >= end)) return true;
+
+    QHash<SessionID, PressureHistogram> & cache = map->m_sessionCache[code];
+
+    for (const auto & sess : map->m_day->sessions) {
+        auto ei = sess->eventlist.find(code);
+        if (ei == sess->eventlist.end()) continue;
+
+        // Extent of this session's pressure data
+        qint64 first = 0, last = 0;
+        bool found = false;
+        for (const auto & EL : ei.value()) {
+            if (EL->count() < 1) continue;
+            if (!found || (EL->first() < first)) first = EL->first();
+            if (!found || (EL->last() > last)) last = EL->last();
+            found = true;
         }
-        if ((lasttime < maxx) || (lastdata == data)) {
-            d1 = qMax(lasttime, minx);
-            d2 = qMin(maxx, EL->last());
-
-            duration = (d2 - d1) / 1000L;
-            key = lastdata;
-            info.times[key] += duration;
-
-            for (const auto & cod : info.chans) {
-                schema::Channel & chan = schema::channel[cod];
-                if (chan.type() == schema::SPAN) {
-                    info.events[cod][key] += sess->rangeSum(cod, d1, d2);
-                } else {
-                    info.events[cod][key] += sess->rangeCount(cod, d1, d2);
+
+        if (!found || (first >= end) || (last <= start)) continue;
+
+        if ((first >= start) && (last <= end)) {
+            // The whole session is covered, so it only ever needs scanning once
+            auto ci = cache.find(sess->session());
+            if (ci == cache.end()) {
+                PressureHistogram whole;
+                whole.reset(chans);
+                if (!updateTimes(whole, sess, code, chans, first, last, 1)) {
+                    return false;
                 }
+                ci = cache.insert(sess->session(), whole);
             }
+            hist.add(ci.value(), sign);
+        } else if (!updateTimes(hist, sess, code, chans, start, end, sign)) {
+            return false;
+        }
+
+        if (cancelled()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PressureInfo::fromHistogram(const PressureHistogram & hist)
+{
+    int size = qMin(times.size(), hist.times.size());
+    for (int i = 0; i < size; ++i) {
+        times[i] = hist.times.at(i) / 1000L;
+    }
+
+    for (const auto & cod : chans) {
+        auto hi = hist.events.find(cod);
+        if (hi == hist.events.end()) continue;
+
+        QVector<int> & dest = events[cod];
+        const QVector<double> & src = hi.value();
+
+        int esize = qMin(dest.size(), src.size());
+        for (int i = 0; i < esize; ++i) {
+            dest[i] = qRound(src.at(i));
         }
     }
 }
@@ -1026,10 +1148,21 @@ void PressureInfo::finishCalcs()
 
 void RecalcMAP::run()
 {
-    QMutexLocker locker(&map->mutex);
-    map->m_recalculating = true;
+    // Requests queued up behind a newer one needn't even wait for the lock
+    if (!cancelled()) {
+        QMutexLocker locker(&map->mutex);
+        if (!cancelled() && map->m_day) {
+            calculate();
+        }
+    }
+
+    // This must be the last thing touching map, as its destructor waits on it
+    map->m_jobs.deref();
+}
+
+void RecalcMAP::calculate()
+{
     Day * day = map->m_day;
-    if (!day) return;
 
     // Get the channels for specified Channel types
     QList<ChannelID> chans = day->getSortedMachineChannels(schema::FLAG);
@@ -1038,245 +1171,107 @@ void RecalcMAP::run()
     chans.removeAll(CPAP_VSnore2);
     chans.removeAll(CPAP_FlowLimit);
     chans.removeAll(CPAP_RERA);
-//    for (int i=0;i<chans.size();i++) {
-//        schema::Channel &chan = schema::channel[chans.at(i)];
-//        qDebug() << chan.fullname();
-//    }
 
     ChannelID ipapcode = (day->channelExists(CPAP_IPAP)) ? CPAP_IPAP : CPAP_Pressure;
     ChannelID epapcode = (day->channelExists(CPAP_EPAP)) ? CPAP_EPAP : 0;
 
     qint64 minx, maxx;
     map->m_graph->graphView()->GetXBounds(minx, maxx);
-    PressureInfo IPAP(ipapcode, minx, maxx), EPAP(epapcode, minx, maxx);
-
-    IPAP.AddChannels(chans);
-    EPAP.AddChannels(chans);
-
-    //ChannelID code;
-
-//    QList<ChannelID> badchans;
-//    for (int i=0 ; i < chans.size(); ++i) {
-//        code = chans.at(i);
-//      //  if (!day->channelExists(code)) badchans.push_back(code);
-//    }
-
-//    for (int i=0; i < badchans.size(); ++i) {
-//        code = badchans.at(i);
-//        chans.removeAll(code);
-//    }
 
+    if (chans != map->m_cacheChans) {
+        map->m_sessionCache.clear();
+        map->m_cacheChans = chans;
+        map->m_rangeValid = false;
+    }
+    if ((ipapcode != map->m_rangeIPAPcode) || (epapcode != map->m_rangeEPAPcode)) {
+        map->m_rangeValid = false;
+    }
 
-//    int numchans = chans.size();
-//    // Zero the pressure counts
-//    for (int i=map->m_minpressure; i <= map->m_maxpressure; i++) {
-//        times[i] = 0;
-
-//        for (int c = 0; c < numchans; ++c) {
-//            code = chans.at(c);
-//            events[code].insert(i, 0);
-//        }
-//    }
-
+    PressureHistogram ihist, ehist;
 
+    auto addRange = [&](qint64 start, qint64 end, int sign) -> bool {
+        return accumulate(ihist, ipapcode, chans, start, end, sign)
+            && accumulate(ehist, epapcode, chans, start, end, sign);
+    };
 
-    for (const auto & sess : day->sessions) {
+    qint64 oldmin = map->m_rangeMinx;
+    qint64 oldmax = map->m_rangeMaxx;
+    qint64 delta = qAbs(minx - oldmin) + qAbs(maxx - oldmax);
 
-        updateTimes(EPAP, sess);
-        updateTimes(IPAP, sess);
+    // Scrolling and small zooms only need the bits at either end added or taken away,
+    // as long as that's less work than starting over
+    if (map->m_rangeValid && (minx < oldmax) && (maxx > oldmin) && (delta < (maxx - minx))) {
+        ihist = map->m_rangeIPAP;
+        ehist = map->m_rangeEPAP;
 
-        if (m_quit) {
-            m_done = true;
-            return;
+        bool ok = true;
+        if (minx < oldmin) {
+            ok = addRange(minx, oldmin, 1);
+        } else if (minx > oldmin) {
+            ok = addRange(oldmin, minx, -1);
         }
+        if (ok && (maxx > oldmax)) {
+            ok = addRange(oldmax, maxx, 1);
+        } else if (ok && (maxx < oldmax)) {
+            ok = addRange(maxx, oldmax, -1);
+        }
+        if (!ok) return;
+    } else {
+        ihist.reset(chans);
+        ehist.reset(chans);
+        if (!addRange(minx, maxx, 1)) return;
+    }
 
+    map->m_rangeIPAP = ihist;
+    map->m_rangeEPAP = ehist;
+    map->m_rangeIPAPcode = ipapcode;
+    map->m_rangeEPAPcode = epapcode;
+    map->m_rangeMinx = minx;
+    map->m_rangeMaxx = maxx;
+    map->m_rangeValid = true;
 
-/*        auto ei = sess->eventlist.find(ipapcode);
-        if (ei == sess->eventlist.end())
-            continue;
-
-        const auto & evec = ei.value();
-        int esize = evec.size();
-        for (int ei = 0; ei < esize; ++ei) {
-            const EventList *EL = evec.at(ei);
-            EventDataType gain = EL->gain();
-            quint32 ELsize = EL->count();
-            if (ELsize < 1)  return;
-            qint64 lasttime = 0; //EL->time(0);
-            EventStoreType lastdata = 0; // EL->raw(0);
-
-            bool first = true;
-            if ((EL->first() > maxx) || (EL->last() < minx)) {
-                continue;
-            }
-
-            for (quint32 e = 0; e < ELsize; ++e) {
-                qint64 time = EL->time(e);
-                EventStoreType data = EL->raw(e);
-
-                if ((time < minx)) {
-                    lasttime = time;
-                    lastdata = data;
-                    first = false;
-                    goto skip;
-                }
-
-                if (first) {
-                    lasttime = time;
-                    lastdata = data;
-                    first = false;
-                }
-
-                if (lastdata != data) {
-                    qint64 d1 = qMax(minx, lasttime);
-                    qint64 d2 = qMin(maxx, time);
-
-
-                    int duration = (d2 - d1) / 1000L;
-                    EventStoreType key = floor(lastdata * gain);
-                    if (key <= 30) {
-                        times[key] += duration;
-                        for (int c = 0; c < chans.size(); ++c) {
-                            ChannelID code = chans.at(c);
-                            schema::Channel & chan = schema::channel[code];
-                            if (chan.type() == schema::SPAN) {
-                                events[code][key] += sess->rangeSum(code, d1, d2);
-                            } else {
-                                events[code][key] += sess->rangeCount(code, d1, d2);
-                            }
-                        }
-                    }
-                    lasttime = time;
-                    lastdata = data;
-                }
-                if (time > maxx) {
-
-                    break;
-                }
-skip:
-                if (m_quit) {
-                    m_done = true;
-                    return;
-                }
-            }
-            if (lasttime < maxx) {
-                qint64 d1 = qMax(lasttime, minx);
-                qint64 d2 = qMin(maxx, EL->last());
-
-                int duration = (d2 - d1) / 1000L;
-                EventStoreType key = floor(lastdata * gain);
-                if (key <= 30) {
-                    times[key] += duration;
-                    for (int c = 0; c < chans.size(); ++c) {
-                        ChannelID code = chans.at(c);
-                        schema::Channel & chan = schema::channel[code];
-                        if (chan.type() == schema::SPAN) {
-                            events[code][key] += sess->rangeSum(code, d1, d2);
-                        } else {
-                            events[code][key] += sess->rangeCount(code, d1, d2);
-                        }
-                    }
-                }
-
-            }
-
+    PressureInfo IPAP(ipapcode, minx, maxx), EPAP(epapcode, minx, maxx);
 
-        } */
-    }
+    IPAP.AddChannels(chans);
+    EPAP.AddChannels(chans);
 
+    IPAP.fromHistogram(ihist);
+    EPAP.fromHistogram(ehist);
 
     EPAP.finishCalcs();
     IPAP.finishCalcs();
 
-/*
-    int maxtime = 0;
-
-    QList<EventStoreType> trash;
-    for (auto it=times.begin(), end=times.end(); it != end; ++it) {
-        //EventStoreType key = it.key();
-        int value = it.value();
-//        if (value == 0) {
-//            trash.append(key);
-//        } else {
-            maxtime = qMax(value, maxtime);
-//        }
-    }
-    chans.push_front(CPAP_AHI);
-
-    int maxevents = 0, val;
-
-    for (int i = map->m_minpressure; i <= map->m_maxpressure; i++) {
-        val = events[CPAP_Obstructive][i] +
-              events[CPAP_Hypopnea][i] +
-              events[CPAP_Apnea][i] +
-              events[CPAP_ClearAirway][i];
-
-        events[CPAP_AHI].insert(i, val);
-     //   maxevents = qMax(val, maxevents);
-    }
-
-    for (int i = map->m_minpressure; i <= map->m_maxpressure; i++) {
-        for (int j=0 ; j < chans.size(); ++j) {
-            code = chans.at(j);
-            if ((code == CPAP_AHI) || (schema::channel[code].type() == schema::SPAN)) continue;
-            val = events[code][i];
-            maxevents = qMax(val, maxevents);
-        }
-    }
-
-//    for (int i=0; i< trash.size(); ++i) {
-//        EventStoreType key = trash.at(i);
-
-//        times.remove(key);
-//        for (auto eit=events.begin(), end=events.end(); eit != end; ++eit) {
-//            eit.value().remove(key);
-//        }
-//    }
-*/
-
     map->timelock.lock();
-
-//    map->times = times;
-//    map->events = events;
     map->epap = EPAP;
     map->ipap = IPAP;
-//    map->chans = chans;
- //   map->m_presChannel = ipapcode;
     map->timelock.unlock();
 
     map->recalcFinished();
-    m_done = true;
 }
 
 void MinutesAtPressure::recalculate(gGraph * graph)
 {
-
-    while (recalculating())
-        m_remap->quit();
-
-    m_remap = new RecalcMAP(this);
-    m_remap->setAutoDelete(true);
+    // Anything still running or queued is now stale, and bails out at its next check
+    cancelRecalc();
 
     m_graph = graph;
+    m_recalculating = true;
+    m_jobs.ref();
 
-    QThreadPool * tp = QThreadPool::globalInstance();
-//    tp->reserveThread();
+    int generation = m_generation.load();
 
     if (graph->printing()) {
-        m_remap->run();
+        RecalcMAP remap(this, generation);
+        remap.run();
     } else {
-        while(!tp->tryStart(m_remap));
+        // Start recalculating in another thread, which organizes a callback to redraw when done..
+        RecalcMAP * remap = new RecalcMAP(this, generation);
+        remap->setAutoDelete(true);
+        QThreadPool::globalInstance()->start(remap);
 
         m_lastmaxx = m_maxx;
         m_lastminx = m_minx;
-
     }
-
-
-    // Start recalculating in another thread, organize a callback to redraw when done..
-
-
-
 }
 
 void MinutesAtPressure::recalcFinished()
@@ -1285,11 +1280,7 @@ void MinutesAtPressure::recalcFinished()
         // Can't call this using standard timedRedraw function, we are in another thread, so have to use a throwaway timer
         QTimer::singleShot(0, m_graph->graphView(), SLOT(refreshTimeout()));
     }
-    m_remap = nullptr;
     m_recalculating = false;
-//    QThreadPool * tp = QThreadPool::globalInstance();
-//    tp->releaseThread();
-
 }
 
 
@@ -13,6 +13,27 @@
 #include "SleepLib/day.h"
 
 class MinutesAtPressure;
+
+/*! \struct PressureHistogram
+    \brief Milliseconds spent at, and flagged events occuring at, each pressure over some time range.
+
+    Histograms of adjoining time ranges simply add (or subtract), which is what lets
+    MinutesAtPressure update incrementally as the visible range is dragged about.
+    */
+struct PressureHistogram
+{
+    PressureHistogram() {}
+
+    //! \brief Zeroes the histogram, sized for the supplied event channels
+    void reset(const QList<ChannelID> & chans);
+
+    //! \brief Adds other into this histogram, or subtracts it when sign is negative
+    void add(const PressureHistogram & other, int sign = 1);
+
+    QVector<qint64> times;
+    QHash<ChannelID, QVector<double> > events;
+};
+
 struct PressureInfo
 {
     PressureInfo()
@@ -50,6 +71,9 @@ struct PressureInfo
             AddChannel(chans.at(i));
         }
     }
+    //! \brief Fills times and events from a histogram, converting to seconds
+    void fromHistogram(const PressureHistogram & hist);
+
     void finishCalcs();
 
     ChannelID code;
@@ -66,16 +90,23 @@ class RecalcMAP:public QRunnable
 {
     friend class MinutesAtPressure;
 public:
-    explicit RecalcMAP(MinutesAtPressure * map) :map(map), m_quit(false), m_done(false) {}
+    explicit RecalcMAP(MinutesAtPressure * map, int generation) :map(map), m_generation(generation) {}
     virtual ~RecalcMAP();
     virtual void run();
 
-    void quit();
+    //! \brief Returns true once a newer recalculation has been requested, making this one stale
+    bool cancelled() const;
 protected:
-    void updateTimes(PressureInfo & info, Session * sess);
+    void calculate();
+
+    //! \brief Adds (or subtracts) the histogram of code between start and end from every session into hist
+    bool accumulate(PressureHistogram & hist, ChannelID code, const QList<ChannelID> & chans, qint64 start, qint64 end, int sign);
+
+    //! \brief Scans code and the event channels of sess between start and end into hist
+    bool updateTimes(PressureHistogram & hist, Session * sess, ChannelID code, const QList<ChannelID> & chans, qint64 start, qint64 end, int sign);
+
     MinutesAtPressure * map;
-    volatile bool m_quit;
-    volatile bool m_done;
+    int m_generation;
 };
 
 class MinutesAtPressure:public Layer
@@ -100,6 +131,10 @@ public:
     bool mouseReleaseEvent(QMouseEvent *event, gGraph *graph);
 
     virtual void recalcFinished();
+
+    //! \brief Abandons any recalculation in progress or queued
+    void cancelRecalc();
+
     virtual Layer * Clone() {
         MinutesAtPressure * map = new MinutesAtPressure();
         Layer::CloneInto(map);
@@ -139,7 +174,25 @@ protected:
     qint64 m_lastminx;
     qint64 m_lastmaxx;
     gGraph * m_graph;
-    RecalcMAP * m_remap;
+
+    //! \brief Bumped to make running or queued RecalcMAP jobs stale
+    QAtomicInt m_generation;
+
+    //! \brief Number of RecalcMAP jobs started that haven't returned yet
+    QAtomicInt m_jobs;
+
+    // The session cache and range state are only touched with mutex held
+
+    //! \brief Whole-session histograms, by pressure channel then session
+    QHash<ChannelID, QHash<SessionID, PressureHistogram> > m_sessionCache;
+    QList<ChannelID> m_cacheChans;
+
+    //! \brief Histograms of the range last calculated, which the next range is worked out relative to
+    PressureHistogram m_rangeIPAP, m_rangeEPAP;
+    ChannelID m_rangeIPAPcode, m_rangeEPAPcode;
+    qint64 m_rangeMinx, m_rangeMaxx;
+    bool m_rangeValid;
+
     QMap<EventStoreType, int> times;
     QMap<EventStoreType, int> epap_times;
     QList<ChannelID> chans;
@@ -0,0 +1,159 @@
+/* gFlagBins Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include "SleepLib/event.h"
+#include "gFlagBins.h"
+
+FlagBins::FlagBins()
+    : m_left(0), m_width(0), m_minx(0), m_xmult(0), m_used(0)
+{
+}
+
+void FlagBins::reset(int left, int width, double minx, double maxx)
+{
+    m_left = left;
+    m_width = qMax(width, 0);
+    m_minx = qint64(minx);
+
+    double xx = maxx - minx;
+    m_xmult = (xx > 0) ? double(m_width) / xx : 0;
+
+    // fill() keeps the existing allocation when the width hasn't changed
+    m_counts.resize(m_width);
+    m_counts.fill(0);
+    m_cover.resize(m_width + 1);
+    m_cover.fill(0);
+    m_used = 0;
+}
+
+void FlagBins::addFlag(qint64 time)
+{
+    int x = column(time);
+
+    if ((x < 0) || (x >= m_width)) { return; }
+
+    m_counts[x]++;
+    m_used++;
+}
+
+void FlagBins::addSpan(qint64 start, qint64 end)
+{
+    if (start > end) { qSwap(start, end); }
+
+    int x1 = column(start);
+    int x2 = column(end);
+
+    if ((x2 < 0) || (x1 >= m_width)) { return; }
+
+    x1 = qMax(x1, 0);
+    x2 = qMin(x2, m_width - 1);
+
+    // Every span covers at least the pixel it starts in
+    m_counts[x1]++;
+    m_cover[x1]++;
+    m_cover[x2 + 1]--;
+    m_used++;
+}
+
+quint32 FlagBins::maxCount() const
+{
+    quint32 mx = 0;
+
+    for (int i = 0; i < m_width; ++i) {
+        if (m_counts[i] > mx) { mx = m_counts[i]; }
+    }
+
+    return mx;
+}
+
+QVector<QLine> FlagBins::lines(int top, int bottom, quint32 mincount, quint32 maxcount) const
+{
+    QVector<QLine> vlines;
+
+    if (!m_used) { return vlines; }
+
+    vlines.reserve(qMin(m_used, m_width));
+
+    const quint32 *cptr = m_counts.constData();
+
+    for (int i = 0; i < m_width; ++i) {
+        if ((cptr[i] >= mincount) && (cptr[i] <= maxcount)) {
+            vlines.append(QLine(m_left + i, top, m_left + i, bottom));
+        }
+    }
+
+    return vlines;
+}
+
+QVector<QPoint> FlagBins::points(int y) const
+{
+    QVector<QPoint> pts;
+
+    if (!m_used) { return pts; }
+
+    pts.reserve(qMin(m_used, m_width));
+
+    const quint32 *cptr = m_counts.constData();
+
+    for (int i = 0; i < m_width; ++i) {
+        if (cptr[i]) {
+            pts.append(QPoint(m_left + i, y));
+        }
+    }
+
+    return pts;
+}
+
+QVector<QRect> FlagBins::rects(int top, int height) const
+{
+    QVector<QRect> rs;
+
+    if (!m_used) { return rs; }
+
+    const qint32 *dptr = m_cover.constData();
+    int cover = 0;
+    int runstart = -1;
+
+    // Prefix sum of the coverage deltas, merging adjacent covered columns into one rect
+    for (int i = 0; i <= m_width; ++i) {
+        cover += dptr[i];
+
+        if ((cover > 0) && (i < m_width)) {
+            if (runstart < 0) { runstart = i; }
+        } else if (runstart >= 0) {
+            rs.append(QRect(m_left + runstart, top, i - runstart, height));
+            runstart = -1;
+        }
+    }
+
+    return rs;
+}
+
+quint32 FlagBins::firstIndex(EventList *el, qint64 time, qint64 drift)
+{
+    qint64 offset = time - (el->first() + drift);
+
+    if (offset <= 0) { return 0; }
+
+    if (el->type() == EVL_Waveform) {
+        double rate = el->rate();
+        return (rate > 0) ? qMin(quint32(offset / rate), el->count()) : 0;
+    }
+
+    // EventList::AddEvent() rebases events arriving out of order in place, so the times aren't
+    // guaranteed to ascend and a binary search could skip visible events
+    const quint32 *tptr = el->rawTime();
+    quint32 count = el->count();
+    quint32 i = 0;
+
+    while ((i < count) && (qint64(tptr[i]) < offset)) {
+        ++i;
+    }
+
+    return i;
+}
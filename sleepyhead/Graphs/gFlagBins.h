@@ -0,0 +1,75 @@
+/* gFlagBins Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef GFLAGBINS_H
+#define GFLAGBINS_H
+
+#include <QVector>
+#include <QLine>
+#include <QRect>
+#include <QPoint>
+
+class EventList;
+
+/*! \class FlagBins
+    \brief Bins event flags and spans into pixel columns, so a row of events can be drawn with
+           one batched QPainter call no matter how many events land on the same pixel.
+    */
+class FlagBins
+{
+  public:
+    FlagBins();
+
+    //! \brief Prepares width pixel columns starting at left, spanning the time range minx to maxx
+    void reset(int left, int width, double minx, double maxx);
+
+    //! \brief Returns the pixel column (relative to left) containing time, unclamped
+    inline int column(qint64 time) const { return int(double(time - m_minx) * m_xmult); }
+
+    //! \brief Bins a single flag at time
+    void addFlag(qint64 time);
+
+    //! \brief Bins a span running from start to end
+    void addSpan(qint64 start, qint64 end);
+
+    //! \brief Returns true if nothing visible has been binned since the last reset
+    inline bool isEmpty() const { return m_used == 0; }
+
+    //! \brief Returns the per-column event counts, for density shading
+    const QVector<quint32> &counts() const { return m_counts; }
+
+    //! \brief Returns the highest per-column count
+    quint32 maxCount() const;
+
+    //! \brief Returns one vertical line from top to bottom per column holding between mincount and maxcount events
+    QVector<QLine> lines(int top, int bottom, quint32 mincount = 1, quint32 maxcount = 0xffffffff) const;
+
+    //! \brief Returns one point at height y per occupied column
+    QVector<QPoint> points(int y) const;
+
+    //! \brief Returns one rectangle per run of adjacent columns covered by spans
+    QVector<QRect> rects(int top, int height) const;
+
+    //! \brief Returns the index of the first event in el ending at or after time (el times offset by drift).
+    //! Event times can be out of order, so this is a linear skip like the loops it replaced
+    static quint32 firstIndex(EventList *el, qint64 time, qint64 drift = 0);
+
+  protected:
+    //! \brief Number of events (flags or span starts) landing in each column
+    QVector<quint32> m_counts;
+
+    //! \brief Span coverage deltas, one extra entry so spans may close past the last column
+    QVector<qint32> m_cover;
+
+    int m_left, m_width;
+    qint64 m_minx;
+    double m_xmult;
+    int m_used;
+};
+
+#endif // GFLAGBINS_H
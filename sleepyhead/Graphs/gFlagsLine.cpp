@@ -285,20 +285,24 @@ void gFlagsLine::paint(QPainter &painter, gGraph &w, const QRegion &region)
     qint64 start;
     quint32 *tptr;
     EventStoreType *dptr, * eptr;
-    int idx;
     QHash<ChannelID, QVector<EventList *> >::iterator cei;
 
     qint64 clockdrift = qint64(p_profile->cpap->clockDrift()) * 1000L;
     qint64 drift = 0;
 
-    QVector<QLine> vlines;
-
     QColor color=schema::channel[m_code].defaultColor();
-    QBrush brush(color);
 
     int tooltipTimeout = AppSetting->tooltipTimeout();
 
-    bool hover = false;
+    // Events are binned into pixel columns, then drawn in one batch below
+    m_bins.reset(left, width, minx, maxx);
+
+    QPoint mouse = w.graphView()->currentMousePos();
+    bool hover = w.selectingArea() || (mouse.y() < bartop - 2) || (mouse.y() > bottom + 2);
+
+    // The highlight goes on top of the batch, so it's only drawn once that's done
+    QRect hoverrect;
+
     for (const auto & sess : m_day->sessions) {
         if (!sess->enabled()) {
             continue;
@@ -316,32 +320,15 @@ void gFlagsLine::paint(QPainter &painter, gGraph &w, const QRegion &region)
         for (const auto & el : cei.value()) {
 
             start = el->first() + drift;
-            tptr = el->rawTime();
-            dptr = el->rawData();
-            int np = el->count();
-            eptr = dptr + np;
-
-            for (idx = 0; dptr < eptr; dptr++, tptr++, idx++) {
-                X = start + *tptr;
-                L = *dptr * 1000;
-
-                if (X >= minx) {
-                    break;
-                }
-
-                X2 = X - L;
-
-                if (X2 >= minx) {
-                    break;
-                }
-
-            }
 
-            np -= idx;
+            quint32 idx = FlagBins::firstIndex(el, minx, drift);
+            tptr = el->rawTime() + idx;
+            dptr = el->rawData() + idx;
+            eptr = el->rawData() + el->count();
 
             if (chan.type() == schema::SPAN) {
                 ///////////////////////////////////////////////////////////////////////////
-                // Draw Event Flag Spans
+                // Bin Event Flag Spans
                 ///////////////////////////////////////////////////////////////////////////
 
                 for (; dptr < eptr; dptr++) {
@@ -354,16 +341,17 @@ void gFlagsLine::paint(QPainter &painter, gGraph &w, const QRegion &region)
                         break;
                     }
 
+                    m_bins.addSpan(X2, X);
+
+                    if (hover) { continue; }
+
                     x1 = double(X - minx) * xmult + left;
                     x2 = double(X2 - minx) * xmult + left;
 
-                    brush = QBrush(color);
-                    painter.fillRect(x2, bartop, x1-x2, bottom-bartop, brush);
-                    if (!w.selectingArea() && !hover && QRect(x2, bartop, x1-x2, bottom-bartop).contains(w.graphView()->currentMousePos())) {
+                    if (QRect(x2, bartop, x1-x2, bottom-bartop).contains(mouse)) {
                         hover = true;
-                        painter.setPen(QPen(Qt::red,1));
+                        hoverrect = QRect(x2, bartop, x1-x2, bottom-bartop);
 
-                        painter.drawRect(x2, bartop, x1-x2, bottom-bartop);
                         int x,y;
                         int s = *dptr;
                         int m = s / 60;
@@ -382,38 +370,53 @@ void gFlagsLine::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
             } else { //if (chan.type() == schema::FLAG) {
                 ///////////////////////////////////////////////////////////////////////////
-                // Draw Event Flag Bars
+                // Bin Event Flag Bars
                 ///////////////////////////////////////////////////////////////////////////
 
-                for (int i = 0; i < np; i++, dptr++) {
+                for (; dptr < eptr; dptr++) {
                     X = start + *tptr++;
 
                     if (X > maxx) {
                         break;
                     }
 
+                    m_bins.addFlag(X);
+
+                    if (hover) { continue; }
+
                     x1 = (X - minx) * xmult + left;
 
-                    if (!w.selectingArea() && !hover && QRect(x1-3, bartop-2, 6, bottom-bartop+4).contains(w.graphView()->currentMousePos())) {
+                    if (QRect(x1-3, bartop-2, 6, bottom-bartop+4).contains(mouse)) {
                         hover = true;
-                        painter.setPen(QPen(Qt::red,1));
+                        hoverrect = QRect(x1-2, bartop-2, 4, bottom-bartop+4);
 
-                        painter.drawRect(x1-2, bartop-2, 4, bottom-bartop+4);
                         int x,y;
                         QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(*dptr);
                         GetTextExtent(lab, x, y);
 
                         w.ToolTip(lab, x1 - 10, bartop + (3 * w.printScaleY()), TT_AlignRight, tooltipTimeout);
                     }
-
-                    vlines.append(QLine(x1, bartop, x1, bottom));
                 }
             }
         }
     }
 
-    painter.setPen(color);
-    painter.drawLines(vlines);
+    if (m_bins.isEmpty()) { return; }
+
+    if (chan.type() == schema::SPAN) {
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QBrush(color));
+        painter.drawRects(m_bins.rects(bartop, bottom - bartop));
+        painter.setBrush(Qt::NoBrush);
+    } else {
+        painter.setPen(color);
+        painter.drawLines(m_bins.lines(bartop, bottom));
+    }
+
+    if (!hoverrect.isNull()) {
+        painter.setPen(QPen(Qt::red,1));
+        painter.drawRect(hoverrect);
+    }
 }
 
 bool gFlagsLine::mouseMoveEvent(QMouseEvent *event, gGraph *graph)
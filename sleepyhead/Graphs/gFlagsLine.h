@@ -10,6 +10,7 @@
 
 #include "gGraphView.h"
 #include "gspacer.h"
+#include "gFlagBins.h"
 
 class gFlagsGroup;
 
@@ -89,6 +90,9 @@ class gFlagsLine: public Layer
     int total_lines, line_num;
     int m_lx, m_ly;
 
+    //! \brief Per-pixel event bins, kept between paints to reuse their storage
+    FlagBins m_bins;
+
 };
 
 /*! \class gFlagsGroup
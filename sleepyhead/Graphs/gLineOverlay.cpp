@@ -47,7 +47,7 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
     if (xx <= 0) { return; }
 
-    double x1, x2;
+    double x1;
 
     int x, y;
 
@@ -85,6 +85,18 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
     int tooltipTimeout = AppSetting->tooltipTimeout();
 
+    // Events are binned into pixel columns, then drawn in one batch below
+    m_bins.reset(left, width, w.min_x, w.max_x);
+
+    bool canhover = !w.selectingArea() && !m_blockhover;
+
+    // The highlight goes on top of the batch, so it's only drawn once that's done
+    bool hovered = false;
+    double hoverx = 0, hoverwidth = 0;
+
+    QString lab = QString("%1").arg(m_label);
+    GetTextExtent(lab, x, y);
+
     // For each session, process it's eventlist
     for (const auto sess : m_day->sessions) {
         if (!sess->enabled()) { continue; }
@@ -101,28 +113,19 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
         for (const auto & el : cei.value()) {
             count = el->count();
             stime = el->first() + drift;
-            dptr = el->rawData();
-            eptr = dptr + count;
-            tptr = el->rawTime();
 
             ////////////////////////////////////////////////////////////////////////////
             // Skip data previous to minx bounds
             ////////////////////////////////////////////////////////////////////////////
-
-            for (; dptr < eptr; ++dptr) {
-
-                if ((stime + *tptr) >= w.min_x) {
-                    break;
-                }
-
-                ++tptr;
-            }
+            quint32 idx = FlagBins::firstIndex(el, w.min_x, drift);
+            dptr = el->rawData() + idx;
+            eptr = el->rawData() + count;
+            tptr = el->rawTime() + idx;
 
             if (m_flt == FT_Span) {
                 ////////////////////////////////////////////////////////////////////////////
                 // FT_Span
                 ////////////////////////////////////////////////////////////////////////////
-                QBrush brush(m_flag_color);
                 for (; dptr < eptr; dptr++) {
 
                     X = stime + *tptr++;
@@ -135,70 +138,29 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
                     m_sum += raw;
                     ++m_count;
 
-                    x1 = jj * double(X - w.min_x);
-                    x2 = jj * double(Y - w.min_x);
-
-                    x2 += (int(x1)==int(x2)) ? 1 : 0;
-
-                    x2 = qMax(0.0, x2)+left;
-                    x1 = qMin(width, x1)+left;
-
-                    painter.fillRect(QRect(x2, start_py, x1-x2, height), brush);
+                    m_bins.addSpan(Y, X);
                 }
-            }/* else if (m_flt == FT_Dot) {
+            } else if ((m_flt == FT_Bar) || (m_flt == FT_Dot)) {
                 ////////////////////////////////////////////////////////////////////////////
-                // FT_Dot
+                // FT_Bar
                 ////////////////////////////////////////////////////////////////////////////
                 for (; dptr < eptr; dptr++) {
-                    hover = false;
-
-                    X = stime + *tptr++; //el.time(i);
-                    raw = *dptr; //el.data(i);
+                    X = stime + *tptr++;
+                    raw = *dptr;
 
                     if (X > w.max_x) {
                         break;
                     }
 
-                    x1 = jj * double(X - w.min_x) + left;
                     m_count++;
                     m_sum += raw;
+                    m_bins.addFlag(X);
 
-//                    if ((odt == ODT_Bars) || (xx < 3600000)) {
-                        // show the fat dots in the middle
-                        painter.setPen(QPen(m_flag_color,4));
-
-                        painter.drawPoint(x1, double(height) / double(yy)*double(-20 - w.min_y) + topp);
-                        painter.setPen(QPen(m_flag_color,1));
-
-//                    } else {
-//                        // thin lines down the bottom
-//                        painter.drawLine(x1, start_py + 1, x1, start_py + 1 + 12);
-//                    }
-                }
-            } */else if ((m_flt == FT_Bar) || (m_flt == FT_Dot)) {
-                ////////////////////////////////////////////////////////////////////////////
-                // FT_Bar
-                ////////////////////////////////////////////////////////////////////////////
-                QColor col = m_flag_color;
-
-                QString lab = QString("%1").arg(m_label);
-                GetTextExtent(lab, x, y);
-
-                //int lx,ly;
-
-                for (; dptr < eptr; dptr++) {
-                   // hover = false;
-                    X = stime + *tptr++;
-                    raw = *dptr;
+                    bool zoomed = (m_flt == FT_Bar) && (odt == ODT_Bars) && (xx < 3600000);
 
-                    if (X > w.max_x) {
-                        break;
-                    }
+                    if (m_hover && !zoomed) { continue; }
 
                     x1 = jj * double(X - w.min_x) + left;
-                    m_count++;
-                    m_sum += raw;
-                    int z = start_py + height;
 
                     double d1 = jj * double(raw) * 1000.0;
 
@@ -206,32 +168,17 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
                     if ((m_flt == FT_Bar) && (odt == ODT_Bars)) {
                         QRect rect(x1-d1, top, d1+4, height);
 
-                        painter.setPen(QPen(col,4));
-                        painter.drawPoint(x1, top);
-
-                        if (!w.selectingArea() && !m_blockhover && rect.contains(mouse) && !m_hover) {
+                        if (canhover && rect.contains(mouse) && !m_hover) {
                             m_hover = true;
-
-                            QColor col2(230,230,230,128);
-                            QRect rect((x1-d1), start_py+2, d1, height-2);
-                            if (rect.x() < left) {
-                                rect.setX(left);
-                            }
-
-                            painter.fillRect(rect, QBrush(col2));
-                            painter.setPen(col);
-                            painter.drawRect(rect);
+                            hovered = true;
+                            hoverx = x1;
+                            hoverwidth = d1;
 
                             // Queue tooltip
                             QString lab2 = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
                             w.ToolTip(lab2, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, AppSetting->tooltipTimeout());
-
-                            painter.setPen(QPen(col,3));
-                        } else {
-                            painter.setPen(QPen(col,1));
                         }
-                        painter.drawLine(x1, top, x1, bottom);
-                        if (xx < (3600000)) {
+                        if (zoomed) {
                             w.renderText(lab, x1 - (x / 2), top - y + (5 * w.printScaleY()),0);
                         }
 
@@ -240,39 +187,90 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
                         //////////////////////////////////////////////////////////////////////////////////////
                         // Top and bottom markers
                         //////////////////////////////////////////////////////////////////////////////////////
-                        //bool b = false;
-                        if (!w.selectingArea() && !m_blockhover && QRect(x1-2, topp, 6, height).contains(mouse) && !m_hover) {
+                        if (canhover && QRect(x1-2, topp, 6, height).contains(mouse) && !m_hover) {
                             // only want to draw the highlight/label once per frame
                             m_hover = true;
+                            hovered = true;
+                            hoverx = x1;
 
                             // Draw text label
                             QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
                             GetTextExtent(lab, x, y, defaultfont);
 
                             w.ToolTip(lab, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, tooltipTimeout);
-
-                            QColor col = m_flag_color;
-                            col.setAlpha(60);
-                            painter.setPen(QPen(col, 4));
-
-                            painter.drawLine(x1, start_py+14, x1, z - 12);
-                            painter.setPen(QPen(m_flag_color,4));
-
-                            painter.drawLine(x1, z, x1, z - 14);
-                            painter.drawLine(x1, start_py+2, x1, start_py + 16);
-                        } else {
-                            QColor col = m_flag_color;
-                            col.setAlpha(10);
-                            painter.setPen(QPen(col,1));
-                            painter.drawLine(x1, start_py+14, x1, z);
-                            painter.setPen(QPen(m_flag_color,1));
-                            painter.drawLine(x1, start_py+2, x1, start_py + 14);
                         }
                     }
                 }
             }
         }
     }
+
+    if (m_bins.isEmpty()) { return; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Draw everything binned above, one batch per marker type
+    ////////////////////////////////////////////////////////////////////////////
+    if (m_flt == FT_Span) {
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QBrush(m_flag_color));
+        painter.drawRects(m_bins.rects(start_py, height));
+        painter.setBrush(Qt::NoBrush);
+    } else if ((m_flt == FT_Bar) && (odt == ODT_Bars)) {
+        painter.setPen(QPen(m_flag_color,4));
+        painter.drawPoints(m_bins.points(top));
+        painter.setPen(QPen(m_flag_color,1));
+        painter.drawLines(m_bins.lines(top, bottom));
+    } else {
+        int z = start_py + height;
+        QColor col = m_flag_color;
+
+        // Each flag used to be drawn at alpha 10 over the others, so busy columns built up darker.
+        // Shade each column by its share of the busiest column's count instead, a batch per level
+        quint32 most = m_bins.maxCount();
+        double full = 1.0 - pow(1.0 - 10.0 / 255.0, double(most));
+        quint32 levels = qMin<quint32>(most, 8);
+
+        for (quint32 l = 0; l < levels; ++l) {
+            quint32 lo = 1 + (most * l) / levels;
+            quint32 hi = (most * (l + 1)) / levels;
+
+            col.setAlpha(qMax(10, int(255.0 * full * double(hi) / double(most))));
+            painter.setPen(QPen(col,1));
+            painter.drawLines(m_bins.lines(start_py+14, z, lo, hi));
+        }
+        painter.setPen(QPen(m_flag_color,1));
+        painter.drawLines(m_bins.lines(start_py+2, start_py + 14));
+    }
+
+    if (!hovered) { return; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Highlight the flag under the mouse
+    ////////////////////////////////////////////////////////////////////////////
+    if ((m_flt == FT_Bar) && (odt == ODT_Bars)) {
+        QColor col2(230,230,230,128);
+        QRect rect((hoverx-hoverwidth), start_py+2, hoverwidth, height-2);
+        if (rect.x() < left) {
+            rect.setX(left);
+        }
+
+        painter.fillRect(rect, QBrush(col2));
+        painter.setPen(m_flag_color);
+        painter.drawRect(rect);
+
+        painter.setPen(QPen(m_flag_color,3));
+        painter.drawLine(hoverx, top, hoverx, bottom);
+    } else {
+        int z = start_py + height;
+        QColor col = m_flag_color;
+        col.setAlpha(60);
+        painter.setPen(QPen(col, 4));
+
+        painter.drawLine(hoverx, start_py+14, hoverx, z - 12);
+        painter.setPen(QPen(m_flag_color,4));
+        painter.drawLine(hoverx, z, hoverx, z - 14);
+        painter.drawLine(hoverx, start_py+2, hoverx, start_py + 16);
+    }
 }
 bool gLineOverlayBar::mouseMoveEvent(QMouseEvent *event, gGraph *graph)
 {
@@ -11,6 +11,7 @@
 
 #include "SleepLib/common.h"
 #include "gGraphView.h"
+#include "gFlagBins.h"
 
 
 /*! \class gLineOverlayBar
@@ -55,6 +56,9 @@ class gLineOverlayBar: public Layer
     double m_sum;
     bool m_hover;
     bool m_blockhover;
+
+    //! \brief Per-pixel event bins, kept between paints to reuse their storage
+    FlagBins m_bins;
 };
 
 /*! \class gLineOverlaySummary
@@ -9,6 +9,10 @@
 #include <math.h>
 #include <QLabel>
 #include <QDateTime>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <typeinfo>
 
 #include "mainwindow.h"
 #include "SleepLib/profiles.h"
@@ -20,6 +24,88 @@ extern MainWindow * mainwin;
 
 short SummaryCalcItem::midcalc;
 
+//! \brief Slices published by one chart for others sharing its signature
+struct SharedSlices {
+    SummaryCacheTag tag;
+    quint32 settings;
+    bool empty;
+    QVector<SummaryChartSlice> slices;
+    QVector<int> calcidx;
+};
+
+// Guards the shared slice store between the GUI thread and the prefetch thread. The prefetch thread
+// populates a chart of its own, and Day records guard their own caches.
+static QMutex summaryMutex;
+static QHash<QString, QHash<QDate, SharedSlices> > sharedSlices;
+
+// Bumped to tell a running prefetch to give up
+static QAtomicInt prefetchEpoch;
+
+static QThreadPool * prefetchPool()
+{
+    static QThreadPool * pool = nullptr;
+    if (!pool) {
+        pool = new QThreadPool();
+        pool->setMaxThreadCount(1);
+
+        // The worker holds Day records, so it has to stop before any are deleted
+        Profile::addDayReader(gSummaryChart::cancelPrefetch);
+    }
+    return pool;
+}
+
+/*! \class SummaryPrefetch
+    \brief Populates a private Clone() of a summary chart for a range of days, publishing the
+           results to the shared slice cache so scrolling the Overview finds them ready.
+    */
+class SummaryPrefetch : public QRunnable
+{
+public:
+    SummaryPrefetch(gSummaryChart * chart, int start, int end)
+        :chart(chart), start(start), end(end), epoch(prefetchEpoch.load()) {}
+    virtual ~SummaryPrefetch() { delete chart; }
+
+    virtual void run() {
+        for (int i = start; i <= end; ++i) {
+            if (epoch != prefetchEpoch.load()) break;
+
+            Day * day = chart->daylist.at(i);
+            if (!day) continue;
+
+            {
+                QMutexLocker locker(&summaryMutex);
+                if (chart->adoptShared(day, i)) continue;
+            }
+
+            // The chart is this task's own, so only the shared store needs the lock
+            day->OpenSummary();
+            chart->populate(day, i);
+            chart->markCached(i, day);
+
+            QMutexLocker locker(&summaryMutex);
+            chart->publishShared(day, i);
+        }
+    }
+protected:
+    gSummaryChart * chart;
+    int start, end;
+    int epoch;
+};
+
+void gSummaryChart::cancelPrefetch()
+{
+    prefetchEpoch.ref();
+    prefetchPool()->clear();
+    prefetchPool()->waitForDone(-1);
+}
+
+void gSummaryChart::clearSharedCache()
+{
+    cancelPrefetch();
+    QMutexLocker locker(&summaryMutex);
+    sharedSlices.clear();
+}
+
 gSummaryChart::gSummaryChart(QString label, MachineType machtype)
     :Layer(NoChannel), m_label(label), m_machtype(machtype)
 {
@@ -33,6 +119,8 @@ gSummaryChart::gSummaryChart(QString label, MachineType machtype)
 
     idx_end = 0;
     idx_start = 0;
+    cachesettings = 0;
+    prefetch_start = prefetch_end = -1;
 }
 
 gSummaryChart::gSummaryChart(ChannelID code, MachineType machtype)
@@ -53,6 +141,8 @@ gSummaryChart::gSummaryChart(ChannelID code, MachineType machtype)
 
     idx_end = 0;
     idx_start = 0;
+    cachesettings = 0;
+    prefetch_start = prefetch_end = -1;
 }
 
 gSummaryChart::~gSummaryChart()
@@ -61,32 +151,52 @@ gSummaryChart::~gSummaryChart()
 
 void gSummaryChart::SetDay(Day *unused_day)
 {
-    cache.clear();
-
     Q_UNUSED(unused_day)
     Layer::SetDay(nullptr);
 
+    // The prefetch thread may be holding Day records that are about to change
+    cancelPrefetch();
+    prefetch_start = prefetch_end = -1;
+
+    QDate oldfirst = firstday;
     firstday = p_profile->FirstDay(m_machtype);
     lastday = p_profile->LastDay(m_machtype);
 
-    dayindex.clear();
-    daylist.clear();
+    if (!firstday.isValid() || !lastday.isValid()) {
+        cache.clear();
+        cachetags.clear();
+        dayindex.clear();
+        daylist.clear();
+        return;
+    }
+
+    if (firstday != oldfirst) {
+        // Cache indexes count from firstday, so they all shift
+        cache.clear();
+        cachetags.clear();
+        dayindex.clear();
+        daylist.clear();
+    }
+
+    // Refresh the Day pointers already indexed and append any new dates. Cached slices stay put;
+    // isCached() throws away any whose Day record or generation no longer matches.
+    int size = firstday.daysTo(lastday) + 1;
+    while (daylist.size() > size) {
+        dayindex.remove(firstday.addDays(daylist.size() - 1));
+        daylist.removeLast();
+    }
+    daylist.reserve(size);
 
-    if (!firstday.isValid() || !lastday.isValid()) return;
-   // daylist.reserve(firstday.daysTo(lastday)+1);
     QDate date = firstday;
-    int idx = 0;
-    do {
-        auto di = p_profile->daylist.find(date);
-        Day * day = nullptr;
-        if (di != p_profile->daylist.end()) {
-            day = di.value();
+    for (int idx = 0; idx < size; ++idx, date = date.addDays(1)) {
+        Day * day = p_profile->FindDay(date);
+        if (idx < daylist.size()) {
+            daylist[idx] = day;
+        } else {
+            daylist.append(day);
+            dayindex[date] = idx;
         }
-        daylist.append(day);
-        dayindex[date] = idx;
-        idx++;
-        date = date.addDays(1);
-    } while (date <= lastday);
+    }
 
     m_minx = QDateTime(firstday, QTime(0,0,0), Qt::UTC).toMSecsSinceEpoch();
     m_maxx = QDateTime(lastday, QTime(23,59,59), Qt::UTC).toMSecsSinceEpoch();
@@ -312,6 +422,132 @@ QString gSummaryChart::tooltipData(Day *, int idx)
     return txt;
 }
 
+bool gSummaryChart::isCached(int idx, Day * day)
+{
+    auto tit = cachetags.find(idx);
+    if (tit == cachetags.end()) return false;
+
+    if (tit.value().matches(day)) return true;
+
+    cachetags.erase(tit);
+    cache.remove(idx);
+    return false;
+}
+
+QVector<SummaryChartSlice> * gSummaryChart::slicesFor(Day * day, int idx)
+{
+    if (!isCached(idx, day)) {
+        if (!adoptShared(day, idx)) {
+            day->OpenSummary();
+            populate(day, idx);
+            markCached(idx, day);
+            publishShared(day, idx);
+        }
+    }
+
+    auto cit = cache.find(idx);
+    return (cit != cache.end()) ? &cit.value() : nullptr;
+}
+
+quint32 gSummaryChart::settingsKey()
+{
+    QString key = QString("%1:%2:%3:%4:%5").arg(p_profile->general->prefCalcMiddle())
+            .arg(p_profile->general->prefCalcPercentile()).arg(p_profile->general->prefCalcMax())
+            .arg(p_profile->cpap->complianceHours()).arg(p_profile->general->calculateRDI());
+    return qHash(key);
+}
+
+QString gSummaryChart::signature()
+{
+    if (m_signature.isEmpty()) {
+        QStringList parts;
+        // The subclasses populate() differently, so the class goes in too
+        parts.append(typeid(*this).name());
+        parts.append(QString::number(m_machtype));
+        for (const auto & calc : calcitems) {
+            parts.append(QString("%1/%2").arg(calc.code).arg(calc.type));
+        }
+        m_signature = parts.join(":");
+    }
+    return m_signature;
+}
+
+bool gSummaryChart::adoptShared(Day * day, int idx)
+{
+    auto sit = sharedSlices.find(signature());
+    if (sit == sharedSlices.end()) return false;
+
+    auto dit = sit.value().find(firstday.addDays(idx));
+    if (dit == sit.value().end()) return false;
+
+    const SharedSlices & shared = dit.value();
+    if (!shared.tag.matches(day) || (shared.settings != cachesettings)) return false;
+
+    if (shared.empty) {
+        cache.remove(idx);
+    } else {
+        QVector<SummaryChartSlice> & slices = cache[idx];
+        slices = shared.slices;
+
+        // Point the slices back at this chart's own calc items
+        for (int i = 0; i < slices.size(); ++i) {
+            int ci = shared.calcidx.at(i);
+            slices[i].calc = ((ci >= 0) && (ci < calcitems.size())) ? &calcitems[ci] : nullptr;
+        }
+    }
+    markCached(idx, day);
+    return true;
+}
+
+void gSummaryChart::publishShared(Day * day, int idx)
+{
+    SharedSlices & shared = sharedSlices[signature()][firstday.addDays(idx)];
+    shared.tag = SummaryCacheTag(day);
+    shared.settings = cachesettings;
+    shared.slices.clear();
+    shared.calcidx.clear();
+
+    auto cit = cache.find(idx);
+    shared.empty = (cit == cache.end());
+    if (shared.empty) return;
+
+    shared.slices = cit.value();
+    const SummaryCalcItem * base = calcitems.constData();
+    for (const auto & slice : shared.slices) {
+        shared.calcidx.append(slice.calc ? int(slice.calc - base) : -1);
+    }
+}
+
+void gSummaryChart::startPrefetch(int start, int end)
+{
+    if (!canPrefetch() || daylist.isEmpty()) return;
+
+    start = qMax(start, 0);
+    end = qMin(end, daylist.size() - 1);
+    if ((prefetch_start >= 0) && (start >= prefetch_start) && (end <= prefetch_end)) return;
+
+    // Skip the queue entirely if everything is already here
+    bool needed = false;
+    for (int i = start; i <= end; ++i) {
+        Day * day = daylist.at(i);
+        if (day && !isCached(i, day)) {
+            needed = true;
+            break;
+        }
+    }
+
+    prefetch_start = start;
+    prefetch_end = end;
+    if (!needed) return;
+
+    gSummaryChart * clone = dynamic_cast<gSummaryChart *>(Clone());
+    if (!clone) return;
+
+    SummaryPrefetch * task = new SummaryPrefetch(clone, start, end);
+    task->setAutoDelete(true);
+    prefetchPool()->start(task);
+}
+
 void gSummaryChart::populate(Day * day, int idx)
 {
 
@@ -390,6 +626,16 @@ void gSummaryChart::populate(Day * day, int idx)
 
 void gSummaryChart::paint(QPainter &painter, gGraph &graph, const QRegion &region)
 {
+    QMutexLocker locker(&summaryMutex);
+
+    quint32 settings = settingsKey();
+    if (settings != cachesettings) {
+        cache.clear();
+        cachetags.clear();
+        cachesettings = settings;
+        prefetch_start = prefetch_end = -1;
+    }
+
     QRectF rect = region.boundingRect();
 
     rect.translate(0.0f, 0.001f);
@@ -483,18 +729,11 @@ void gSummaryChart::paint(QPainter &painter, gGraph &graph, const QRegion &regio
             continue;
         }
 
-        day->OpenSummary();
-
-        auto cit = cache.find(i);
+        QVector<SummaryChartSlice> * slices = slicesFor(day, i);
 
-        if (cit == cache.end()) {
-            populate(day, i);
-            cit = cache.find(i);
-        }
-
-        if (cit != cache.end()) {
+        if (slices) {
             float base = 0, val;
-            for (const auto & slice : cit.value()) {
+            for (const auto & slice : *slices) {
                 val = slice.height;
                 base += val;
             }
@@ -555,19 +794,14 @@ void gSummaryChart::paint(QPainter &painter, gGraph &graph, const QRegion &regio
             hlday = true;
         }
 
-        auto cit = cache.find(idx);
-
-        if (cit == cache.end()) {
-            populate(day, idx);
-            cit = cache.find(idx);
-        }
+        QVector<SummaryChartSlice> * slices = slicesFor(day, idx);
 
         float lastval = 0, val, y1,y2;
-        if (cit != cache.end()) {
+        if (slices) {
             /////////////////////////////////////////////////////////////////////////////////////
             /// Draw pressure settings
             /////////////////////////////////////////////////////////////////////////////////////
-            QVector<SummaryChartSlice> & list = cit.value();
+            QVector<SummaryChartSlice> & list = *slices;
             customCalc(day, list);
 
             QLinearGradient gradient(lastx1, 0, lastx1 + barw, 0); //rect.bottom(), barw, rect.bottom());
@@ -610,6 +844,12 @@ void gSummaryChart::paint(QPainter &painter, gGraph &graph, const QRegion &regio
     painter.setPen(QPen(Qt::black,1));
     painter.drawRects(outlines);
 
+    // Get a screen's worth either side of the visible range ready for scrolling
+    if (!graph.printing()) {
+        int margin = idx_end - idx_start + 1;
+        startPrefetch(idx_start - margin, idx_end + margin);
+    }
+
     if (hl) {
         QColor col2(255,0,0,64);
         painter.fillRect(hl_rect, QBrush(col2));
@@ -802,6 +1042,8 @@ void gSessionTimesChart::afterDraw(QPainter & /*painter */, gGraph &graph, QRect
 
 void gSessionTimesChart::paint(QPainter &painter, gGraph &graph, const QRegion &region)
 {
+    QMutexLocker locker(&summaryMutex);
+
     QRectF rect = region.boundingRect();
 
     painter.setPen(QColor(Qt::black));
@@ -868,9 +1110,7 @@ void gSessionTimesChart::paint(QPainter &painter, gGraph &graph, const QRegion &
             continue;
         }
 
-        auto cit = cache.find(i);
-
-        if (cit == cache.end()) {
+        if (!isCached(i, day)) {
             day->OpenSummary();
             date = it2.key();
             splittime = QDateTime(date, split);
@@ -916,9 +1156,11 @@ void gSessionTimesChart::paint(QPainter &painter, gGraph &graph, const QRegion &
                 }
             }
 
-            cit = cache.find(i);
+            markCached(i, day);
         }
 
+        auto cit = cache.find(i);
+
         if (cit != cache.end()) {
             float peak = 0, base = 999;
 
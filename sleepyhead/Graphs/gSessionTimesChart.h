@@ -154,8 +154,23 @@ struct SummaryChartSlice {
 //    QBrush brush;
 };
 
+//! \brief Identifies the day (by date and Day generation) a cached set of slices was built from.
+//! Day generations are never reused, so a Day record reallocated at the same address can't match
+struct SummaryCacheTag {
+    SummaryCacheTag() : generation(0) {}
+    SummaryCacheTag(Day * day) : date(day->date()), generation(day->generation()) {}
+
+    bool matches(Day * d) const { return (date == d->date()) && (generation == d->generation()); }
+
+    QDate date;
+    quint32 generation;
+};
+
+class SummaryPrefetch;
+
 class gSummaryChart : public Layer
 {
+    friend class SummaryPrefetch;
 public:
     gSummaryChart(QString label, MachineType machtype);
     gSummaryChart(ChannelID code, MachineType machtype);
@@ -185,15 +200,30 @@ public:
     virtual QString tooltipData(Day *, int);
 
     virtual void dataChanged() {
+        cancelPrefetch();
         cache.clear();
+        cachetags.clear();
+        prefetch_start = prefetch_end = -1;
     }
 
+    //! \brief Returns true if populate() may be run on a Clone() of this chart from the prefetch thread
+    virtual bool canPrefetch() { return true; }
+
+    //! \brief Stops background slice prefetching, and waits until the worker has let go of all Day records.
+    //! Registered with Profile::addDayReader(), so it happens before any Day or Session is deleted
+    static void cancelPrefetch();
+
+    //! \brief Empties the slice cache shared by all Overview charts, for when Day records are deleted
+    static void clearSharedCache();
+
 
     void addCalc(ChannelID code, SummaryType type, QColor color) {
         calcitems.append(SummaryCalcItem(code, type, color));
+        m_signature.clear();
     }
     void addCalc(ChannelID code, SummaryType type) {
         calcitems.append(SummaryCalcItem(code, type, schema::channel[code].defaultColor()));
+        m_signature.clear();
     }
 
     virtual Layer * Clone() {
@@ -218,6 +248,8 @@ public:
         layer->idx_start = idx_start;
         layer->idx_end = idx_end;
         layer->cache.clear();
+        layer->cachetags.clear();
+        layer->cachesettings = cachesettings;
         layer->dayindex = dayindex;
         layer->daylist = daylist;
     }
@@ -235,7 +267,32 @@ protected:
     //! \brief Mouse Button was released over this area. (jumps to daily view here)
     virtual bool mouseReleaseEvent(QMouseEvent *event, gGraph *graph);
 
+    //! \brief Returns the slices for day at idx, populating (or borrowing another chart's) when stale. nullptr if there's no data
+    QVector<SummaryChartSlice> * slicesFor(Day * day, int idx);
+
+    //! \brief Returns true if the cache entry for idx was built from the current generation of day, dropping it if not
+    bool isCached(int idx, Day * day);
+
+    //! \brief Records that the cache entry for idx is up to date with day
+    void markCached(int idx, Day * day) { cachetags[idx] = SummaryCacheTag(day); }
+
+    //! \brief Returns a hash of every preference populate() depends on
+    virtual quint32 settingsKey();
+
+    //! \brief Charts with matching signatures (chart class, machine type and calculations) produce identical slices, and share them
+    QString signature();
+
+    //! \brief Copies another chart's slices for day at idx into cache, if current
+    bool adoptShared(Day * day, int idx);
+
+    //! \brief Offers the cached slices for day at idx to other charts with the same signature
+    void publishShared(Day * day, int idx);
+
+    //! \brief Queues a Clone() of this chart to populate days start to end in the background
+    void startPrefetch(int start, int end);
+
     QString m_label;
+    QString m_signature;
     MachineType m_machtype;
     bool m_empty;
     int hl_day;
@@ -248,6 +305,9 @@ protected:
     QList<Day *> daylist;
 
     QHash<int, QVector<SummaryChartSlice> > cache;
+    QHash<int, SummaryCacheTag> cachetags;
+    quint32 cachesettings;
+    int prefetch_start, prefetch_end;
     QVector<SummaryCalcItem> calcitems;
 
     int expected_slices;
@@ -279,9 +339,19 @@ public:
     }
     virtual ~gSessionTimesChart() {}
 
+    //! \brief Session times are built inside paint(), not populate(), so there's nothing to prefetch
+    virtual bool canPrefetch() { return false; }
+
     virtual void SetDay(Day * day = nullptr) {
         gSummaryChart::SetDay(day);
-        split = p_profile->session->daySplitTime();
+
+        QTime newsplit = p_profile->session->daySplitTime();
+        if (newsplit != split) {
+            // Slice positions are relative to the split time
+            cache.clear();
+            cachetags.clear();
+        }
+        split = newsplit;
 
         m_miny = 0;
         m_maxy = 28;
@@ -0,0 +1,458 @@
+/* SleepLib Arrow IPC File Writer Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+#include "arrowwriter.h"
+
+// Enumerations and field numbers from Arrow's Schema.fbs, Message.fbs and File.fbs
+const qint16 arrow_metadata_v5 = 4;
+const quint8 arrow_header_schema = 1;
+const quint8 arrow_header_recordbatch = 3;
+
+const quint8 arrow_type_int = 2;
+const quint8 arrow_type_floatingpoint = 3;
+const quint8 arrow_type_utf8 = 5;
+const quint8 arrow_type_timestamp = 10;
+
+const char arrow_magic[] = "ARROW1";
+
+/*! \class FlatBuilder
+    \brief Just enough of a FlatBuffers builder for Arrow's metadata.
+
+    Like the real one, it builds back to front, so everything a table points at has to be
+    created before the table is started, and only one table can be under construction at a time.
+    Offsets are counted back from the end of the buffer until finish() lays it out.
+    */
+class FlatBuilder
+{
+  public:
+    FlatBuilder() : m_minalign(4), m_tablestart(0) {}
+
+    quint32 size() const { return m_buf.size(); }
+
+    //! \brief Pads so that after another additional bytes the size is a multiple of alignment
+    void align(int alignment, int additional = 0) {
+        if (alignment > m_minalign) m_minalign = alignment;
+        int padding = (-(m_buf.size() + additional)) & (alignment - 1);
+        if (padding) m_buf.prepend(QByteArray(padding, 0));
+    }
+
+    template<typename T> void push(T value) {
+        value = qToLittleEndian(value);
+        m_buf.prepend(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    //! \brief Adds a scalar, aligned to its size
+    template<typename T> void add(T value) {
+        align(sizeof(T));
+        push(value);
+    }
+
+    //! \brief Adds an offset pointing at something already built
+    void addOffset(quint32 target) {
+        align(4);
+        push<quint32>(size() + 4 - target);
+    }
+
+    quint32 createString(const QString &str) {
+        QByteArray utf8 = str.toUtf8();
+        align(4, utf8.size() + 1);
+        push<quint8>(0);
+        m_buf.prepend(utf8);
+        push<quint32>(utf8.size());
+        return size();
+    }
+
+    //! \brief Creates a vector of count structs or scalars, packed little endian into elems
+    quint32 createVector(const QByteArray &elems, int count, int alignment) {
+        align(4, elems.size());
+        align(alignment, elems.size());
+        m_buf.prepend(elems);
+        push<quint32>(count);
+        return size();
+    }
+
+    //! \brief Creates a vector of offsets to tables or strings
+    quint32 createVector(const QVector<quint32> &offsets) {
+        align(4, offsets.size() * 4);
+        for (int i = offsets.size() - 1; i >= 0; --i) {
+            push<quint32>(size() + 4 - offsets.at(i));
+        }
+        push<quint32>(offsets.size());
+        return size();
+    }
+
+    void startTable() {
+        m_fields.clear();
+        m_tablestart = size();
+    }
+
+    template<typename T> void addField(int id, T value) {
+        add(value);
+        m_fields.append(qMakePair(id, size()));
+    }
+
+    void addOffsetField(int id, quint32 target) {
+        addOffset(target);
+        m_fields.append(qMakePair(id, size()));
+    }
+
+    quint32 endTable() {
+        // The table starts with a signed offset back to its vtable, filled in once that's placed
+        add<qint32>(0);
+        quint32 table = size();
+
+        int count = 0;
+        for (const auto & field : m_fields) {
+            count = qMax(count, field.first + 1);
+        }
+
+        QVector<quint16> vtable(count, 0);
+        for (const auto & field : m_fields) {
+            vtable[field.first] = table - field.second;
+        }
+        for (int i = count - 1; i >= 0; --i) {
+            push<quint16>(vtable.at(i));
+        }
+        push<quint16>(table - m_tablestart);
+        push<quint16>((count + 2) * 2);
+
+        qint32 soffset = qToLittleEndian<qint32>(size() - table);
+        memcpy(m_buf.data() + m_buf.size() - table, &soffset, sizeof(soffset));
+
+        m_fields.clear();
+        return table;
+    }
+
+    //! \brief Adds the root offset and returns the finished buffer
+    QByteArray finish(quint32 root) {
+        align(m_minalign, 4);
+        push<quint32>(size() + 4 - root);
+        return m_buf;
+    }
+
+  protected:
+    QByteArray m_buf;
+    int m_minalign;
+
+    quint32 m_tablestart;
+    QList<QPair<int, quint32> > m_fields;
+};
+
+static void packLE(QByteArray &out, qint64 value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static int typeWidth(ArrowType type)
+{
+    switch (type) {
+    case ARROW_UInt8:
+        return 1;
+    case ARROW_Int16:
+        return 2;
+    case ARROW_UInt32:
+    case ARROW_Float32:
+        return 4;
+    case ARROW_Int64:
+    case ARROW_Float64:
+    case ARROW_Timestamp:
+        return 8;
+    case ARROW_Utf8:
+        break;
+    }
+    return 0;
+}
+
+static quint32 buildField(FlatBuilder &fb, const ArrowField &field)
+{
+    quint32 name = fb.createString(field.name);
+    quint32 timezone = (field.type == ARROW_Timestamp) ? fb.createString("UTC") : 0;
+    quint32 children = fb.createVector(QVector<quint32>());
+
+    quint8 typetype;
+    fb.startTable();
+
+    switch (field.type) {
+    case ARROW_UInt8:
+    case ARROW_Int16:
+    case ARROW_UInt32:
+    case ARROW_Int64:
+        typetype = arrow_type_int;
+        fb.addField<qint32>(0, typeWidth(field.type) * 8);                     // bitWidth
+        fb.addField<quint8>(1, (field.type == ARROW_Int16) || (field.type == ARROW_Int64)); // is_signed
+        break;
+    case ARROW_Float32:
+    case ARROW_Float64:
+        typetype = arrow_type_floatingpoint;
+        fb.addField<qint16>(0, (field.type == ARROW_Float32) ? 1 : 2);         // precision: SINGLE, DOUBLE
+        break;
+    case ARROW_Timestamp:
+        typetype = arrow_type_timestamp;
+        fb.addField<qint16>(0, 1);                                              // unit: MILLISECOND
+        fb.addOffsetField(1, timezone);
+        break;
+    case ARROW_Utf8:
+    default:
+        typetype = arrow_type_utf8;
+        break;
+    }
+    quint32 type = fb.endTable();
+
+    fb.startTable();
+    fb.addOffsetField(0, name);
+    fb.addField<quint8>(1, 0);          // nullable
+    fb.addField<quint8>(2, typetype);
+    fb.addOffsetField(3, type);
+    fb.addOffsetField(5, children);
+    return fb.endTable();
+}
+
+static quint32 buildSchema(FlatBuilder &fb, const QList<ArrowField> &fields,
+                           const QList<QPair<QString, QString> > &metadata)
+{
+    QVector<quint32> fieldtables;
+    for (const auto & field : fields) {
+        fieldtables.append(buildField(fb, field));
+    }
+    quint32 fieldvec = fb.createVector(fieldtables);
+
+    QVector<quint32> keyvalues;
+    for (const auto & kv : metadata) {
+        quint32 key = fb.createString(kv.first);
+        quint32 value = fb.createString(kv.second);
+        fb.startTable();
+        fb.addOffsetField(0, key);
+        fb.addOffsetField(1, value);
+        keyvalues.append(fb.endTable());
+    }
+    quint32 metavec = fb.createVector(keyvalues);
+
+    fb.startTable();
+    fb.addField<qint16>(0, (Q_BYTE_ORDER == Q_BIG_ENDIAN) ? 1 : 0);    // endianness
+    fb.addOffsetField(1, fieldvec);
+    fb.addOffsetField(2, metavec);
+    return fb.endTable();
+}
+
+static QByteArray buildMessage(FlatBuilder &fb, quint8 headertype, quint32 header, qint64 bodylength)
+{
+    fb.startTable();
+    fb.addField<qint64>(3, bodylength);
+    fb.addOffsetField(2, header);
+    fb.addField<qint16>(0, arrow_metadata_v5);
+    fb.addField<quint8>(1, headertype);
+    return fb.finish(fb.endTable());
+}
+
+void ArrowColumn::append(const QString &str)
+{
+    m_data.append(str.toUtf8());
+    m_length++;
+
+    qint32 end = m_data.size();
+    m_offsets.append(reinterpret_cast<const char *>(&end), sizeof(end));
+}
+
+void ArrowColumn::reserve(int count)
+{
+    int width = typeWidth(m_type);
+    if (width > 0) {
+        m_data.reserve(m_data.size() + count * width);
+    }
+}
+
+void ArrowColumn::clear()
+{
+    m_data.clear();
+    m_offsets.clear();
+    m_length = 0;
+
+    if (m_type == ARROW_Utf8) {
+        qint32 start = 0;
+        m_offsets.append(reinterpret_cast<const char *>(&start), sizeof(start));
+    }
+}
+
+ArrowFileWriter::ArrowFileWriter(const QList<ArrowField> &fields, const QList<QPair<QString, QString> > &metadata)
+    : m_fields(fields), m_metadata(metadata), m_pos(0), m_ok(false)
+{
+}
+
+bool ArrowFileWriter::writeRaw(const char *data, qint64 size)
+{
+    if (!m_ok) return false;
+
+    if (m_file.write(data, size) != size) {
+        qWarning() << "ArrowFileWriter couldn't write" << m_file.fileName();
+        m_ok = false;
+        return false;
+    }
+    m_pos += size;
+    return true;
+}
+
+bool ArrowFileWriter::pad()
+{
+    static const char zeros[8] = { 0 };
+    int padding = (-m_pos) & 7;
+    return writeRaw(zeros, padding);
+}
+
+bool ArrowFileWriter::open(const QString &filename)
+{
+    m_file.setFileName(filename);
+    m_pos = 0;
+    m_blocks.clear();
+
+    m_ok = m_file.open(QFile::WriteOnly);
+    if (!m_ok) {
+        qWarning() << "ArrowFileWriter couldn't open" << filename;
+        return false;
+    }
+
+    writeRaw(arrow_magic, 6);
+    pad();
+
+    FlatBuilder fb;
+    quint32 schema = buildSchema(fb, m_fields, m_metadata);
+    QByteArray meta = buildMessage(fb, arrow_header_schema, schema, 0);
+
+    return writeMessage(meta, QList<QByteArray>(), 0);
+}
+
+bool ArrowFileWriter::writeMessage(const QByteArray &meta, const QList<QByteArray> &buffers, qint64 bodylength)
+{
+    // Continuation marker and metadata length, then the metadata padded so the body starts on 8 bytes
+    qint32 metalength = (meta.size() + 7) & ~7;
+    qint32 prefix[2] = { qToLittleEndian<qint32>(-1), qToLittleEndian<qint32>(metalength) };
+
+    Block block;
+    block.offset = m_pos;
+    block.metalength = metalength + sizeof(prefix);
+    block.bodylength = bodylength;
+
+    writeRaw(reinterpret_cast<const char *>(prefix), sizeof(prefix));
+    writeRaw(meta.constData(), meta.size());
+    pad();
+
+    for (const auto & buffer : buffers) {
+        writeRaw(buffer.constData(), buffer.size());
+        pad();
+    }
+
+    if (m_ok && (bodylength > 0)) {
+        m_blocks.append(block);
+    }
+    return m_ok;
+}
+
+bool ArrowFileWriter::write(const QVector<ArrowColumn> &columns)
+{
+    if (!m_ok) return false;
+
+    if (columns.size() != m_fields.size()) {
+        qWarning() << "ArrowFileWriter::write() given" << columns.size() << "columns for" << m_fields.size() << "fields";
+        return false;
+    }
+
+    qint64 length = columns.isEmpty() ? 0 : columns.at(0).length();
+
+    QByteArray nodes, bufferspecs;
+    QList<QByteArray> buffers;
+    qint64 offset = 0;
+
+    for (const auto & column : columns) {
+        if (column.length() != length) {
+            qWarning() << "ArrowFileWriter::write() given columns of different lengths";
+            return false;
+        }
+
+        packLE(nodes, length);
+        packLE(nodes, 0);                       // null_count
+
+        // No validity bitmap, as nothing is null
+        packLE(bufferspecs, offset);
+        packLE(bufferspecs, 0);
+
+        QList<QByteArray> colbuffers;
+        if (column.type() == ARROW_Utf8) {
+            colbuffers << column.offsets();
+        }
+        colbuffers << column.data();
+
+        for (const auto & buffer : colbuffers) {
+            packLE(bufferspecs, offset);
+            packLE(bufferspecs, buffer.size());
+            offset += (buffer.size() + 7) & ~7;
+            buffers << buffer;
+        }
+    }
+
+    FlatBuilder fb;
+    quint32 nodevec = fb.createVector(nodes, columns.size(), 8);
+    quint32 buffervec = fb.createVector(bufferspecs, bufferspecs.size() / 16, 8);
+
+    fb.startTable();
+    fb.addField<qint64>(0, length);
+    fb.addOffsetField(1, nodevec);
+    fb.addOffsetField(2, buffervec);
+    quint32 batch = fb.endTable();
+
+    return writeMessage(buildMessage(fb, arrow_header_recordbatch, batch, offset), buffers, offset);
+}
+
+bool ArrowFileWriter::commit()
+{
+    // End of stream marker
+    qint32 eos[2] = { qToLittleEndian<qint32>(-1), 0 };
+    writeRaw(reinterpret_cast<const char *>(eos), sizeof(eos));
+
+    FlatBuilder fb;
+    quint32 schema = buildSchema(fb, m_fields, m_metadata);
+
+    QByteArray blocks;
+    for (const auto & block : m_blocks) {
+        packLE(blocks, block.offset);
+        packLE(blocks, quint32(block.metalength));   // and the struct's 4 bytes of padding
+        packLE(blocks, block.bodylength);
+    }
+    quint32 batchvec = fb.createVector(blocks, m_blocks.size(), 8);
+    quint32 dictvec = fb.createVector(QByteArray(), 0, 8);
+
+    fb.startTable();
+    fb.addOffsetField(1, schema);
+    fb.addOffsetField(2, dictvec);
+    fb.addOffsetField(3, batchvec);
+    fb.addField<qint16>(0, arrow_metadata_v5);
+    QByteArray footer = fb.finish(fb.endTable());
+
+    writeRaw(footer.constData(), footer.size());
+
+    qint32 footerlength = qToLittleEndian<qint32>(footer.size());
+    writeRaw(reinterpret_cast<const char *>(&footerlength), sizeof(footerlength));
+    writeRaw(arrow_magic, 6);
+
+    if (!m_ok) {
+        m_file.cancelWriting();
+        return false;
+    }
+
+    m_ok = false;
+    return m_file.commit();
+}
+
+void ArrowFileWriter::cancel()
+{
+    m_ok = false;
+    m_file.cancelWriting();
+}
@@ -0,0 +1,138 @@
+/* SleepLib Arrow IPC File Writer Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <QSaveFile>
+
+//! \brief The column types ArrowFileWriter can write
+enum ArrowType {
+    ARROW_UInt8, ARROW_Int16, ARROW_UInt32, ARROW_Int64, ARROW_Float32, ARROW_Float64,
+    ARROW_Timestamp, ARROW_Utf8
+};
+
+/*! \struct ArrowField
+    \brief A column's name and type. ARROW_Timestamp columns hold milliseconds since epoch, UTC
+    */
+struct ArrowField
+{
+    ArrowField() : type(ARROW_Int16) {}
+    ArrowField(const QString &name, ArrowType type) : name(name), type(type) {}
+
+    QString name;
+    ArrowType type;
+};
+
+/*! \class ArrowColumn
+    \brief The values of one column of a record batch, in Arrow's in-memory layout
+    */
+class ArrowColumn
+{
+  public:
+    ArrowColumn(ArrowType type = ARROW_Int16) : m_type(type), m_length(0) { clear(); }
+
+    //! \brief Appends a value. T must match the column type (qint64 for ARROW_Timestamp)
+    template<typename T> inline void append(T value) {
+        m_data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        m_length++;
+    }
+
+    //! \brief Appends count values at once
+    template<typename T> void append(const T *values, int count) {
+        m_data.append(reinterpret_cast<const char *>(values), count * int(sizeof(T)));
+        m_length += count;
+    }
+
+    //! \brief Appends a string to an ARROW_Utf8 column
+    void append(const QString &str);
+
+    //! \brief Makes room for count more values, so a column whose size is known grows its storage once
+    void reserve(int count);
+
+    //! \brief Empties the column, keeping its type
+    void clear();
+
+    ArrowType type() const { return m_type; }
+    int length() const { return m_length; }
+
+    //! \brief The values, or for ARROW_Utf8 the concatenated string bytes
+    QByteArray &data() { return m_data; }
+    const QByteArray &data() const { return m_data; }
+
+    //! \brief The string end offsets of an ARROW_Utf8 column (length + 1 of them); empty otherwise
+    const QByteArray &offsets() const { return m_offsets; }
+
+  protected:
+    ArrowType m_type;
+    int m_length;
+    QByteArray m_data;
+    QByteArray m_offsets;
+};
+
+/*! \class ArrowFileWriter
+    \brief Writes a table in the Apache Arrow IPC file format (Feather V2), one record batch at a time.
+
+    The files can be read directly by pyarrow, R's arrow, pandas and DuckDB, with no parsing.
+    Only flat, non-null columns are supported, which is all the exports need, and the small
+    amount of FlatBuffers metadata the format wants is encoded by hand. Column values are
+    written in the host's byte order, which the schema records.
+    */
+class ArrowFileWriter
+{
+  public:
+    //! \brief metadata is stored as key/value pairs in the schema
+    ArrowFileWriter(const QList<ArrowField> &fields,
+                    const QList<QPair<QString, QString> > &metadata = QList<QPair<QString, QString> >());
+
+    //! \brief Starts writing to filename, which only replaces it once commit() succeeds
+    bool open(const QString &filename);
+
+    //! \brief Writes a record batch. There must be one column per field, in order, all the same length
+    bool write(const QVector<ArrowColumn> &columns);
+
+    //! \brief Writes the footer and puts the file in place
+    bool commit();
+
+    //! \brief Throws away everything written so far
+    void cancel();
+
+    const QList<ArrowField> &fields() const { return m_fields; }
+
+  protected:
+    //! \brief Writes a message: the FlatBuffers metadata, then the body buffers, each padded to 8 bytes
+    bool writeMessage(const QByteArray &meta, const QList<QByteArray> &buffers, qint64 bodylength);
+
+    //! \brief Writes bytes to the file, keeping count of the position
+    bool writeRaw(const char *data, qint64 size);
+
+    //! \brief Writes zeros until the file position is a multiple of 8
+    bool pad();
+
+    QList<ArrowField> m_fields;
+    QList<QPair<QString, QString> > m_metadata;
+
+    QSaveFile m_file;
+    qint64 m_pos;
+    bool m_ok;
+
+    //! \brief Where each record batch starts, its metadata length, and its body length, for the footer
+    struct Block {
+        qint64 offset;
+        qint32 metalength;
+        qint64 bodylength;
+    };
+    QList<Block> m_blocks;
+};
+
+#endif // ARROWWRITER_H
@@ -0,0 +1,300 @@
+/* SleepLib Backup Engine Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#ifdef _MSC_VER
+#include "QtZlib/zlib.h"
+#else
+#include "zlib.h"
+#endif
+
+#include "backupengine.h"
+#include "appsettings.h"
+
+const QString backup_manifest_name = "backup.manifest";
+
+// Files are read and written a chunk at a time, so big ones don't have to fit in memory
+const qint64 backup_chunk_size = 256 * 1024;
+
+//! \brief Works out the crc32 of file's contents, a chunk at a time
+static bool fileCrc(const QString &filename, quint32 &crc)
+{
+    QFile f(filename);
+    if (!f.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray buffer;
+    crc = crc32(0L, Z_NULL, 0);
+
+    while (!(buffer = f.read(backup_chunk_size)).isEmpty()) {
+        crc = crc32(crc, (const Bytef *)buffer.constData(), buffer.size());
+    }
+    return f.error() == QFile::NoError;
+}
+
+void BackupTask::run()
+{
+    QFileInfo fi(src);
+    if (!fi.exists()) {
+        return;
+    }
+
+    // Importing from the backup folder itself
+    if (QDir::cleanPath(fi.absoluteFilePath()) == QDir::cleanPath(QFileInfo(dst).absoluteFilePath())) {
+        return;
+    }
+
+    qint64 size = fi.size();
+    qint64 modified = fi.lastModified().toMSecsSinceEpoch();
+
+    bool exists = QFile::exists(dst);
+    BackupEntry entry;
+    bool known = exists && engine->lookup(dst, entry);
+
+    // Backups without a manifest entry are always rewritten, as nothing says what they were made
+    // from; rolling files like STR.edf would otherwise keep an old copy for good
+    if (known && (entry.size == size)) {
+        if (entry.modified == modified) {
+            removeObsolete();
+            engine->m_skipped.ref();
+            return;
+        }
+
+        // Only touched, so it's worth reading through to see if the contents changed
+        quint32 crc;
+        if (fileCrc(src, crc) && (crc == entry.crc)) {
+            engine->record(dst, BackupEntry(size, modified, crc));
+            removeObsolete();
+            engine->m_skipped.ref();
+            return;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(dst).absolutePath());
+
+    // Write alongside, so an interrupted backup never leaves a truncated file in place
+    QString tmpname = dst + ".tmp";
+    QFile::remove(tmpname);
+
+    bool ok = false;
+    quint32 crc = crc32(0L, Z_NULL, 0);
+
+    if (mode == BACKUP_Uncompress) {
+        // The manifest holds the crc of the compressed source, not of what's written
+        gzFile gz = gzopen(QFile::encodeName(src).constData(), "rb");
+        QFile out(tmpname);
+        if (gz && out.open(QFile::WriteOnly) && fileCrc(src, crc)) {
+            QByteArray buffer(backup_chunk_size, 0);
+            int bytes;
+            ok = true;
+            while ((bytes = gzread(gz, buffer.data(), buffer.size())) > 0) {
+                if (out.write(buffer.constData(), bytes) != bytes) {
+                    ok = false;
+                    break;
+                }
+            }
+            ok = ok && (bytes == 0);
+        }
+        out.close();
+        if (gz) gzclose(gz);
+    } else {
+        QFile in(src);
+        if (!in.open(QFile::ReadOnly)) {
+            qDebug() << "BackupTask couldn't open" << src;
+            return;
+        }
+
+        gzFile gz = nullptr;
+        QFile out(tmpname);
+
+        if (mode == BACKUP_Compress) {
+            gz = gzopen(QFile::encodeName(tmpname).constData(), "wb");
+            ok = (gz != nullptr);
+        } else {
+            ok = out.open(QFile::WriteOnly);
+        }
+
+        QByteArray buffer;
+        while (ok && !(buffer = in.read(backup_chunk_size)).isEmpty()) {
+            crc = crc32(crc, (const Bytef *)buffer.constData(), buffer.size());
+
+            if (gz) {
+                ok = (gzwrite(gz, buffer.constData(), buffer.size()) == buffer.size());
+            } else {
+                ok = (out.write(buffer) == buffer.size());
+            }
+        }
+        ok = ok && (in.error() == QFile::NoError);
+
+        if (gz) {
+            ok = (gzclose(gz) == Z_OK) && ok;
+        }
+        out.close();
+    }
+
+    if (!ok || (exists && !QFile::remove(dst)) || !QFile::rename(tmpname, dst)) {
+        qDebug() << "BackupTask couldn't write" << dst;
+        QFile::remove(tmpname);
+        return;
+    }
+
+    removeObsolete();
+
+    engine->record(dst, BackupEntry(size, modified, crc));
+    engine->m_written.ref();
+}
+
+void BackupTask::removeObsolete()
+{
+    for (const auto & name : obsolete) {
+        QFile::exists(name) && QFile::remove(name);
+    }
+}
+
+BackupEngine::BackupEngine(const QString &root)
+    : m_root(root), m_dirty(false)
+{
+    if (!m_root.endsWith("/")) {
+        m_root += "/";
+    }
+
+    // Copying is disk bound and the import's own threads already fill the cores, so a couple of
+    // workers keep the card busy without crowding them out. With multithreading off it still
+    // overlaps the import, it just doesn't spread out
+    m_pool.setMaxThreadCount(AppSetting->multithreading() ? qBound(1, QThread::idealThreadCount() / 2, 2) : 1);
+
+    loadManifest();
+}
+
+BackupEngine::~BackupEngine()
+{
+    waitForDone();
+}
+
+BackupMode BackupEngine::modeFor(const QString &src, bool compress)
+{
+    bool gz = src.endsWith(".gz", Qt::CaseInsensitive);
+
+    if (compress && !gz) return BACKUP_Compress;
+    if (!compress && gz) return BACKUP_Uncompress;
+
+    return BACKUP_Copy;
+}
+
+void BackupEngine::queue(const QString &src, const QString &dst, BackupMode mode, const QStringList &obsolete)
+{
+    BackupTask *task = new BackupTask(this, src, dst, mode, obsolete);
+    task->setAutoDelete(true);
+    m_pool.start(task);
+}
+
+void BackupEngine::queuePath(const QString &src, const QString &dst)
+{
+    QDir dir(src);
+    if (!dir.exists())
+        return;
+
+    // Recursively handle directories
+    for (const auto & d : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QString dst_path = dst + QDir::separator() + d;
+        dir.mkpath(dst_path);
+        queuePath(src + QDir::separator() + d, dst_path);
+    }
+
+    for (const auto & f : dir.entryList(QDir::Files)) {
+        queue(src + QDir::separator() + f, dst + QDir::separator() + f);
+    }
+}
+
+void BackupEngine::waitForDone()
+{
+    m_pool.waitForDone(-1);
+    saveManifest();
+}
+
+QString BackupEngine::key(const QString &dst) const
+{
+    QString path = QDir::cleanPath(QFileInfo(dst).absoluteFilePath());
+    return QDir(m_root).relativeFilePath(path);
+}
+
+bool BackupEngine::lookup(const QString &dst, BackupEntry &entry)
+{
+    QString k = key(dst);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_manifest.find(k);
+    if (it == m_manifest.end()) {
+        return false;
+    }
+    entry = it.value();
+    return true;
+}
+
+void BackupEngine::record(const QString &dst, const BackupEntry &entry)
+{
+    QString k = key(dst);
+
+    QMutexLocker locker(&m_mutex);
+    m_manifest[k] = entry;
+    m_dirty = true;
+}
+
+void BackupEngine::loadManifest()
+{
+    QFile f(m_root + backup_manifest_name);
+    if (!f.open(QFile::ReadOnly | QFile::Text)) {
+        return;
+    }
+
+    QTextStream in(&f);
+    in.setCodec("UTF-8");
+
+    while (!in.atEnd()) {
+        QStringList fields = in.readLine().split("\t");
+        if (fields.size() != 4) continue;
+
+        bool ok1, ok2, ok3;
+        BackupEntry entry(fields[1].toLongLong(&ok1), fields[2].toLongLong(&ok2), fields[3].toUInt(&ok3, 16));
+        if (ok1 && ok2 && ok3) {
+            m_manifest[fields[0]] = entry;
+        }
+    }
+}
+
+void BackupEngine::saveManifest()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_dirty) return;
+
+    QDir().mkpath(m_root);
+
+    QFile f(m_root + backup_manifest_name);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+        qDebug() << "Couldn't write backup manifest" << f.fileName();
+        return;
+    }
+
+    QTextStream out(&f);
+    out.setCodec("UTF-8");
+
+    for (auto it = m_manifest.begin(), end = m_manifest.end(); it != end; ++it) {
+        const BackupEntry & e = it.value();
+        out << it.key() << "\t" << e.size << "\t" << e.modified << "\t" << QString::number(e.crc, 16) << "\n";
+    }
+    m_dirty = false;
+}
@@ -0,0 +1,123 @@
+/* SleepLib Backup Engine Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef BACKUPENGINE_H
+#define BACKUPENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThreadPool>
+
+class BackupEngine;
+
+//! \brief How a backup job turns its source into its destination
+enum BackupMode { BACKUP_Copy, BACKUP_Compress, BACKUP_Uncompress };
+
+/*! \struct BackupEntry
+    \brief What a backed up file was made from, as remembered in the manifest */
+struct BackupEntry
+{
+    BackupEntry() : size(0), modified(0), crc(0) {}
+    BackupEntry(qint64 size, qint64 modified, quint32 crc) : size(size), modified(modified), crc(crc) {}
+
+    //! \brief Size and last modified time (in ms since epoch) of the source file
+    qint64 size;
+    qint64 modified;
+
+    //! \brief crc32 of the source file's contents
+    quint32 crc;
+};
+
+/*! \class BackupTask
+    \brief Backs up a single file on one of BackupEngine's worker threads
+    */
+class BackupTask : public QRunnable
+{
+  public:
+    BackupTask(BackupEngine *engine, const QString &src, const QString &dst, BackupMode mode, const QStringList &obsolete)
+        : engine(engine), src(src), dst(dst), mode(mode), obsolete(obsolete) {}
+    virtual ~BackupTask() {}
+
+    virtual void run();
+
+  protected:
+    //! \brief Removes the files the backup replaces
+    void removeObsolete();
+
+    BackupEngine *engine;
+    QString src;
+    QString dst;
+    BackupMode mode;
+
+    //! \brief Files the new backup replaces, removed once it's written
+    QStringList obsolete;
+};
+
+/*! \class BackupEngine
+    \brief Copies SD card files into a machine's backup folder in the background, while the import carries on.
+
+    A manifest in the backup folder records the size, modification time and crc32 of the source
+    each backup was made from. Files that match it are skipped without being read, and files that
+    were only touched are read and hashed but not rewritten, so importing the same card again costs
+    next to nothing. Backups the manifest doesn't know about are rewritten. Files are streamed a
+    chunk at a time, never read whole.
+
+    Jobs are queued from the import thread. The destructor waits for them and saves the manifest.
+    */
+class BackupEngine
+{
+    friend class BackupTask;
+
+  public:
+    //! \brief Backs up into the folder root, where the manifest is kept
+    BackupEngine(const QString &root);
+    ~BackupEngine();
+
+    //! \brief Queues src to be backed up to dst. Files in obsolete are removed after dst has been written.
+    void queue(const QString &src, const QString &dst, BackupMode mode = BACKUP_Copy,
+               const QStringList &obsolete = QStringList());
+
+    //! \brief Queues every file in the src folder tree to be copied into the dst folder tree
+    void queuePath(const QString &src, const QString &dst);
+
+    //! \brief Waits for all the queued jobs to finish, and saves the manifest
+    void waitForDone();
+
+    //! \brief Returns the BackupMode that gets src into a compressed, or uncompressed, backup
+    static BackupMode modeFor(const QString &src, bool compress);
+
+    //! \brief Number of files written, and left alone because they were already backed up
+    int written() const { return m_written.load(); }
+    int skipped() const { return m_skipped.load(); }
+
+  protected:
+    void loadManifest();
+    void saveManifest();
+
+    //! \brief Returns the manifest key for dst, which is relative to m_root
+    QString key(const QString &dst) const;
+
+    bool lookup(const QString &dst, BackupEntry &entry);
+    void record(const QString &dst, const BackupEntry &entry);
+
+    QString m_root;
+    QThreadPool m_pool;
+
+    QMutex m_mutex;
+    QHash<QString, BackupEntry> m_manifest;
+    bool m_dirty;
+
+    QAtomicInt m_written;
+    QAtomicInt m_skipped;
+};
+
+#endif // BACKUPENGINE_H
@@ -0,0 +1,298 @@
+/* SleepLib CSV Export Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSaveFile>
+
+#include "csvexport.h"
+#include "profiles.h"
+#include "session.h"
+#include "day.h"
+
+const char csv_sep = ',';
+const char csv_newline = '\n';
+
+static QByteArray csvDateTime(qint64 time)
+{
+    return QDateTime::fromTime_t(time / 1000L).toString(Qt::ISODate).toLatin1();
+}
+
+static QByteArray csvDuration(qint64 length)
+{
+    int time = length / 1000L;
+    char buf[32];
+    qsnprintf(buf, sizeof(buf), "%02i:%02i:%02i", time / 3600, int(time / 60) % 60, int(time) % 60);
+    return QByteArray(buf);
+}
+
+void CSVExportTask::prepare()
+{
+    for (const auto & day : days) {
+        if (queue->cancelled()) return;
+        dayRows(day);
+    }
+
+    for (const auto & file : files) {
+        if (queue->cancelled()) break;
+        detailRows(file.first, file.second);
+    }
+}
+
+void CSVExportTask::dayRows(Day *day)
+{
+    const QList<ChannelID> &countlist = exporter->m_countlist;
+    const QList<ChannelID> &avglist = exporter->m_avglist;
+    const QList<ChannelID> &p90list = exporter->m_p90list;
+    const QList<ChannelID> &maxlist = exporter->m_maxlist;
+    EventDataType percent = exporter->m_percent;
+
+    if (exporter->m_mode == CSV_Summary) {
+        CSVRowValues row;
+        row.date = day->date();
+        row.number = day->size();
+        row.first = day->first();
+        row.last = day->last();
+        row.length = day->total_time();
+        row.ahi = day->count(CPAP_Obstructive) + day->count(CPAP_Hypopnea) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
+        row.ahi /= day->hours();
+
+        for (const auto & code : countlist) row.values.append(day->count(code));
+        for (const auto & code : avglist) row.values.append(day->calcMiddle(code));
+        for (const auto & code : p90list) row.values.append(day->percentile(code, percent));
+        for (const auto & code : maxlist) row.values.append(day->calcMax(code));
+
+        formatRow(row);
+        return;
+    }
+
+    for (auto & sess : day->sessions) {
+        CSVRowValues row;
+        row.date = day->date();
+        row.number = sess->session();
+        row.first = sess->first();
+        row.last = sess->last();
+        row.length = sess->length();
+        row.ahi = sess->count(CPAP_Obstructive) + sess->count(CPAP_Hypopnea) + sess->count(CPAP_Apnea) + sess->count(CPAP_ClearAirway);
+        row.ahi /= sess->hours();
+
+        for (const auto & code : countlist) row.values.append(sess->count(code));
+        for (const auto & code : avglist) row.values.append(sess->calcMiddle(code));
+        for (const auto & code : p90list) row.values.append(sess->percentile(code, percent));
+        for (const auto & code : maxlist) row.values.append(sess->calcMax(code));
+
+        formatRow(row);
+    }
+}
+
+void CSVExportTask::formatRow(const CSVRowValues &row)
+{
+    data += row.date.toString(Qt::ISODate).toLatin1();
+    data += csv_sep + QByteArray::number(row.number);
+    data += csv_sep + csvDateTime(row.first);
+    data += csv_sep + csvDateTime(row.last);
+    data += csv_sep + csvDuration(row.length);
+    data += csv_sep + QByteArray::number(row.ahi, 'f', 3);
+
+    for (const auto & value : row.values) {
+        data += csv_sep + QByteArray::number(value);
+    }
+
+    data += csv_newline;
+}
+
+void CSVExportTask::detailRows(SessionID session, const QString &filename)
+{
+    // Always read from disk, so nothing the GUI thread has open is touched
+    SessionEventData events;
+    if (!Session::ReadEvents(filename, events)) return;
+
+    QByteArray sessionid = QByteArray::number(qint64(session));
+
+    for (const auto & channel : exporter->m_detaillist) {
+        auto fnd = events.eventlist.find(channel.first);
+        if (fnd == events.eventlist.end()) continue;
+
+        // Neighbouring events mostly share a second, so the timestamp rarely needs formatting again
+        qint64 lastsecond = -1;
+        QByteArray timestamp;
+
+        for (const auto & ev : fnd.value()) {
+            for (quint32 q = 0, cnt = ev->count(); q < cnt; ++q) {
+                if (queue->cancelled()) return;
+
+                qint64 time = ev->time(q);
+                if ((time / 1000L) != lastsecond) {
+                    lastsecond = time / 1000L;
+                    timestamp = csvDateTime(time);
+                }
+
+                data += timestamp;
+                data += csv_sep + sessionid;
+                data += csv_sep + channel.second;
+                data += csv_sep + QByteArray::number(ev->data(q), 'f', 2);
+                data += csv_newline;
+            }
+        }
+    }
+}
+
+CSVExporter::CSVExporter(CSVExportMode mode, QDate start, QDate end)
+    : m_mode(mode), m_start(start), m_end(end)
+{
+    m_countlist << CPAP_Hypopnea << CPAP_Obstructive << CPAP_Apnea << CPAP_ClearAirway << CPAP_VSnore
+                << CPAP_VSnore2 << CPAP_RERA << CPAP_FlowLimit << CPAP_SensAwake << CPAP_NRI << CPAP_ExP
+                << CPAP_LeakFlag << CPAP_UserFlag1 << CPAP_UserFlag2 << CPAP_PressurePulse;
+
+    // Pholynyk, 25Aug2015, add ResMed Flow Limitation
+    m_avglist << CPAP_Pressure << CPAP_IPAP << CPAP_EPAP << CPAP_FLG;
+    m_p90list << CPAP_Pressure << CPAP_IPAP << CPAP_EPAP << CPAP_FLG;
+
+    // Pholynyk, 18Aug2015, add maximums
+    m_maxlist << CPAP_Pressure << CPAP_IPAP << CPAP_EPAP << CPAP_FLG;
+
+    m_percent = p_profile->general->prefCalcPercentile() / 100.0;
+
+    for (const auto & code : m_countlist + m_avglist) {
+        m_detaillist.append(qMakePair(code, schema::channel[code].code().toLatin1()));
+    }
+}
+
+CSVExporter::~CSVExporter()
+{
+}
+
+bool CSVExporter::parseMode(const QString &str, CSVExportMode &mode)
+{
+    QString s = str.toLower();
+
+    if (s == "summary") {
+        mode = CSV_Summary;
+    } else if (s == "sessions") {
+        mode = CSV_Sessions;
+    } else if (s == "details") {
+        mode = CSV_Details;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QByteArray CSVExporter::header() const
+{
+    const QString sep = ",";
+    QString header;
+
+    // Not sure this section should be translateable.. :-/
+    if (m_mode == CSV_Details) {
+        header = tr("DateTime") + sep + tr("Session") + sep + tr("Event") + sep + tr("Data/Duration");
+    } else {
+        if (m_mode == CSV_Summary) {
+            header = tr("Date") + sep + tr("Session Count") + sep + tr("Start") + sep + tr("End") + sep +
+                     tr("Total Time") + sep + tr("AHI");
+        } else {
+            header = tr("Date") + sep + tr("Session") + sep + tr("Start") + sep + tr("End") + sep +
+                     tr("Total Time") + sep + tr("AHI");
+        }
+
+        for (const auto & code : m_countlist) {
+            header += sep + schema::channel[code].label() + tr(" Count");
+        }
+
+        for (const auto & code : m_avglist) {
+            header += sep + Day::calcMiddleLabel(code);
+        }
+
+        for (const auto & code : m_p90list) {
+            header += sep + tr("%1% ").arg(m_percent * 100.0, 0, 'f', 0) + schema::channel[code].label();
+        }
+
+        for (const auto & code : m_maxlist) {
+            header += sep + Day::calcMaxLabel(code);
+        }
+    }
+
+    header += "\n";
+    return header.toLatin1();
+}
+
+void CSVExporter::addDay(CSVExportTask *task, Day *day)
+{
+    // Loading summaries isn't safe from several threads, so it's done here rather than on the workers
+    day->OpenSummary();
+
+    if (m_mode == CSV_Details) {
+        for (auto & sess : day->sessions) {
+            if (sess->type() != MT_JOURNAL) {
+                task->files.append(qMakePair(sess->session(), sess->eventFile()));
+            }
+        }
+        return;
+    }
+
+    task->days.append(day);
+}
+
+bool CSVExporter::exportTo(const QString &filename)
+{
+    m_queue.reset();
+
+    // Written alongside and renamed at the end, so a cancelled or failed export leaves nothing behind
+    QSaveFile file(filename);
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning() << "CSVExporter couldn't open" << filename;
+        return false;
+    }
+
+    bool ok = (file.write(header()) >= 0);
+
+    // Summary rows are small, so days go out a month at a time. Event rows can come
+    // to megabytes a day, so those go one day at a time
+    int chunkdays = (m_mode == CSV_Details) ? 1 : 31;
+
+    int total = qMax<qint64>(m_start.daysTo(m_end) + 1, 0);
+    emit setProgressMax(total);
+    emit setProgressValue(0);
+
+    QDate date = m_start;
+
+    while (ok) {
+        while (!cancelled() && (date <= m_end) && m_queue.hasRoom()) {
+            CSVExportTask *task = new CSVExportTask(this);
+
+            for (int i = 0; (i < chunkdays) && (date <= m_end); ++i, date = date.addDays(1)) {
+                // Days are looked up afresh for every run
+                Day *day = p_profile->GetDay(date, MT_CPAP);
+                if (day) addDay(task, day);
+            }
+            task->to = date;
+            m_queue.start(task);
+        }
+
+        CSVExportTask *task = static_cast<CSVExportTask *>(m_queue.next());
+        if (!task) break;
+
+        ok = !cancelled() && (file.write(task->data) == task->data.size());
+        emit setProgressValue(m_start.daysTo(task->to));
+        delete task;
+    }
+
+    if (!ok || cancelled()) {
+        // Stop what's still queued, and throw the partial file away
+        m_queue.abort();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "CSVExporter couldn't write" << filename;
+        return false;
+    }
+
+    return true;
+}
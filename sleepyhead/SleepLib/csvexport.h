@@ -0,0 +1,144 @@
+/* SleepLib CSV Export Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef CSVEXPORT_H
+#define CSVEXPORT_H
+
+#include <QObject>
+#include <QDate>
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+
+#include "SleepLib/machine_common.h"
+#include "SleepLib/exportqueue.h"
+
+class Day;
+class CSVExporter;
+
+//! \brief What each row of a CSV export holds
+enum CSVExportMode { CSV_Summary, CSV_Sessions, CSV_Details };
+
+/*! \struct CSVRowValues
+    \brief The figures for one summary or sessions row
+    */
+struct CSVRowValues
+{
+    QDate date;
+
+    //! \brief The session count for a summary row, or the session number for a sessions row
+    quint32 number;
+    qint64 first;
+    qint64 last;
+    qint64 length;
+    float ahi;
+
+    //! \brief Counts, middles, percentiles and maximums, in the order of the exporter's channel lists
+    QVector<EventDataType> values;
+};
+
+/*! \class CSVExportTask
+    \brief Works out and formats the rows for a run of consecutive days on one of CSVExporter's worker threads.
+
+    Summary and sessions figures come from the days' summaries, which the exporter loads before the
+    task is queued, as the statistics cells do. Events for the details export are read from disk.
+    */
+class CSVExportTask : public ExportTask
+{
+    friend class CSVExporter;
+
+  public:
+    CSVExportTask(CSVExporter *exporter) : exporter(exporter) {}
+    virtual ~CSVExportTask() {}
+
+  protected:
+    virtual void prepare();
+
+    //! \brief Works out day's summary row, or a sessions row for each of its sessions
+    void dayRows(Day *day);
+
+    void formatRow(const CSVRowValues &row);
+    void detailRows(SessionID session, const QString &filename);
+
+    CSVExporter *exporter;
+
+    //! \brief Days to work out summary or sessions rows for. ExportQueue::cancelAll() waits for the
+    //! task before any of them can change
+    QList<Day *> days;
+
+    //! \brief Session numbers and events files for the details export
+    QList<QPair<SessionID, QString> > files;
+
+    //! \brief The day after this run, for progress
+    QDate to;
+
+    //! \brief The formatted rows, ready to be written once the task is handed back
+    QByteArray data;
+};
+
+/*! \class CSVExporter
+    \brief Writes the CPAP days between two dates to a CSV file, one row per day, session or event.
+
+    Days are split into runs. Each run's figures are worked out and formatted on worker threads,
+    while the calling thread writes the finished runs out in date order. Only a few runs are ever in
+    flight, so memory use doesn't grow with the date range. Events for the details export are always
+    read straight from disk on the workers, and dropped once formatted.
+    */
+class CSVExporter : public QObject
+{
+    Q_OBJECT
+    friend class CSVExportTask;
+
+  public:
+    CSVExporter(CSVExportMode mode, QDate start, QDate end);
+    virtual ~CSVExporter();
+
+    /*! \brief Writes the export to filename. Must be called from the thread that owns the Day records,
+        which keeps processing events while it waits. Returns false if the file couldn't be written,
+        or the export was cancelled, in which case nothing is left behind */
+    bool exportTo(const QString &filename);
+
+    //! \brief Asks a running export to stop. Safe to call from a slot while exportTo() is waiting
+    void cancel() { m_queue.cancel(); }
+
+    //! \brief Returns true if cancel() has been called
+    bool cancelled() const { return m_queue.cancelled(); }
+
+    //! \brief Returns the export mode named by str ("summary", "sessions" or "details"), or false if there's none
+    static bool parseMode(const QString &str, CSVExportMode &mode);
+
+  signals:
+    void setProgressMax(int max);
+    void setProgressValue(int val);
+
+  protected:
+    //! \brief Returns the column header line for the export mode
+    QByteArray header() const;
+
+    //! \brief Hands day to task, loading its summaries first. Called on the thread that owns the Day records
+    void addDay(CSVExportTask *task, Day *day);
+
+    CSVExportMode m_mode;
+    QDate m_start;
+    QDate m_end;
+
+    QList<ChannelID> m_countlist;
+    QList<ChannelID> m_avglist;
+    QList<ChannelID> m_p90list;
+    QList<ChannelID> m_maxlist;
+    EventDataType m_percent;
+
+    //! \brief Channels the details export writes, with their codes as they appear in the file
+    QList<QPair<ChannelID, QByteArray> > m_detaillist;
+
+    ExportQueue m_queue;
+};
+
+#endif // CSVEXPORT_H
@@ -0,0 +1,255 @@
+/* SleepLib Daily Aggregates Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QMutexLocker>
+#include <cfloat>
+
+#include "dailyaggregates.h"
+#include "profiles.h"
+#include "day.h"
+
+QAtomicInt DailyAggregates::s_nextgeneration(1);
+
+void AggregateColumn::buildSums(const QVector<double> &values, const QVector<double> &w)
+{
+    int n = values.size();
+
+    sums.resize(n + 1);
+    weights.resize(n + 1);
+    sums[0] = weights[0] = 0;
+
+    for (int i = 0; i < n; ++i) {
+        sums[i + 1] = sums[i] + values[i];
+        weights[i + 1] = weights[i] + w[i];
+    }
+}
+
+void AggregateColumn::buildTable(const QVector<EventDataType> &values, bool min)
+{
+    minimum = min;
+    table.clear();
+    table.append(values);
+
+    int n = values.size();
+    for (int k = 1; (1 << k) <= n; ++k) {
+        const QVector<EventDataType> &prev = table[k - 1];
+        int half = 1 << (k - 1);
+        int len = n - (1 << k) + 1;
+
+        QVector<EventDataType> level(len);
+        for (int i = 0; i < len; ++i) {
+            level[i] = minimum ? qMin(prev[i], prev[i + half]) : qMax(prev[i], prev[i + half]);
+        }
+        table.append(level);
+    }
+}
+
+EventDataType AggregateColumn::extreme(int a, int b) const
+{
+    // Two overlapping power of two spans cover the range
+    int len = b - a + 1;
+    int k = 0;
+    while ((2 << k) <= len) ++k;
+
+    EventDataType x = table[k][a];
+    EventDataType y = table[k][b - (1 << k) + 1];
+
+    return minimum ? qMin(x, y) : qMax(x, y);
+}
+
+DailyAggregates::DailyAggregates(Profile *profile)
+    : m_profile(profile), m_generation(0), m_count(0)
+{
+    touch();
+}
+
+bool DailyAggregates::range(QDate first, int count, QDate start, QDate end, int &a, int &b)
+{
+    if (start.isNull() || (count == 0)) {
+        return false;
+    }
+
+    // The calc functions always looked at the start day, even when end came before it
+    if (end.isNull() || (end < start)) {
+        end = start;
+    }
+
+    a = qMax<qint64>(first.daysTo(start), 0);
+    b = qMin<qint64>(first.daysTo(end), count - 1);
+
+    return a <= b;
+}
+
+AggregateColumn DailyAggregates::column(const AggregateKey &key, QDate &first, int &count)
+{
+    int generation;
+    QList<QDate> dates;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        generation = m_datageneration.load();
+        if (generation != m_generation) {
+            m_columns.clear();
+            m_generation = generation;
+
+            m_dates = m_profile->dayDates();
+            if (m_dates.isEmpty()) {
+                m_first = QDate();
+                m_count = 0;
+            } else {
+                m_first = m_dates.first();
+                m_count = m_first.daysTo(m_dates.last()) + 1;
+            }
+        }
+
+        first = m_first;
+        count = m_count;
+        dates = m_dates;
+
+        auto it = m_columns.find(key);
+        if (it != m_columns.end()) {
+            return it.value();
+        }
+    }
+
+    AggregateColumn col;
+    buildColumn(key, first, count, dates, col);
+
+    QMutexLocker locker(&m_mutex);
+    if ((m_generation == generation) && (m_datageneration.load() == generation)) {
+        m_columns.insert(key, col);
+    }
+    return col;
+}
+
+void DailyAggregates::buildColumn(const AggregateKey &key, QDate first, int count, const QList<QDate> &dates, AggregateColumn &col)
+{
+    bool isTable = (key.kind == AGG_Min) || (key.kind == AGG_Max) ||
+                   (key.kind == AGG_SettingsMin) || (key.kind == AGG_SettingsMax);
+    bool minimum = (key.kind == AGG_Min) || (key.kind == AGG_SettingsMin);
+
+    QVector<double> values, weights;
+    QVector<EventDataType> extremes;
+
+    if (isTable) {
+        extremes.fill(minimum ? FLT_MAX : -FLT_MAX, count);
+    } else {
+        values.fill(0, count);
+        weights.fill(0, count);
+    }
+
+    for (const QDate &date : dates) {
+        int i = first.daysTo(date);
+        if (i >= count) break;
+
+        if (key.kind == AGG_CompliantDays) {
+            Day *day = m_profile->FindGoodDay(date, key.mt);
+            if (day && (day->hours(key.mt) > key.param)) {
+                values[i] = 1;
+            }
+            continue;
+        }
+
+        Day *day = m_profile->GetGoodDay(date, key.mt);
+        if (!day) continue;
+
+        switch (key.kind) {
+        case AGG_Count:
+            values[i] = day->count(key.code);
+            break;
+        case AGG_Sum:
+            values[i] = day->sum(key.code);
+            break;
+        case AGG_Hours:
+            values[i] = day->hours();
+            break;
+        case AGG_AboveThreshold:
+            values[i] = day->timeAboveThreshold(key.code, key.param);
+            break;
+        case AGG_BelowThreshold:
+            values[i] = day->timeBelowThreshold(key.code, key.param);
+            break;
+        case AGG_Avg:
+            if (!day->summaryOnly() || day->hasData(key.code, ST_AVG)) {
+                values[i] = day->sum(key.code);
+                weights[i] = day->count(key.code);
+            }
+            break;
+        case AGG_Wavg:
+            if (!day->summaryOnly() || day->hasData(key.code, ST_WAVG)) {
+                double hours = day->hours();
+                values[i] = day->wavg(key.code) * hours;
+                weights[i] = hours;
+            }
+            break;
+        case AGG_Min:
+            if (!day->summaryOnly() || day->hasData(key.code, ST_MIN)) {
+                extremes[i] = day->Min(key.code);
+            }
+            break;
+        case AGG_Max:
+            if (!day->summaryOnly() || day->hasData(key.code, ST_MAX)) {
+                extremes[i] = day->Max(key.code);
+            }
+            break;
+        case AGG_SettingsMin:
+            extremes[i] = day->settings_min(key.code);
+            break;
+        case AGG_SettingsMax:
+            extremes[i] = day->settings_max(key.code);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (isTable) {
+        col.buildTable(extremes, minimum);
+    } else {
+        col.buildSums(values, weights);
+    }
+}
+
+double DailyAggregates::sum(const AggregateKey &key, QDate start, QDate end)
+{
+    double value, weight;
+    sum(key, start, end, value, weight);
+    return value;
+}
+
+void DailyAggregates::sum(const AggregateKey &key, QDate start, QDate end, double &value, double &weight)
+{
+    QDate first;
+    int count;
+    AggregateColumn col = column(key, first, count);
+
+    int a, b;
+    if (!range(first, count, start, end, a, b)) {
+        value = weight = 0;
+        return;
+    }
+
+    value = col.sum(a, b);
+    weight = col.weight(a, b);
+}
+
+bool DailyAggregates::extreme(const AggregateKey &key, QDate start, QDate end, EventDataType &value)
+{
+    QDate first;
+    int count;
+    AggregateColumn col = column(key, first, count);
+
+    int a, b;
+    if (!range(first, count, start, end, a, b)) {
+        return false;
+    }
+
+    value = col.extreme(a, b);
+
+    return (value != FLT_MAX) && (value != -FLT_MAX);
+}
@@ -0,0 +1,144 @@
+/* SleepLib Daily Aggregates Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef DAILYAGGREGATES_H
+#define DAILYAGGREGATES_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "SleepLib/machine_common.h"
+
+class Profile;
+
+//! \brief The per-day statistic a column of DailyAggregates holds
+enum AggregateKind {
+    AGG_CompliantDays, AGG_Count, AGG_Sum, AGG_Hours, AGG_Avg, AGG_Wavg,
+    AGG_Min, AGG_Max, AGG_SettingsMin, AGG_SettingsMax, AGG_AboveThreshold, AGG_BelowThreshold
+};
+
+/*! \struct AggregateKey
+    \brief Identifies a column: a statistic of a channel, for a machine type, with an optional parameter (a threshold or compliance hours)
+    */
+struct AggregateKey
+{
+    AggregateKey(AggregateKind kind, ChannelID code, MachineType mt, EventDataType param = 0)
+        : kind(kind), code(code), mt(mt), param(param) {}
+
+    bool operator==(const AggregateKey &other) const {
+        return (kind == other.kind) && (code == other.code) && (mt == other.mt) && (param == other.param);
+    }
+
+    AggregateKind kind;
+    ChannelID code;
+    MachineType mt;
+    EventDataType param;
+};
+
+inline uint qHash(const AggregateKey &key, uint seed = 0)
+{
+    return qHash(int(key.kind) | (int(key.mt) << 8), seed) ^ qHash(key.code) ^ qHash(key.param);
+}
+
+/*! \struct AggregateColumn
+    \brief One statistic laid out by day number, ready for constant time range queries
+    */
+struct AggregateColumn
+{
+    AggregateColumn() : minimum(false) {}
+
+    //! \brief Prefix sums of the day values and of their weights: sums[i] totals the days before day i
+    QVector<double> sums;
+    QVector<double> weights;
+
+    //! \brief Sparse table for range min or max: table[k][i] covers days i to i + 2^k - 1.
+    //! Days without a value hold +/- FLT_MAX, so they never win
+    QVector<QVector<EventDataType> > table;
+    bool minimum;
+
+    //! \brief Returns the sum of the values, and of the weights, for days a to b inclusive
+    double sum(int a, int b) const { return sums[b + 1] - sums[a]; }
+    double weight(int a, int b) const { return weights[b + 1] - weights[a]; }
+
+    //! \brief Returns the smallest or largest value for days a to b inclusive
+    EventDataType extreme(int a, int b) const;
+
+    void buildSums(const QVector<double> &values, const QVector<double> &weights);
+    void buildTable(const QVector<EventDataType> &values, bool minimum);
+};
+
+/*! \class DailyAggregates
+    \brief Columnar per-day statistics behind Profile's calc* range queries.
+
+    A column holds one statistic of one channel, one value per day from the profile's first day on.
+    Sums are kept as prefix sums and minimums and maximums in sparse tables, so any date range is
+    answered in constant time. A column is built the first time it's asked for, with the same Day
+    lookups the range loops did, and every column is dropped whenever the profile's day data changes.
+
+    Columns are built without holding the lock, so several threads can build different columns at
+    once; a finished column is only kept if no day changed while it was being built.
+    */
+class DailyAggregates
+{
+  public:
+    DailyAggregates(Profile *profile);
+
+    //! \brief Marks all columns stale. Called whenever sessions are added, removed, enabled or disabled, or their summaries change
+    void touch() { m_datageneration.store(s_nextgeneration.fetchAndAddOrdered(1)); }
+
+    //! \brief Returns a number that changes whenever this profile's day data does, for caching results derived from it.
+    //! No two profiles share a number, even one reopened at the same address
+    int generation() const { return m_datageneration.load(); }
+
+    //! \brief Returns the summed day values of key's column between start and end
+    double sum(const AggregateKey &key, QDate start, QDate end);
+
+    //! \brief Sums the day values, and their weights, of key's column between start and end
+    void sum(const AggregateKey &key, QDate start, QDate end, double &value, double &weight);
+
+    //! \brief Finds the minimum or maximum value of key's column between start and end.
+    //! Returns false if no day in the range has one.
+    bool extreme(const AggregateKey &key, QDate start, QDate end, EventDataType &value);
+
+  protected:
+    //! \brief Returns key's column, building it if need be, and the day numbering it uses
+    AggregateColumn column(const AggregateKey &key, QDate &first, int &count);
+
+    //! \brief Works out key's column for count days from first, over the given dates. Called without m_mutex held
+    void buildColumn(const AggregateKey &key, QDate first, int count, const QList<QDate> &dates, AggregateColumn &col);
+
+    //! \brief Converts the dates to day numbers, clipped to the count days from first. Returns false if none are left
+    static bool range(QDate first, int count, QDate start, QDate end, int &a, int &b);
+
+    Profile *m_profile;
+
+    //! \brief Guards the columns and the day numbering, not the building of columns
+    QMutex m_mutex;
+    QHash<AggregateKey, AggregateColumn> m_columns;
+
+    //! \brief The data generation the columns were built for, and the current one
+    int m_generation;
+    QAtomicInt m_datageneration;
+
+    //! \brief Date of day number 0, and the number of days the columns cover
+    QDate m_first;
+    int m_count;
+
+    //! \brief The dates with day records, copied from the profile's day index when the generation changed.
+    //! Profile::daylist isn't locked, so worker threads can't walk it
+    QList<QDate> m_dates;
+
+    //! \brief Hands out data generations, so they're never reused between profiles
+    static QAtomicInt s_nextgeneration;
+};
+
+#endif // DAILYAGGREGATES_H
@@ -7,6 +7,7 @@
  * for more details. */
 
 #include <QMultiMap>
+#include <QMutexLocker>
 
 #include <algorithm>
 #include <cmath>
@@ -16,12 +17,21 @@
 #include "day.h"
 #include "profiles.h"
 
-Day::Day()
+// Next Day generation, shared by all Day records
+static QAtomicInt s_daygeneration(1);
+
+Day::Day(Profile *profile)
+    : d_profile(profile)
 {
     d_firstsession = true;
     d_summaries_open = false;
     d_events_open = false;
-    d_invalidate = true;
+    d_generation.store(s_daygeneration.fetchAndAddOrdered(1));
+    d_intervals_generation = quint32(-1);
+    d_memo_generation = quint32(-1);
+    d_memo_global = 0;
+    d_totaltime = 0;
+    d_hours = 0;
 
 }
 Day::~Day()
@@ -29,6 +39,9 @@ Day::~Day()
     for (auto & sess : sessions) {
         delete sess;
     }
+    if (d_profile) {
+        d_profile->aggregates().touch();
+    }
 }
 
 void Day::updateCPAPCache()
@@ -41,7 +54,6 @@ void Day::updateCPAPCache()
     for (const auto code : channels) {
         d_count[code] = count(code);
         d_sum[code] = count(code);
-        d_machhours[MT_CPAP] = hours(MT_CPAP);
     }
 }
 
@@ -97,24 +109,54 @@ Session *Day::find(SessionID sessid)
     return nullptr;
 }
 
-void Day::addSession(Session *s)
+bool Day::canAdd(Session *s)
 {
     if (s == nullptr) {
         qDebug() << "addSession called with null session pointer";
-        return;
+        return false;
     }
-    invalidate();
     auto mi = machines.find(s->type());
     if (mi != machines.end()) {
         if (mi.value() != s->machine()) {
             qDebug() << "SleepyHead can't add session" << s->session() << "to this day record, as it already contains a different machine of the same MachineType";
-            return;
+            return false;
         }
     } else {
         machines[s->type()] = s->machine();
     }
+    return true;
+}
+
+void Day::addSession(Session *s)
+{
+    if (!canAdd(s)) return;
+
+    {
+        QMutexLocker locker(&d_mutex);
+        sessions.push_back(s);
+    }
 
-    sessions.push_back(s);
+    // After the change, so nobody rebuilds the new generation from the old list
+    invalidate();
+}
+
+void Day::addSessions(const QList<Session *> &list)
+{
+    QList<Session *> added;
+    for (auto & s : list) {
+        if (canAdd(s)) {
+            added.push_back(s);
+        }
+    }
+    if (added.isEmpty()) return;
+
+    {
+        QMutexLocker locker(&d_mutex);
+        sessions.append(added);
+    }
+
+    // As addSession(), once for the lot
+    invalidate();
 }
 EventDataType Day::calcMiddle(ChannelID code)
 {
@@ -301,19 +343,55 @@ EventDataType Day::settings_wavg(ChannelID code)
 }
 
 
+bool Day::memoLookup(const DayMemoKey & key, EventDataType & value, DayMemoStamp & stamp)
+{
+    QMutexLocker locker(&d_memo_mutex);
+
+    // Session summaries can be redone without their day changing, so the global data generation counts too
+    stamp.generation = generation();
+    stamp.global = dataGeneration();
+
+    if ((d_memo_generation != stamp.generation) || (d_memo_global != stamp.global)) {
+        d_memo.clear();
+        d_memo_generation = stamp.generation;
+        d_memo_global = stamp.global;
+        return false;
+    }
+
+    auto it = d_memo.find(key);
+    if (it == d_memo.end()) {
+        return false;
+    }
+    value = it.value();
+    return true;
+}
+
+void Day::memoStore(const DayMemoKey & key, EventDataType value, const DayMemoStamp & stamp)
+{
+    QMutexLocker locker(&d_memo_mutex);
+
+    // Worked out from what was there at lookup time, so it's no good if anything has moved on since
+    if ((stamp.generation == generation()) && (stamp.global == dataGeneration())
+            && (d_memo_generation == stamp.generation) && (d_memo_global == stamp.global)) {
+        d_memo[key] = value;
+    }
+}
+
 EventDataType Day::percentile(ChannelID code, EventDataType percentile)
 {
-    // Cache this calculation?
-    //    QHash<ChannelID, QHash<EventDataType, EventDataType> >::iterator pi;
-    //    pi=perc_cache.find(code);
-    //    if (pi!=perc_cache.end()) {
-    //        QHash<EventDataType, EventDataType> & hsh=pi.value();
-    //        QHash<EventDataType, EventDataType>::iterator hi=hsh.find(
-    //        if (hi!=pi.value().end()) {
-    //            return hi.value();
-    //        }
-    //    }
+    DayMemoKey key(DS_Percentile, code, percentile);
+    DayMemoStamp stamp;
+    EventDataType value;
 
+    if (!memoLookup(key, value, stamp)) {
+        value = weightedPercentile(code, percentile);
+        memoStore(key, value, stamp);
+    }
+    return value;
+}
+
+EventDataType Day::weightedPercentile(ChannelID code, EventDataType percentile)
+{
     QHash<EventStoreType, qint64> wmap; // weight map
 
     QHash<EventStoreType, qint64>::iterator wmapit;
@@ -331,7 +409,7 @@ EventDataType Day::percentile(ChannelID code, EventDataType percentile)
 
         auto tei = sess->m_timesummary.find(code);
         timeweight = (tei != sess->m_timesummary.end());
-        gain = sess->m_gain[code];
+        gain = sess->m_gain.value(code);
 
         // Here's assuming gains don't change accross a days sessions
         // Can't assume this in any multi day calculations..
@@ -576,8 +654,12 @@ EventDataType Day::rangePercentile(ChannelID code, float p, qint64 st, qint64 et
 
 EventDataType Day::avg(ChannelID code)
 {
+    DayMemoKey key(DS_Avg, code);
+    DayMemoStamp stamp;
+    EventDataType result;
+    if (memoLookup(key, result, stamp)) return result;
+
     double val = 0;
-    // Cache this?
     int cnt = 0;
 
     for (auto & sess : sessions) {
@@ -586,16 +668,20 @@ EventDataType Day::avg(ChannelID code)
             cnt += sess->count(code);
         }
     }
-    if (cnt == 0) { return 0; }
-    val /= double(cnt);
+    result = (cnt == 0) ? 0 : val / double(cnt);
 
-    return val;
+    memoStore(key, result, stamp);
+    return result;
 }
 
 EventDataType Day::sum(ChannelID code)
 {
-    // Cache this?
-    EventDataType val = 0;
+    DayMemoKey key(DS_Sum, code);
+    DayMemoStamp stamp;
+    EventDataType val;
+    if (memoLookup(key, val, stamp)) return val;
+
+    val = 0;
 
     for (auto & sess : sessions) {
         if (sess->enabled() && sess->m_sum.contains(code)) {
@@ -603,11 +689,17 @@ EventDataType Day::sum(ChannelID code)
         }
     }
 
+    memoStore(key, val, stamp);
     return val;
 }
 
 EventDataType Day::wavg(ChannelID code)
 {
+    DayMemoKey key(DS_Wavg, code);
+    DayMemoStamp stamp;
+    EventDataType result;
+    if (memoLookup(key, result, stamp)) return result;
+
     double s0 = 0, s1 = 0, s2 = 0;
     qint64 d;
 
@@ -623,155 +715,135 @@ EventDataType Day::wavg(ChannelID code)
         }
     }
 
-    if (s2 == 0) {
-        return 0;
+    result = (s2 == 0) ? 0 : (s1 / s2);
+
+    memoStore(key, result, stamp);
+    return result;
+}
+
+void Day::invalidate()
+{
+    {
+        QMutexLocker locker(&d_mutex);
+        d_generation.store(s_daygeneration.fetchAndAddOrdered(1));
+    }
+    if (d_profile) {
+        d_profile->aggregates().touch();
+        d_profile->updateDayIndex(this);
     }
+}
 
-    return (s1 / s2);
+int Day::dataGeneration() const
+{
+    return d_profile ? d_profile->aggregates().generation() : 0;
 }
 
 // Total session time in milliseconds
 qint64 Day::total_time()
 {
-    qint64 d_totaltime = 0;
-    QMultiMap<qint64, bool> range;
-    //range.reserve(size()*2);
-
-    // Remember sessions may overlap..
-
-    qint64 first, last;
+    QMutexLocker locker(&d_mutex);
+    updateIntervals();
+    return d_totaltime;
+}
 
-    for (auto & sess : sessions) {
-        int slicesize = sess->m_slices.size();
-
-        if (sess->enabled() && (sess->type() != MT_JOURNAL)) {
-            first = sess->first();
-            last = sess->last();
-
-            if (slicesize == 0) {
-                // This algorithm relies on non zero length, and correctly ordered sessions
-                if (last > first) {
-                    range.insert(first, 0);
-                    range.insert(last, 1);
-                    d_totaltime += sess->length();
-                }
-            } else {
-                for (auto & slice : sess->m_slices) {
-                    if (slice.status == EquipmentOn) {
-                        range.insert(slice.start, 0);
-                        range.insert(slice.end, 1);
-                        d_totaltime += slice.end - slice.start;
-                    }
-                }
-            }
-        }
-    }
+// Total session time in milliseconds, only considering machinetype
+qint64 Day::total_time(MachineType type)
+{
+    QMutexLocker locker(&d_mutex);
+    updateIntervals();
+    return d_machtime.value(type, 0);
+}
 
-    bool b;
-    int nest = 0;
-    qint64 ti = 0;
-    qint64 total = 0;
+EventDataType Day::hours()
+{
+    QMutexLocker locker(&d_mutex);
+    updateIntervals();
+    return d_hours;
+}
 
-    // This is my implementation of a typical "brace counting" algorithm mentioned here:
-    // http://stackoverflow.com/questions/7468948/problem-calculating-overlapping-date-ranges
+EventDataType Day::hours(MachineType type)
+{
+    QMutexLocker locker(&d_mutex);
+    updateIntervals();
+    return double(d_machtime.value(type, 0)) / 3600000.0;
+}
 
-    auto rend = range.end();
-    for (auto rit = range.begin(); rit != rend; ++rit) {
-        b = rit.value();
+QVector<DayInterval> Day::intervals()
+{
+    QMutexLocker locker(&d_mutex);
+    updateIntervals();
+    return d_intervals;
+}
 
-        if (!b) {
-            if (!ti) {
-                ti = rit.key();
-            }
+// Merges intervals in place, after sorting them by start time, and returns the time they cover
+static qint64 mergeIntervals(QVector<DayInterval> & list)
+{
+    std::sort(list.begin(), list.end());
 
-            nest++;
+    int n = 0;
+    qint64 total = 0;
+    for (int i = 0; i < list.size(); ++i) {
+        const DayInterval & iv = list.at(i);
+        if ((n > 0) && (iv.start <= list[n-1].end)) {
+            list[n-1].end = qMax(list[n-1].end, iv.end);
         } else {
-            if (--nest <= 0) {
-                total += rit.key() - ti;
-                ti = 0;
-            }
+            list[n++] = iv;
         }
     }
+    list.resize(n);
 
-    if (total != d_totaltime) {
-        // They can overlap.. tough.
-//        qDebug() << "Sessions Times overlaps!" << total << d_totaltime;
+    for (const auto & iv : list) {
+        total += iv.end - iv.start;
     }
-
-    return total; //d_totaltime;
+    return total;
 }
 
-// Total session time in milliseconds, only considering machinetype
-qint64 Day::total_time(MachineType type)
+void Day::updateIntervals()
 {
-    qint64 d_totaltime = 0;
-    QMultiMap<qint64, bool> range;
-    //range.reserve(size()*2);
+    quint32 generation = d_generation.load();
+    if (d_intervals_generation == generation) return;
 
-    // Remember sessions may overlap..
+    QVector<DayInterval> intervals;
+    QHash<MachineType, QVector<DayInterval> > machintervals;
+    QHash<MachineType, qint64> machtime;
 
-    qint64 first, last;
+    // Remember sessions may overlap, so each machine type's time, and the day's, is that of its merged intervals
     for (auto & sess : sessions) {
-        int slicesize = sess->m_slices.size();
-
-        if (sess->enabled() && (sess->type() == type)) {
-            first = sess->first();
-            last = sess->last();
-
-            // This algorithm relies on non zero length, and correctly ordered sessions
-            if (slicesize == 0) {
-                if (last > first) {
-                    range.insert(first, 0);
-                    range.insert(last, 1);
-                    d_totaltime += sess->length();
-                }
-            } else {
-                for (const auto & slice : sess->m_slices) {
-                    if (slice.status == EquipmentOn) {
-                        range.insert(slice.start, 0);
-                        range.insert(slice.end, 1);
-                        d_totaltime += slice.end - slice.start;
-                    }
-                }
-            }
-        }
-    }
-
-    bool b;
-    int nest = 0;
-    qint64 ti = 0;
-    qint64 total = 0;
-
-    // This is my implementation of a typical "brace counting" algorithm mentioned here:
-    // http://stackoverflow.com/questions/7468948/problem-calculating-overlapping-date-ranges
+        if (!sess->enabled()) continue;
 
-    auto rend = range.end();
-    for (auto rit = range.begin(); rit != rend; ++rit) {
-        b = rit.value();
+        MachineType type = sess->type();
+        QVector<DayInterval> & list = machintervals[type];
 
-        if (!b) {
-            if (!ti) {
-                ti = rit.key();
+        if (sess->m_slices.size() == 0) {
+            // Zero length or out of order sessions don't count
+            if (sess->last() > sess->first()) {
+                list.append(DayInterval(sess->first(), sess->last()));
             }
-
-            nest++;
         } else {
-            if (--nest <= 0) {
-                total += rit.key() - ti;
-                ti = 0;
+            for (const auto & slice : sess->m_slices) {
+                if (slice.status == EquipmentOn) {
+                    list.append(DayInterval(slice.start, slice.end));
+                }
             }
         }
     }
 
-    if (total != d_totaltime) {
-        // They can overlap.. tough.
-//        qDebug() << "Sessions Times overlaps!" << total << d_totaltime;
+    for (auto it = machintervals.begin(), end = machintervals.end(); it != end; ++it) {
+        if (it.key() != MT_JOURNAL) {
+            intervals += it.value();
+        }
+        machtime[it.key()] = mergeIntervals(it.value());
     }
 
-    return total; //d_totaltime;
+    // Only marked up to date once everything is in place
+    d_totaltime = mergeIntervals(intervals);
+    d_hours = double(d_totaltime) / 3600000.0;
+    d_intervals = intervals;
+    d_machintervals = machintervals;
+    d_machtime = machtime;
+    d_intervals_generation = generation;
 }
 
-
 bool Day::hasEnabledSessions()
 {
     for (auto & sess : sessions) {
@@ -1009,6 +1081,11 @@ EventDataType Day::physMax(ChannelID code)
 }
 EventDataType Day::cph(ChannelID code)
 {
+    DayMemoKey key(DS_CPH, code);
+    DayMemoStamp stamp;
+    EventDataType result;
+    if (memoLookup(key, result, stamp)) return result;
+
     double sum = 0;
 
     for (auto & sess : sessions) {
@@ -1017,12 +1094,19 @@ EventDataType Day::cph(ChannelID code)
         }
     }
     sum /= hours();
-    return sum;
+
+    memoStore(key, result = sum, stamp);
+    return result;
 }
 
 EventDataType Day::sph(ChannelID code)
 {
-    EventDataType sum = 0;
+    DayMemoKey key(DS_SPH, code);
+    DayMemoStamp stamp;
+    EventDataType sum;
+    if (memoLookup(key, sum, stamp)) return sum;
+
+    sum = 0;
     EventDataType h = 0;
 
     for (auto & sess : sessions) {
@@ -1033,18 +1117,27 @@ EventDataType Day::sph(ChannelID code)
 
     h = hours();
     sum = (100.0 / h) * sum;
+
+    memoStore(key, sum, stamp);
     return sum;
 }
 
 EventDataType Day::count(ChannelID code)
 {
-    EventDataType total = 0;
+    DayMemoKey key(DS_Count, code);
+    DayMemoStamp stamp;
+    EventDataType total;
+    if (memoLookup(key, total, stamp)) return total;
+
+    total = 0;
 
     for (auto & sess : sessions) {
         if (sess->enabled() && sess->m_cnt.contains(code)) {
             total += sess->count(code);
         }
     }
+
+    memoStore(key, total, stamp);
     return total;
 }
 
@@ -1149,6 +1242,8 @@ void Day::OpenEvents()
 
 void Day::OpenSummary()
 {
+    // Overview's prefetch opens summaries on a worker thread too
+    QMutexLocker locker(&d_mutex);
     if (d_summaries_open) return;
     for (auto & sess : sessions) {
         sess->LoadSummary();
@@ -1297,7 +1392,12 @@ bool Day::removeSession(Session *sess)
 {
     sess->machine()->sessionlist.remove(sess->session());
     MachineType mt = sess->type();
-    bool b = sessions.removeAll(sess) > 0;
+    bool b;
+    {
+        QMutexLocker locker(&d_mutex);
+        b = sessions.removeAll(sess) > 0;
+    }
+    invalidate();
     if (!searchMachine(mt)) {
         machines.remove(mt);
     }
@@ -1418,6 +1518,64 @@ QString Day::getPressureSettings()
     return STR_TR_Unknown;
 }
 
+quint32 Day::settingsFingerprint()
+{
+    Machine * mach = machine(MT_CPAP);
+    if (!mach) return 0;
+
+    CPAPLoader * loader = qobject_cast<CPAPLoader *>(mach->loader());
+    if (!loader) return 0;
+
+    // The same values getCPAPMode, getPressureRelief and getPressureSettings show, rounded as they display them
+    QVector<int> values;
+
+    values << qRound(settings_wavg(loader->CPAPModeChannel()));
+
+    ChannelID pr_level_chan = loader->PresReliefLevel();
+    ChannelID pr_mode_chan = loader->PresReliefMode();
+
+    if ((pr_mode_chan != NoChannel) && settingExists(pr_mode_chan)) {
+        values << qRound(settings_wavg(pr_mode_chan));
+        if ((pr_level_chan != NoChannel) && settingExists(pr_level_chan)) {
+            values << qRound(settings_wavg(pr_level_chan));
+        } else values << -1;
+    } else values << -2;
+
+    CPAPMode mode = (CPAPMode)(int)settings_max(CPAP_Mode);
+    values << mode;
+
+    QList<EventDataType> pressures;
+    if (mode == MODE_CPAP) {
+        pressures << settings_min(CPAP_Pressure);
+    } else if (mode == MODE_APAP) {
+        pressures << settings_min(CPAP_PressureMin) << settings_max(CPAP_PressureMax);
+    } else if ((mode == MODE_BILEVEL_FIXED) || (mode == MODE_AVAPS)) {
+        pressures << settings_min(CPAP_EPAP) << settings_max(CPAP_IPAP);
+    } else if (mode == MODE_BILEVEL_AUTO_FIXED_PS) {
+        pressures << settings_max(CPAP_PS) << settings_min(CPAP_EPAPLo) << settings_max(CPAP_IPAPHi);
+    } else if (mode == MODE_BILEVEL_AUTO_VARIABLE_PS) {
+        pressures << settings_min(CPAP_EPAPLo) << settings_max(CPAP_IPAPHi) << settings_min(CPAP_PSMin) << settings_max(CPAP_PSMax);
+    } else if (mode == MODE_ASV) {
+        pressures << settings_min(CPAP_EPAP) << settings_min(CPAP_PSMin) << settings_max(CPAP_PSMax);
+    } else if (mode == MODE_ASV_VARIABLE_EPAP) {
+        pressures << settings_min(CPAP_EPAPLo) << settings_max(CPAP_IPAPHi) << settings_max(CPAP_PSMin) << settings_min(CPAP_PSMax);
+    }
+    // Pressures are shown to one decimal place, so days that read the same share an entry
+    for (int i = 0; i < pressures.size(); ++i) {
+        values << qRound(QString::number(pressures.at(i), 'f', 1).toDouble() * 10.0);
+    }
+
+    // FNV-1a, rather than qHash, whose seed may change between runs
+    quint32 hash = 2166136261U;
+    for (int i = 0; i < values.size(); ++i) {
+        quint32 v = values.at(i);
+        for (int b = 0; b < 4; ++b) {
+            hash = (hash ^ ((v >> (b * 8)) & 0xff)) * 16777619U;
+        }
+    }
+    return hash;
+}
+
 
 EventDataType Day::calc(ChannelID code, ChannelCalcType type)
 {
@@ -14,6 +14,10 @@
 #include "SleepLib/machine.h"
 #include "SleepLib/event.h"
 #include "SleepLib/session.h"
+#include "SleepLib/dailyaggregates.h"
+
+#include <QMutex>
+#include <QAtomicInt>
 
 /*! \class OneTypePerDay
     \brief An Exception class to catch multiple machine records per day
@@ -24,6 +28,57 @@ class OneTypePerDay
 
 class Machine;
 class Session;
+class Profile;
+
+/*! \struct DayInterval
+    \brief A time range, in milliseconds since epoch, during which a Day's equipment was on
+    */
+struct DayInterval
+{
+    DayInterval() : start(0), end(0) {}
+    DayInterval(qint64 start, qint64 end) : start(start), end(end) {}
+
+    bool operator<(const DayInterval & other) const { return start < other.start; }
+
+    qint64 start;
+    qint64 end;
+};
+
+//! \brief The Day statistics kept in its memo table
+enum DayStat { DS_Avg, DS_Sum, DS_Wavg, DS_Count, DS_CPH, DS_SPH, DS_Percentile };
+
+/*! \struct DayMemoKey
+    \brief Identifies a memoized Day statistic: what was worked out, for which channel, with which parameter
+    */
+struct DayMemoKey
+{
+    DayMemoKey(DayStat stat, ChannelID code, EventDataType param = 0)
+        : stat(stat), code(code), param(param) {}
+
+    bool operator==(const DayMemoKey & other) const {
+        return (stat == other.stat) && (code == other.code) && (param == other.param);
+    }
+
+    DayStat stat;
+    ChannelID code;
+    EventDataType param;
+};
+
+inline uint qHash(const DayMemoKey & key, uint seed = 0)
+{
+    return qHash(int(key.stat), seed) ^ qHash(key.code) ^ qHash(key.param);
+}
+
+/*! \struct DayMemoStamp
+    \brief The generations a memo lookup saw, so a value worked out after it is only kept if nothing changed meanwhile
+    */
+struct DayMemoStamp
+{
+    DayMemoStamp() : generation(0), global(0) {}
+
+    quint32 generation;
+    int global;
+};
 
 /*! \class Day
     \brief Contains a list of all Sessions for single date, for a single machine
@@ -31,7 +86,8 @@ class Session;
 class Day
 {
   public:
-    Day();
+    //! \brief profile is the one whose daylist holds this day, or nullptr for a day of its own
+    Day(Profile *profile = nullptr);
     ~Day();
 
     //! \brief Add a new machine to this day record
@@ -46,6 +102,9 @@ class Day
     //! \brief Add Session to this Day object (called during Load)
     void addSession(Session *s);
 
+    //! \brief Adds several Sessions at once, so the day only changes generation once
+    void addSessions(const QList<Session *> &list);
+
     EventDataType rangeCount(ChannelID code, qint64 st, qint64 et);
     EventDataType rangeSum(ChannelID code, qint64 st, qint64 et);
     EventDataType rangeAvg(ChannelID code, qint64 st, qint64 et);
@@ -156,6 +215,9 @@ class Day
     //! \brief Returns the total time in milliseconds for this day
     qint64 total_time();
 
+    //! \brief Returns the sorted, merged time ranges covered by this day's enabled sessions, except journals
+    QVector<DayInterval> intervals();
+
     //! \brief Returns the total time in milliseconds for this day for given machine type
     qint64 total_time(MachineType type);
 
@@ -166,18 +228,10 @@ class Day
     bool hasEnabledSessions();
 
     //! \brief Return the total time in decimal hours for this day
-    EventDataType hours() {
-        if (!d_invalidate) return d_hours;
-        d_invalidate = false;
-        return d_hours = double(total_time()) / 3600000.0;
-    }
-    EventDataType hours(MachineType type) {
-        auto it = d_machhours.find(type);
-        if (it == d_machhours.end()) {
-            return d_machhours[type] = double(total_time(type)) / 3600000.0;
-        }
-        return it.value();
-    }
+    EventDataType hours();
+
+    //! \brief Return the total time in decimal hours for this day for given machine type
+    EventDataType hours(MachineType type);
 
     //! \brief Return the session indexed by i
     Session *operator [](int i) { return sessions[i]; }
@@ -235,6 +289,10 @@ class Day
     QString getPressureRelief();
     QString getPressureSettings();
 
+    //! \brief Returns a hash of the settings the three strings above are made from, to compare days' prescriptions without formatting them.
+    //! It is stable between runs, so it can be saved.
+    quint32 settingsFingerprint();
+
     // Some more very much CPAP only related stuff
 
     //! \brief Calculate AHI (Apnea Hypopnea Index)
@@ -302,10 +360,12 @@ class Day
     int useCounter() { return d_useCounter; }
 
 
-    void invalidate() {
-        d_invalidate = true;
-        d_machhours.clear();
-    }
+    //! \brief Marks this day's cached times and statistics stale, after its sessions change
+    void invalidate();
+
+    //! \brief Returns a generation that changes whenever this day's sessions change, so callers can tell if their cached results are stale.
+    //! Generations are never handed out twice, not even to different Day records
+    inline quint32 generation() const { return quint32(d_generation.load()); }
 
     void updateCPAPCache();
 
@@ -315,18 +375,54 @@ class Day
 
 
 
-    QHash<ChannelID, QHash<EventDataType, EventDataType> > perc_cache;
+    //! \brief Rebuilds the merged session time ranges and their totals, if the sessions changed since they were
+    //! last built. Callers must hold d_mutex
+    void updateIntervals();
+
+    //! \brief Returns the data generation of this day's profile, which moves when any of its session summaries are redone
+    int dataGeneration() const;
+
+    //! \brief Looks up a memoized statistic. Returns false if it needs working out, with stamp set for memoStore()
+    bool memoLookup(const DayMemoKey & key, EventDataType & value, DayMemoStamp & stamp);
+
+    //! \brief Remembers a statistic, unless the day changed since the memoLookup() that gave stamp
+    void memoStore(const DayMemoKey & key, EventDataType value, const DayMemoStamp & stamp);
+
+    //! \brief The time weighted percentile calculation behind percentile()
+    EventDataType weightedPercentile(ChannelID code, EventDataType percentile);
+
+    //! \brief Returns false if s can't be added, as this day already has a different machine of its type
+    bool canAdd(Session *s);
     //qint64 d_first,d_last;
   private:
+    Profile *d_profile;
     bool d_firstsession;
     int d_useCounter;
     bool d_summaries_open;
     bool d_events_open;
-    float d_hours;
-    QHash<MachineType, EventDataType> d_machhours;
     QHash<ChannelID, long> d_count;
     QHash<ChannelID, double> d_sum;
-    bool d_invalidate;
+    QAtomicInt d_generation;
+
+    //! \brief Guards the merged intervals and the times worked out from them, which worker threads
+    //! (statistics, overview prefetch, exports) ask for while the GUI thread uses the same day
+    QMutex d_mutex;
+
+    //! \brief Merged session time ranges, for all machine types but journals and for each type, built for d_intervals_generation
+    QVector<DayInterval> d_intervals;
+    QHash<MachineType, QVector<DayInterval> > d_machintervals;
+    qint64 d_totaltime;
+    float d_hours;
+    QHash<MachineType, qint64> d_machtime;
+    quint32 d_intervals_generation;
+
+    //! \brief Statistics already worked out, valid while d_generation and the DailyAggregates generation stay the same.
+    //! Guarded by d_memo_mutex, which is never held while a value is worked out; hours() and the other
+    //! cached times the calculations use are guarded by d_mutex, so several threads may ask at once
+    QMutex d_memo_mutex;
+    QHash<DayMemoKey, EventDataType> d_memo;
+    quint32 d_memo_generation;
+    int d_memo_global;
     QDate d_date;
 };
 
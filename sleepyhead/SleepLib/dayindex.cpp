@@ -0,0 +1,243 @@
+/* SleepLib Day Index Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QMutexLocker>
+#include <QtAlgorithms>
+
+#include "dayindex.h"
+#include "day.h"
+
+void DayIndex::insert(QDate date, Day *day)
+{
+    qint64 jd = date.toJulianDay();
+
+    QMutexLocker locker(&m_mutex);
+
+    bool moved = false;
+
+    if (m_days.isEmpty()) {
+        m_first = jd;
+    } else if (jd < m_first) {
+        // Imports often work backwards from the newest day, so leave room for more before it
+        qint64 grow = qMax<qint64>(m_first - jd, m_days.size() / 2);
+        QVector<Day *> days(grow, nullptr);
+        days += m_days;
+        m_days.swap(days);
+        m_first -= grow;
+        moved = true;
+    }
+
+    qint64 i = jd - m_first;
+    if (i >= m_days.size()) {
+        m_days.resize(i + 1);
+
+        // Bitmaps always have a word for every day in the array
+        int words = (m_days.size() + 63) / 64;
+        for (auto it = m_bits.begin(), end = m_bits.end(); it != end; ++it) {
+            it.value().resize(words);
+        }
+    }
+    m_days[i] = day;
+
+    if (moved) {
+        // Every day's bit position shifted, which the extra room makes rare
+        rebuildBits();
+    } else {
+        updateBits(i);
+    }
+}
+
+void DayIndex::remove(QDate date)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 i = date.toJulianDay() - m_first;
+    if ((i >= 0) && (i < m_days.size())) {
+        m_days[i] = nullptr;
+        updateBits(i);
+    }
+}
+
+void DayIndex::update(QDate date)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 i = date.toJulianDay() - m_first;
+    if ((i >= 0) && (i < m_days.size())) {
+        updateBits(i);
+    }
+}
+
+void DayIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_days.clear();
+    m_bits.clear();
+    m_first = 0;
+}
+
+Day *DayIndex::at(QDate date) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 i = date.toJulianDay() - m_first;
+    return ((i >= 0) && (i < m_days.size())) ? m_days.at(i) : nullptr;
+}
+
+void DayIndex::setBit(MachineType mt, int i)
+{
+    QVector<quint64> &bits = m_bits[mt];
+    if (bits.isEmpty()) {
+        bits.fill(0, (m_days.size() + 63) / 64);
+    }
+    bits[i >> 6] |= quint64(1) << (i & 63);
+}
+
+void DayIndex::updateBits(int i)
+{
+    quint64 bit = quint64(1) << (i & 63);
+    int word = i >> 6;
+
+    for (auto it = m_bits.begin(), end = m_bits.end(); it != end; ++it) {
+        it.value()[word] &= ~bit;
+    }
+
+    Day *day = m_days.at(i);
+    if (!day) return;
+
+    for (auto & sess : day->sessions) {
+        if (!sess->enabled()) continue;
+
+        setBit(sess->type(), i);
+        setBit(MT_UNKNOWN, i);
+    }
+}
+
+void DayIndex::rebuildBits()
+{
+    m_bits.clear();
+
+    for (int i = 0, n = m_days.size(); i < n; ++i) {
+        if (m_days.at(i)) {
+            updateBits(i);
+        }
+    }
+}
+
+bool DayIndex::range(QDate start, QDate end, int &a, int &b) const
+{
+    if (start.isNull() || m_days.isEmpty()) {
+        return false;
+    }
+
+    // The range loops this replaces always looked at the start day, even when end came before it
+    if (end.isNull() || (end < start)) {
+        end = start;
+    }
+
+    a = qMax<qint64>(start.toJulianDay() - m_first, 0);
+    b = qMin<qint64>(end.toJulianDay() - m_first, m_days.size() - 1);
+
+    return a <= b;
+}
+
+bool DayIndex::isGood(QDate date, MachineType mt)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 i = date.toJulianDay() - m_first;
+    if ((i < 0) || (i >= m_days.size())) {
+        return false;
+    }
+
+    auto it = m_bits.find(mt);
+    if (it == m_bits.end()) {
+        return false;
+    }
+    return (it.value().at(i >> 6) >> (i & 63)) & 1;
+}
+
+int DayIndex::count(MachineType mt, QDate start, QDate end)
+{
+    QMutexLocker locker(&m_mutex);
+
+    int a, b;
+    if (!range(start, end, a, b)) {
+        return 0;
+    }
+
+    auto it = m_bits.find(mt);
+    if (it == m_bits.end()) {
+        return 0;
+    }
+    const QVector<quint64> &bits = it.value();
+
+    int wa = a >> 6, wb = b >> 6;
+    int total = 0;
+
+    for (int w = wa; w <= wb; ++w) {
+        quint64 word = bits.at(w);
+
+        // Mask off the days outside the range in the first and last words
+        if (w == wa) word &= ~quint64(0) << (a & 63);
+        if (w == wb) word &= ~quint64(0) >> (63 - (b & 63));
+
+        total += qPopulationCount(word);
+    }
+
+    return total;
+}
+
+QList<QDate> DayIndex::dates()
+{
+    QList<QDate> list;
+
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0, n = m_days.size(); i < n; ++i) {
+        if (m_days.at(i)) {
+            list.push_back(QDate::fromJulianDay(m_first + i));
+        }
+    }
+
+    return list;
+}
+
+QList<Day *> DayIndex::goodDays(MachineType mt, QDate start, QDate end)
+{
+    QList<Day *> list;
+
+    QMutexLocker locker(&m_mutex);
+
+    int a, b;
+    if (!range(start, end, a, b)) {
+        return list;
+    }
+
+    auto it = m_bits.find(mt);
+    if (it == m_bits.end()) {
+        return list;
+    }
+    const QVector<quint64> &bits = it.value();
+
+    for (int i = a; i <= b; ++i) {
+        quint64 word = bits.at(i >> 6);
+
+        // Skip empty stretches a word at a time
+        if ((word == 0) && ((i & 63) == 0) && (i + 63 <= b)) {
+            i += 63;
+            continue;
+        }
+
+        if ((word >> (i & 63)) & 1) {
+            list.push_back(m_days.at(i));
+        }
+    }
+
+    return list;
+}
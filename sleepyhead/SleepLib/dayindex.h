@@ -0,0 +1,84 @@
+/* SleepLib Day Index Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef DAYINDEX_H
+#define DAYINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+
+#include "SleepLib/machine_common.h"
+
+class Day;
+
+/*! \class DayIndex
+    \brief Profile's Day records laid out by Julian day number, kept in step with Profile::daylist.
+
+    Looking a date up is an array access, and ranges of days are contiguous walks. Alongside the
+    array, a bitmap per machine type marks the days that have enabled sessions of that type
+    (MT_UNKNOWN marks days with any), so "good" days are tested and counted a word at a time.
+    Only a day's own bits change when it's inserted, removed or updated. Every call takes the
+    lock, as loader threads add days while the GUI thread looks them up.
+    */
+class DayIndex
+{
+  public:
+    DayIndex() : m_first(0) {}
+
+    //! \brief Records day as date's Day record
+    void insert(QDate date, Day *day);
+
+    //! \brief Forgets date's Day record
+    void remove(QDate date);
+
+    //! \brief Updates date's bits, after its Day record's sessions were added, removed, enabled or disabled
+    void update(QDate date);
+
+    //! \brief Forgets all Day records
+    void clear();
+
+    //! \brief Returns date's Day record, or nullptr if there isn't one
+    Day *at(QDate date) const;
+
+    //! \brief Returns true if date's Day record has enabled sessions of machine type mt
+    bool isGood(QDate date, MachineType mt);
+
+    //! \brief Counts the days between start and end inclusive with enabled sessions of machine type mt
+    int count(MachineType mt, QDate start, QDate end);
+
+    //! \brief Returns the Day records between start and end inclusive with enabled sessions of machine type mt
+    QList<Day *> goodDays(MachineType mt, QDate start, QDate end);
+
+    //! \brief Returns every date that has a Day record, in order
+    QList<QDate> dates();
+
+  protected:
+    //! \brief Sets day i's bits from its Day record's enabled sessions. Must be called with m_mutex held.
+    void updateBits(int i);
+
+    //! \brief Rebuilds every day's bits, after the array moved. Must be called with m_mutex held.
+    void rebuildBits();
+
+    //! \brief Sets day i's bit in machine type mt's bitmap, creating the bitmap if need be
+    void setBit(MachineType mt, int i);
+
+    //! \brief Converts the dates to array indexes, clipped to the array. Returns false if none are left
+    bool range(QDate start, QDate end, int &a, int &b) const;
+
+    //! \brief Day records from Julian day m_first on, nullptr where there are none
+    QVector<Day *> m_days;
+    qint64 m_first;
+
+    mutable QMutex m_mutex;
+    QHash<MachineType, QVector<quint64> > m_bits;
+};
+
+#endif // DAYINDEX_H
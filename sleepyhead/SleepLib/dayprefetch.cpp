@@ -0,0 +1,207 @@
+/* SleepLib Day Prefetcher Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QDebug>
+
+#include "dayprefetch.h"
+#include "day.h"
+#include "profiles.h"
+
+void DayPrefetchTask::run()
+{
+    QHash<SessionID, SessionEventData *> results;
+
+    for (const auto & file : files) {
+        if (epoch != owner->m_epoch.load()) break;
+
+        SessionEventData * data = new SessionEventData();
+        if (Session::ReadEvents(file.second, *data)) {
+            results[file.first] = data;
+        } else {
+            delete data;
+        }
+    }
+
+    owner->finished(epoch, date, results);
+}
+
+DayPrefetcher::DayPrefetcher()
+{
+    // Previous and next day
+    m_pool.setMaxThreadCount(2);
+
+    m_budget = 256 * 1048576;
+    m_maxdays = 7;
+}
+
+DayPrefetcher::~DayPrefetcher()
+{
+    clear();
+}
+
+void DayPrefetcher::finished(int epoch, QDate date, QHash<SessionID, SessionEventData *> &results)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if ((epoch == m_epoch.load()) && m_wanted.contains(date)) {
+        m_ready[date] = results;
+    } else {
+        // Cancelled, or the user moved on while it was being read
+        qDeleteAll(results);
+    }
+    results.clear();
+
+    m_pending.remove(date);
+    m_done.wakeAll();
+}
+
+void DayPrefetcher::prefetch(Day *day)
+{
+    if (!day) return;
+
+    QList<QPair<SessionID, QString> > files;
+
+    for (const auto & sess : day->sessions) {
+        if ((sess->type() == MT_JOURNAL) || sess->eventsLoaded() || (sess->eventlist.size() > 0)) {
+            continue;
+        }
+        files.append(qMakePair(sess->session(), sess->eventFile()));
+    }
+
+    if (files.isEmpty()) return;
+
+    QDate date = day->date();
+
+    if (m_pending.contains(date) || m_ready.contains(date)) return;
+
+    m_pending.insert(date);
+
+    DayPrefetchTask * task = new DayPrefetchTask(this, m_epoch.load(), date, files);
+    task->setAutoDelete(true);
+    m_pool.start(task);
+}
+
+void DayPrefetcher::prefetchNeighbours(Day *prev, Day *next)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_wanted.clear();
+    if (prev) m_wanted.insert(prev->date());
+    if (next) m_wanted.insert(next->date());
+
+    // Days read for earlier neighbours that weren't viewed would otherwise pile up as the user scrolls
+    for (auto it = m_ready.begin(); it != m_ready.end();) {
+        if (m_wanted.contains(it.key())) {
+            ++it;
+        } else {
+            qDeleteAll(it.value());
+            it = m_ready.erase(it);
+        }
+    }
+
+    prefetch(prev);
+    prefetch(next);
+}
+
+void DayPrefetcher::adopt(Day *day)
+{
+    if (!day) return;
+
+    QDate date = day->date();
+    QHash<SessionID, SessionEventData *> results;
+
+    m_mutex.lock();
+    // Whatever's left of a load already under way is still quicker than starting again
+    while (m_pending.contains(date)) {
+        m_done.wait(&m_mutex);
+    }
+    auto it = m_ready.find(date);
+    if (it != m_ready.end()) {
+        results = it.value();
+        m_ready.erase(it);
+    }
+    m_mutex.unlock();
+
+    if (results.isEmpty()) return;
+
+    for (auto & sess : day->sessions) {
+        auto rit = results.find(sess->session());
+        if (rit == results.end()) continue;
+
+        // Don't clobber events something else has loaded (or generated) since
+        if (!sess->eventsLoaded() && (sess->eventlist.size() == 0)) {
+            sess->AdoptEvents(*rit.value());
+        }
+    }
+    qDeleteAll(results);
+}
+
+void DayPrefetcher::touch(Day *day)
+{
+    if (!day) return;
+
+    QDate date = day->date();
+    m_recent.removeAll(date);
+    m_recent.prepend(date);
+
+    // The current day always stays; older days are dropped once either limit is passed
+    qint64 total = 0;
+    int kept = 0;
+    for (int i = 0; i < m_recent.size(); ++i) {
+        Day * d = p_profile->FindDay(m_recent.at(i));
+        if (d) {
+            total += eventMemory(d);
+        }
+
+        if ((i > 0) && (!d || (kept >= m_maxdays) || (total > m_budget))) {
+            m_recent.removeAt(i--);
+            continue;
+        }
+        kept++;
+    }
+}
+
+bool DayPrefetcher::isRetained(Day *day) const
+{
+    return day && m_recent.contains(day->date());
+}
+
+void DayPrefetcher::clear()
+{
+    m_epoch.ref();
+    m_pool.clear();
+    m_pool.waitForDone(-1);
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_ready.begin(), end = m_ready.end(); it != end; ++it) {
+        qDeleteAll(it.value());
+    }
+    m_ready.clear();
+    m_wanted.clear();
+
+    // Tasks removed from the queue by clear() never report back
+    m_pending.clear();
+    m_recent.clear();
+}
+
+qint64 DayPrefetcher::eventMemory(Day *day)
+{
+    qint64 bytes = 0;
+
+    for (const auto & sess : day->sessions) {
+        for (auto it = sess->eventlist.begin(), end = sess->eventlist.end(); it != end; ++it) {
+            for (const auto & el : it.value()) {
+                qint64 per = sizeof(EventStoreType);
+                if (el->hasSecondField()) per += sizeof(EventStoreType);
+                if (el->type() != EVL_Waveform) per += sizeof(quint32);
+                bytes += per * el->count();
+            }
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,111 @@
+/* SleepLib Day Prefetcher Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef DAYPREFETCH_H
+#define DAYPREFETCH_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "SleepLib/session.h"
+
+class Day;
+class DayPrefetcher;
+
+/*! \class DayPrefetchTask
+    \brief Reads a single day's Session events files on a worker thread
+    */
+class DayPrefetchTask : public QRunnable
+{
+  public:
+    DayPrefetchTask(DayPrefetcher *owner, int epoch, QDate date,
+                    const QList<QPair<SessionID, QString> > &files)
+        : owner(owner), epoch(epoch), date(date), files(files) {}
+    virtual ~DayPrefetchTask() {}
+
+    virtual void run();
+
+  protected:
+    DayPrefetcher *owner;
+    int epoch;
+    QDate date;
+    QList<QPair<SessionID, QString> > files;
+};
+
+/*! \class DayPrefetcher
+    \brief Loads the events for days the user is likely to view next in the background, and
+           keeps a few recently viewed days open within a memory budget.
+
+    All public methods must be called from the GUI thread, which owns the Day records.
+    */
+class DayPrefetcher
+{
+    friend class DayPrefetchTask;
+
+  public:
+    DayPrefetcher();
+    ~DayPrefetcher();
+
+    /*! \brief Queues the events of the days either side of the one being viewed to be read in the background.
+        Anything read for other days is thrown away, so only the neighbours' events are ever held here */
+    void prefetchNeighbours(Day *prev, Day *next);
+
+    //! \brief Hands events read in the background to day's Sessions, waiting if they are still being read
+    void adopt(Day *day);
+
+    //! \brief Marks day as the most recently viewed, and trims the retained list to the limits
+    void touch(Day *day);
+
+    //! \brief Returns true if day is one of the recently viewed days being kept open
+    bool isRetained(Day *day) const;
+
+    //! \brief Cancels outstanding work and forgets everything. Call before any Day records are deleted
+    void clear();
+
+    //! \brief Sets the approximate memory recently viewed days' events may use before being closed
+    void setMemoryBudget(qint64 bytes) { m_budget = bytes; }
+
+    //! \brief Sets how many recently viewed days are kept open at most
+    void setMaxDays(int days) { m_maxdays = days; }
+
+    //! \brief Returns an estimate of the memory used by day's loaded events
+    static qint64 eventMemory(Day *day);
+
+  protected:
+    //! \brief Queues day's events to be read in the background, unless already loaded or queued. Called with m_mutex held
+    void prefetch(Day *day);
+
+    //! \brief Called by the worker with the events it read for date
+    void finished(int epoch, QDate date, QHash<SessionID, SessionEventData *> &results);
+
+    QThreadPool m_pool;
+    mutable QMutex m_mutex;
+    QWaitCondition m_done;
+
+    QSet<QDate> m_pending;
+    QHash<QDate, QHash<SessionID, SessionEventData *> > m_ready;
+
+    //! \brief The neighbouring days whose events are worth keeping once read
+    QSet<QDate> m_wanted;
+
+    //! \brief Recently viewed days, most recent first
+    QList<QDate> m_recent;
+
+    QAtomicInt m_epoch;
+    qint64 m_budget;
+    int m_maxdays;
+};
+
+#endif // DAYPREFETCH_H
@@ -87,10 +87,11 @@ void EventList::AddEvent(qint64 time, EventStoreType data)
         // This really shouldn't happen.
         qDebug() << "Unordered time detected in AddEvent().";
 
-        qint32 delta = (m_first - time);
+        // Offsets are from m_first, which moves back by delta, so they all grow by it
+        quint32 delta = (m_first - time);
 
         for (quint32 i = 0; i < m_count; ++i) {
-            m_time[i] -= delta;
+            m_time[i] += delta;
         }
 
         m_first = time;
@@ -120,6 +121,204 @@ void EventList::AddEvent(qint64 time, EventStoreType data, EventStoreType data2)
     m_data2.push_back(data2);
 }
 
+void EventList::reserve(quint32 count)
+{
+    quint32 size = m_count + count;
+
+    m_data.reserve(size);
+    if (m_type == EVL_Event) m_time.reserve(size);
+    if (m_second_field) m_data2.reserve(size);
+}
+
+void EventList::AddEvents(const qint64 *time, const EventStoreType *data, int count)
+{
+    AddEvents(time, data, nullptr, count);
+}
+
+// Adds a block of events with one resize, instead of growing per AddEvent
+void EventList::AddEvents(const qint64 *time, const EventStoreType *data, const EventStoreType *data2, int count)
+{
+    if (m_type != EVL_Event) {
+        qWarning() << "Attempted to add events to non-event object";
+        return;
+    }
+
+    if (count < 1) return;
+
+    // Plain min/max passes over the whole block; simple enough for the compiler to vectorize
+    qint64 tmin = time[0], tmax = time[0];
+    for (int i = 1; i < count; ++i) {
+        tmin = (time[i] < tmin) ? time[i] : tmin;
+        tmax = (time[i] > tmax) ? time[i] : tmax;
+    }
+
+    if (!m_first) {
+        m_first = tmin;
+        m_last = tmin;
+    }
+
+    if (m_first > tmin) {
+        qDebug() << "Unordered time detected in AddEvents().";
+
+        // Same rebasing as AddEvent()
+        quint32 delta = (m_first - tmin);
+        quint32 *tp = m_time.data();
+        for (quint32 i = 0; i < m_count; ++i) {
+            tp[i] += delta;
+        }
+
+        m_first = tmin;
+    }
+
+    if (m_last < tmax) {
+        m_last = tmax;
+    }
+
+    quint32 r = m_count;
+    m_count += count;
+
+    m_data.resize(m_count);
+    m_time.resize(m_count);
+    memcpy(m_data.data() + r, data, count * sizeof(EventStoreType));
+
+    quint32 *tp = m_time.data() + r;
+    for (int i = 0; i < count; ++i) {
+        tp[i] = quint32(time[i] - m_first);
+    }
+
+    if (m_update_minmax) {
+        EventStoreType rmin = data[0], rmax = data[0];
+        for (int i = 1; i < count; ++i) {
+            rmin = (data[i] < rmin) ? data[i] : rmin;
+            rmax = (data[i] > rmax) ? data[i] : rmax;
+        }
+
+        // Gain could be negative, so gain both ends before comparing
+        EventDataType a = EventDataType(rmin) * m_gain, b = EventDataType(rmax) * m_gain;
+        EventDataType mn = qMin(a, b), mx = qMax(a, b);
+
+        if (r == 0) {
+            m_min = mn;
+            m_max = mx;
+        } else {
+            m_min = qMin(m_min, mn);
+            m_max = qMax(m_max, mx);
+        }
+    }
+
+    if (!m_second_field) return;
+
+    m_data2.resize(m_count);
+    EventStoreType *d2 = m_data2.data() + r;
+
+    if (!data2) {
+        memset(d2, 0, count * sizeof(EventStoreType));
+        return;
+    }
+
+    memcpy(d2, data2, count * sizeof(EventStoreType));
+
+    for (int i = 0; i < count; ++i) {
+        m_min2 = (data2[i] < m_min2) ? data2[i] : m_min2;
+        m_max2 = (data2[i] > m_max2) ? data2[i] : m_max2;
+    }
+}
+
+// Adds the changes in a fixed-rate signal as run-length events
+void EventList::AddStepSignal(qint64 start, double rate, const EventStoreType *data, int recs, bool square, bool closing)
+{
+    if (m_type != EVL_Event) {
+        qWarning() << "Attempted to add a step signal to non-event object";
+        return;
+    }
+
+    if (recs < 1) return;
+
+    if (m_count && (start < m_first)) {
+        // Rare enough not to bother doing quickly, AddEvent already deals with moving m_first
+        AddEvent(start, data[0]);
+        for (int i = 1; i < recs; ++i) {
+            if (data[i] != data[i-1]) {
+                qint64 t = start + qint64(double(i) * rate);
+                if (square) AddEvent(t, data[i-1]);
+                AddEvent(t, data[i]);
+            }
+        }
+        if (closing) AddEvent(start + qint64(double(recs) * rate), data[recs-1]);
+        return;
+    }
+
+    // Count the changes first, so storage can be sized exactly
+    int changes = 0;
+    for (int i = 1; i < recs; ++i) {
+        changes += (data[i] != data[i-1]);
+    }
+
+    int events = 1 + (square ? changes * 2 : changes) + (closing ? 1 : 0);
+
+    if (!m_first) {
+        m_first = start;
+        m_last = start;
+    }
+
+    quint32 r = m_count;
+    m_count += events;
+    m_data.resize(m_count);
+    m_time.resize(m_count);
+
+    EventStoreType *dp = m_data.data() + r;
+    quint32 *tp = m_time.data() + r;
+
+    qint64 base = start - m_first;
+    qint64 t = base;
+
+    EventStoreType rmin = data[0], rmax = data[0];
+
+    *dp++ = data[0];
+    *tp++ = quint32(base);
+
+    for (int i = 1; i < recs; ++i) {
+        EventStoreType c = data[i];
+        if (c == data[i-1]) continue;
+
+        t = base + qint64(double(i) * rate);
+
+        if (square) {
+            *dp++ = data[i-1];
+            *tp++ = quint32(t);
+        }
+        *dp++ = c;
+        *tp++ = quint32(t);
+
+        rmin = (c < rmin) ? c : rmin;
+        rmax = (c > rmax) ? c : rmax;
+    }
+
+    if (closing) {
+        t = base + qint64(double(recs) * rate);
+        *dp++ = data[recs-1];
+        *tp++ = quint32(t);
+    }
+
+    if (m_last < m_first + t) {
+        m_last = m_first + t;
+    }
+
+    if (m_update_minmax) {
+        // Gain could be negative, so gain both ends before comparing
+        EventDataType a = EventDataType(rmin) * m_gain, b = EventDataType(rmax) * m_gain;
+        EventDataType mn = qMin(a, b), mx = qMax(a, b);
+
+        if (r == 0) {
+            m_min = mn;
+            m_max = mx;
+        } else {
+            m_min = qMin(m_min, mn);
+            m_max = qMax(m_max, mx);
+        }
+    }
+}
+
 // Adds a consecutive waveform chunk
 void EventList::AddWaveform(qint64 start, qint16 *data, int recs, qint64 duration)
 {
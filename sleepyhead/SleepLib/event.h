@@ -36,10 +36,28 @@ class EventList
       Note, data2 is only used if second_field is specified in the constructor */
     void AddEvent(qint64 time, EventStoreType data);
     void AddEvent(qint64 time, EventStoreType data, EventStoreType data2);
+
+    //! \brief Makes room for count more events, so a loader that knows (or can estimate) how many are coming grows storage once
+    void reserve(quint32 count);
+
+    /*! \brief Adds count events at once, from parallel arrays of millisecond times and raw data (and data2).
+        Storage is resized a single time and min/max are found in one pass over the block.
+        data2 may be null, and is ignored unless second_field was specified in the constructor */
+    void AddEvents(const qint64 *time, const EventStoreType *data, int count);
+    void AddEvents(const qint64 *time, const EventStoreType *data, const EventStoreType *data2, int count);
+
     void AddWaveform(qint64 start, qint16 *data, int recs, qint64 duration);
     void AddWaveform(qint64 start, unsigned char *data, int recs, qint64 duration);
     void AddWaveform(qint64 start, char *data, int recs, qint64 duration);
 
+    /*! \brief Adds a fixed-rate signal of recs samples starting at start, as run-length events:
+        one event where each run of equal values begins, rate milliseconds per sample.
+
+        Storage is sized exactly in a counting pass and filled directly, instead of an AddEvent per change.
+        square adds the old value at each change too, so lines drawn between events step rather than slope.
+        closing adds a final event at the end of the last sample, holding its value. */
+    void AddStepSignal(qint64 start, double rate, const EventStoreType *data, int recs, bool square = false, bool closing = true);
+
     //! \brief Returns a count of records contained in this EventList
     inline quint32 count() const { return m_count; }
 
@@ -185,4 +203,53 @@ class EventList
     bool m_second_field;
 };
 
+/*! \class EventBuffer
+    \brief Collects events bound for an EventList while a record is parsed, so they are either
+           added in one go by commit(), or thrown away by rollback() if the record turns out bad.
+    */
+class EventBuffer
+{
+  public:
+    EventBuffer(int expected = 0) { reserve(expected); }
+
+    //! \brief Makes room for count events in the buffer
+    void reserve(int count) { m_time.reserve(count); m_data.reserve(count); }
+
+    inline void add(qint64 time, EventStoreType data) {
+        m_time.append(time);
+        m_data.append(data);
+    }
+    inline void add(qint64 time, EventStoreType data, EventStoreType data2) {
+        // data2 is kept in step with data, padded if earlier events didn't have one
+        m_data2.resize(m_data.size());
+        add(time, data);
+        m_data2.append(data2);
+    }
+
+    //! \brief Returns the count of events waiting to be committed
+    inline int count() const { return m_data.size(); }
+
+    //! \brief Adds the buffered events to el and empties the buffer
+    void commit(EventList *el) {
+        if (el && !m_data.isEmpty()) {
+            if (!m_data2.isEmpty()) m_data2.resize(m_data.size());
+            el->AddEvents(m_time.constData(), m_data.constData(),
+                          m_data2.isEmpty() ? nullptr : m_data2.constData(), m_data.size());
+        }
+        rollback();
+    }
+
+    //! \brief Throws away the buffered events, keeping the allocation for reuse
+    void rollback() {
+        m_time.resize(0);
+        m_data.resize(0);
+        m_data2.resize(0);
+    }
+
+  protected:
+    QVector<qint64> m_time;
+    QVector<EventStoreType> m_data;
+    QVector<EventStoreType> m_data2;
+};
+
 #endif // EVENT_H
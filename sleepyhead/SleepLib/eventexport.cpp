@@ -0,0 +1,268 @@
+/* SleepLib Event Export Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+
+#include "eventexport.h"
+#include "profiles.h"
+#include "session.h"
+#include "day.h"
+
+//! \brief Lists table rows are written out once this many have built up
+const int eventexport_list_rows = 65536;
+
+static QList<ArrowField> sampleFields()
+{
+    QList<ArrowField> fields;
+    fields << ArrowField("list", ARROW_UInt32)
+           << ArrowField("time", ARROW_Timestamp)
+           << ArrowField("raw", ARROW_Int16);
+    return fields;
+}
+
+static QList<ArrowField> listFields()
+{
+    QList<ArrowField> fields;
+    fields << ArrowField("list", ARROW_UInt32)
+           << ArrowField("session", ARROW_UInt32)
+           << ArrowField("machine", ARROW_Utf8)
+           << ArrowField("channel", ARROW_UInt32)
+           << ArrowField("code", ARROW_Utf8)
+           << ArrowField("name", ARROW_Utf8)
+           << ArrowField("units", ARROW_Utf8)
+           << ArrowField("type", ARROW_Utf8)
+           << ArrowField("rate", ARROW_Float64)
+           << ArrowField("gain", ARROW_Float32)
+           << ArrowField("offset", ARROW_Float32)
+           << ArrowField("first", ARROW_Timestamp)
+           << ArrowField("last", ARROW_Timestamp)
+           << ArrowField("count", ARROW_UInt32);
+    return fields;
+}
+
+static QVector<ArrowColumn> columnsFor(const QList<ArrowField> &fields)
+{
+    QVector<ArrowColumn> columns;
+    for (const auto & field : fields) {
+        columns.append(ArrowColumn(field.type));
+    }
+    return columns;
+}
+
+EventExportTask::EventExportTask(SessionID session, const QString &machine, const QString &filename)
+    : session(session), machine(machine), filename(filename)
+{
+    samples = columnsFor(sampleFields());
+}
+
+void EventExportTask::prepare()
+{
+    // Always read from disk, so nothing the GUI thread has open is touched
+    SessionEventData events;
+    if (!Session::ReadEvents(filename, events)) return;
+
+    const QHash<ChannelID, QVector<EventList *> > &eventlist = events.eventlist;
+
+    QList<ChannelID> codes = eventlist.keys();
+    std::sort(codes.begin(), codes.end());
+
+    int total = 0;
+    for (auto it = eventlist.begin(), end = eventlist.end(); it != end; ++it) {
+        for (const auto & ev : it.value()) {
+            total += ev->count();
+        }
+    }
+    for (auto & column : samples) {
+        column.reserve(total);
+    }
+
+    for (const auto & code : codes) {
+        for (const auto & ev : eventlist.value(code)) {
+            quint32 list = lists.size();
+            quint32 count = ev->count();
+
+            ExportedEventList info;
+            info.code = code;
+            info.type = ev->type();
+            info.rate = ev->rate();
+            info.gain = ev->gain();
+            info.offset = ev->offset();
+            info.first = ev->first();
+            info.last = ev->last();
+            info.count = count;
+            lists.append(info);
+
+            for (quint32 i = 0; i < count; ++i) {
+                samples[0].append<quint32>(list);
+                samples[1].append<qint64>(ev->time(i));
+            }
+            samples[2].append<EventStoreType>(ev->rawData(), count);
+        }
+    }
+}
+
+EventExporter::EventExporter(QDate start, QDate end)
+    : m_start(start), m_end(end), m_listcount(0)
+{
+}
+
+EventExporter::~EventExporter()
+{
+}
+
+QString EventExporter::listsFilename(const QString &filename)
+{
+    QString base = filename;
+    if (base.endsWith(".arrow", Qt::CaseInsensitive)) {
+        base.chop(6);
+    }
+    return base + ".lists.arrow";
+}
+
+bool EventExporter::writeSession(EventExportTask *task, ArrowFileWriter &samples, ArrowFileWriter &lists)
+{
+    ArrowColumn &listcol = task->samples[0];
+
+    if (listcol.length() > 0) {
+        // List numbers run on across the whole export
+        quint32 *list = reinterpret_cast<quint32 *>(listcol.data().data());
+        for (int i = 0, n = listcol.length(); i < n; ++i) {
+            list[i] += m_listcount;
+        }
+
+        if (!samples.write(task->samples)) {
+            return false;
+        }
+    }
+
+    for (const auto & info : task->lists) {
+        schema::Channel &chan = schema::channel[info.code];
+
+        m_listrows[0].append<quint32>(m_listcount++);
+        m_listrows[1].append<quint32>(task->session);
+        m_listrows[2].append(task->machine);
+        m_listrows[3].append<quint32>(info.code);
+        m_listrows[4].append(chan.code());
+        m_listrows[5].append(chan.fullname());
+        m_listrows[6].append(chan.units());
+        m_listrows[7].append(QString((info.type == EVL_Waveform) ? "waveform" : "event"));
+        m_listrows[8].append<double>(info.rate);
+        m_listrows[9].append<float>(info.gain);
+        m_listrows[10].append<float>(info.offset);
+        m_listrows[11].append<qint64>(info.first);
+        m_listrows[12].append<qint64>(info.last);
+        m_listrows[13].append<quint32>(info.count);
+    }
+
+    if (m_listrows[0].length() >= eventexport_list_rows) {
+        if (!lists.write(m_listrows)) {
+            return false;
+        }
+        for (auto & column : m_listrows) {
+            column.clear();
+        }
+    }
+    return true;
+}
+
+bool EventExporter::exportTo(const QString &filename)
+{
+    m_queue.reset();
+    m_listcount = 0;
+    m_listrows = columnsFor(listFields());
+
+    QString listsname = listsFilename(filename);
+
+    QList<QPair<QString, QString> > metadata;
+    metadata << qMakePair(QString("profile"), p_profile->user->userName());
+    metadata << qMakePair(QString("start"), m_start.toString(Qt::ISODate));
+    metadata << qMakePair(QString("end"), m_end.toString(Qt::ISODate));
+
+    QList<QPair<QString, QString> > samplemeta = metadata;
+    samplemeta << qMakePair(QString("lists"), QFileInfo(listsname).fileName());
+    samplemeta << qMakePair(QString("value"), QString("raw * gain, from the lists row with the same list number"));
+
+    ArrowFileWriter samples(sampleFields(), samplemeta);
+    ArrowFileWriter lists(listFields(), metadata);
+
+    if (!samples.open(filename) || !lists.open(listsname)) {
+        samples.cancel();
+        lists.cancel();
+        return false;
+    }
+
+    // Only what the workers need is copied out, as Sessions may change while events are processed below
+    struct ExportedSession {
+        SessionID session;
+        QString machine;
+        QString filename;
+    };
+    QList<ExportedSession> sessions;
+
+    for (auto it = p_profile->daylist.lowerBound(m_start), end = p_profile->daylist.end(); (it != end) && (it.key() <= m_end); ++it) {
+        for (auto & sess : it.value()->sessions) {
+            if ((sess->type() != MT_JOURNAL) && sess->enabled()) {
+                ExportedSession exported;
+                exported.session = sess->session();
+                exported.machine = sess->machine()->serial();
+                exported.filename = sess->eventFile();
+                sessions.append(exported);
+            }
+        }
+    }
+
+    emit setProgressMax(sessions.size());
+    emit setProgressValue(0);
+
+    int next = 0;
+    int written = 0;
+    bool ok = true;
+
+    while (ok) {
+        while (!cancelled() && (next < sessions.size()) && m_queue.hasRoom()) {
+            const ExportedSession & exported = sessions.at(next++);
+            m_queue.start(new EventExportTask(exported.session, exported.machine, exported.filename));
+        }
+
+        EventExportTask *task = static_cast<EventExportTask *>(m_queue.next());
+        if (!task) break;
+
+        ok = !cancelled() && writeSession(task, samples, lists);
+        delete task;
+
+        emit setProgressValue(++written);
+    }
+
+    if (ok && (m_listrows[0].length() > 0)) {
+        ok = lists.write(m_listrows);
+    }
+    m_listrows.clear();
+
+    if (!ok || cancelled()) {
+        // Stop what's still queued, and throw the partial files away
+        m_queue.abort();
+
+        samples.cancel();
+        lists.cancel();
+        return false;
+    }
+
+    if (!lists.commit()) {
+        samples.cancel();
+        return false;
+    }
+    if (!samples.commit()) {
+        QFile::remove(listsname);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,122 @@
+/* SleepLib Event Export Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef EVENTEXPORT_H
+#define EVENTEXPORT_H
+
+#include <QObject>
+#include <QDate>
+#include <QList>
+#include <QVector>
+#include <QString>
+
+#include "SleepLib/machine_common.h"
+#include "SleepLib/event.h"
+#include "SleepLib/arrowwriter.h"
+#include "SleepLib/exportqueue.h"
+
+class Session;
+class EventExporter;
+
+/*! \struct ExportedEventList
+    \brief What one EventList in an event export was, for its row in the lists table
+    */
+struct ExportedEventList
+{
+    ChannelID code;
+    EventListType type;
+    double rate;
+    EventDataType gain;
+    EventDataType offset;
+    qint64 first;
+    qint64 last;
+    quint32 count;
+};
+
+/*! \class EventExportTask
+    \brief Reads one session's events file and lays it out as Arrow columns, on one of EventExporter's worker threads.
+
+    It only holds the session's number, machine serial and file name, never the Session itself.
+    */
+class EventExportTask : public ExportTask
+{
+    friend class EventExporter;
+
+  public:
+    EventExportTask(SessionID session, const QString &machine, const QString &filename);
+    virtual ~EventExportTask() {}
+
+  protected:
+    virtual void prepare();
+
+    SessionID session;
+    QString machine;
+    QString filename;
+
+    //! \brief The samples table columns: list number within this session, time and raw value
+    QVector<ArrowColumn> samples;
+
+    //! \brief What each of this session's lists was, by list number
+    QList<ExportedEventList> lists;
+};
+
+/*! \class EventExporter
+    \brief Writes the raw waveforms and events of every session between two dates to Apache Arrow files.
+
+    The samples file holds one row per sample or event: the list it came from, its time and its raw
+    stored value. Each session goes in as a record batch of its own. The lists file, named after the
+    samples file with a .lists.arrow ending, has a row per EventList with its session, machine,
+    channel details, gain, offset, sample rate and time span, joined to the samples by list number.
+    The value SleepyHead shows for a sample is raw * gain.
+
+    Sessions are always read from disk on worker threads with Session::ReadEvents, without being
+    attached to the profile, and written out in date order, so only a few sessions are held at once
+    however large the date range.
+    */
+class EventExporter : public QObject
+{
+    Q_OBJECT
+
+  public:
+    EventExporter(QDate start, QDate end);
+    virtual ~EventExporter();
+
+    /*! \brief Writes the export to filename and its lists file. Must be called from the thread that owns
+        the Day records, which keeps processing events while it waits. Returns false if either file
+        couldn't be written, or the export was cancelled, in which case nothing is left behind */
+    bool exportTo(const QString &filename);
+
+    //! \brief Returns true if cancel() has been called
+    bool cancelled() const { return m_queue.cancelled(); }
+
+    //! \brief Returns the name of the lists file that goes with the samples file filename
+    static QString listsFilename(const QString &filename);
+
+  public slots:
+    //! \brief Asks a running export to stop
+    void cancel() { m_queue.cancel(); }
+
+  signals:
+    void setProgressMax(int max);
+    void setProgressValue(int val);
+
+  protected:
+    //! \brief Writes a finished session's samples, numbering its lists on from m_listcount, and adds rows for them to m_listrows
+    bool writeSession(EventExportTask *task, ArrowFileWriter &samples, ArrowFileWriter &lists);
+
+    QDate m_start;
+    QDate m_end;
+
+    //! \brief The lists table rows not written yet, and the number of lists so far
+    QVector<ArrowColumn> m_listrows;
+    quint32 m_listcount;
+
+    ExportQueue m_queue;
+};
+
+#endif // EVENTEXPORT_H
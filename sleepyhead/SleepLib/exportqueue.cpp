@@ -0,0 +1,101 @@
+/* SleepLib Export Queue Implementation
+ *
+ * Copyright (c) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#include <QApplication>
+#include <QMutexLocker>
+#include <QThread>
+
+#include "exportqueue.h"
+#include "appsettings.h"
+#include "profiles.h"
+
+// Every ExportQueue in existence, so exports can be stopped when Day records change
+static QList<ExportQueue *> exportQueues;
+static QMutex exportQueuesMutex;
+
+void ExportTask::run()
+{
+    if (!queue->cancelled()) {
+        prepare();
+    }
+    queue->finished(this);
+}
+
+ExportQueue::ExportQueue()
+{
+    m_pool.setMaxThreadCount(AppSetting->multithreading() ? qMax(QThread::idealThreadCount(), 1) : 1);
+
+    // Enough to keep every worker busy, but no further ahead of the caller than that
+    m_maxqueued = m_pool.maxThreadCount() * 2;
+
+    QMutexLocker locker(&exportQueuesMutex);
+    if (exportQueues.isEmpty()) {
+        Profile::addDayReader(ExportQueue::cancelAll);
+    }
+    exportQueues.append(this);
+}
+
+ExportQueue::~ExportQueue()
+{
+    {
+        QMutexLocker locker(&exportQueuesMutex);
+        exportQueues.removeAll(this);
+    }
+    abort();
+}
+
+void ExportQueue::cancelAll()
+{
+    QMutexLocker locker(&exportQueuesMutex);
+    for (auto & queue : exportQueues) {
+        queue->cancel();
+
+        // Tasks may be reading Day records, so they have to be out of the way before those change
+        queue->m_pool.waitForDone(-1);
+    }
+}
+
+void ExportQueue::start(ExportTask *task)
+{
+    task->queue = this;
+    m_queue.append(task);
+    m_pool.start(task);
+}
+
+void ExportQueue::finished(ExportTask *task)
+{
+    QMutexLocker locker(&m_mutex);
+    task->done = true;
+    m_finished.wakeAll();
+}
+
+ExportTask *ExportQueue::next()
+{
+    if (m_queue.isEmpty()) {
+        return nullptr;
+    }
+    ExportTask *task = m_queue.takeFirst();
+
+    QMutexLocker locker(&m_mutex);
+    while (!task->done) {
+        m_finished.wait(&m_mutex, 50);
+
+        locker.unlock();
+        QApplication::processEvents();
+        locker.relock();
+    }
+    return task;
+}
+
+void ExportQueue::abort()
+{
+    cancel();
+    m_pool.waitForDone(-1);
+    qDeleteAll(m_queue);
+    m_queue.clear();
+}
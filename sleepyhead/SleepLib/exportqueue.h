@@ -0,0 +1,98 @@
+/* SleepLib Export Queue Header
+ *
+ * Copyright (C) 2011-2018 Mark Watkins <mark@jedimark.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the source code
+ * for more details. */
+
+#ifndef EXPORTQUEUE_H
+#define EXPORTQUEUE_H
+
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThreadPool>
+
+class ExportQueue;
+
+/*! \class ExportTask
+    \brief One piece of an export, prepared on an ExportQueue worker thread and written out in turn by the caller
+    */
+class ExportTask : public QRunnable
+{
+    friend class ExportQueue;
+
+  public:
+    ExportTask() : queue(nullptr), done(false) { setAutoDelete(false); }
+    virtual ~ExportTask() {}
+
+    virtual void run();
+
+  protected:
+    //! \brief Does the work for this piece of the export, on a worker thread
+    virtual void prepare() = 0;
+
+    ExportQueue *queue;
+    bool done;
+};
+
+/*! \class ExportQueue
+    \brief Runs ExportTasks on a worker pool, and hands them back in the order they were started.
+
+    No more than twice the thread count of tasks are in flight, so memory doesn't grow with the size
+    of the export. While waiting, the calling thread keeps processing events so a dialog's cancel
+    button still works. Profile::cancelDayReaders() cancels every running queue and waits for the
+    tasks already running, so tasks may read Day records that were there when they were queued.
+    */
+class ExportQueue
+{
+    friend class ExportTask;
+
+  public:
+    ExportQueue();
+    ~ExportQueue();
+
+    //! \brief Returns true if another task can be started without getting too far ahead of the caller
+    bool hasRoom() const { return m_queue.size() < m_maxqueued; }
+
+    //! \brief Returns true if no tasks are waiting to be taken
+    bool isEmpty() const { return m_queue.isEmpty(); }
+
+    //! \brief Queues task to run on a worker
+    void start(ExportTask *task);
+
+    //! \brief Waits for the oldest task to finish and returns it, or nullptr if there are none. The caller deletes it
+    ExportTask *next();
+
+    //! \brief Cancels, waits for and deletes any tasks still queued
+    void abort();
+
+    //! \brief Asks the tasks to stop. Safe to call from a slot while next() is waiting
+    void cancel() { m_abort.store(1); }
+
+    //! \brief Clears a previous cancel, ready for another export
+    void reset() { m_abort.store(0); }
+
+    //! \brief Returns true if cancel() has been called
+    bool cancelled() const { return m_abort.load() != 0; }
+
+  protected:
+    //! \brief Called by a task once prepare() returns
+    void finished(ExportTask *task);
+
+    //! \brief Cancels every running queue and waits for their running tasks, as Day records or Sessions are about to change
+    static void cancelAll();
+
+    QThreadPool m_pool;
+    QList<ExportTask *> m_queue;
+    int m_maxqueued;
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    QAtomicInt m_abort;
+};
+
+#endif // EXPORTQUEUE_H
@@ -18,9 +18,100 @@
 
 #include "edfparser.h"
 
+// Compressed bytes read from the file at a time
+const int EDFGzipChunk = 131072;
+
+EDFGzipReader::EDFGzipReader()
+    : m_inited(false), m_size(-1), m_eof(false), m_error(false)
+{
+}
+
+EDFGzipReader::~EDFGzipReader()
+{
+    close();
+}
+
+bool EDFGzipReader::open(const QString & name)
+{
+    close();
+
+    m_file.setFileName(name);
+    if (!m_file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    // The gzip trailer holds the inflated size (modulo 4GB, which no EDF gets near)
+    m_size = -1;
+    if ((m_file.size() > 18) && m_file.seek(m_file.size() - 4)) {
+        unsigned char ch[4];
+        if (m_file.read((char *)ch, 4) == 4) {
+            m_size = quint32(ch[0] | (ch[1] << 8) | (ch[2] << 16) | (quint32(ch[3]) << 24));
+        }
+    }
+
+    m_in.resize(EDFGzipChunk);
+
+    memset(&m_strm, 0, sizeof(m_strm));
+    m_inited = (inflateInit2(&m_strm, 15 + 16) == Z_OK); // gzip decoding
+    if (!m_inited || !m_file.seek(0)) {
+        return false;
+    }
+
+    m_eof = m_error = false;
+    return true;
+}
+
+void EDFGzipReader::close()
+{
+    if (m_inited) {
+        inflateEnd(&m_strm);
+        m_inited = false;
+    }
+    m_file.close();
+}
+
+qint64 EDFGzipReader::read(char *dest, qint64 len)
+{
+    qint64 done = 0;
+
+    while ((done < len) && !m_eof && !m_error) {
+        if (m_strm.avail_in == 0) {
+            qint64 n = m_file.read(m_in.data(), m_in.size());
+            if (n <= 0) {
+                // Truncated
+                m_error = true;
+                break;
+            }
+            m_strm.next_in = (Bytef *)m_in.data();
+            m_strm.avail_in = uInt(n);
+        }
+
+        uInt want = uInt(qMin(len - done, qint64(0x40000000)));
+        m_strm.next_out = (Bytef *)(dest + done);
+        m_strm.avail_out = want;
+
+        int ret = inflate(&m_strm, Z_NO_FLUSH);
+
+        qint64 got = want - m_strm.avail_out;
+        done += got;
+
+        if (ret == Z_STREAM_END) {
+            m_eof = true;
+            break;
+        }
+        if ((ret != Z_OK) && !((ret == Z_BUF_ERROR) && (got > 0 || m_strm.avail_in == 0))) {
+            m_error = true;
+            break;
+        }
+    }
+    return done;
+}
+
 EDFParser::EDFParser(QString name)
 {
     buffer = nullptr;
+    header = nullptr;
+    gz = nullptr;
     if (!name.isEmpty())
         Open(name);
 }
@@ -29,6 +120,21 @@ EDFParser::~EDFParser()
     for (auto & s : edfsignals) {
         if (s.data) { delete [] s.data; }
     }
+    delete gz;
+}
+
+// Copies n samples of little endian 16 bit data
+static inline void copySamples(qint16 *dest, const char *src, long n)
+{
+#ifdef Q_LITTLE_ENDIAN
+    // Intel x86, etc..
+    memcpy((char *)dest, src, n * 2);
+#else
+    // Big endian safe
+    for (long j = 0; j < n; ++j) {
+        dest[j] = quint8(src[j*2]) | (qint8(src[j*2+1]) << 8);
+    }
+#endif
 }
 // Read a 16 bits integer
 qint16 EDFParser::Read16()
@@ -168,14 +274,20 @@ bool EDFParser::Parse()
     // could do it earlier, but it won't crash from > EOF Reads
     if (eof) return false;
 
-    // Now check the file isn't truncated before allocating all the memory
-    long allocsize = 0;
+    long recbytes = 0;
     for (auto & sig : edfsignals) {
-        if (num_data_records > 0) {
-            allocsize += sig.nr * num_data_records * 2;
-        }
+        recbytes += sig.nr * 2;
+    }
+
+    // Now check the file isn't truncated before allocating all the memory
+    long allocsize = (num_data_records > 0) ? recbytes * num_data_records : 0;
+
+    // A compressed file's size comes from its gzip trailer
+    qint64 available = datasize - pos;
+    if (gz) {
+        available = (gz->size() >= 0) ? (gz->size() - EDFHeaderSize - pos) : allocsize;
     }
-    if (allocsize > (datasize - pos)) {
+    if (allocsize > available) {
         // Space required more than the remainder left to read,
         // so abort and let the user clean up the corrupted file themselves
         qWarning() << "EDFParser::Parse():" << filename << " is truncated!";
@@ -195,29 +307,47 @@ bool EDFParser::Parse()
         sig.pos = 0;
     }
 
+    if (!gz) {
+        for (int x = 0; x < num_data_records; x++) {
+            for (auto & sig : edfsignals) {
+                copySamples(&sig.data[sig.pos], &buffer[pos], sig.nr);
+                sig.pos += sig.nr;
+                pos += sig.nr * 2;
+            }
+        }
+        return true;
+    }
 
-    for (int x = 0; x < num_data_records; x++) {
-        for (auto & sig : edfsignals) {
-#ifdef Q_LITTLE_ENDIAN
-            // Intel x86, etc..
-            memcpy((char *)&sig.data[sig.pos], (char *)&buffer[pos], sig.nr * 2);
-            sig.pos += sig.nr;
-            pos += sig.nr * 2;
-#else
-            // Big endian safe
-            for (int j=0;j<sig.nr;j++) {
-                qint16 t=Read16();
-                sig.data[sig.pos++]=t;
+    // The reader sits just past the signal headers, where the data records start.
+    // Inflate a batch of records at a time, then deal them out to the signals
+    long count = qMax(num_data_records, 0L);
+    if (recbytes > 0) {
+        long batch = qMax(1L, 262144L / recbytes);
+        QByteArray scratch(int(batch * recbytes), 0);
+
+        for (long x = 0; x < count; x += batch) {
+            long n = qMin(batch, count - x);
+            qint64 want = qint64(n) * recbytes;
+
+            if (gz->read(scratch.data(), want) != want) {
+                qWarning() << "EDFParser::Parse():" << filename << " is truncated!";
+                return false;
+            }
+
+            const char *src = scratch.constData();
+            for (long r = 0; r < n; ++r) {
+                for (auto & sig : edfsignals) {
+                    copySamples(&sig.data[sig.pos], src, sig.nr);
+                    sig.pos += sig.nr;
+                    src += sig.nr * 2;
+                }
             }
-#endif
         }
     }
 
     return true;
 }
 
-QByteArray gUncompress(const QByteArray &data);
-
 bool EDFParser::Open(const QString & name)
 {
     if (buffer != nullptr) {
@@ -232,15 +362,35 @@ bool EDFParser::Open(const QString & name)
 
     if (name.endsWith(STR_ext_gz)) {
         filename = name; //name.mid(0, -3); // DoubleCheck: why am I cropping the extension? this is used for debugging
+        fi.close();
+
+        // Only the header is inflated here, Parse() streams the data records into the signals
+        gz = new EDFGzipReader();
+        if (!gz->open(name)) {
+            goto badfile;
+        }
 
-        // Open and decempress file
-        data = gUncompress(fi.readAll());
+        data.resize(EDFHeaderSize);
+        if (gz->read(data.data(), EDFHeaderSize) != EDFHeaderSize) {
+            goto badfile;
+        }
+
+        // Each signal has 256 bytes of header
+        bool ok;
+        long ns = QString::fromLatin1(((EDFHeader *)data.constData())->num_signals, 4).toLong(&ok);
+        if (!ok || (ns <= 0)) {
+            goto badfile;
+        }
+        data.resize(EDFHeaderSize + ns * 256);
+        if (gz->read(data.data() + EDFHeaderSize, ns * 256) != (ns * 256)) {
+            goto badfile;
+        }
     } else {
         // Open and read uncompressed file
         filename = name;
         data = fi.readAll();
+        fi.close();
     }
-    fi.close();
 
     filesize = data.size();
 
@@ -254,6 +404,8 @@ bool EDFParser::Open(const QString & name)
     return true;
 
 badfile:
+    delete gz;
+    gz = nullptr;
     filesize = 0;
     datasize = 0;
     buffer = nullptr;
@@ -14,6 +14,12 @@
 #include <QHash>
 #include <QList>
 #include <QMutex>
+#include <QFile>
+#ifdef _MSC_VER
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
 
 #include "SleepLib/common.h"
 
@@ -92,6 +98,39 @@ struct EDFSignal {
 };
 
 
+/*! \class EDFGzipReader
+    \brief Inflates a gzipped file a piece at a time, straight into the caller's buffers.
+
+    Reading forward never holds more than a small input buffer. This saves memory, not time: zlib
+    inflates as fast as gUncompress did, but the whole compressed file and its inflated copy are no
+    longer held side by side. Reads only go forward, there's no seeking.
+    */
+class EDFGzipReader
+{
+  public:
+    EDFGzipReader();
+    ~EDFGzipReader();
+
+    bool open(const QString & name);
+    void close();
+
+    //! \brief Inflates up to len bytes into dest, returning how many were read
+    qint64 read(char *dest, qint64 len);
+
+    //! \brief Returns the inflated size recorded in the gzip trailer, or -1 if it couldn't be read
+    qint64 size() const { return m_size; }
+
+  protected:
+    QFile m_file;
+    z_stream m_strm;
+    bool m_inited;
+    QByteArray m_in;
+
+    qint64 m_size;
+    bool m_eof;
+    bool m_error;
+};
+
 /*! \class EDFParser
     \author Mark Watkins <mark@jedimark.net>
     \brief Parse an EDF+ data file into a list of EDFSignal's
@@ -137,10 +176,14 @@ class EDFParser
     //! \brief Returns the patientid field from the EDF header
     QString GetPatient() { return patientident; }
 
-    //! \brief Parse the EDF+ file into the list of EDFSignals.. Must be call Open(..) first.
+    /*! \brief Parse the EDF+ file into the list of EDFSignals.. Must be call Open(..) first.
+        Compressed files are inflated straight into the signal buffers. */
     bool Parse();
     char *buffer;
 
+    //! \brief Streams the data records of a .gz file, whose header alone is in data
+    EDFGzipReader *gz;
+
     //! \brief  The EDF+ files header structure, used as a place holder while processing the text data.
     EDFHeader *header;
     QByteArray data;
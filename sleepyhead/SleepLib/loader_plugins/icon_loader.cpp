@@ -10,6 +10,7 @@
 #include <QMessageBox>
 #include <QDataStream>
 #include <QTextStream>
+#include <QThreadPool>
 #include <cmath>
 
 #include "icon_loader.h"
@@ -218,8 +219,25 @@ int FPIconLoader::OpenMachine(Machine *mach, const QString & path)
         OpenDetail(mach, det[i]);
     }
 
-    for (int i = 0; i < flw.size(); i++) {
-        OpenFLW(mach, flw[i]);
+    // Flow files are decoded side by side through the task queue, a batch of one per thread at a
+    // time, then matched up with sessions in order. Only a batch's flow data is held at once
+    int batch = AppSetting->multithreading() ? qMax(QThreadPool::globalInstance()->maxThreadCount(), 1) : 1;
+
+    for (int first = 0; (first < flw.size()) && !isAborted(); first += batch) {
+        QList<FPFLWFile *> flwfiles;
+        for (int i = first; i < qMin(first + batch, flw.size()); i++) {
+            FPFLWFile *file = new FPFLWFile(flw[i]);
+            flwfiles.push_back(file);
+            queTask(new FPFLWTask(this, file));
+        }
+        runTasks(AppSetting->multithreading());
+
+        for (int i = 0; i < flwfiles.size(); i++) {
+            if (flwfiles[i]->ok) {
+                AddFLW(mach, *flwfiles[i]);
+            }
+        }
+        qDeleteAll(flwfiles);
     }
 
     SessionID sid;//,st;
@@ -425,47 +443,82 @@ hour=(ts >> 12) & 0x1f; */
 // 0x0200-0x0203 32bit timestamp in
 bool FPIconLoader::OpenFLW(Machine *mach, const QString & filename)
 {
-    Q_UNUSED(mach);
+    FPFLWFile flw(filename);
 
-    quint32 ts;
-    double ti;
+    if (!ParseFLW(flw)) {
+        return false;
+    }
+    AddFLW(mach, flw);
 
-    EventList *flow = nullptr, * pressure = nullptr;
+    return true;
+}
 
-    qDebug() << filename;
-    QFile file(filename);
+const int FLW_samples_per_block = 50;
+const int FLW_block_size = FLW_samples_per_block * 2 + 3;
+
+// Copies count 16bit little endian values from src to dest
+static inline void copyLE16(qint16 *dest, const unsigned char *src, int count)
+{
+#ifdef Q_LITTLE_ENDIAN
+    memcpy((char *)dest, src, count * 2);
+#else
+    for (int i = 0; i < count; ++i, src += 2) {
+        dest[i] = qint16(src[0] | (src[1] << 8));
+    }
+#endif
+}
+
+// Scales a block of raw flow samples in place, and widens min/max to cover them
+static inline void scaleFLWBlock(qint16 *samples, int count, int offset, EventDataType &min, EventDataType &max)
+{
+    for (int i = 0; i < count; ++i) {
+        // Assuming Litres per hour, converting to litres per minute and applying offset?
+        // As in should be 60.0?
+        EventDataType val = (EventDataType(samples[i]) / 100.0) - offset;
+        samples[i] = val;
+
+        // Min and max are of the stored value, as AddWaveform finds them
+        val = samples[i];
+        min = (val < min) ? val : min;
+        max = (val > max) ? val : max;
+    }
+}
+
+bool FPIconLoader::ParseFLW(FPFLWFile & flw)
+{
+    qDebug() << flw.filename;
+    QFile file(flw.filename);
 
     if (!file.open(QFile::ReadOnly)) {
-        qDebug() << "Couldn't open" << filename;
+        qDebug() << "Couldn't open" << flw.filename;
         return false;
     }
 
     QByteArray header = file.read(0x200);
     if (header.size() != 0x200) {
-        qDebug() << "Short file" << filename;
+        qDebug() << "Short file" << flw.filename;
         return false;
     }
 
     unsigned char hsum = 0x0;
     for (int i = 0; i < 0x1ff; i++) { hsum ^= header[i]; }
     if (hsum != header[0x1ff]) {
-        qDebug() << "Header checksum mismatch" << filename;
+        qDebug() << "Header checksum mismatch" << flw.filename;
     }
 
     QTextStream htxt(&header);
-    QString h1, version, fname, serial, model, type;
+    QString h1, version, fname;
     htxt >> h1;
     htxt >> version;
     htxt >> fname;
-    htxt >> serial;
-    htxt >> model;
-    htxt >> type;
-
-    if (mach->model().isEmpty()) {
-        mach->setModel(model+" "+type);
-    }
+    htxt >> flw.serial;
+    htxt >> flw.model;
+    htxt >> flw.type;
 
     QByteArray buf = file.read(4);
+    if (buf.size() != 4) {
+        return false;
+    }
     unsigned char * data = (unsigned char *)buf.data();
 
     quint32 t2 = data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24;
@@ -478,17 +531,94 @@ bool FPIconLoader::OpenFLW(Machine *mach, const QString & filename)
     data = (unsigned char *)block.data();
 
     // Abort if crapy
-    if (!(data[103]==0xff && data[104]==0xff))
+    if ((block.size() <= 104) || !(data[103]==0xff && data[104]==0xff))
         return false;
 
-    ts = convertFLWDate(t2);
+    flw.ts = convertFLWDate(t2);
 
-    if (ts > QDateTime(QDate(2015,1,1), QTime(0,0,0)).toTime_t()) {
+    if (flw.ts > QDateTime(QDate(2015,1,1), QTime(0,0,0)).toTime_t()) {
         return false;
     }
 
+    // Find where each block starts first, so the lists can be sized once and filled in place
+    QVector<int> blocks;
+    blocks.reserve(block.size() / FLW_block_size);
+
+    quint16 endMarker = 0;
+    unsigned char *p = data;
+    unsigned char *end = data + block.size();
+
+    while (p + 2 <= end) {
+        endMarker = p[0] | (p[1] << 8);
+        if (endMarker == 0xffff) {
+            p += 2;
+            continue;
+        }
+        if ((endMarker == 0x7fff) || (p + FLW_block_size > end)) {
+            break;
+        }
+        blocks.append(p - data);
+        p += FLW_block_size;
+    }
+
+    if (endMarker != 0x7fff) {
+        qDebug() << fname << "waveform does not end with the corrent marker" << hex << endMarker;
+    }
+
+    int count = blocks.size();
+
+    const double rate = 1000.0 / double(FLW_samples_per_block);
+    const qint64 blockduration = qint64(FLW_samples_per_block * rate);
+    qint64 ti = qint64(flw.ts) * 1000L;
+
+    // F&P Overwrites this file, not appends to it.
+    flw.flow = new EventList(EVL_Waveform, 1.0F, 0, 0, 0, rate);
+    flw.pressure = new EventList(EVL_Event, 0.01F, 0, 0, 0, rate * double(FLW_samples_per_block));
+
+    flw.flow->setFirst(ti);
+    flw.pressure->setFirst(ti);
+
+    if (count > 0) {
+        // Flow samples are decoded straight into the waveform's storage
+        flw.flow->rawDataResize(count * FLW_samples_per_block);
+        qint16 *samples = flw.flow->rawData();
+
+        QVector<qint64> times(count);
+        QVector<EventStoreType> pressures(count);
+
+        EventDataType min = 32767, max = -32768;
+
+        for (int b = 0; b < count; ++b, samples += FLW_samples_per_block) {
+            const unsigned char *bp = data + blocks[b];
+
+            copyLE16(samples, bp, FLW_samples_per_block);
+            scaleFLWBlock(samples, FLW_samples_per_block, ((qint8 *)bp)[102], min, max);
+
+            // mask pressure
+            quint16 pres = bp[100] | (bp[101] << 8);
+            times[b] = ti + b * blockduration;
+            pressures[b] = pres;
+        }
+
+        flw.flow->setMin(min);
+        flw.flow->setMax(max);
+        flw.flow->setLast(ti + count * blockduration);
+
+        flw.pressure->AddEvents(times.constData(), pressures.constData(), count);
+    }
+    flw.end = ti + count * blockduration;
+
+    return true;
+}
 
-    ti = qint64(ts) * 1000L;
+void FPIconLoader::AddFLW(Machine *mach, FPFLWFile & flw)
+{
+    if (mach->model().isEmpty()) {
+        mach->setModel(flw.model+" "+flw.type);
+    }
+
+    quint32 ts = flw.ts;
+    qint64 ti = qint64(ts) * 1000L;
 
     QMap<SessionID, Session *>::iterator sit = Sessions.find(ts);
 
@@ -533,88 +663,35 @@ bool FPIconLoader::OpenFLW(Machine *mach, const QString & filename)
 //            qDebug() << filenum << ":" << date << "couldn't find matching session for" << ts;
         }
     }
-    const int samples_per_block = 50;
-    const double rate = 1000.0 / double(samples_per_block);
 
+    sess->setLast(CPAP_FlowRate, flw.end);
+    sess->setLast(CPAP_MaskPressure, flw.end);
+    sess->eventlist[CPAP_FlowRate].push_back(flw.flow);
+    sess->eventlist[CPAP_MaskPressure].push_back(flw.pressure);
 
-    // F&P Overwrites this file, not appends to it.
-    flow = new EventList(EVL_Waveform, 1.0F, 0, 0, 0, rate);
-    pressure = new EventList(EVL_Event, 0.01F, 0, 0, 0, rate * double(samples_per_block));
-
-    flow->setFirst(ti);
-    pressure->setFirst(ti);
-
-    quint16 endMarker;
-    qint8 offset;         // offset from center for this block
-    quint16 pres;       // mask pressure
-
-    qint16 tmp;
-
-    qint16 samples[samples_per_block];
-
-    EventDataType val;
-
-    unsigned char *p = data;
-    int datasize = block.size();
-    unsigned char *end = data+datasize;
-    do {
-        endMarker = *((quint16 *)p);
-        if (endMarker == 0xffff) {
-            p += 2;
-            continue;
-        }
-        if (endMarker == 0x7fff) {
-            break;
-        }
-        offset = ((qint8*)p)[102];
-        for (int i=0; i< samples_per_block; ++i) {
-            tmp = ((char *)p)[1] << 8 | p[0];
-            p += 2;
-            // Assuming Litres per hour, converting to litres per minute and applying offset?
-            // As in should be 60.0?
-            val = (EventDataType(tmp) / 100.0) - offset;
-            samples[i] = val;
-        }
-        flow->AddWaveform(ti, samples, samples_per_block, rate);
-
-        pres = *((quint16 *)p);
-        pressure->AddEvent(ti, pres);
-
-        ti += samples_per_block * rate;
-
-        p+=3; // (offset too)
-    } while (p < end);
-
-    if (endMarker != 0x7fff) {
-        qDebug() << fname << "waveform does not end with the corrent marker" << hex << endMarker;
-    }
-
-    if (sess) {
-        sess->setLast(CPAP_FlowRate, ti);
-        sess->setLast(CPAP_MaskPressure, ti);
-        sess->eventlist[CPAP_FlowRate].push_back(flow);
-        sess->eventlist[CPAP_MaskPressure].push_back(pressure);
-    }
+    // The session owns them now
+    flw.flow = flw.pressure = nullptr;
 
     if (newsess) {
         addSession(sess);
     }
 
     if (p_profile->session->backupCardData()) {
-        QString backup = mach->getBackupPath()+"FPHCARE/ICON/"+serial.right(serial.size()-4)+"/";
+        QString backup = mach->getBackupPath()+"FPHCARE/ICON/"+flw.serial.right(flw.serial.size()-4)+"/";
         QDir dir;
         QString newname = QString("FLW%1.FPH").arg(ts);
         dir.mkpath(backup);
         dir.cd(backup);
         if (!dir.exists(newname)) {
-            file.copy(backup+newname);
+            QFile::copy(flw.filename, backup+newname);
         }
     }
-
-
-    return true;
 }
 
+void FPFLWTask::run()
+{
+    flw->ok = loader->ParseFLW(*flw);
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Open Summary file
@@ -813,12 +890,8 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
         // faulty file..
         return false;
     }
-    QDataStream in(index);
     quint32 ts;
 
-    in.setVersion(QDataStream::Qt_4_6);
-    in.setByteOrder(QDataStream::LittleEndian);
-
     QVector<quint32> times;
     QVector<quint16> start;
     QVector<quint8> records;
@@ -828,15 +901,19 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
 
     int totalrecs = 0;
 
-    do {
-        in >> ts;
+    // Index entries are a 32bit timestamp, 16bit start record and 8bit record count, little endian
+    const unsigned char *ip = (const unsigned char *)index.constData();
+    const unsigned char *iend = ip + index.size();
+
+    for (; ip + 7 <= iend; ip += 7) {
+        ts = quint32(ip[0]) | quint32(ip[1]) << 8 | quint32(ip[2]) << 16 | quint32(ip[3]) << 24;
         if (ts == 0xffffffff) break;
         if ((ts & 0xfafe) == 0xfafe) break;
 
         ts = convertDate(ts);
 
-        in >> strt;
-        in >> recs;
+        strt = ip[4] | ip[5] << 8;
+        recs = ip[6];
         totalrecs += recs;
 
         if (Sessions.contains(ts)) {
@@ -844,13 +921,10 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
             start.push_back(strt);
             records.push_back(recs);
         }
-    } while (!in.atEnd());
+    }
 
     QByteArray databytes = file.readAll();
 
-    in.setVersion(QDataStream::Qt_4_6);
-    in.setByteOrder(QDataStream::BigEndian);
-
     // 5 byte repeating patterns
 
     quint8 *data = (quint8 *)databytes.data();
@@ -862,6 +936,9 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
     Session *sess;
     int idx;
 
+    // Pressure and leak arrive as three samples per record, so each session's lists are filled in one go
+    EventBuffer prbuf, lkbuf;
+
     for (int r = 0; r < start.size(); r++) {
         sessid = times[r];
         sess = Sessions[sessid];
@@ -880,14 +957,17 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
 
         idx = stidx * 15;
 
+        prbuf.reserve(rec * 3);
+        lkbuf.reserve(rec * 3);
+
         quint8 bitmask;
         for (int i = 0; i < rec; ++i) {
             for (int j = 0; j < 3; ++j) {
                 pressure = data[idx];
-                PR->AddEvent(ti+120000, pressure);
+                prbuf.add(ti+120000, pressure);
 
                 leak = data[idx + 1];
-                LK->AddEvent(ti+120000, leak);
+                lkbuf.add(ti+120000, leak);
 
                 a1 = data[idx + 2];   // [0..5] Obstructive flag, [6..7] Unknown
                 a2 = data[idx + 3];   // [0..5] Hypopnea,         [6..7] Unknown
@@ -913,6 +993,8 @@ bool FPIconLoader::OpenDetail(Machine *mach, const QString & filename)
                 idx += 5;
             }
         }
+        prbuf.commit(PR);
+        lkbuf.commit(LK);
 
         //  sess->really_set_last(ti-360000L);
         //        sess->SetChanged(true);
@@ -40,6 +40,54 @@ const int fpicon_load_buffer_size = 1024 * 1024;
 
 const QString fpicon_class_name = STR_MACH_FPIcon;
 
+/*! \struct FPFLWFile
+    \brief An FLW file's flow and mask pressure, decoded and waiting to be added to its session
+    */
+struct FPFLWFile
+{
+    FPFLWFile(const QString & filename)
+        : filename(filename), ts(0), end(0), flow(nullptr), pressure(nullptr), ok(false) {}
+    ~FPFLWFile() {
+        delete flow;
+        delete pressure;
+    }
+
+    QString filename;
+    QString serial, model, type;
+
+    //! \brief Start time of the file, and end of its last block of flow data
+    quint32 ts;
+    qint64 end;
+
+    //! \brief Owned here until the lists are handed over to a session
+    EventList *flow;
+    EventList *pressure;
+
+    //! \brief True if the file decoded successfully
+    bool ok;
+
+  private:
+    Q_DISABLE_COPY(FPFLWFile)
+};
+
+class FPIconLoader;
+
+/*! \class FPFLWTask
+    \brief Decodes an FLW file on a worker thread, leaving sessions alone
+    */
+class FPFLWTask : public ImportTask
+{
+  public:
+    FPFLWTask(FPIconLoader *loader, FPFLWFile *flw) : loader(loader), flw(flw) {}
+    virtual ~FPFLWTask() {}
+
+    virtual void run();
+
+  protected:
+    FPIconLoader *loader;
+    FPFLWFile *flw;
+};
+
 /*! \class FPIconLoader
     \brief Loader for Fisher & Paykel Icon data
     This is only relatively recent addition and still needs more work
@@ -64,6 +112,12 @@ class FPIconLoader : public CPAPLoader
     bool OpenDetail(Machine *mach, const QString & path);
     bool OpenFLW(Machine *mach, const QString & filename);
 
+    //! \brief Reads and decodes an FLW file. Touches no sessions, so it's safe to run from several threads at once
+    bool ParseFLW(FPFLWFile & flw);
+
+    //! \brief Hands the flow and pressure of a decoded FLW file to the session it belongs to
+    void AddFLW(Machine *mach, FPFLWFile & flw);
+
     //! \brief Returns SleepLib database version of this F&P Icon loader
     virtual int Version() { return fpicon_data_version; }
 
@@ -11,6 +11,7 @@
 #include <QDir>
 
 #include "intellipap_loader.h"
+#include "SleepLib/backupengine.h"
 
 ChannelID INTP_SmartFlexMode, INTP_SmartFlexLevel;
 
@@ -248,8 +249,10 @@ int IntellipapLoader::OpenDV5(const QString & path)
     QString backupPath = mach->getBackupPath();
     QString copypath = path;
 
+    // Copied in the background while the files are parsed, skipping anything already backed up
+    BackupEngine backups(backupPath);
     if (QDir::cleanPath(path).compare(QDir::cleanPath(backupPath)) != 0) {
-        copyPath(path, backupPath);
+        backups.queuePath(path, backupPath);
     }
 
 
@@ -665,6 +668,626 @@ PACK(struct SET_BIN_REC {
     unsigned char checksum;
 }); // http://digitalvampire.org/blog/index.php/2006/07/31/why-you-shouldnt-use-__attribute__packed/
 
+DV6RecordFile::DV6RecordFile(const QString & filename, int headerSize, int recordLength)
+    : m_file(filename), m_map(nullptr), m_data(nullptr), m_size(0),
+      m_headerSize(headerSize), m_recordLength(recordLength), m_count(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    m_size = m_file.size();
+    if (m_size > 0) {
+        m_map = m_file.map(0, m_size);
+    }
+    if (m_map) {
+        m_data = m_map;
+    } else {
+        // Not every file system can be mapped, so fall back to reading it in
+        m_buffer = m_file.readAll();
+        m_size = m_buffer.size();
+        m_data = (const unsigned char *)m_buffer.constData();
+    }
+    if (m_size > m_headerSize) {
+        m_count = (m_size - m_headerSize) / m_recordLength;
+    }
+}
+
+DV6RecordFile::~DV6RecordFile()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+    m_file.close();
+}
+
+void DV6RecordFile::truncateUnordered()
+{
+    for (int r=1; r<m_count; ++r) {
+        if (at(r).time() < at(r-1).time()) {
+            qDebug() << "Corruption/Out of sequence data found in" << m_file.fileName() << "at record" << r << "ignoring the rest";
+            m_count = r;
+            break;
+        }
+    }
+}
+
+int DV6RecordFile::lowerBound(quint32 time) const
+{
+    int lo = 0, hi = m_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (at(mid).time() < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*! \class DV6SessionTask
+    \brief Decodes one DV6 session from its time range of the R.BIN, L.BIN and E.BIN record files, then stores it
+    */
+class DV6SessionTask : public ImportTask
+{
+  public:
+    DV6SessionTask(IntellipapLoader * loader, Machine * mach, DV6_S_Record * R,
+                   const DV6RecordFile * rfile, const DV6RecordFile * lfile, const DV6RecordFile * efile, quint32 ep)
+        : loader(loader), mach(mach), R(R), rfile(rfile), lfile(lfile), efile(efile), ep(ep) {}
+    virtual ~DV6SessionTask() {}
+
+    virtual void run();
+
+  protected:
+    //! \brief Parses the flow and pressure waveforms and event flags from R.BIN
+    void parseR();
+    //! \brief Parses the per-minute data from L.BIN
+    void parseL();
+    //! \brief Parses the event list from E.BIN
+    void parseE();
+
+    IntellipapLoader * loader;
+    Machine * mach;
+    DV6_S_Record * R;
+    const DV6RecordFile * rfile;
+    const DV6RecordFile * lfile;
+    const DV6RecordFile * efile;
+    quint32 ep;
+};
+
+void DV6SessionTask::run()
+{
+    parseR();
+    parseL();
+    parseE();
+
+    Session * sess = R->sess;
+
+    // Update indexes, process waveform and perform flagging
+    sess->UpdateSummaries();
+
+    // Save and AddSession are not threadsafe
+    loader->sessionMutex.lock();
+    sess->Store(mach->getDataPath());
+    mach->AddSession(sess);
+    loader->sessionMutex.unlock();
+
+    // Unload them from memory
+    sess->TrashEvents();
+}
+
+void DV6SessionTask::parseR()
+{
+    Session * sess = R->sess;
+
+    EventList * flow = nullptr;
+    EventList * pressure = nullptr;
+//    EventList * leak = NULL;
+    EventList * OA  = nullptr;
+    EventList * HY  = nullptr;
+    EventList * NOA = nullptr;
+    EventList * EXP = nullptr;
+    EventList * FL  = nullptr;
+    EventList * PB  = nullptr;
+    EventList * VS  = nullptr;
+    EventList * LL  = nullptr;
+    EventList * RE  = nullptr;
+    bool inOA = false, inH = false, inCA = false, inExP = false, inVS = false, inFL = false, inPB = false, inRE = false, inLL = false;
+    qint64 OAstart = 0, OAend = 0;
+    qint64 Hstart = 0, Hend = 0;
+    qint64 CAstart = 0, CAend = 0;
+    qint64 ExPstart = 0, ExPend = 0;
+    qint64 VSstart = 0, VSend = 0;
+    qint64 FLstart = 0, FLend = 0;
+    qint64 PBstart = 0, PBend = 0;
+    qint64 REstart =0, REend = 0;
+    qint64 LLstart =0, LLend = 0;
+    quint32 ts1, lastts1 = 0;
+
+    for (int r=rfile->lowerBound(R->start_time - ep), n=rfile->count(); r<n; ++r) {
+        const unsigned char * data = rfile->at(r).data;
+
+        ts1 = rfile->at(r).time() + ep;
+        if (ts1 > R->stop_time) {
+            break;
+        }
+
+        if (flow && ((ts1 - lastts1) > 2)) {
+            sess->set_last(flow->last());
+
+            flow = nullptr;
+            pressure = nullptr;
+        }
+        lastts1=ts1;
+
+        if (!flow) {
+            flow = sess->AddEventList(CPAP_FlowRate, EVL_Waveform, 1.0f/60.0f, 0.0f, 0.0f, 0.0f, double(2000) / double(50));
+            pressure = sess->AddEventList(CPAP_Pressure, EVL_Waveform, 0.1f, 0.0f, 0.0f, 0.0f, double(2000) / double(2));
+            R->hasMaskPressure = true;
+            //leak = sess->AddEventList(CPAP_Leak, EVL_Waveform, 1.0, 0.0, 0.0, 0.0, double(2000) / double(1));
+            OA = sess->AddEventList(CPAP_Obstructive, EVL_Event);
+            NOA = sess->AddEventList(CPAP_NRI, EVL_Event);
+            RE = sess->AddEventList(CPAP_RERA, EVL_Event);
+            VS = sess->AddEventList(CPAP_VSnore, EVL_Event);
+            HY = sess->AddEventList(CPAP_Hypopnea, EVL_Event);
+            EXP = sess->AddEventList(CPAP_ExP, EVL_Event);
+            FL = sess->AddEventList(CPAP_FlowLimit, EVL_Event);
+            PB = sess->AddEventList(CPAP_PB, EVL_Event);
+            LL = sess->AddEventList(CPAP_LargeLeak, EVL_Event);
+        }
+
+        // starting at position 5 is 100 bytes, 16bit LE 25hz samples
+        qint16 *wavedata = (qint16 *)(&data[5]);
+
+        qint64 ti = qint64(ts1) * 1000;
+
+        unsigned char d[2];
+        d[0] = data[105];
+        d[1] = data[106];
+        flow->AddWaveform(ti+40000,wavedata,50,2000);
+        pressure->AddWaveform(ti+40000, d, 2, 2000);
+        // Fields data[107] && data[108] are bitfields default is 0x90, occasionally 0x98
+
+        d[0] = data[107];
+        d[1] = data[108];
+
+        //leak->AddWaveform(ti+40000, d, 2, 2000);
+
+
+        // Needs to track state to pull events out cleanly..
+
+        //////////////////////////////////////////////////////////////////
+        // High Leak
+        //////////////////////////////////////////////////////////////////
+
+        if (data[110] & 3) {  // LL state 1st second
+            if (!inLL) {
+                LLstart = ti;
+                inLL = true;
+            }
+            LLend = ti+1000L;
+        } else {
+            if (inLL) {
+                inLL = false;
+                LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
+                LLstart = 0;
+            }
+        }
+        if (data[114] & 3) {
+            if (!inLL) {
+                LLstart = ti+1000L;
+                inLL = true;
+            }
+            LLend = ti+2000L;
+
+        } else {
+            if (inLL) {
+                inLL = false;
+                LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
+                LLstart = 0;
+            }
+        }
+
+
+        //////////////////////////////////////////////////////////////////
+        // Obstructive Apnea
+        //////////////////////////////////////////////////////////////////
+
+        if (data[110] & 12) {  // OA state 1st second
+            if (!inOA) {
+                OAstart = ti;
+                inOA = true;
+            }
+            OAend = ti+1000L;
+        } else {
+            if (inOA) {
+                inOA = false;
+                OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
+                OAstart = 0;
+            }
+        }
+        if (data[114] & 12) {
+            if (!inOA) {
+                OAstart = ti+1000L;
+                inOA = true;
+            }
+            OAend = ti+2000L;
+
+        } else {
+            if (inOA) {
+                inOA = false;
+                OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
+                OAstart = 0;
+            }
+        }
+
+
+        //////////////////////////////////////////////////////////////////
+        // Hypopnea
+        //////////////////////////////////////////////////////////////////
+
+        if (data[110] & 192) {
+            if (!inH) {
+                Hstart = ti;
+                inH = true;
+            }
+            Hend = ti + 1000L;
+        } else {
+            if (inH) {
+                inH = false;
+                HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
+                Hstart = 0;
+            }
+        }
+
+        if (data[114] & 192) {
+            if (!inH) {
+                Hstart = ti+1000L;
+                inH = true;
+            }
+            Hend = ti + 2000L;
+        } else {
+            if (inH) {
+                inH = false;
+                HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
+                Hstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // Non Responding Apnea Event (Are these CA's???)
+        //////////////////////////////////////////////////////////////////
+        if (data[110] & 48) {  // OA state 1st second
+            if (!inCA) {
+                CAstart = ti;
+                inCA = true;
+            }
+            CAend = ti+1000L;
+        } else {
+            if (inCA) {
+                inCA = false;
+                NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
+                CAstart = 0;
+            }
+        }
+        if (data[114] & 48) {
+            if (!inCA) {
+                CAstart = ti+1000L;
+                inCA = true;
+            }
+            CAend = ti+2000L;
+
+        } else {
+            if (inCA) {
+                inCA = false;
+                NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
+                CAstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // VSnore Event
+        //////////////////////////////////////////////////////////////////
+        if (data[109] & 3) {  // OA state 1st second
+            if (!inVS) {
+                VSstart = ti;
+                inVS = true;
+            }
+            VSend = ti+1000L;
+        } else {
+            if (inVS) {
+                inVS = false;
+                VS->AddEvent(VSstart,(VSend-VSstart) / 1000L);
+                VSstart = 0;
+            }
+        }
+        if (data[113] & 3) {
+            if (!inVS) {
+                VSstart = ti+1000L;
+                inVS = true;
+            }
+            VSend = ti+2000L;
+
+        } else {
+            if (inVS) {
+                inVS = false;
+                VS->AddEvent(VSstart,(VSend-VSstart) / 1000L);
+                VSstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // Expiratory puff Event
+        //////////////////////////////////////////////////////////////////
+        if (data[109] & 12) {  // OA state 1st second
+            if (!inExP) {
+                ExPstart = ti;
+                inExP = true;
+            }
+            ExPend = ti+1000L;
+        } else {
+            if (inExP) {
+                inExP = false;
+                EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
+                ExPstart = 0;
+            }
+        }
+        if (data[113] & 12) {
+            if (!inExP) {
+                ExPstart = ti+1000L;
+                inExP = true;
+            }
+            ExPend = ti+2000L;
+
+        } else {
+            if (inExP) {
+                inExP = false;
+                EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
+                ExPstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // Flow Limitation Event
+        //////////////////////////////////////////////////////////////////
+        if (data[109] & 48) {  // OA state 1st second
+            if (!inFL) {
+                FLstart = ti;
+                inFL = true;
+            }
+            FLend = ti+1000L;
+        } else {
+            if (inFL) {
+                inFL = false;
+                FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
+                FLstart = 0;
+            }
+        }
+        if (data[113] & 48) {
+            if (!inFL) {
+                FLstart = ti+1000L;
+                inFL = true;
+            }
+            FLend = ti+2000L;
+
+        } else {
+            if (inFL) {
+                inFL = false;
+                FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
+                FLstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // Periodic Breathing Event
+        //////////////////////////////////////////////////////////////////
+        if (data[109] & 192) {  // OA state 1st second
+            if (!inPB) {
+                PBstart = ti;
+                inPB = true;
+            }
+            PBend = ti+1000L;
+        } else {
+            if (inPB) {
+                inPB = false;
+                PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
+                PBstart = 0;
+            }
+        }
+        if (data[113] & 192) {
+            if (!inPB) {
+                PBstart = ti+1000L;
+                inPB = true;
+            }
+            PBend = ti+2000L;
+
+        } else {
+            if (inPB) {
+                inPB = false;
+                PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
+                PBstart = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////
+        // Respiratory Effort Related Arousal Event
+        //////////////////////////////////////////////////////////////////
+        if (data[111] & 48) {  // OA state 1st second
+            if (!inRE) {
+                REstart = ti;
+                inRE = true;
+            }
+            REend = ti+1000L;
+        } else {
+            if (inRE) {
+                inRE = false;
+                RE->AddEvent(REstart,(REend-REstart) / 1000L);
+                REstart = 0;
+            }
+        }
+        if (data[115] & 48) {
+            if (!inRE) {
+                REstart = ti+1000L;
+                inRE = true;
+            }
+            REend = ti+2000L;
+
+        } else {
+            if (inRE) {
+                inRE = false;
+                RE->AddEvent(REstart,(REend-REstart) / 1000L);
+                REstart = 0;
+            }
+        }
+    }
+    if (flow) {
+        // Close event states if they are still open, and write event.
+        if (inH) HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
+        if (inOA) OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
+        if (inCA) NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
+        if (inLL) LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
+        if (inVS) HY->AddEvent(VSstart,(VSend-VSstart) / 1000L);
+        if (inExP) EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
+        if (inFL) FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
+        if (inPB) PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
+        if (inPB) RE->AddEvent(REstart,(REend-REstart) / 1000L);
+
+        // update min and max
+        // then add to machine
+        EventDataType min = flow->Min();
+        EventDataType max = flow->Max();
+        sess->setMin(CPAP_FlowRate, min);
+        sess->setMax(CPAP_FlowRate, max);
+
+        sess->setPhysMax(CPAP_FlowRate, min); // not sure :/
+        sess->setPhysMin(CPAP_FlowRate, max);
+        sess->really_set_last(flow->last());
+    }
+}
+
+void DV6SessionTask::parseL()
+{
+    Session * sess = R->sess;
+
+    EventList *leak = nullptr;
+    EventList *maxleak = nullptr;
+    EventList * RR  = nullptr;
+    EventList * Pressure  = nullptr;
+    EventList * TV  = nullptr;
+    EventList * MV = nullptr;
+    quint32 ts1, lastts1 = 0;
+
+    for (int r=lfile->lowerBound(R->start_time - ep), n=lfile->count(); r<n; ++r) {
+        const unsigned char * data = lfile->at(r).data;
+
+        ts1 = lfile->at(r).time() + ep;
+        if (ts1 > R->stop_time) {
+            break;
+        }
+
+        if (leak && ((ts1 - lastts1) > 60)) {
+            sess->set_last(maxleak->last());
+
+            leak = nullptr;
+            maxleak = nullptr;
+            MV = TV = RR = nullptr;
+            Pressure = nullptr;
+        }
+        lastts1=ts1;
+
+        if (!leak) {
+            qDebug() << "Adding Leak data for session" << sess->session() << "starting at" << ts1;
+            leak = sess->AddEventList(CPAP_Leak, EVL_Event); // , 1.0, 0.0, 0.0, 0.0, double(60000) / double(1));
+            maxleak = sess->AddEventList(CPAP_MaxLeak, EVL_Event);// , 1.0, 0.0, 0.0, 0.0, double(60000) / double(1));
+            RR = sess->AddEventList(CPAP_RespRate, EVL_Event);
+            MV = sess->AddEventList(CPAP_MinuteVent, EVL_Event);
+            TV = sess->AddEventList(CPAP_TidalVolume, EVL_Event);
+
+            if (!R->hasMaskPressure) {
+                // Don't use this pressure if we have higher resolution available
+                Pressure = sess->AddEventList(CPAP_Pressure, EVL_Event);
+            }
+
+            // One record a minute until the session stops, so size the lists up front
+            quint32 expected = qMin<quint32>((qMax(R->stop_time, ts1) - ts1) / 60 + 1, n - r);
+            leak->reserve(expected);
+            maxleak->reserve(expected);
+            RR->reserve(expected);
+            MV->reserve(expected);
+            TV->reserve(expected);
+            if (Pressure) Pressure->reserve(expected);
+        }
+
+        qint64 ti = qint64(ts1) * 1000L;
+
+        maxleak->AddEvent(ti, data[5]);
+        leak->AddEvent(ti, data[6]);
+        RR->AddEvent(ti, data[9]);
+
+        if (Pressure) Pressure->AddEvent(ti, data[11] / 10.0f);
+
+        unsigned tv = data[7] | data[8] << 8;
+        MV->AddEvent(ti, data[10] );
+        TV->AddEvent(ti, tv);
+    }
+    if (leak) {
+        sess->set_last(maxleak->last());
+    }
+}
+
+void DV6SessionTask::parseE()
+{
+    Session * sess = R->sess;
+
+    EventList * OA = nullptr;
+    EventList * CA = nullptr;
+    EventList * H = nullptr;
+    EventList * RE = nullptr;
+    quint32 ts1;
+
+    for (int r=efile->lowerBound(R->start_time - ep), n=efile->count(); r<n; ++r) {
+        const unsigned char * data = efile->at(r).data;
+
+        ts1 = efile->at(r).time() + ep; // start time
+        if (ts1 > R->stop_time) {
+            break;
+        }
+
+        if (!OA) {
+            qDebug() << "Adding Event data for session" << sess->session() << "starting at" << ts1;
+            OA = sess->AddEventList(CPAP_Obstructive, EVL_Event);
+            H = sess->AddEventList(CPAP_Hypopnea, EVL_Event);
+            RE = sess->AddEventList(CPAP_RERA, EVL_Event);
+            CA = sess->AddEventList(CPAP_ClearAirway, EVL_Event);
+        }
+
+        qint64 ti = qint64(ts1) * 1000L;
+        int code = data[13];
+        switch (code) {
+        case 1:
+            CA->AddEvent(ti, data[17]);
+            break;
+        case 2:
+            OA->AddEvent(ti, data[17]);
+            break;
+        case 4:
+            H->AddEvent(ti, data[17]);
+            break;
+        case 5:
+            RE->AddEvent(ti, data[17]);
+            break;
+        default:
+            break;
+        }
+    }
+    if (OA) {
+        sess->set_last(OA->last());
+        sess->set_last(CA->last());
+        sess->set_last(H->last());
+        sess->set_last(RE->last());
+    }
+}
+
 int IntellipapLoader::OpenDV6(const QString & path)
 {
     QString newpath = path + DV6_DIR;
@@ -758,753 +1381,111 @@ int IntellipapLoader::OpenDV6(const QString & path)
 
 
     ////////////////////////////////////////////////////////////////////////////////////////
-    // Open and parse session list and create a list of sessions to import
+    // Open the record files. They're memory mapped, and each session only reads its own span of them.
     ////////////////////////////////////////////////////////////////////////////////////////
 
-
     const int DV6_L_RecLength = 45;
     const int DV6_E_RecLength = 25;
     const int DV6_S_RecLength = 55;
-    unsigned int ts1,ts2, lastts1;
-
-    QMap<quint32, DV6_S_Record> summaryList;  // QHash is faster, but QMap keeps order
-
-    QDateTime epoch(QDate(2002, 1, 1), QTime(0, 0, 0), Qt::UTC); // Intellipap Epoch
-    int ep = epoch.toTime_t();
-
-
-    f.setFileName(newpath+"/S.BIN");
-    if (f.open(QIODevice::ReadOnly)) {
-        dataBA = f.readAll();
-        f.close();
-
-        data = (unsigned char *)dataBA.data();
-
-        int records = dataBA.size() / DV6_S_RecLength;
-
-        //data[0x11]; // Start of data block
-        //data[0x12]; // Record count
-        // First record is block header
-        for (int r=1; r<records-1; r++) {
-            data += DV6_S_RecLength; // just so happen the headers the same length, though we probably should parse it to get it's version
-            DV6_S_Record R;
-
-            ts1 = ((data[4] << 24) | (data[3] << 16) | (data[2] << 8) | data[1])+ep; // session start time
-            ts2 = ((data[8] << 24) | (data[7] << 16) | (data[6] << 8) | data[5])+ep; // session end
-
-            if (!mach->sessionlist.contains(ts1)) { // Check if already imported
-                qDebug() << "Detected new Session" << ts1;
-                R.sess = new Session(mach, ts1);
-                R.sess->SetChanged(true);
-
-                R.sess->really_set_first(qint64(ts1) * 1000L);
-                R.sess->really_set_last(qint64(ts2) * 1000L);
-
-                R.start_time = ts1;
-                R.stop_time = ts2;
-
-                R.atpressure_time = ((data[12] << 24) | (data[11] << 16) | (data[10] << 8) | data[9])+ep;
-                R.hours = float(data[13]) / 10.0F;
-                R.pressureSetMin = float(data[49]) / 10.0F;
-                R.pressureSetMax = float(data[50]) / 10.0F;
-
-                // The following stuff is not necessary to decode, but can be used to verify we are on the right track
-                //data[14]... unknown
-                R.pressureAvg = float(data[15]) / 10.0F;
-                R.pressureMax = float(data[16]) / 10.0F;
-                R.pressure50 = float(data[17]) / 10.0F;
-                R.pressure90 = float(data[18]) / 10.0F;
-                R.pressure95 = float(data[19]) / 10.0F;
-                R.pressureStdDev = float(data[20]) / 10.0F;
-                //data[21]... unknown
-                R.leakAvg = float(data[22]) / 10.0F;
-                R.leakMax = float(data[23]) / 10.0F;
-                R.leak50= float(data[24]) / 10.0F;
-                R.leak90 = float(data[25]) / 10.0F;
-                R.leak95 = float(data[26]) / 10.0F;
-                R.leakStdDev = float(data[27]) / 10.0F;
-
-                R.tidalVolume = float(data[28] | data[29] << 8);
-                R.avgBreathRate = float(data[30] | data[31] << 8);
-
-                if (data[49] != data[50]) {
-                    R.sess->settings[CPAP_PressureMin] = R.pressureSetMin;
-                    R.sess->settings[CPAP_PressureMax] = R.pressureSetMax;
-                    R.sess->settings[CPAP_Mode] = MODE_APAP;
-                } else {
-                    R.sess->settings[CPAP_Mode] = MODE_CPAP;
-                    R.sess->settings[CPAP_Pressure] = R.pressureSetMin;
-                }
-                R.hasMaskPressure = false;
-                summaryList[ts1] = R;
-            }
-        }
-
-    } else { // if (f.open(...)
-        // S.BIN open failed
-        return -1;
-    }
-
-
-    QMap<quint32, DV6_S_Record>::iterator SR;
     const int DV6_R_RecLength = 117;
     const int DV6_R_HeaderSize = 55;
-    f.setFileName(newpath+"/R.BIN");
-    int numRrecs = (f.size()-DV6_R_HeaderSize) / DV6_R_RecLength;
-    Session *sess = NULL;
-    if (f.open(QIODevice::ReadOnly)) {
-        // Let's not parse R all at once, it's huge
-        dataBA = f.read(DV6_R_HeaderSize);
-        if (dataBA.size() < DV6_R_HeaderSize) {
-            // bit mean aborting on corrupt R file... but oh well
-            return -1;
-        }
-
-        sess = NULL;
-        EventList * flow = NULL;
-        EventList * pressure = NULL;
-//        EventList * leak = NULL;
-        EventList * OA  = NULL;
-        EventList * HY  = NULL;
-        EventList * NOA = NULL;
-        EventList * EXP = NULL;
-        EventList * FL  = NULL;
-        EventList * PB  = NULL;
-        EventList * VS  = NULL;
-        EventList * LL  = NULL;
-        EventList * RE  = NULL;
-        bool inOA = false, inH = false, inCA = false, inExP = false, inVS = false, inFL = false, inPB = false, inRE = false, inLL = false;
-        qint64 OAstart = 0, OAend = 0;
-        qint64 Hstart = 0, Hend = 0;
-        qint64 CAstart = 0, CAend = 0;
-        qint64 ExPstart = 0, ExPend = 0;
-        qint64 VSstart = 0, VSend = 0;
-        qint64 FLstart = 0, FLend = 0;
-        qint64 PBstart = 0, PBend = 0;
-        qint64 REstart =0, REend = 0;
-        qint64 LLstart =0, LLend = 0;
-        lastts1 = 0;
-
-        SR = summaryList.begin();
-        for (int r=0; r<numRrecs; data += DV6_R_RecLength, ++r) {
-            dataBA=f.read(DV6_R_RecLength);
-            data = (unsigned char *)dataBA.data();
-            if (dataBA.size() < DV6_R_RecLength) {
-                break;
-            }
-
-            DV6_S_Record *R = &SR.value();
-
-            ts1 = ((data[4] << 24) | (data[3] << 16) | (data[2] << 8) | data[1]) + ep;
-
-            if (flow && ((ts1 - lastts1) > 2)) {
-                sess->set_last(flow->last());
-
-                sess = nullptr;
-                flow = nullptr;
-                pressure = nullptr;
-            }
-            lastts1=ts1;
-
-            while (ts1 > R->stop_time) {
-                if (flow && sess) {
-                    // update min and max
-                    // then add to machine
-                    sess = nullptr;
-                    flow = nullptr;
-                    pressure = nullptr;
-                }
-                SR++;
-                if (SR == summaryList.end()) break;
-                R = &SR.value();
-            }
-            if (SR == summaryList.end())
-                break;
-
-            if (ts1 >= R->start_time) {
-                if (!flow && R->sess) {
-                    flow = R->sess->AddEventList(CPAP_FlowRate, EVL_Waveform, 1.0f/60.0f, 0.0f, 0.0f, 0.0f, double(2000) / double(50));
-                    pressure = R->sess->AddEventList(CPAP_Pressure, EVL_Waveform, 0.1f, 0.0f, 0.0f, 0.0f, double(2000) / double(2));
-                    R->hasMaskPressure = true;
-                    //leak = R->sess->AddEventList(CPAP_Leak, EVL_Waveform, 1.0, 0.0, 0.0, 0.0, double(2000) / double(1));
-                    OA = R->sess->AddEventList(CPAP_Obstructive, EVL_Event);
-                    NOA = R->sess->AddEventList(CPAP_NRI, EVL_Event);
-                    RE = R->sess->AddEventList(CPAP_RERA, EVL_Event);
-                    VS = R->sess->AddEventList(CPAP_VSnore, EVL_Event);
-                    HY = R->sess->AddEventList(CPAP_Hypopnea, EVL_Event);
-                    EXP = R->sess->AddEventList(CPAP_ExP, EVL_Event);
-                    FL = R->sess->AddEventList(CPAP_FlowLimit, EVL_Event);
-                    PB = R->sess->AddEventList(CPAP_PB, EVL_Event);
-                    LL = R->sess->AddEventList(CPAP_LargeLeak, EVL_Event);
-                }
-                if (flow) {
-                    sess = R->sess;
-                    // starting at position 5 is 100 bytes, 16bit LE 25hz samples
-                    qint16 *wavedata = (qint16 *)(&data[5]);
-
-                    qint64 ti = qint64(ts1) * 1000;
-
-                    unsigned char d[2];
-                    d[0] = data[105];
-                    d[1] = data[106];
-                    flow->AddWaveform(ti+40000,wavedata,50,2000);
-                    pressure->AddWaveform(ti+40000, d, 2, 2000);
-                    // Fields data[107] && data[108] are bitfields default is 0x90, occasionally 0x98
-
-                    d[0] = data[107];
-                    d[1] = data[108];
-
-                    //leak->AddWaveform(ti+40000, d, 2, 2000);
-
-
-                    // Needs to track state to pull events out cleanly..
-
-                    //////////////////////////////////////////////////////////////////
-                    // High Leak
-                    //////////////////////////////////////////////////////////////////
-
-                    if (data[110] & 3) {  // LL state 1st second
-                        if (!inLL) {
-                            LLstart = ti;
-                            inLL = true;
-                        }
-                        LLend = ti+1000L;
-                    } else {
-                        if (inLL) {
-                            inLL = false;
-                            LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
-                            LLstart = 0;
-                        }
-                    }
-                    if (data[114] & 3) {
-                        if (!inLL) {
-                            LLstart = ti+1000L;
-                            inLL = true;
-                        }
-                        LLend = ti+2000L;
-
-                    } else {
-                        if (inLL) {
-                            inLL = false;
-                            LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
-                            LLstart = 0;
-                        }
-                    }
-
-
-                    //////////////////////////////////////////////////////////////////
-                    // Obstructive Apnea
-                    //////////////////////////////////////////////////////////////////
-
-                    if (data[110] & 12) {  // OA state 1st second
-                        if (!inOA) {
-                            OAstart = ti;
-                            inOA = true;
-                        }
-                        OAend = ti+1000L;
-                    } else {
-                        if (inOA) {
-                            inOA = false;
-                            OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
-                            OAstart = 0;
-                        }
-                    }
-                    if (data[114] & 12) {
-                        if (!inOA) {
-                            OAstart = ti+1000L;
-                            inOA = true;
-                        }
-                        OAend = ti+2000L;
-
-                    } else {
-                        if (inOA) {
-                            inOA = false;
-                            OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
-                            OAstart = 0;
-                        }
-                    }
-
-
-                    //////////////////////////////////////////////////////////////////
-                    // Hypopnea
-                    //////////////////////////////////////////////////////////////////
-
-                    if (data[110] & 192) {
-                        if (!inH) {
-                            Hstart = ti;
-                            inH = true;
-                        }
-                        Hend = ti + 1000L;
-                    } else {
-                        if (inH) {
-                            inH = false;
-                            HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
-                            Hstart = 0;
-                        }
-                    }
-
-                    if (data[114] & 192) {
-                        if (!inH) {
-                            Hstart = ti+1000L;
-                            inH = true;
-                        }
-                        Hend = ti + 2000L;
-                    } else {
-                        if (inH) {
-                            inH = false;
-                            HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
-                            Hstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // Non Responding Apnea Event (Are these CA's???)
-                    //////////////////////////////////////////////////////////////////
-                    if (data[110] & 48) {  // OA state 1st second
-                        if (!inCA) {
-                            CAstart = ti;
-                            inCA = true;
-                        }
-                        CAend = ti+1000L;
-                    } else {
-                        if (inCA) {
-                            inCA = false;
-                            NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
-                            CAstart = 0;
-                        }
-                    }
-                    if (data[114] & 48) {
-                        if (!inCA) {
-                            CAstart = ti+1000L;
-                            inCA = true;
-                        }
-                        CAend = ti+2000L;
-
-                    } else {
-                        if (inCA) {
-                            inCA = false;
-                            NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
-                            CAstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // VSnore Event
-                    //////////////////////////////////////////////////////////////////
-                    if (data[109] & 3) {  // OA state 1st second
-                        if (!inVS) {
-                            VSstart = ti;
-                            inVS = true;
-                        }
-                        VSend = ti+1000L;
-                    } else {
-                        if (inVS) {
-                            inVS = false;
-                            VS->AddEvent(VSstart,(VSend-VSstart) / 1000L);
-                            VSstart = 0;
-                        }
-                    }
-                    if (data[113] & 3) {
-                        if (!inVS) {
-                            VSstart = ti+1000L;
-                            inVS = true;
-                        }
-                        VSend = ti+2000L;
-
-                    } else {
-                        if (inVS) {
-                            inVS = false;
-                            VS->AddEvent(VSstart,(VSend-VSstart) / 1000L);
-                            VSstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // Expiratory puff Event
-                    //////////////////////////////////////////////////////////////////
-                    if (data[109] & 12) {  // OA state 1st second
-                        if (!inExP) {
-                            ExPstart = ti;
-                            inExP = true;
-                        }
-                        ExPend = ti+1000L;
-                    } else {
-                        if (inExP) {
-                            inExP = false;
-                            EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
-                            ExPstart = 0;
-                        }
-                    }
-                    if (data[113] & 12) {
-                        if (!inExP) {
-                            ExPstart = ti+1000L;
-                            inExP = true;
-                        }
-                        ExPend = ti+2000L;
-
-                    } else {
-                        if (inExP) {
-                            inExP = false;
-                            EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
-                            ExPstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // Flow Limitation Event
-                    //////////////////////////////////////////////////////////////////
-                    if (data[109] & 48) {  // OA state 1st second
-                        if (!inFL) {
-                            FLstart = ti;
-                            inFL = true;
-                        }
-                        FLend = ti+1000L;
-                    } else {
-                        if (inFL) {
-                            inFL = false;
-                            FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
-                            FLstart = 0;
-                        }
-                    }
-                    if (data[113] & 48) {
-                        if (!inFL) {
-                            FLstart = ti+1000L;
-                            inFL = true;
-                        }
-                        FLend = ti+2000L;
-
-                    } else {
-                        if (inFL) {
-                            inFL = false;
-                            FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
-                            FLstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // Periodic Breathing Event
-                    //////////////////////////////////////////////////////////////////
-                    if (data[109] & 192) {  // OA state 1st second
-                        if (!inPB) {
-                            PBstart = ti;
-                            inPB = true;
-                        }
-                        PBend = ti+1000L;
-                    } else {
-                        if (inPB) {
-                            inPB = false;
-                            PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
-                            PBstart = 0;
-                        }
-                    }
-                    if (data[113] & 192) {
-                        if (!inPB) {
-                            PBstart = ti+1000L;
-                            inPB = true;
-                        }
-                        PBend = ti+2000L;
-
-                    } else {
-                        if (inPB) {
-                            inPB = false;
-                            PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
-                            PBstart = 0;
-                        }
-                    }
-
-                    //////////////////////////////////////////////////////////////////
-                    // Respiratory Effort Related Arousal Event
-                    //////////////////////////////////////////////////////////////////
-                    if (data[111] & 48) {  // OA state 1st second
-                        if (!inRE) {
-                            REstart = ti;
-                            inRE = true;
-                        }
-                        REend = ti+1000L;
-                    } else {
-                        if (inRE) {
-                            inRE = false;
-                            RE->AddEvent(REstart,(REend-REstart) / 1000L);
-                            REstart = 0;
-                        }
-                    }
-                    if (data[115] & 48) {
-                        if (!inRE) {
-                            REstart = ti+1000L;
-                            inRE = true;
-                        }
-                        REend = ti+2000L;
-
-                    } else {
-                        if (inRE) {
-                            inRE = false;
-                            RE->AddEvent(REstart,(REend-REstart) / 1000L);
-                            REstart = 0;
-                        }
-                    }
-                }
-            }
-
+    const int DV6_L_HeaderSize = 55;
+    const int DV6_E_HeaderSize = 55;
 
-        }
-        if (flow && sess) {
-            // Close event states if they are still open, and write event.
-            if (inH) HY->AddEvent(Hstart,(Hend-Hstart) / 1000L);
-            if (inOA) OA->AddEvent(OAstart,(OAend-OAstart) / 1000L);
-            if (inCA) NOA->AddEvent(CAstart,(CAend-CAstart) / 1000L);
-            if (inLL) LL->AddEvent(LLstart,(LLend-LLstart) / 1000L);
-            if (inVS) HY->AddEvent(VSstart,(VSend-VSstart) / 1000L);
-            if (inExP) EXP->AddEvent(ExPstart,(ExPend-ExPstart) / 1000L);
-            if (inFL) FL->AddEvent(FLstart,(FLend-FLstart) / 1000L);
-            if (inPB) PB->AddEvent(PBstart,(PBend-PBstart) / 1000L);
-            if (inPB) RE->AddEvent(REstart,(REend-REstart) / 1000L);
-
-            // update min and max
-            // then add to machine
-            EventDataType min = flow->Min();
-            EventDataType max = flow->Max();
-            sess->setMin(CPAP_FlowRate, min);
-            sess->setMax(CPAP_FlowRate, max);
-
-            sess->setPhysMax(CPAP_FlowRate, min); // not sure :/
-            sess->setPhysMin(CPAP_FlowRate, max);
-            sess->really_set_last(flow->last());
-
-            sess = NULL;
-            flow = NULL;
-        }
+    // The first S.BIN record is a block header, just so happens it's the same length
+    DV6RecordFile sfile(newpath+"/S.BIN", DV6_S_RecLength, DV6_S_RecLength);
+    DV6RecordFile rfile(newpath+"/R.BIN", DV6_R_HeaderSize, DV6_R_RecLength);
+    DV6RecordFile lfile(newpath+"/L.BIN", DV6_L_HeaderSize, DV6_L_RecLength);
+    DV6RecordFile efile(newpath+"/E.BIN", DV6_E_HeaderSize, DV6_E_RecLength);
 
-        f.close();
-        data = (unsigned char *)dataBA.data();
-    } else { // if (f.open(...)
-        // L.BIN open failed
+    if (!sfile.isOpen() || !rfile.isOpen() || !lfile.isOpen() || !efile.isOpen()) {
         return -1;
     }
-
-
-    /////////////////////////////////////////////////////////////////////////////////////////////
-    /// Parse L.BIN and extract per-minute data.
-    /////////////////////////////////////////////////////////////////////////////////////////////
-
-    EventList *leak = NULL;
-    EventList *maxleak = NULL;
-    EventList * RR  = NULL;
-    EventList * Pressure  = NULL;
-    EventList * TV  = NULL;
-    EventList * MV = NULL;
-
-
-    sess = NULL;
-    const int DV6_L_HeaderSize = 55;
-    // Need to parse L.bin minute table to get graphs
-    f.setFileName(newpath+"/L.BIN");
-    if (f.open(QIODevice::ReadOnly)) {
-        dataBA = f.readAll();
-        if (dataBA.size() <= DV6_L_HeaderSize) {
-            return -1;
-        }
-
-        f.close();
-        data = (unsigned char *)dataBA.data()+DV6_L_HeaderSize;
-        int numLrecs = (dataBA.size()-DV6_L_HeaderSize) / DV6_L_RecLength;
-
-        SR = summaryList.begin();
-
-        lastts1 = 0;
-
-
-        if (SR != summaryList.end()) for (int r=0; r<numLrecs; data += DV6_L_RecLength, ++r) {
-            ts1 = ((data[4] << 24) | (data[3] << 16) | (data[2] << 8) | data[1])+ep; // session start time
-            if (ts1 < lastts1) {
-                qDebug() << "Corruption/Out of sequence data found in L.bin, aborting";
-                break;
-            }
-            DV6_S_Record *R = &SR.value();
-            if (leak && ((ts1 - lastts1) > 60)) {
-                sess->set_last(maxleak->last());
-
-                sess = nullptr;
-                leak = nullptr;
-                maxleak = nullptr;
-                MV = TV = RR = nullptr;
-                Pressure = nullptr;
-            }
-            lastts1=ts1;
-            while (ts1 > R->stop_time) {
-                if (leak && sess) {
-                    // Close the open session and update the min and max
-                    sess->set_last(maxleak->last());
-
-                    sess = nullptr;
-                    leak = nullptr;
-                    maxleak = nullptr;
-                    MV = TV = RR = nullptr;
-                    Pressure = nullptr;
-                }
-                SR++;
-                if (SR == summaryList.end()) break;
-                R = &SR.value();
-            }
-            if (SR == summaryList.end())
-                break;
-
-            if (ts1 >= R->start_time) {
-                if (!leak && R->sess) {
-                    qDebug() << "Adding Leak data for session" << R->sess->session() << "starting at" << ts1;
-                    leak = R->sess->AddEventList(CPAP_Leak, EVL_Event); // , 1.0, 0.0, 0.0, 0.0, double(60000) / double(1));
-                    maxleak = R->sess->AddEventList(CPAP_MaxLeak, EVL_Event);// , 1.0, 0.0, 0.0, 0.0, double(60000) / double(1));
-                    RR = R->sess->AddEventList(CPAP_RespRate, EVL_Event);
-                    MV = R->sess->AddEventList(CPAP_MinuteVent, EVL_Event);
-                    TV = R->sess->AddEventList(CPAP_TidalVolume, EVL_Event);
-
-                    if (!R->hasMaskPressure) {
-                        // Don't use this pressure if we have higher resolution available
-                        Pressure = R->sess->AddEventList(CPAP_Pressure, EVL_Event);
-                    }
-                }
-                if (leak) {
-                    sess = R->sess;
-
-                    qint64 ti = qint64(ts1) * 1000L;
-
-                    maxleak->AddEvent(ti, data[5]);
-                    leak->AddEvent(ti, data[6]);
-                    RR->AddEvent(ti, data[9]);
-
-                    if (Pressure) Pressure->AddEvent(ti, data[11] / 10.0f);
-
-                    unsigned tv = data[7] | data[8] << 8;
-                    MV->AddEvent(ti, data[10] );
-                    TV->AddEvent(ti, tv);
-
-                    if (!sess->channelExists(CPAP_FlowRate)) {
-                        // No flow rate, so lets grab this data...
-                    }
-                }
-
-            }
-        } // for
-        if (sess && leak) {
-            sess->set_last(maxleak->last());
-        }
-
-    } else { // if (f.open(...)
-        // L.BIN open failed
+    if ((rfile.fileSize() < DV6_R_HeaderSize) || (lfile.fileSize() <= DV6_L_HeaderSize) || (efile.fileSize() == 0)) {
+        // bit mean aborting on corrupt files... but oh well
         return -1;
     }
 
+    rfile.truncateUnordered();
+    lfile.truncateUnordered();
+    efile.truncateUnordered();
 
-    // Now sessionList is populated with summary data, lets parse the Events list in E.BIN
-
-
-    EventList * OA = nullptr;
-    EventList * CA = nullptr;
-    EventList * H = nullptr;
-    EventList * RE = nullptr;
-    f.setFileName(newpath+"/E.BIN");
-    const int DV6_E_HeaderSize = 55;
-
-    if (f.open(QIODevice::ReadOnly)) {
-        dataBA = f.readAll();
-        if (dataBA.size() == 0) {
-            return -1;
-        }
-        f.close();
-        data = (unsigned char *)dataBA.data()+DV6_E_HeaderSize;
-        int numErecs = (dataBA.size()-DV6_E_HeaderSize) / DV6_E_RecLength;
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Parse session list and create a list of sessions to import
+    ////////////////////////////////////////////////////////////////////////////////////////
 
-        SR = summaryList.begin();
+    unsigned int ts1,ts2;
 
-        for (int r=0; r<numErecs; ++r, data += DV6_E_RecLength) {
-            ts1 = ((data[4] << 24) | (data[3] << 16) | (data[2] << 8) | data[1])+ep; // start time
-            ts2 = ((data[8] << 24) | (data[7] << 16) | (data[6] << 8) | data[5])+ep; // end
+    QMap<quint32, DV6_S_Record> summaryList;  // QHash is faster, but QMap keeps order
 
-            if (SR == summaryList.end())
-                break;
+    QDateTime epoch(QDate(2002, 1, 1), QTime(0, 0, 0), Qt::UTC); // Intellipap Epoch
+    int ep = epoch.toTime_t();
 
-            DV6_S_Record *R = &SR.value();
-            while (ts1 > R->stop_time) {
-                if (OA && sess) {
-                    // Close the open session and update the min and max
-                    sess->set_last(OA->last());
-                    sess->set_last(CA->last());
-                    sess->set_last(H->last());
-                    sess->set_last(RE->last());
-
-                    sess = nullptr;
-                    H = CA = RE = OA = nullptr;
-                }
-                SR++;
-                if (SR == summaryList.end()) break;
-                R = &SR.value();
+    // The last record is skipped too
+    for (int r=0; r<sfile.count()-1; r++) {
+        const unsigned char * data = sfile.at(r).data;
+        DV6_S_Record R;
+
+        ts1 = sfile.at(r).time()+ep; // session start time
+        ts2 = sfile.at(r).time2()+ep; // session end
+
+        if (!mach->sessionlist.contains(ts1)) { // Check if already imported
+            qDebug() << "Detected new Session" << ts1;
+            R.sess = new Session(mach, ts1);
+            R.sess->SetChanged(true);
+
+            R.sess->really_set_first(qint64(ts1) * 1000L);
+            R.sess->really_set_last(qint64(ts2) * 1000L);
+
+            R.start_time = ts1;
+            R.stop_time = ts2;
+
+            R.atpressure_time = ((data[12] << 24) | (data[11] << 16) | (data[10] << 8) | data[9])+ep;
+            R.hours = float(data[13]) / 10.0F;
+            R.pressureSetMin = float(data[49]) / 10.0F;
+            R.pressureSetMax = float(data[50]) / 10.0F;
+
+            // The following stuff is not necessary to decode, but can be used to verify we are on the right track
+            //data[14]... unknown
+            R.pressureAvg = float(data[15]) / 10.0F;
+            R.pressureMax = float(data[16]) / 10.0F;
+            R.pressure50 = float(data[17]) / 10.0F;
+            R.pressure90 = float(data[18]) / 10.0F;
+            R.pressure95 = float(data[19]) / 10.0F;
+            R.pressureStdDev = float(data[20]) / 10.0F;
+            //data[21]... unknown
+            R.leakAvg = float(data[22]) / 10.0F;
+            R.leakMax = float(data[23]) / 10.0F;
+            R.leak50= float(data[24]) / 10.0F;
+            R.leak90 = float(data[25]) / 10.0F;
+            R.leak95 = float(data[26]) / 10.0F;
+            R.leakStdDev = float(data[27]) / 10.0F;
+
+            R.tidalVolume = float(data[28] | data[29] << 8);
+            R.avgBreathRate = float(data[30] | data[31] << 8);
+
+            if (data[49] != data[50]) {
+                R.sess->settings[CPAP_PressureMin] = R.pressureSetMin;
+                R.sess->settings[CPAP_PressureMax] = R.pressureSetMax;
+                R.sess->settings[CPAP_Mode] = MODE_APAP;
+            } else {
+                R.sess->settings[CPAP_Mode] = MODE_CPAP;
+                R.sess->settings[CPAP_Pressure] = R.pressureSetMin;
             }
-            if (SR == summaryList.end())
-                break;
-
-            if (ts1 >= R->start_time) {
-                if (!OA && R->sess) {
-                    qDebug() << "Adding Event data for session" << R->sess->session() << "starting at" << ts1;
-                    OA = R->sess->AddEventList(CPAP_Obstructive, EVL_Event);
-                    H = R->sess->AddEventList(CPAP_Hypopnea, EVL_Event);
-                    RE = R->sess->AddEventList(CPAP_RERA, EVL_Event);
-                    CA = R->sess->AddEventList(CPAP_ClearAirway, EVL_Event);
-                }
-                if (OA) {
-                    sess = R->sess;
-
-                    qint64 ti = qint64(ts1) * 1000L;
-                    int code = data[13];
-                    switch (code) {
-                    case 1:
-                        CA->AddEvent(ti, data[17]);
-                        break;
-                    case 2:
-                        OA->AddEvent(ti, data[17]);
-                        break;
-                    case 4:
-                        H->AddEvent(ti, data[17]);
-                        break;
-                    case 5:
-                        RE->AddEvent(ti, data[17]);
-                        break;
-                    default:
-                        break;
-                    }
-                }
-
-
-            } // for
+            R.hasMaskPressure = false;
+            summaryList[ts1] = R;
         }
-        if (sess && OA) {
-            sess->set_last(OA->last());
-            sess->set_last(CA->last());
-            sess->set_last(H->last());
-            sess->set_last(RE->last());
-
-        }
-    } else { // if (f.open(...)
-        // E.BIN open failed
-        return -1;
     }
 
-    QMap<quint32, DV6_S_Record>::iterator it;
-
-    for (it=summaryList.begin(); it!= summaryList.end(); ++it) {
-        Session * sess = it.value().sess;
-
-        mach->AddSession(sess);
-
-        // Update indexes, process waveform and perform flagging
-        sess->UpdateSummaries();
-
-        // Save is not threadsafe
-        sess->Store(mach->getDataPath());
-
-        // Unload them from memory
-        sess->TrashEvents();
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Each session is decoded from its own time range of R.BIN, L.BIN and E.BIN, so they
+    // can be spread across the thread pool, and stored and unloaded as they finish
+    ////////////////////////////////////////////////////////////////////////////////////////
 
+    for (auto it=summaryList.begin(); it!= summaryList.end(); ++it) {
+        queTask(new DV6SessionTask(this, mach, &it.value(), &rfile, &lfile, &efile, ep));
     }
-
+    runTasks(AppSetting->multithreading());
 
     return summaryList.size();
 }
@@ -9,6 +9,8 @@
 #ifndef INTELLIPAP_LOADER_H
 #define INTELLIPAP_LOADER_H
 
+#include <QFile>
+
 #include "SleepLib/machine.h" // Base class: MachineLoader
 #include "SleepLib/machine_loader.h"
 #include "SleepLib/profiles.h"
@@ -41,6 +43,68 @@ extern ChannelID INTP_SmartFlexLevel;
 
 const QString intellipap_class_name = STR_MACH_Intellipap;
 
+/*! \struct DV6Record
+    \brief View of one fixed length record in a DV6 data file, each of which starts with a position byte and a timestamp
+    */
+struct DV6Record
+{
+    DV6Record(const unsigned char * data) : data(data) {}
+
+    //! \brief Returns the record's timestamp, in seconds since the Intellipap epoch
+    inline quint32 time() const {
+        return (quint32(data[4]) << 24) | (quint32(data[3]) << 16) | (quint32(data[2]) << 8) | data[1];
+    }
+
+    //! \brief Returns the second timestamp of E.BIN and S.BIN records, where the event or session ends
+    inline quint32 time2() const {
+        return (quint32(data[8]) << 24) | (quint32(data[7]) << 16) | (quint32(data[6]) << 8) | data[5];
+    }
+
+    inline unsigned char operator[](int i) const { return data[i]; }
+
+    const unsigned char * data;
+};
+
+/*! \class DV6RecordFile
+    \brief Read only access to the records of a DV6 data file, memory mapped so a card's years of data
+           are paged in as they're used instead of being read in up front
+    */
+class DV6RecordFile
+{
+  public:
+    //! \brief Opens filename, whose records of recordLength bytes follow headerSize bytes of header
+    DV6RecordFile(const QString & filename, int headerSize, int recordLength);
+    ~DV6RecordFile();
+
+    //! \brief Returns true if the file could be opened
+    bool isOpen() const { return m_data != nullptr; }
+
+    //! \brief Returns the size of the file in bytes
+    qint64 fileSize() const { return m_size; }
+
+    //! \brief Returns the number of complete records
+    int count() const { return m_count; }
+
+    //! \brief Returns a view of record i
+    DV6Record at(int i) const { return DV6Record(m_data + m_headerSize + qint64(i) * m_recordLength); }
+
+    //! \brief Drops the records from where the timestamps first go backwards, as they can't be trusted
+    void truncateUnordered();
+
+    //! \brief Returns the index of the first record with a timestamp at or after time (Intellipap epoch)
+    int lowerBound(quint32 time) const;
+
+  protected:
+    QFile m_file;
+    uchar * m_map;
+    QByteArray m_buffer;
+    const unsigned char * m_data;
+    qint64 m_size;
+    int m_headerSize;
+    int m_recordLength;
+    int m_count;
+};
+
 /*! \class IntellipapLoader
     \brief Loader for DeVilbiss Intellipap Auto data
     This is only relatively recent addition and still needs more work
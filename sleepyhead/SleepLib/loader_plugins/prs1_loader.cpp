@@ -14,10 +14,13 @@
 #include <QDataStream>
 #include <QMessageBox>
 #include <QDebug>
+#include <QThreadPool>
+#include <QMutexLocker>
 #include <cmath>
 
 #include "SleepLib/schema.h"
 #include "prs1_loader.h"
+#include "SleepLib/backupengine.h"
 #include "SleepLib/session.h"
 #include "SleepLib/calcs.h"
 
@@ -611,8 +614,10 @@ int PRS1Loader::OpenMachine(const QString & path)
 
     QString backupPath = m->getBackupPath() + path.section("/", -2);
 
+    // Copied in the background while the files are parsed, skipping anything already backed up
+    BackupEngine backups(m->getBackupPath());
     if (QDir::cleanPath(path).compare(QDir::cleanPath(backupPath)) != 0) {
-        copyPath(path, backupPath);
+        backups.queuePath(path, backupPath);
     }
 
 
@@ -626,6 +631,7 @@ int PRS1Loader::OpenMachine(const QString & path)
 
 
     PRS1Import * task = nullptr;
+    QList<PRS1ParseTask *> parsetasks;
     // Note, I have observed p0/p1/etc folders containing duplicates session files (in Robin Sanders data.)
 
     emit updateMessage(QObject::tr("Scanning Files..."));
@@ -701,60 +707,94 @@ int PRS1Loader::OpenMachine(const QString & path)
                 continue;
             }
 
-            // Parse the data chunks and read the files..
-            QList<PRS1DataChunk *> Chunks = ParseFile(fi.canonicalFilePath());
+            // The data chunks are read later, all at once
+            parsetasks.push_back(new PRS1ParseTask(this, fi.canonicalFilePath(), ext));
+        }
+        if (isAborted()) break;
+    }
 
-            for (int i=0; i < Chunks.size(); ++i) {
+    // Parse the summary/event files across the available cores
+    if (!isAborted()) {
+        if (AppSetting->multithreading()) {
+            QThreadPool pool;
+            for (int i=0; i < parsetasks.size(); ++i) {
+                parsetasks.at(i)->setAutoDelete(false);
+                pool.start(parsetasks.at(i));
+            }
+            while (!pool.waitForDone(50)) {
+                QCoreApplication::processEvents();
+            }
+        } else {
+            for (int i=0; i < parsetasks.size(); ++i) {
                 if (isAborted()) break;
+                parsetasks.at(i)->run();
+            }
+        }
+    }
 
-                PRS1DataChunk * chunk = Chunks.at(i);
+    // Sort the chunks into sessions in the order the files were found, so duplicates resolve as before
+    for (int p=0; p < parsetasks.size(); ++p) {
+        PRS1ParseTask * pt = parsetasks.at(p);
+        ext = pt->ext;
 
-                if (ext <= 1) {
-                    const unsigned char * data = (unsigned char *)chunk->m_data.constData();
+        for (int i=0; i < pt->chunks.size(); ++i) {
+            if (isAborted()) break;
 
-                    if (data[0x00] != 0) {
-                        delete chunk;
-                        continue;
-                    }
-                }
+            PRS1DataChunk * chunk = pt->chunks.at(i);
+            pt->chunks[i] = nullptr;
 
-                SessionID chunk_sid = chunk->sessionid;
-                if (m->SessionExists(sid)) {
+            if (ext <= 1) {
+                const unsigned char * data = (unsigned char *)chunk->m_data.constData();
+
+                if (data[0x00] != 0) {
                     delete chunk;
                     continue;
                 }
+            }
 
+            SessionID chunk_sid = chunk->sessionid;
+            if (m->SessionExists(chunk_sid)) {
+                delete chunk;
+                continue;
+            }
 
-                task = nullptr;
-                QHash<SessionID, PRS1Import *>::iterator it = sesstasks.find(chunk_sid);
-                if (it != sesstasks.end()) {
-                    task = it.value();
-                } else {
-                    task = new PRS1Import(this, chunk_sid, m);
-                    sesstasks[chunk_sid] = task;
-                    // save a loop an que this now
-                    queTask(task);
-                }
-                switch (ext) {
-                case 0:
-                    if (task->compliance) continue; // (skipping to avoid duplicates)
-                    task->compliance = chunk;
-                    break;
-                case 1:
-                    if (task->summary) continue;
-                    task->summary = chunk;
-                    break;
-                case 2:
-                    if (task->event) continue;
-                    task->event = chunk;
-                    break;
-                default:
-                    break;
-                }
+
+            task = nullptr;
+            QHash<SessionID, PRS1Import *>::iterator it = sesstasks.find(chunk_sid);
+            if (it != sesstasks.end()) {
+                task = it.value();
+            } else {
+                task = new PRS1Import(this, chunk_sid, m);
+                sesstasks[chunk_sid] = task;
+                // save a loop an que this now
+                queTask(task);
+            }
+
+            PRS1DataChunk ** slot = nullptr;
+            switch (ext) {
+            case 0:
+                slot = &task->compliance;
+                break;
+            case 1:
+                slot = &task->summary;
+                break;
+            case 2:
+                slot = &task->event;
+                break;
+            default:
+                break;
+            }
+
+            if (slot && !*slot) {
+                *slot = chunk;
+            } else {
+                // (skipping to avoid duplicates)
+                delete chunk;
             }
         }
-        if (isAborted()) break;
+        delete pt;
     }
+    parsetasks.clear();
 
 
     int tasks = countTasks();
@@ -770,6 +810,9 @@ int PRS1Loader::OpenMachine(const QString & path)
 
     finishAddingSessions();
 
+    // Nothing's left to hand the pooled buffers to
+    prs1BufferPool.clear();
+
     if (unknownCodes.size() > 0) {
         for (auto it = unknownCodes.begin(), end=unknownCodes.end(); it != end; ++it) {
             qDebug() << QString("Unknown CPAP Codes '0x%1' was detected during import").arg((short)it.key(), 2, 16, QChar(0));
@@ -810,7 +853,7 @@ bool PRS1Import::ParseF5EventsFV3()
     int lastpos = 0, startpos = 0, lastpos2 = 0, lastpos3 = 0;
 
     int size = event->m_data.size();
-    unsigned char * buffer = (unsigned char *)event->m_data.data();
+    unsigned char * buffer = (unsigned char *)event->m_data.constData();
     EventList *OA = session->AddEventList(CPAP_Obstructive, EVL_Event);
     EventList *HY = session->AddEventList(CPAP_Hypopnea, EVL_Event);
 
@@ -1060,7 +1103,7 @@ bool PRS1Import::ParseF5Events()
     int lastpos = 0, startpos = 0, lastpos2 = 0, lastpos3 = 0;
 
     int size = event->m_data.size();
-    unsigned char * buffer = (unsigned char *)event->m_data.data();
+    unsigned char * buffer = (unsigned char *)event->m_data.constData();
 
     while (pos < size) {
         lastcode3 = lastcode2;
@@ -1458,7 +1501,7 @@ bool PRS1Import::ParseF3EventsV3()
     int pos = 0;
     int datasize = event->m_data.size();
 
-    unsigned char * data = (unsigned char *)event->m_data.data();
+    unsigned char * data = (unsigned char *)event->m_data.constData();
     unsigned char code;
     unsigned short delta;
     bool failed = false;
@@ -1610,7 +1653,7 @@ bool PRS1Import::ParseF3Events()
     EventList *FLOW = session->AddEventList(CPAP_FlowRate, EVL_Event);
 
     int size = event->m_data.size()/0x10;
-    unsigned char * h = (unsigned char *)event->m_data.data();
+    unsigned char * h = (unsigned char *)event->m_data.constData();
 
     int hy, oa, ca;
     qint64 div = 0;
@@ -1777,7 +1820,7 @@ bool PRS1Import::ParseF0Events()
     int size = event->m_data.size();
 
     bool FV3 = (event->fileVersion == 3);
-    unsigned char * buffer = (unsigned char *)event->m_data.data();
+    unsigned char * buffer = (unsigned char *)event->m_data.constData();
 
     EventDataType currentPressure=0, leak; //, p;
 
@@ -3017,6 +3060,53 @@ bool PRS1Import::ParseEvents()
     return res;
 }
 
+//! \brief Splits a waveform chunk's interleaved samples into one buffer per signal, reading straight from its block views
+static void deinterleave(const PRS1DataChunk * chunk, QVector<QByteArray> & out)
+{
+    int num = chunk->waveformInfo.size();
+    out.resize(num);
+
+    int group = 0;
+    for (int n=0; n < num; ++n) {
+        group += chunk->waveformInfo.at(n).interleave;
+    }
+    if (group == 0) return;
+
+    // Size each signal's buffer up front, rather than growing it a few bytes at a time
+    int total = chunk->size();
+    QVector<char *> dest(num);
+    for (int n=0; n < num; ++n) {
+        out[n].resize((total / group + 1) * chunk->waveformInfo.at(n).interleave);
+        dest[n] = out[n].data();
+    }
+
+    // Blocks are treated as one continuous stream, as interleave groups may straddle them
+    int n = 0;
+    int left = chunk->waveformInfo.at(0).interleave;
+    for (const auto & block : chunk->m_blocks) {
+        const char * src = block.constData();
+        int len = block.size();
+
+        while (len > 0) {
+            if (left == 0) {
+                n = (n + 1) % num;
+                left = chunk->waveformInfo.at(n).interleave;
+                continue;
+            }
+            int take = qMin(left, len);
+            memcpy(dest[n], src, take);
+            dest[n] += take;
+            src += take;
+            len -= take;
+            left -= take;
+        }
+    }
+
+    for (int n=0; n < num; ++n) {
+        out[n].resize(dest[n] - out[n].data());
+    }
+}
+
 bool PRS1Import::ParseOximetery()
 {
     int size = oximetry.size();
@@ -3025,7 +3115,7 @@ bool PRS1Import::ParseOximetery()
         PRS1DataChunk * oxi = oximetry.at(i);
         int num = oxi->waveformInfo.size();
 
-        int size = oxi->m_data.size();
+        int size = oxi->size();
         if (size == 0) {
             continue;
         }
@@ -3035,16 +3125,7 @@ bool PRS1Import::ParseOximetery()
         if (num > 1) {
             // Process interleaved samples
             QVector<QByteArray> data;
-            data.resize(num);
-
-            int pos = 0;
-            do {
-                for (int n=0; n < num; n++) {
-                    int interleave = oxi->waveformInfo.at(n).interleave;
-                    data[n].append(oxi->m_data.mid(pos, interleave));
-                    pos += interleave;
-                }
-            } while (pos < size);
+            deinterleave(oxi, data);
 
             if (data[0].size() > 0) {
                 EventList * pulse = session->AddEventList(OXI_Pulse, EVL_Waveform, 1.0, 0.0, 0.0, 0.0, dur / data[0].size());
@@ -3074,7 +3155,7 @@ bool PRS1Import::ParseWaveforms()
         PRS1DataChunk * waveform = waveforms.at(i);
         int num = waveform->waveformInfo.size();
 
-        int size = waveform->m_data.size();
+        int size = waveform->size();
         if (size == 0) {
             continue;
         }
@@ -3092,16 +3173,7 @@ bool PRS1Import::ParseWaveforms()
         if (num > 1) {
             // Process interleaved samples
             QVector<QByteArray> data;
-            data.resize(num);
-
-            int pos = 0;
-            do {
-                for (int n=0; n < num; n++) {
-                    int interleave = waveform->waveformInfo.at(n).interleave;
-                    data[n].append(waveform->m_data.mid(pos, interleave));
-                    pos += interleave;
-                }
-            } while (pos < size);
+            deinterleave(waveform, data);
 
             s1 = data[0].size();
             s2 = data[1].size();
@@ -3117,9 +3189,10 @@ bool PRS1Import::ParseWaveforms()
             }
 
         } else {
-            // Non interleaved, so can process it much faster
-            EventList * flow = session->AddEventList(CPAP_FlowRate, EVL_Waveform, 1.0f, 0.0f, 0.0f, 0.0f, double(dur) / double(waveform->m_data.size()));
-            flow->AddWaveform(ti, (char *)waveform->m_data.data(), waveform->m_data.size(), dur);
+            // Non interleaved, so can process it much faster, straight out of the file buffer if it's one block
+            QByteArray data = waveform->contiguousData();
+            EventList * flow = session->AddEventList(CPAP_FlowRate, EVL_Waveform, 1.0f, 0.0f, 0.0f, 0.0f, double(dur) / double(data.size()));
+            flow->AddWaveform(ti, (char *)data.constData(), data.size(), dur);
         }
         lastti = dur+ti;
     }
@@ -3181,6 +3254,69 @@ void PRS1Import::run()
 }
 
 
+PRS1BufferPool prs1BufferPool;
+
+// Waveform chunks get merged into big buffers, which aren't worth hanging on to
+const int max_pooled_buffer = 256 * 1024;
+const qint64 max_pooled_total = 16 * 1024 * 1024;
+
+QByteArray PRS1BufferPool::acquire(int size)
+{
+    mutex.lock();
+
+    // Take the smallest that fits
+    int best = -1;
+    for (int i=0; i < buffers.size(); ++i) {
+        int cap = buffers.at(i).capacity();
+        if ((cap >= size) && ((best < 0) || (cap < buffers.at(best).capacity()))) {
+            best = i;
+        }
+    }
+
+    if (best >= 0) {
+        QByteArray buffer = buffers.takeAt(best);
+        pooled -= buffer.capacity();
+        mutex.unlock();
+
+        buffer.resize(size);
+        return buffer;
+    }
+    mutex.unlock();
+
+    return QByteArray(size, Qt::Uninitialized);
+}
+
+void PRS1BufferPool::release(QByteArray & buffer)
+{
+    int cap = buffer.capacity();
+
+    if ((cap > 0) && (cap <= max_pooled_buffer) && buffer.isDetached()) {
+        QMutexLocker locker(&mutex);
+        if ((pooled + cap) <= max_pooled_total) {
+            // Reserving marks the capacity as wanted, so resize(0) keeps the allocation
+            buffer.reserve(cap);
+            buffer.resize(0);
+            buffers.append(buffer);
+            pooled += cap;
+        }
+    }
+    buffer = QByteArray();
+}
+
+void PRS1BufferPool::clear()
+{
+    QMutexLocker locker(&mutex);
+    buffers.clear();
+    pooled = 0;
+}
+
+void PRS1ParseTask::run()
+{
+    if (loader->isAborted()) return;
+
+    chunks = loader->ParseFile(path);
+}
+
 QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
 {
     QList<PRS1DataChunk *> CHUNKS;
@@ -3198,13 +3334,27 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
         return CHUNKS;
     }
 
+    // Read the whole file in one go. Chunks keep a reference to this buffer and view their data in place
+    qint64 filesize = f.size();
+    QByteArray source = prs1BufferPool.acquire(filesize);
+    qint64 got = f.read(source.data(), filesize);
+    f.close();
+
+    if (got < filesize) {
+        source.resize(qMax(got, qint64(0)));
+    }
+
+    const unsigned char * buffer = (const unsigned char *)source.constData();
+    const int end = source.size();
+    int fpos = 0;
+
     PRS1DataChunk *chunk = nullptr, *lastchunk = nullptr;
 
     quint8 fileVersion;
     quint16 blocksize;
     quint16 wvfm_signals=0;
 
-    unsigned char * header;
+    const unsigned char * header;
     int cnt = 0;
 
     //int lastheadersize = 0;
@@ -3217,18 +3367,16 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
     quint32 sessionid=0, timestamp=0;
 
     int duration=0;
-
-    QByteArray headerBA, headerB2, extra;
+    int hdb_pos = 0, hdb_size = 0;
 
     QList<PRS1Waveform> waveformInfo;
 
     do {
-        headerBA = f.read(16);
-        if (headerBA.size() != 16) {
+        if ((end - fpos) < 16) {
             break;
         }
 
-        header = (unsigned char *)headerBA.data();
+        header = buffer + fpos;
 
         fileVersion = header[0];    // Correlates to DataFileVersion in PROP[erties].TXT, only 2 or 3 has ever been observed
         blocksize = (header[2] << 8) | header[1];
@@ -3252,6 +3400,8 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
         int diff = 0;
 
         waveformInfo.clear();
+        hdb_pos = -1;
+        hdb_size = 0;
 
         bool hasHeaderDataBlock = (fileVersion == 3);
         if (ext < 5) { // Not a waveform chunk
@@ -3264,28 +3414,21 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
                 // then the 8bit Checksum
 
                 int hdb_len = header[15];
-                int hdb_size = hdb_len * 2;
+                hdb_size = hdb_len * 2;
 
-                headerB2 = f.read(hdb_size+1);  // add extra byte for checksum
-                if (headerB2.size() != hdb_size+1) {
+                if ((end - fpos) < (header_size + hdb_size + 1)) {  // add extra byte for checksum
                     break;
                 }
 
-                headerBA.append(headerB2);
-                header = (unsigned char *)headerBA.data(); // important because it's memory location could move
-
+                hdb_pos = fpos + header_size;
                 header_size += hdb_size+1;
-            } else headerB2 = QByteArray();
+            }
 
        } else { // Waveform Chunk
-            extra = f.read(4);
-            if (extra.size() != 4) {
+            header_size += 4;
+            if ((end - fpos) < header_size) {
                 break;
             }
-            header_size += 4;
-            headerBA.append(extra);
-            // Get the header address again to be safe
-            header = (unsigned char *)headerBA.data();
 
             duration = header[0x0f] | header[0x10] << 8;
             wvfm_signals = header[0x12] | header[0x13] << 8;
@@ -3293,13 +3436,10 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
             int ws_size = (fileVersion == 3) ? 4 : 3;
             int sbsize = wvfm_signals * ws_size + 1;
 
-            extra = f.read(sbsize);
-            if (extra.size() != sbsize) {
+            header_size += sbsize;
+            if ((end - fpos) < header_size) {
                 break;
             }
-            headerBA.append(extra);
-            header = (unsigned char *)headerBA.data();
-            header_size += sbsize;
 
             // Read the waveform information in reverse.
             int pos = 0x14 + (wvfm_signals - 1) * ws_size;
@@ -3339,13 +3479,9 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
                || (lastchunk->family != family)
                || (lastchunk->familyVersion != familyVersion)
                || (lastchunk->htype != htype)) {
-                   QByteArray junk = f.read(lastblocksize - header_size);
+                   // Skip what would have been the previous block's worth of data
+                   fpos = qMin(end, fpos + lastblocksize);
 
-                   Q_UNUSED(junk)
-                   if (lastchunk->ext == 5) {
-                       // The data is random crap
-                       // lastchunk->m_data.append(junk.mid(lastheadersize-16));
-                   }
                    ++cruft;
                    // quit after 3 attempts
                    if (cruft > 3)
@@ -3369,16 +3505,18 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
         chunk->familyVersion = familyVersion;
         chunk->ext = ext;
         chunk->timestamp = timestamp;
-        if (hasHeaderDataBlock) {
-            const unsigned char * hd = (unsigned char *)headerB2.constData();
+        chunk->m_source = source;
+
+        if (hdb_pos >= 0) {
+            const unsigned char * hd = buffer + hdb_pos;
             int pos = 0;
             int recs = header[15];
             for (int i=0; i<recs; i++) {
                 chunk->hblock[hd[pos]] = hd[pos+1];
                 pos += 2;
             }
+            chunk->m_headerblock = QByteArray::fromRawData((const char *)hd, hdb_size + 1);
         }
-        chunk->m_headerblock = headerB2;
 
         lastblocksize = blocksize;
         blocksize -= header_size;
@@ -3392,26 +3530,29 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
             }
         }
 
-        // Read data block
-        chunk->m_data = f.read(blocksize);
+        // The data block follows the header
+        fpos += header_size;
 
-        if (chunk->m_data.size() < blocksize) {
+        if ((end - fpos) < blocksize) {
             delete chunk;
             break;
         }
 
+        const unsigned char * data = buffer + fpos;
+        int datasize = blocksize;
+        fpos += blocksize;
+
         if (chunk->fileVersion==3) {
-            //int ds = chunk->m_data.size();
-            //quint32 crc16 = chunk->m_data.at(ds-2) | chunk->m_data.at(ds-1) << 8;
-            chunk->m_data.chop(4);
-        } else {
+            //quint32 crc16 = data[datasize-2] | data[datasize-1] << 8;
+            datasize -= 4;
+        } else if (datasize >= 2) {
             // last two bytes contain crc16 checksum.
-            int ds = chunk->m_data.size();
-            quint16 crc16 = chunk->m_data.at(ds-2) | chunk->m_data.at(ds-1) << 8;
-            chunk->m_data.chop(2);
+            quint16 crc16 = data[datasize-2] | data[datasize-1] << 8;
+            datasize -= 2;
+            Q_UNUSED(crc16)
 #ifdef PRS1_CRC_CHECK
             // This fails.. it needs to include the header!
-            quint16 calc16 = CRC16((unsigned char *)chunk->m_data.data(), chunk->m_data.size());
+            quint16 calc16 = CRC16((unsigned char *)data, datasize);
             if (calc16 != crc16) {
                 // corrupt data block.. bleh..
             //   qDebug() << "CRC16 doesn't match for chunk" << chunk->sessionid << "for" << path;
@@ -3419,16 +3560,19 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
 #endif
         }
 
+        chunk->addBlock(data, qMax(datasize, 0));
+
         if ((chunk->ext == 5) || (chunk->ext == 6)) {  // if Flow/MaskPressure Waveform or OXI Waveform file
             if (lastchunk != nullptr) {
                 if (lastchunk->sessionid != chunk->sessionid) {
                     qWarning() << "lastchunk->sessionid != chunk->sessionid in PRS1Loader::ParseFile2()";
+                    delete chunk;
                     break;
                 }
 
                 if (diff == 0) {
-                    // In sync, so append waveform data to previous chunk
-                    lastchunk->m_data.append(chunk->m_data);
+                    // In sync, so add this block's view to the previous chunk instead
+                    lastchunk->addBlock(data, qMax(datasize, 0));
                     lastchunk->duration += chunk->duration;
                     delete chunk;
                     cnt++;
@@ -3444,7 +3588,10 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(const QString & path)
         lastchunk = chunk;
         cnt++;
 
-    } while (!f.atEnd());
+    } while (fpos < end);
+
+    // Hand the buffer back now if no chunk ended up using it
+    prs1BufferPool.release(source);
 
     return CHUNKS;
 }
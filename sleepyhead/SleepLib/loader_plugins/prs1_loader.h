@@ -10,6 +10,8 @@
 #define PRS1LOADER_H
 //#include <map>
 //using namespace std;
+#include <QMutex>
+
 #include "SleepLib/machine.h" // Base class: MachineLoader
 #include "SleepLib/machine_loader.h"
 #include "SleepLib/profiles.h"
@@ -50,6 +52,31 @@ struct PRS1Waveform {
 };
 
 
+/*! \class PRS1BufferPool
+ *  \brief Hands out chunk data buffers, keeping the allocations of released ones for reuse */
+class PRS1BufferPool
+{
+public:
+    PRS1BufferPool() : pooled(0) {}
+
+    //! \brief Returns a buffer of size bytes (contents undefined), reusing a released allocation when one is big enough
+    QByteArray acquire(int size);
+
+    //! \brief Hands buffer's allocation back to the pool, leaving buffer empty
+    void release(QByteArray & buffer);
+
+    //! \brief Frees everything held by the pool
+    void clear();
+
+protected:
+    QMutex mutex;
+    QList<QByteArray> buffers;
+    qint64 pooled;
+};
+
+//! \brief Shared by every PRS1DataChunk, whose destructor returns m_data to it
+extern PRS1BufferPool prs1BufferPool;
+
 /*! \class PRS1DataChunk
  *  \brief Representing a chunk of event/summary/waveform data after the header is parsed. */
 class PRS1DataChunk
@@ -67,12 +94,48 @@ public:
 
     }
     ~PRS1DataChunk() {
+        // Views first, so the last chunk out can give the file buffer back
+        m_data.clear();
+        m_headerblock.clear();
+        m_blocks.clear();
+        prs1BufferPool.release(m_source);
+    }
+
+    //! \brief Returns the total size of this chunk's data blocks
+    inline int size() const {
+        int total = 0;
+        for (int i=0; i < m_blocks.size(); ++i) total += m_blocks.at(i).size();
+        return total;
+    }
+
+    //! \brief Adds a view of size bytes at data, which must lie within m_source, to this chunk's data
+    void addBlock(const unsigned char * data, int size) {
+        QByteArray view = QByteArray::fromRawData((const char *)data, size);
+        if (m_blocks.isEmpty()) {
+            m_data = view;
+        }
+        m_blocks.append(view);
     }
-    inline int size() const { return m_data.size(); }
 
+    //! \brief Returns all the data blocks in one piece, only copying if there's more than one
+    QByteArray contiguousData() const {
+        if (m_blocks.size() == 1) return m_data;
+        QByteArray data;
+        data.reserve(size());
+        for (int i=0; i < m_blocks.size(); ++i) data.append(m_blocks.at(i));
+        return data;
+    }
+
+    //! \brief The whole file this chunk was parsed from, which m_data, m_headerblock and m_blocks view without copying
+    QByteArray m_source;
+
+    //! \brief View of the first (usually only) data block. Don't call non-const methods on it, they'd make a copy
     QByteArray m_data;
     QByteArray m_headerblock;
 
+    //! \brief Views of every data block, more than one when contiguous waveform blocks were merged
+    QList<QByteArray> m_blocks;
+
     SessionID sessionid;
 
     quint8 fileVersion;
@@ -90,6 +153,26 @@ public:
 
 class PRS1Loader;
 
+/*! \class PRS1ParseTask
+ *  \brief Breaks a single summary/event file into chunks on a worker thread, for OpenMachine to sort into sessions */
+class PRS1ParseTask:public QRunnable
+{
+public:
+    PRS1ParseTask(PRS1Loader * l, const QString & path, int ext): loader(l), path(path), ext(ext) {}
+    virtual ~PRS1ParseTask() {
+        for (int i=0;i < chunks.size(); ++i) { delete chunks.at(i); }
+    }
+
+    virtual void run();
+
+    PRS1Loader * loader;
+    QString path;
+    int ext;
+
+    //! \brief Chunks parsed from path, in file order. Whoever takes ownership should clear this.
+    QList<PRS1DataChunk *> chunks;
+};
+
 /*! \class PRS1Import
  *  \brief Contains the functions to parse a single session... multithreaded */
 class PRS1Import:public ImportTask
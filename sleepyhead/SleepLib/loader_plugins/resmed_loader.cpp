@@ -15,6 +15,7 @@
 #include <QTextStream>
 #include <QDebug>
 #include <QStringList>
+#include <QThreadPool>
 #include <cmath>
 
 #include "resmed_loader.h"
@@ -105,462 +106,598 @@ bool matchSignal(ChannelID ch, const QString & name)
     return false;
 }
 
-// This function parses a list of STR files and creates a date ordered map of individual records
-void ResmedLoader::ParseSTR(Machine *mach, QMap<QDate, STRFile> & STRmap)
+// Returns the first of two alternative signal labels the file has
+static EDFSignal *lookupEither(ResMedEDFParser & str, const QString & name, const QString & alt)
 {
-    Q_UNUSED(mach)
+    EDFSignal *sig = str.lookupLabel(name);
+    return sig ? sig : str.lookupLabel(alt);
+}
 
-    QDateTime ignoreBefore = p_profile->session->ignoreOlderSessionsDate();
-    bool ignoreOldSessions = p_profile->session->ignoreOlderSessions();
+STRSignals::STRSignals(ResMedEDFParser & str)
+{
+    // ResMed and their consistent naming and spacing... :/
+    maskon = lookupEither(str, "Mask On", "MaskOn");
+    maskoff = lookupEither(str, "Mask Off", "MaskOff");
+    mode = str.lookupSignal(CPAP_Mode);
+
+    cStartPress = str.lookupLabel("S.C.StartPress");
+    asStartPress = str.lookupLabel("S.AS.StartPress");
+    blStartPress = str.lookupLabel("S.BL.StartPress");
+    vaStartPress = str.lookupLabel("S.VA.StartPress");
+
+    maskDur = str.lookupLabel("Mask Dur");
+    leak50 = lookupEither(str, "Leak Med", "Leak.50");
+    leakMax = lookupEither(str, "Leak Max", "Leak.Max");
+    leak95 = lookupEither(str, "Leak 95", "Leak.95");
+    rr50 = lookupEither(str, "RespRate.50", "RR Med");
+    rrMax = lookupEither(str, "RespRate.Max", "RR Max");
+    rr95 = lookupEither(str, "RespRate.95", "RR 95");
+    mv50 = lookupEither(str, "MinVent.50", "Min Vent Med");
+    mvMax = lookupEither(str, "MinVent.Max", "Min Vent Max");
+    mv95 = lookupEither(str, "MinVent.95", "Min Vent 95");
+    tv50 = lookupEither(str, "TidVol.50", "Tid Vol Med");
+    tvMax = lookupEither(str, "TidVol.Max", "Tid Vol Max");
+    tv95 = lookupEither(str, "TidVol.95", "Tid Vol 95");
+    mp50 = lookupEither(str, "MaskPress.50", "Mask Pres Med");
+    mpMax = lookupEither(str, "MaskPress.Max", "Mask Pres Max");
+    mp95 = lookupEither(str, "MaskPress.95", "Mask Pres 95");
+    epap50 = lookupEither(str, "TgtEPAP.50", "Exp Pres Med");
+    epapMax = lookupEither(str, "TgtEPAP.Max", "Exp Pres Max");
+    epap95 = lookupEither(str, "TgtEPAP.95", "Exp Pres 95");
+    ipap50 = lookupEither(str, "TgtIPAP.50", "Insp Pres Med");
+    ipapMax = lookupEither(str, "TgtIPAP.Max", "Insp Pres Max");
+    ipap95 = lookupEither(str, "TgtIPAP.95", "Insp Pres 95");
+    ie50 = str.lookupLabel("I:E Med");
+    ieMax = str.lookupLabel("I:E Max");
+    ie95 = str.lookupLabel("I:E 95");
+
+    ipap = str.lookupSignal(CPAP_IPAP);
+    epap = str.lookupSignal(CPAP_EPAP);
+
+    avStartPress = str.lookupLabel("S.AV.StartPress");
+    avEPAP = str.lookupLabel("S.AV.EPAP");
+    avMinPS = str.lookupLabel("S.AV.MinPS");
+    avMaxPS = str.lookupLabel("S.AV.MaxPS");
+    aaStartPress = str.lookupLabel("S.AA.StartPress");
+    aaMinEPAP = str.lookupLabel("S.AA.MinEPAP");
+    aaMaxEPAP = str.lookupLabel("S.AA.MaxEPAP");
+    aaMinPS = str.lookupLabel("S.AA.MinPS");
+    aaMaxPS = str.lookupLabel("S.AA.MaxPS");
+
+    pressureMax = str.lookupSignal(CPAP_PressureMax);
+    pressureMin = str.lookupSignal(CPAP_PressureMin);
+    setPressure = str.lookupSignal(RMS9_SetPressure);
+    epapHi = str.lookupSignal(CPAP_EPAPHi);
+    epapLo = str.lookupSignal(CPAP_EPAPLo);
+    ipapHi = str.lookupSignal(CPAP_IPAPHi);
+    ipapLo = str.lookupSignal(CPAP_IPAPLo);
+    ps = str.lookupSignal(CPAP_PS);
+
+    // Okay, problem here: THere are TWO PSMin & MAX values on the 36037 with the same string
+    // One is for ASV mode, and one is for ASVAuto
+    for (int i = 0; i < 2; ++i) {
+        maxPS[i] = str.lookupLabel("Max PS", i);
+        minPS[i] = str.lookupLabel("Min PS", i);
+    }
+
+    epr = str.lookupSignal(RMS9_EPR);
+    eprLevel = str.lookupSignal(RMS9_EPRLevel);
+    eprType = str.lookupLabel("S.EPR.EPRType");
+    eprEnable = str.lookupLabel("S.EPR.EPREnable");
+    clinEnable = str.lookupLabel("S.EPR.ClinEnable");
+
+    ahi = str.lookupLabel("AHI");
+    ai = str.lookupLabel("AI");
+    hi = str.lookupLabel("HI");
+    uai = str.lookupLabel("UAI");
+    cai = str.lookupLabel("CAI");
+    oai = str.lookupLabel("OAI");
+    csr = str.lookupLabel("CSR");
+
+    rampTime = str.lookupLabel("S.RampTime");
+    rampEnable = str.lookupLabel("S.RampEnable");
+    abFilter = str.lookupLabel("S.ABFilter");
+    climateControl = str.lookupLabel("S.ClimateControl");
+    mask = str.lookupLabel("S.Mask");
+    ptAccess = str.lookupLabel("S.PtAccess");
+    smartStart = str.lookupLabel("S.SmartStart");
+    humEnable = str.lookupLabel("S.HumEnable");
+    humLevel = str.lookupLabel("S.HumLevel");
+    tempEnable = str.lookupLabel("S.TempEnable");
+    temp = str.lookupLabel("S.Temp");
+    tube = str.lookupLabel("S.Tube");
+}
 
-    int totalRecs = 0;
-    for (auto it=STRmap.begin(), end=STRmap.end(); it != end; ++it) {
-        STRFile & file = it.value();
-        ResMedEDFParser & str = *file.edf;
-        totalRecs += str.GetNumDataRecords();
-    }
+// Record rec's value of sig, with gain and offset applied
+static inline EventDataType STRValue(EDFSignal *sig, int rec)
+{
+    return EventDataType(sig->data[rec]) * sig->gain + sig->offset;
+}
 
-    emit updateMessage("Parsing STR.edf records...");
-    emit setProgressMax(totalRecs);
-    QCoreApplication::processEvents();
+bool STRSignals::read(int rec, const QDate & date, STRRecord & R) const
+{
+    EDFSignal *sig = nullptr;
 
-    int currentRec = 0;
+    int recstart = rec * maskon->nr;
 
-    for (auto it=STRmap.begin(), end=STRmap.end(); it != end; ++it) {
-        STRFile & file = it.value();
-        QString & strfile = file.filename;
-        ResMedEDFParser & str = *file.edf;
+    bool validday = false;
+    for (int s = 0; s < maskon->nr; ++s) {
+        qint32 on = maskon->data[recstart + s];
+        qint32 off = maskoff->data[recstart + s];
 
-        QDate date = str.startdate_orig.date(); // each STR.edf record starts at 12 noon
+        if ((on >= 0) && (off >= 0)) validday=true;
+    }
+    if (!validday) {
+        // There are no mask on/off events, so this STR day is useless.
+        return false;
+    }
 
-        qDebug() << "Parsing" << strfile << date << str.GetNumDataRecords() << str.GetNumSignals();
+    uint timestamp = QDateTime(date,QTime(12,0,0)).toTime_t();
+    R.date = date;
 
-        // ResMed and their consistent naming and spacing... :/
-        EDFSignal *maskon = str.lookupLabel("Mask On");
-        if (!maskon) {
-            maskon = str.lookupLabel("MaskOn");
-        }
-        EDFSignal *maskoff = str.lookupLabel("Mask Off");
-        if (!maskoff) {
-             maskoff = str.lookupLabel("MaskOff");
-        }
+    // For every mask on, there will be a session within 1 minute either way
+    // We can use that for data matching
+    // Scan the mask on/off events by minute
+    R.maskon.resize(maskon->nr);
+    R.maskoff.resize(maskoff->nr);
+    for (int s = 0; s < maskon->nr; ++s) {
+        qint32 on = maskon->data[recstart + s];
+        qint32 off = maskoff->data[recstart + s];
 
-        EDFSignal *sig = nullptr;
+        R.maskon[s] = (on>0) ? (timestamp + (on * 60)) : 0;
+        R.maskoff[s] = (off>0) ? (timestamp + (off * 60)) : 0;
+    }
 
-        int size = str.GetNumDataRecords();
+    // two conditions that need dealing with, mask running at noon start, and finishing at noon start..
+    // (Sessions are forcibly split by resmed.. why the heck don't they store it that way???)
+    if ((R.maskon[0]==0) && (R.maskoff[0]>0)) {
+        R.maskon[0] = timestamp;
+    }
+    if ((R.maskon[maskon->nr-1] > 0) && (R.maskoff[maskoff->nr-1] == 0)) {
+        R.maskoff[maskoff->nr-1] = QDateTime(date,QTime(12,0,0)).addDays(1).toTime_t() - 1;
+    }
 
-        // For each data record, representing 1 day each
-        for (int rec = 0; rec < size; ++rec, date = date.addDays(1)) {
-            emit setProgressValue(++currentRec);
-            QCoreApplication::processEvents();
+    CPAPMode cpapmode = MODE_UNKNOWN;
 
-            if (ignoreOldSessions) {
-                if (date < ignoreBefore.date()) {
-                    continue;
-                }
-            }
+    if ((sig = mode)) {
+        int mod = STRValue(sig, rec);
+        R.rms9_mode = mod;
 
-            auto rit = resdayList.find(date);
-            if (rit != resdayList.end()) {
-                // Already seen this record.. should check if the data is the same, but meh.
-                continue;
-            }
+        if (mod == 11) {
+            cpapmode = MODE_APAP; // For her
+        } else if (mod >= 8) {       // mod 8 == vpap adapt variable epap
+            cpapmode = MODE_ASV_VARIABLE_EPAP;
+        } else if (mod >= 7) {       // mod 7 == vpap adapt
+            cpapmode = MODE_ASV;
+        } else if (mod >= 6) { // mod 6 == vpap auto (Min EPAP, Max IPAP, PS)
+            cpapmode = MODE_BILEVEL_AUTO_FIXED_PS;
+        } else if (mod >= 3) {// mod 3 == vpap s fixed pressure (EPAP, IPAP, No PS)
+            cpapmode = MODE_BILEVEL_FIXED;
+            // 4,5 are S/T types...
 
-            int recstart = rec * maskon->nr;
+        } else if (mod >= 1) {
+            cpapmode = MODE_APAP; // mod 1 == apap
+            // not sure what mode 2 is ?? split ?
+        } else {
+            cpapmode = MODE_CPAP; // mod 0 == cpap
+        }
+        R.mode = cpapmode;
 
-            bool validday = false;
-            for (int s = 0; s < maskon->nr; ++s) {
-                qint32 on = maskon->data[recstart + s];
-                qint32 off = maskoff->data[recstart + s];
+        // Settings.CPAP.Starting Pressure
+        if ((mod == 0) && (sig = cStartPress)) {
+            R.ramp_pressure = STRValue(sig, rec);
+        }
+        // Settings.Adaptive Starting Pressure? // mode 11 = APAP for her?
+        if (((mod == 1) || (mod == 11)) && (sig = asStartPress)) {
+            R.ramp_pressure = STRValue(sig, rec);
+        }
 
-                if ((on >= 0) && (off >= 0)) validday=true;
-            }
-            if (!validday) {
-                // There are no mask on/off events, so this STR day is useless.
-                continue;
-            }
+        if ((R.mode == MODE_BILEVEL_FIXED) && (sig = blStartPress)) {
+            // Bilevel Starting Pressure
+            R.ramp_pressure = STRValue(sig, rec);
+        }
+        if (((R.mode == MODE_ASV) || (R.mode == MODE_ASV_VARIABLE_EPAP)) && (sig = vaStartPress)) {
+            // Bilevel Starting Pressure
+            R.ramp_pressure = STRValue(sig, rec);
+        }
+    }
 
-            rit = resdayList.insert(date, ResMedDay());
+    if ((sig = maskDur)) {
+        R.maskdur = STRValue(sig, rec);
+    }
+    if ((sig = leak50)) {
+        R.leak50 = EventDataType(sig->data[rec]) * (sig->gain * 60.0);
+    }
+    if ((sig = leakMax)) {
+        R.leakmax = EventDataType(sig->data[rec]) * (sig->gain * 60.0);
+    }
+    if ((sig = leak95)) {
+        R.leak95 = EventDataType(sig->data[rec]) * (sig->gain * 60.0);
+    }
+    if ((sig = rr50)) {
+        R.rr50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = rrMax)) {
+        R.rrmax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = rr95)) {
+        R.rr95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = mv50)) {
+        R.mv50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = mvMax)) {
+        R.mvmax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = mv95)) {
+        R.mv95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = tv50)) {
+        R.tv50 = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
+    }
+    if ((sig = tvMax)) {
+        R.tvmax = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
+    }
+    if ((sig = tv95)) {
+        R.tv95 = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
+    }
 
-            STRRecord &R = rit.value().str;
+    if ((sig = mp50)) {
+        R.mp50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = mpMax)) {
+        R.mpmax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = mp95)) {
+        R.mp95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
 
-            uint timestamp = QDateTime(date,QTime(12,0,0)).toTime_t();
-            R.date = date;
+    if ((sig = epap50)) {
+        R.tgtepap50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = epapMax)) {
+        R.tgtepapmax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = epap95)) {
+        R.tgtepap95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
 
-            // skipday = false;
+    if ((sig = ipap50)) {
+        R.tgtipap50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = ipapMax)) {
+        R.tgtipapmax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = ipap95)) {
+        R.tgtipap95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
 
-            // For every mask on, there will be a session within 1 minute either way
-            // We can use that for data matching
-            // Scan the mask on/off events by minute
-            R.maskon.resize(maskon->nr);
-            R.maskoff.resize(maskoff->nr);
-            for (int s = 0; s < maskon->nr; ++s) {
-                qint32 on = maskon->data[recstart + s];
-                qint32 off = maskoff->data[recstart + s];
+    if ((sig = ie50)) {
+        R.ie50 = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = ieMax)) {
+        R.iemax = EventDataType(sig->data[rec]) * sig->gain;
+    }
+    if ((sig = ie95)) {
+        R.ie95 = EventDataType(sig->data[rec]) * sig->gain;
+    }
 
-                R.maskon[s] = (on>0) ? (timestamp + (on * 60)) : 0;
-                R.maskoff[s] = (off>0) ? (timestamp + (off * 60)) : 0;
-            }
+    if ((sig = ipap)) {
+        R.ipap = STRValue(sig, rec);
+    }
+    if ((sig = epap)) {
+        R.epap = STRValue(sig, rec);
+    }
 
+    if (R.mode == MODE_ASV) {
+        if ((sig = avStartPress)) {
+            R.ramp_pressure = STRValue(sig, rec);
+        }
+        if ((sig = avEPAP)) {
+            R.min_epap = R.max_epap = R.epap = STRValue(sig, rec);
+        }
+        if ((sig = avMinPS)) {
+            R.min_ps = STRValue(sig, rec);
+        }
+        if ((sig = avMaxPS)) {
+            R.max_ps = STRValue(sig, rec);
+            R.max_ipap = R.epap + R.max_ps;
+            R.min_ipap = R.epap + R.min_ps;
+        }
+    }
+    if (R.mode == MODE_ASV_VARIABLE_EPAP) {
+        if ((sig = aaStartPress)) {
+            R.ramp_pressure = STRValue(sig, rec);
+        }
+        if ((sig = aaMinEPAP)) {
+            R.min_epap = STRValue(sig, rec);
+        }
+        if ((sig = aaMaxEPAP)) {
+            R.max_epap = STRValue(sig, rec);
+        }
+        if ((sig = aaMinPS)) {
+            R.min_ps = STRValue(sig, rec);
+        }
+        if ((sig = aaMaxPS)) {
+            R.max_ps = STRValue(sig, rec);
+            R.max_ipap = R.max_epap + R.max_ps;
+            R.min_ipap = R.min_epap + R.min_ps;
+        }
+    }
 
-            // two conditions that need dealing with, mask running at noon start, and finishing at noon start..
-            // (Sessions are forcibly split by resmed.. why the heck don't they store it that way???)
-            if ((R.maskon[0]==0) && (R.maskoff[0]>0)) {
-                R.maskon[0] = timestamp;
-            }
-            if ((R.maskon[maskon->nr-1] > 0) && (R.maskoff[maskoff->nr-1] == 0)) {
-                R.maskoff[maskoff->nr-1] = QDateTime(date,QTime(12,0,0)).addDays(1).toTime_t() - 1;
-            }
+    if ((sig = pressureMax)) {
+        R.max_pressure = STRValue(sig, rec);
+    }
+    if ((sig = pressureMin)) {
+        R.min_pressure = STRValue(sig, rec);
+    }
+    if ((sig = setPressure)) {
+        R.set_pressure = STRValue(sig, rec);
+    }
 
-            CPAPMode mode = MODE_UNKNOWN;
-
-            if ((sig = str.lookupSignal(CPAP_Mode))) {
-                int mod = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                R.rms9_mode = mod;
-
-                if (mod == 11) {
-                    mode = MODE_APAP; // For her
-                } else if (mod >= 8) {       // mod 8 == vpap adapt variable epap
-                    mode = MODE_ASV_VARIABLE_EPAP;
-                } else if (mod >= 7) {       // mod 7 == vpap adapt
-                    mode = MODE_ASV;
-                } else if (mod >= 6) { // mod 6 == vpap auto (Min EPAP, Max IPAP, PS)
-                    mode = MODE_BILEVEL_AUTO_FIXED_PS;
-                } else if (mod >= 3) {// mod 3 == vpap s fixed pressure (EPAP, IPAP, No PS)
-                    mode = MODE_BILEVEL_FIXED;
-                    // 4,5 are S/T types...
-
-                } else if (mod >= 1) {
-                    mode = MODE_APAP; // mod 1 == apap
-                    // not sure what mode 2 is ?? split ?
-                } else {
-                    mode = MODE_CPAP; // mod 0 == cpap
-                }
-                R.mode = mode;
+    if ((sig = epapHi)) {
+        R.max_epap = STRValue(sig, rec);
+    }
+    if ((sig = epapLo)) {
+        R.min_epap = STRValue(sig, rec);
+    }
 
-                // Settings.CPAP.Starting Pressure
-                if ((mod == 0) && (sig = str.lookupLabel("S.C.StartPress"))) {
-                    R.ramp_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                // Settings.Adaptive Starting Pressure? // mode 11 = APAP for her?
-                if (((mod == 1) || (mod == 11)) && (sig = str.lookupLabel("S.AS.StartPress"))) {
-                    R.ramp_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
+    if ((sig = ipapHi)) {
+        R.max_ipap = STRValue(sig, rec);
+    }
+    if ((sig = ipapLo)) {
+        R.min_ipap = STRValue(sig, rec);
+    }
+    if ((sig = ps)) {
+        R.ps = STRValue(sig, rec);
+    }
 
-                if ((R.mode == MODE_BILEVEL_FIXED) && (sig = str.lookupLabel("S.BL.StartPress"))) {
-                    // Bilevel Starting Pressure
-                    R.ramp_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if (((R.mode == MODE_ASV) || (R.mode == MODE_ASV_VARIABLE_EPAP)) && (sig = str.lookupLabel("S.VA.StartPress"))) {
-                    // Bilevel Starting Pressure
-                    R.ramp_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-            }
+    int psvar = (cpapmode == MODE_ASV_VARIABLE_EPAP) ? 1 : 0;
 
-            if ((sig = str.lookupLabel("Mask Dur"))) {
-                R.maskdur = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("Leak Med")) || (sig = str.lookupLabel("Leak.50"))) {
-                float gain = sig->gain * 60.0;
-                R.leak50 = EventDataType(sig->data[rec]) * gain;
-            }
-            if ((sig = str.lookupLabel("Leak Max"))|| (sig = str.lookupLabel("Leak.Max"))) {
-                float gain = sig->gain * 60.0;
-                R.leakmax = EventDataType(sig->data[rec]) * gain;
-            }
-            if ((sig = str.lookupLabel("Leak 95")) || (sig = str.lookupLabel("Leak.95"))) {
-                float gain = sig->gain * 60.0;
-                R.leak95 = EventDataType(sig->data[rec]) * gain;
-            }
-            if ((sig = str.lookupLabel("RespRate.50")) || (sig = str.lookupLabel("RR Med"))) {
-                R.rr50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("RespRate.Max")) || (sig = str.lookupLabel("RR Max"))) {
-                R.rrmax = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("RespRate.95")) || (sig = str.lookupLabel("RR 95"))) {
-                R.rr95 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("MinVent.50")) || (sig = str.lookupLabel("Min Vent Med"))) {
-                R.mv50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("MinVent.Max")) || (sig = str.lookupLabel("Min Vent Max"))) {
-                R.mvmax = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("MinVent.95")) || (sig = str.lookupLabel("Min Vent 95"))) {
-                R.mv95 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("TidVol.50")) || (sig = str.lookupLabel("Tid Vol Med"))) {
-                R.tv50 = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
-            }
-            if ((sig = str.lookupLabel("TidVol.Max")) || (sig = str.lookupLabel("Tid Vol Max"))) {
-                R.tvmax = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
-            }
-            if ((sig = str.lookupLabel("TidVol.95")) || (sig = str.lookupLabel("Tid Vol 95"))) {
-                R.tv95 = EventDataType(sig->data[rec]) * (sig->gain*1000.0);
-            }
+    if ((sig = maxPS[psvar])) {
+        R.max_ps = STRValue(sig, rec);
+    }
+    if ((sig = minPS[psvar])) {
+        R.min_ps = STRValue(sig, rec);
+    }
 
-            if ((sig = str.lookupLabel("MaskPress.50")) || (sig = str.lookupLabel("Mask Pres Med"))) {
-                R.mp50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("MaskPress.Max")) || (sig = str.lookupLabel("Mask Pres Max"))) {
-                R.mpmax = EventDataType(sig->data[rec]) * sig->gain ;
-            }
-            if ((sig = str.lookupLabel("MaskPress.95")) || (sig = str.lookupLabel("Mask Pres 95"))) {
-                R.mp95 = EventDataType(sig->data[rec]) * sig->gain ;
-            }
+    if (cpapmode == MODE_ASV_VARIABLE_EPAP) {
+        R.min_ipap = R.min_epap + R.min_ps;
+        R.max_ipap = R.max_epap + R.max_ps;
+    } else if (cpapmode == MODE_ASV) {
+        R.min_ipap = R.epap + R.min_ps;
+        R.max_ipap = R.epap + R.max_ps;
+    }
 
-            if ((sig = str.lookupLabel("TgtEPAP.50")) || (sig = str.lookupLabel("Exp Pres Med"))) {
-                R.tgtepap50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("TgtEPAP.Max")) || (sig = str.lookupLabel("Exp Pres Max"))) {
-                R.tgtepapmax = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("TgtEPAP.95")) || (sig = str.lookupLabel("Exp Pres 95"))) {
-                R.tgtepap95 = EventDataType(sig->data[rec]) * sig->gain;
-            }
+    EventDataType eprval = -1, epr_level = -1;
+    bool a10 = false;
+    if ((cpapmode == MODE_CPAP) || (cpapmode == MODE_APAP)) {
+        if ((sig = epr)) {
+            eprval = STRValue(sig, rec);
+        }
+        if ((sig = eprLevel)) {
+            epr_level = STRValue(sig, rec);
+        }
 
-            if ((sig = str.lookupLabel("TgtIPAP.50")) || (sig = str.lookupLabel("Insp Pres Med"))) {
-                R.tgtipap50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("TgtIPAP.Max")) || (sig = str.lookupLabel("Insp Pres Max"))) {
-                R.tgtipapmax = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("TgtIPAP.95")) || (sig = str.lookupLabel("Insp Pres 95"))) {
-                R.tgtipap95 = EventDataType(sig->data[rec]) * sig->gain;
-            }
+        if ((sig = eprType)) {
+            a10 = true;
+            eprval = STRValue(sig, rec);
+            eprval += 1;
+        }
+        int epr_on=0, clin_epr_on=0;
+        if ((sig = eprEnable)) { // first check machines opinion
+            a10 = true;
+            epr_on = STRValue(sig, rec);
+        }
+        if (epr_on && (sig = clinEnable)) {
+            a10 = true;
+            clin_epr_on = STRValue(sig, rec);
+        }
+        if (a10 && !(epr_on && clin_epr_on)) {
+            eprval = 0;
+            epr_level = 0;
+        }
+    }
 
-            if ((sig = str.lookupLabel("I:E Med"))) {
-                R.ie50 = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("I:E Max"))) {
-                R.iemax = EventDataType(sig->data[rec]) * sig->gain;
-            }
-            if ((sig = str.lookupLabel("I:E 95"))) {
-                R.ie95 = EventDataType(sig->data[rec]) * sig->gain;
+    if ((eprval >= 0) && (epr_level >= 0)) {
+        R.epr_level = epr_level;
+        R.epr = eprval;
+    } else {
+        if (eprval >= 0) {
+            static QAtomicInt warn(0);
+            if (warn.testAndSetRelaxed(0, 1)) { // just nag once
+                qDebug() << "If you can read this, please tell Jedimark you found a ResMed with EPR but no EPR_LEVEL so he can remove this warning";
             }
 
-            bool haveipap = false;
-//                if (R.mode == MODE_BILEVEL_FIXED) {
-                if ((sig = str.lookupSignal(CPAP_IPAP))) {
-                    R.ipap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    haveipap = true;
-                }
+            R.epr = (eprval > 0) ? 1 : 0;
+            R.epr_level = eprval;
+        } else if (epr_level >= 0) {
+            R.epr_level = epr_level;
+            R.epr = (epr_level > 0) ? 1 : 0;
+        }
+    }
 
-                if ((sig = str.lookupSignal(CPAP_EPAP))) {
-                    R.epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
+    if ((sig = ahi)) {
+        R.ahi = STRValue(sig, rec);
+    }
+    if ((sig = ai)) {
+        R.ai = STRValue(sig, rec);
+    }
+    if ((sig = hi)) {
+        R.hi = STRValue(sig, rec);
+    }
+    if ((sig = uai)) {
+        R.uai = STRValue(sig, rec);
+    }
+    if ((sig = cai)) {
+        R.cai = STRValue(sig, rec);
+    }
+    if ((sig = oai)) {
+        R.oai = STRValue(sig, rec);
+    }
+    if ((sig = csr)) {
+        R.csr = STRValue(sig, rec);
+    }
 
+    if ((sig = rampTime)) {
+        R.s_RampTime = STRValue(sig, rec);
+    }
+    if ((sig = rampEnable)) {
+        R.s_RampEnable = STRValue(sig, rec);
+    }
+    if ((sig = clinEnable)) {
+        R.s_EPR_ClinEnable = STRValue(sig, rec);
+    }
+    if ((sig = eprEnable)) {
+        R.s_EPREnable = STRValue(sig, rec);
+    }
 
-            if (R.mode == MODE_ASV) {
-                if ((sig = str.lookupLabel("S.AV.StartPress"))) {
-                    EventDataType sp = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    R.ramp_pressure = sp;
-                }
-                if ((sig = str.lookupLabel("S.AV.EPAP"))) {
-                    R.min_epap = R.max_epap = R.epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
+    if ((sig = abFilter)) {
+        R.s_ABFilter = STRValue(sig, rec);
+    }
 
-                }
-                if ((sig = str.lookupLabel("S.AV.MinPS"))) {
-                    R.min_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if ((sig = str.lookupLabel("S.AV.MaxPS"))) {
-                    R.max_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    R.max_ipap = R.epap + R.max_ps;
-                    R.min_ipap = R.epap + R.min_ps;
-                }
-            }
-            if (R.mode == MODE_ASV_VARIABLE_EPAP) {
-                if ((sig = str.lookupLabel("S.AA.StartPress"))) {
-                    EventDataType sp = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    R.ramp_pressure = sp;
-                }
-                if ((sig = str.lookupLabel("S.AA.MinEPAP"))) {
-                    R.min_epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if ((sig = str.lookupLabel("S.AA.MaxEPAP"))) {
-                    R.max_epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if ((sig = str.lookupLabel("S.AA.MinPS"))) {
-                    R.min_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if ((sig = str.lookupLabel("S.AA.MaxPS"))) {
-                    R.max_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    R.max_ipap = R.max_epap + R.max_ps;
-                    R.min_ipap = R.min_epap + R.min_ps;
-                }
-            }
+    if ((sig = climateControl)) {
+        R.s_ClimateControl = STRValue(sig, rec);
+    }
 
-            if ((sig = str.lookupSignal(CPAP_PressureMax))) {
-                R.max_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupSignal(CPAP_PressureMin))) {
-                R.min_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupSignal(RMS9_SetPressure))) {
-                R.set_pressure = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+    if ((sig = mask)) {
+        R.s_Mask = STRValue(sig, rec);
+    }
+    if ((sig = ptAccess)) {
+        R.s_PtAccess = STRValue(sig, rec);
+    }
+    if ((sig = smartStart)) {
+        R.s_SmartStart = STRValue(sig, rec);
+    }
+    if ((sig = humEnable)) {
+        R.s_HumEnable = STRValue(sig, rec);
+    }
+    if ((sig = humLevel)) {
+        R.s_HumLevel = STRValue(sig, rec);
+    }
+    if ((sig = tempEnable)) {
+        R.s_TempEnable = STRValue(sig, rec);
+    }
+    if ((sig = temp)) {
+        R.s_Temp = STRValue(sig, rec);
+    }
+    if ((sig = tube)) {
+        R.s_Tube = STRValue(sig, rec);
+    }
+    return true;
+}
 
-            if ((sig = str.lookupSignal(CPAP_EPAPHi))) {
-                R.max_epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupSignal(CPAP_EPAPLo))) {
-                R.min_epap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+void STRParseTask::run()
+{
+    QDate day = date.addDays(first);
 
-            if ((sig = str.lookupSignal(CPAP_IPAPHi))) {
-                R.max_ipap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                haveipap = true;
-            }
-            if ((sig = str.lookupSignal(CPAP_IPAPLo))) {
-                R.min_ipap = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                haveipap = true;
-            }
-            if ((sig = str.lookupSignal(CPAP_PS))) {
-                R.ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
+    for (int rec = first; rec < last; ++rec, day = day.addDays(1)) {
+        if (loader->isAborted()) break;
+
+        if (!skip->contains(day)) {
+            STRRecord R;
+            if (sigs->read(rec, day, R)) {
+                records.append(R);
             }
-            //  }
+        }
+        progress->ref();
+    }
+}
 
+// Returns true if date's sessions from mach are already imported with STR settings, so its STR record has nothing to add
+static bool STRAlreadyImported(Machine *mach, const QDate & date)
+{
+    Day * day = p_profile->FindDay(date, MT_CPAP);
+    return day && day->hasMachine(mach) && !day->summaryOnly(mach) && !day->noSettings(mach);
+}
 
-            // Okay, problem here: THere are TWO PSMin & MAX values on the 36037 with the same string
-            // One is for ASV mode, and one is for ASVAuto
-            int psvar = (mode == MODE_ASV_VARIABLE_EPAP) ? 1 : 0;
+// Days of STR records each parse task takes on
+const int STR_records_per_task = 64;
 
-            if ((sig = str.lookupLabel("Max PS", psvar))) {
-                R.max_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("Min PS", psvar))) {
-                R.min_ps = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+// This function parses a list of STR files and creates a date ordered map of individual records
+void ResmedLoader::ParseSTR(Machine *mach, QMap<QDate, STRFile> & STRmap)
+{
+    QDateTime ignoreBefore = p_profile->session->ignoreOlderSessionsDate();
+    bool ignoreOldSessions = p_profile->session->ignoreOlderSessions();
 
-            if (!haveipap) {
-            }
+    // Look the signals up once per file, and work out up front which days aren't needed
+    QList<STRSignals> signalTables;
+    QSet<QDate> skip;
+    QList<STRParseTask *> tasks;
+    QAtomicInt progress(0);
 
-            if (mode == MODE_ASV_VARIABLE_EPAP) {
-                R.min_ipap = R.min_epap + R.min_ps;
-                R.max_ipap = R.max_epap + R.max_ps;
-            } else if (mode == MODE_ASV) {
-                R.min_ipap = R.epap + R.min_ps;
-                R.max_ipap = R.epap + R.max_ps;
-            }
+    int totalRecs = 0;
+    for (auto it=STRmap.begin(), end=STRmap.end(); it != end; ++it) {
+        STRFile & file = it.value();
+        ResMedEDFParser & str = *file.edf;
+        totalRecs += str.GetNumDataRecords();
+    }
 
-            EventDataType epr = -1, epr_level = -1;
-            bool a10 = false;
-            if ((mode == MODE_CPAP) || (mode == MODE_APAP)) {
-                if ((sig = str.lookupSignal(RMS9_EPR))) {
-                    epr= EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if ((sig = str.lookupSignal(RMS9_EPRLevel))) {
-                    epr_level= EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
+    emit updateMessage("Parsing STR.edf records...");
+    emit setProgressMax(totalRecs);
+    QCoreApplication::processEvents();
 
-                if ((sig = str.lookupLabel("S.EPR.EPRType"))) {
-                    a10 = true;
-                    epr = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                    epr += 1;
-                }
-                int epr_on=0, clin_epr_on=0;
-                if ((sig = str.lookupLabel("S.EPR.EPREnable"))) { // first check machines opinion
-                    a10 = true;
-                    epr_on = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if (epr_on && (sig = str.lookupLabel("S.EPR.ClinEnable"))) {
-                    a10 = true;
-                    clin_epr_on = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-                }
-                if (a10 && !(epr_on && clin_epr_on)) {
-                    epr = 0;
-                    epr_level = 0;
-                }
-            }
+    // QList stores these by pointer, so the tasks' pointers stay valid as more are added
+    for (auto it=STRmap.begin(), end=STRmap.end(); it != end; ++it) {
+        STRFile & file = it.value();
+        ResMedEDFParser & str = *file.edf;
 
-            if ((epr >= 0) && (epr_level >= 0)) {
-                R.epr_level = epr_level;
-                R.epr = epr;
-            } else {
-                if (epr >= 0) {
-                    static bool warn=false;
-                    if (!warn) { // just nag once
-                        qDebug() << "If you can read this, please tell Jedimark you found a ResMed with EPR but no EPR_LEVEL so he can remove this warning";
-                        warn = true;
-                    }
+        QDate date = str.startdate_orig.date(); // each STR.edf record starts at 12 noon
+        int size = str.GetNumDataRecords();
 
-                    R.epr = (epr > 0) ? 1 : 0;
-                    R.epr_level = epr;
-                } else if (epr_level >= 0) {
-                    R.epr_level = epr_level;
-                    R.epr = (epr_level > 0) ? 1 : 0;
-                }
-            }
+        qDebug() << "Parsing" << file.filename << date << size << str.GetNumSignals();
 
-            if ((sig = str.lookupLabel("AHI"))) {
-                R.ahi = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("AI"))) {
-                R.ai = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("HI"))) {
-                R.hi = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("UAI"))) {
-                R.uai = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("CAI"))) {
-                R.cai = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("OAI"))) {
-                R.oai = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("CSR"))) {
-                R.csr = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+        signalTables.append(STRSignals(str));
+        const STRSignals * sigs = &signalTables.last();
 
-            if ((sig = str.lookupLabel("S.RampTime"))) {
-                R.s_RampTime = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.RampEnable"))) {
-                R.s_RampEnable = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.EPR.ClinEnable"))) {
-                R.s_EPR_ClinEnable = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.EPR.EPREnable"))) {
-                R.s_EPREnable = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+        if (!sigs->maskon || !sigs->maskoff) {
+            qDebug() << "No mask on/off signals in" << file.filename;
+            totalRecs -= size;
+            continue;
+        }
 
-            if ((sig = str.lookupLabel("S.ABFilter"))) {
-                R.s_ABFilter = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
+        QDate day = date;
+        for (int rec = 0; rec < size; ++rec, day = day.addDays(1)) {
+            if ((ignoreOldSessions && (day < ignoreBefore.date())) || STRAlreadyImported(mach, day)) {
+                skip.insert(day);
             }
+        }
 
-            if ((sig = str.lookupLabel("S.ClimateControl"))) {
-                R.s_ClimateControl = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
+        for (int rec = 0; rec < size; rec += STR_records_per_task) {
+            tasks.append(new STRParseTask(this, sigs, date, rec, qMin(rec + STR_records_per_task, size), &skip, &progress));
+        }
+    }
+    emit setProgressMax(totalRecs);
 
-            if ((sig = str.lookupLabel("S.Mask"))) {
-                R.s_Mask = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.PtAccess"))) {
-                R.s_PtAccess = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.SmartStart"))) {
-                R.s_SmartStart = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.HumEnable"))) {
-                R.s_HumEnable = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.HumLevel"))) {
-                R.s_HumLevel = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.TempEnable"))) {
-                R.s_TempEnable = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.Temp"))) {
-                R.s_Temp = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
-            }
-            if ((sig = str.lookupLabel("S.Tube"))) {
-                R.s_Tube = EventDataType(sig->data[rec]) * sig->gain + sig->offset;
+    if (AppSetting->multithreading()) {
+        QThreadPool pool;
+        for (int i=0; i < tasks.size(); ++i) {
+            tasks.at(i)->setAutoDelete(false);
+            pool.start(tasks.at(i));
+        }
+        while (!pool.waitForDone(50)) {
+            emit setProgressValue(progress.load());
+            QCoreApplication::processEvents();
+        }
+    } else {
+        for (int i=0; i < tasks.size(); ++i) {
+            if (isAborted()) break;
+            tasks.at(i)->run();
+            emit setProgressValue(progress.load());
+            QCoreApplication::processEvents();
+        }
+    }
+    emit setProgressValue(progress.load());
+
+    // Merge in file then record order, so the first file with a day's record keeps it as before
+    for (int i=0; i < tasks.size(); ++i) {
+        STRParseTask * task = tasks.at(i);
+        for (const auto & R : task->records) {
+            if (!resdayList.contains(R.date)) {
+                resdayList[R.date].str = R;
             }
         }
+        delete task;
     }
 }
 
@@ -944,7 +1081,7 @@ EDFduration getEDFDuration(const QString & filename)
 ///////////////////////////////////////////////////////////////////////////////////////////
 // Sorted EDF files that need processing into date records according to ResMed noon split
 ///////////////////////////////////////////////////////////////////////////////////////////
-int ResmedLoader::scanFiles(Machine * mach, const QString & datalog_path)
+int ResmedLoader::scanFiles(Machine * mach, const QString & datalog_path, BackupEngine & backups)
 {
     QTime time;
 
@@ -1070,7 +1207,10 @@ int ResmedLoader::scanFiles(Machine * mach, const QString & datalog_path)
         }
         QString fullpath = fi.filePath();
 
-        QString newpath = create_backups ? backup(fullpath, backup_path) : fullpath;
+        // The backup is written in the background, so the import reads the card's copy
+        if (create_backups) {
+            backup(fullpath, backup_path, backups);
+        }
 
 
         // Accept only .edf and .edf.gz files
@@ -1094,7 +1234,7 @@ int ResmedLoader::scanFiles(Machine * mach, const QString & datalog_path)
         ResMedDay & resday = rd.value();
 
         if (!resday.files.contains(filename)) {
-            resday.files[filename] = newpath;
+            resday.files[filename] = fullpath;
         }
     }
 #ifdef DEBUG_EFFICIENCY
@@ -1300,6 +1440,38 @@ struct OverlappingEDF {
     Session * sess;
 };
 
+// Opens and parses one of a day's EDF files, so they can all be read at once
+class ResEDFParseTask : public QRunnable
+{
+  public:
+    ResEDFParseTask(ResmedLoader * loader, const QString & path) : loader(loader), path(path), ok(false) {}
+    virtual void run() { ok = loader->OpenEDF(edf, path); }
+
+    ResmedLoader * loader;
+    QString path;
+    ResMedEDFParser edf;
+    bool ok;
+};
+
+// BRP signals at least this long get converted alongside each other (an hour of 25Hz flow is 90000)
+const long BRP_parallel_samples = 65536;
+
+// Fills one BRP waveform's EventList from its EDF signal
+class ResWaveformTask : public QRunnable
+{
+  public:
+    ResWaveformTask(EventList * el, EDFSignal * es, ChannelID code, qint64 start, long recs, qint64 duration)
+        : el(el), es(es), code(code), start(start), recs(recs), duration(duration) {}
+    virtual void run() { el->AddWaveform(start, es->data, recs, duration); }
+
+    EventList * el;
+    EDFSignal * es;
+    ChannelID code;
+    qint64 start;
+    long recs;
+    qint64 duration;
+};
+
 void ResDayTask::run()
 {
 //    if (this->resday->date == QDate(2016,1,6)) {
@@ -1468,30 +1640,72 @@ void ResDayTask::run()
 
     if (overlaps.size()==0) return;
 
+    // EVE and CSL files cover the whole day, so each is parsed once up front and applied to every session
+    QHash<QString, ResEDFParseTask *> parsed;
+    bool anydata = false;
+
+    for (const auto & ovr : overlaps) {
+        if (ovr.filemap.size() > 0) {
+            anydata = true;
+            break;
+        }
+    }
+    if (anydata) {
+        SubTaskGroup parsers;
+        for (const auto & filename : EVElist) {
+            parsed[filename] = new ResEDFParseTask(loader, resday->files[filename]);
+        }
+        for (const auto & filename : CSLlist) {
+            parsed[filename] = new ResEDFParseTask(loader, resday->files[filename]);
+        }
+        for (auto task : parsed) {
+            parsers.add(task);
+        }
+        parsers.run();
+    }
+
     // Now overlaps is populated with zero or more individual session groups of EDF files (zero because of sucky summary only days)
     for (auto & ovr : overlaps) {
         if (ovr.filemap.size() == 0) continue;
         Session * sess = new Session(mach, ovr.start);
         ovr.sess = sess;
 
+        // Parse this session's signal files side by side on whatever threads are idle, so no more
+        // than one session's signal data is held at once. Filling in the Session stays on this thread,
+        // as Session isn't thread safe.
+        QHash<QString, ResEDFParseTask *> sessparsed;
+        SubTaskGroup parsers;
+
+        for (const auto & filename : ovr.filemap) {
+            EDFType type = lookupEDFType(filename.section("_", -1).section(".",0,0).toUpper());
+            if (((type == EDF_BRP) || (type == EDF_PLD) || (type == EDF_SAD)) && !sessparsed.contains(filename)) {
+                ResEDFParseTask * task = new ResEDFParseTask(loader, resday->files[filename]);
+                sessparsed[filename] = task;
+                parsers.add(task);
+            }
+        }
+        parsers.run();
+
         for (auto mit=ovr.filemap.begin(), mend=ovr.filemap.end(); mit != mend; ++mit) {
             const QString & filename = mit.value();
-            const QString & fullpath = resday->files[filename];
             QString ext = filename.section("_", -1).section(".",0,0).toUpper();
             EDFType type = lookupEDFType(ext);
 
 #ifdef SESSION_DEBUG
             sess->session_files.append(filename);
 #endif
+            ResEDFParseTask * edf = sessparsed.take(filename);
+            bool ok = edf && edf->ok;
+
             switch (type) {
             case EDF_BRP:
-                loader->LoadBRP(sess, fullpath);
+                if (ok) loader->LoadBRP(sess, edf->edf);
                 break;
             case EDF_PLD:
-                loader->LoadPLD(sess, fullpath);
+                if (ok) loader->LoadPLD(sess, edf->edf);
                 break;
             case EDF_SAD:
-                loader->LoadSAD(sess, fullpath);
+                if (ok) loader->LoadSAD(sess, edf->edf);
                 break;
             case EDF_EVE:
             case EDF_CSL:
@@ -1499,17 +1713,20 @@ void ResDayTask::run()
             default:
                 qWarning() << "Unrecognized file type for" << filename;
             }
+
+            // Freed as soon as it's loaded
+            delete edf;
         }
 
         // Turns out there is only one or sometimes two EVE's per day, and they store data for the whole day
         // So we have to extract Annotations data and apply it for all sessions
         for (auto eit=EVElist.begin(), eveend=EVElist.end(); eit != eveend; ++eit) {
-            const QString & fullpath = resday->files[eit.value()];
-            loader->LoadEVE(ovr.sess, fullpath);
+            ResEDFParseTask * edf = parsed.value(eit.value());
+            if (edf && edf->ok) loader->LoadEVE(ovr.sess, edf->edf);
         }
         for (auto eit=CSLlist.begin(), cslend=CSLlist.end(); eit != cslend; ++eit) {
-            const QString & fullpath = resday->files[eit.value()];
-            loader->LoadCSL(ovr.sess, fullpath);
+            ResEDFParseTask * edf = parsed.value(eit.value());
+            if (edf && edf->ok) loader->LoadCSL(ovr.sess, edf->edf);
         }
 
         if (EVElist.size() == 0) {
@@ -1591,6 +1808,7 @@ void ResDayTask::run()
         sess->TrashEvents();
 
     }
+    qDeleteAll(parsed);
 }
 
 int ResmedLoader::Open(const QString & dirpath)
@@ -1727,6 +1945,10 @@ int ResmedLoader::Open(const QString & dirpath)
         create_backups = false;
     }
 
+    // Card files are copied into the backup folder in the background while the import carries on,
+    // and anything already backed up is skipped. It's waited for when this returns.
+    BackupEngine backups(backup_path);
+
     ///////////////////////////////////////////////////////////////////////////////////
     // Parse the idmap into machine objects properties, (overwriting any old values)
     ///////////////////////////////////////////////////////////////////////////////////
@@ -1803,28 +2025,9 @@ int ResmedLoader::Open(const QString & dirpath)
 
             backupfile = compress_backups ? gzfile : nongzfile;
 
-            if (!QFile::exists(backupfile)) {
-                if (filename.endsWith(STR_ext_gz,Qt::CaseInsensitive)) {
-                    if (compress_backups) {
-                        QFile::copy(filename, backupfile);
-                    } else {
-                        uncompressFile(filename, backupfile);
-                    }
-                } else {
-                    if (compress_backups) {
-                        // already compressed, keep it.
-                        compressFile(filename, backupfile);
-                    } else {
-                        QFile::copy(filename, backupfile);
-                    }
-                }
-            }
-            // Remove any duplicate compressed/uncompressed
-            if (compress_backups) {
-                QFile::exists(nongzfile) && QFile::remove(nongzfile);
-            } else {
-                QFile::exists(gzfile) && QFile::remove(gzfile);
-            }
+            // Removing any duplicate compressed/uncompressed once it's done
+            backups.queue(filename, backupfile, BackupEngine::modeFor(filename, compress_backups),
+                          QStringList() << (compress_backups ? nongzfile : gzfile));
 
 
             STRmap[date] = STRFile(backupfile, stredf);
@@ -1896,14 +2099,15 @@ int ResmedLoader::Open(const QString & dirpath)
             }
         }
 
-        compress_backups ? compressFile(path + "STR.edf", backup_path + "STR.edf.gz") : QFile::copy(path + "STR.edf", backup_path + "STR.edf");
+        backups.queue(path + "STR.edf", backup_path + (compress_backups ? "STR.edf.gz" : "STR.edf"),
+                      compress_backups ? BACKUP_Compress : BACKUP_Copy);
 
         // Copy Identification files to backup folder
-        QFile::copy(path + RMS9_STR_idfile + STR_ext_TGT, backup_path + RMS9_STR_idfile + STR_ext_TGT);
-        QFile::copy(path + RMS9_STR_idfile + STR_ext_CRC, backup_path + RMS9_STR_idfile + STR_ext_CRC);
+        backups.queue(path + RMS9_STR_idfile + STR_ext_TGT, backup_path + RMS9_STR_idfile + STR_ext_TGT);
+        backups.queue(path + RMS9_STR_idfile + STR_ext_CRC, backup_path + RMS9_STR_idfile + STR_ext_CRC);
 
         // Meh.. these can be calculated if ever needed for ResScan SDcard export
-        QFile::copy(path + "STR.crc", backup_path + "STR.crc");
+        backups.queue(path + "STR.crc", backup_path + "STR.crc");
     }
 
 
@@ -1920,7 +2124,7 @@ int ResmedLoader::Open(const QString & dirpath)
 
     if (isAborted()) return 0;
 
-    scanFiles(mach, newpath);
+    scanFiles(mach, newpath, backups);
     if (isAborted()) return 0;
 
     // Now at this point we have resdayList populated with processable summary and EDF files data
@@ -2035,7 +2239,7 @@ int ResmedLoader::Open(const QString & dirpath)
 }
 
 
-QString ResmedLoader::backup(const QString & fullname, const QString & backup_path)
+QString ResmedLoader::backup(const QString & fullname, const QString & backup_path, BackupEngine & backups)
 {
     QDir dir;
     QString filename, yearstr, newname, oldname;
@@ -2064,57 +2268,59 @@ QString ResmedLoader::backup(const QString & fullname, const QString & backup_pa
 
     newname = newpath+"/"+filename;
 
-    QString tmpname = newname;
-
     QString newnamegz = newname + STR_ext_gz;
     QString newnamenogz = newname;
 
     newname = compress ? newnamegz : newnamenogz;
 
-    // First make sure the correct backup exists in the right place
-    if (!QFile::exists(newname)) {
-        if (compress) {
-            // If input file is already compressed.. copy it to the right location, otherwise compress it
-            gz ? QFile::copy(fullname, newname) : compressFile(fullname, newname);
-        } else {
-            // If inputs a gz, uncompress it, otherwise copy is raw
-            gz ? uncompressFile(fullname, newname) : QFile::copy(fullname, newname);
-        }
-    } // else backup already exists... good.
-
-    // Now the correct backup is in place, we can trash any
-    if (compress) {
-        // Remove any uncompressed duplicate
-        QFile::exists(newnamenogz) && QFile::remove(newnamenogz);
-    } else {
-        // Delete the non compressed copy and choose it instead.
-        QFile::exists(newnamegz) && QFile::remove(newnamegz);
-    }
-
     // Used to store it under Backup\Datalog
-    // Remove any traces from old backup directory structure
     oldname = backup_path + RMS9_STR_datalog + "/" + filename;
-    QFile::exists(oldname) && QFile::remove(oldname);
-    QFile::exists(oldname + STR_ext_gz) && QFile::remove(oldname + STR_ext_gz);
+
+    // Once the correct backup is in place, trash any duplicate in the other format,
+    // and any traces from the old backup directory structure
+    QStringList obsolete;
+    obsolete << (compress ? newnamenogz : newnamegz) << oldname << (oldname + STR_ext_gz);
+
+    backups.queue(fullname, newname, BackupEngine::modeFor(fullname, compress), obsolete);
 
     return newname;
 }
 
-bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
+bool ResmedLoader::OpenEDF(ResMedEDFParser & edf, const QString & path)
 {
 #ifdef DEBUG_EFFICIENCY
     QTime time;
     time.start();
 #endif
-    ResMedEDFParser edf(path);
+    bool ok = edf.Open(path);
 #ifdef DEBUG_EFFICIENCY
     int edfopentime = time.elapsed();
     time.start();
 #endif
-    if (!edf.Parse())
-        return false;
+    ok = ok && edf.Parse();
 #ifdef DEBUG_EFFICIENCY
     int edfparsetime = time.elapsed();
+    timeMutex.lock();
+    timeInEDFOpen += edfopentime;
+    timeInEDFParser += edfparsetime;
+    timeMutex.unlock();
+#endif
+    return ok;
+}
+
+bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
+{
+    ResMedEDFParser edf;
+    if (!OpenEDF(edf, path))
+        return false;
+
+    return LoadCSL(sess, edf);
+}
+
+bool ResmedLoader::LoadCSL(Session *sess, ResMedEDFParser & edf)
+{
+#ifdef DEBUG_EFFICIENCY
+    QTime time;
     time.start();
 #endif
 
@@ -2256,8 +2462,6 @@ bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
 #ifdef DEBUG_EFFICIENCY
     timeMutex.lock();
     timeInLoadCSL += time.elapsed();
-    timeInEDFOpen += edfopentime;
-    timeInEDFParser += edfparsetime;
     timeMutex.unlock();
 #endif
 
@@ -2266,19 +2470,17 @@ bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
 {
-#ifdef DEBUG_EFFICIENCY
-    QTime time;
-    time.start();
-#endif
-    ResMedEDFParser edf(path);
-#ifdef DEBUG_EFFICIENCY
-    int edfopentime = time.elapsed();
-    time.start();
-#endif
-    if (!edf.Parse())
+    ResMedEDFParser edf;
+    if (!OpenEDF(edf, path))
         return false;
+
+    return LoadEVE(sess, edf);
+}
+
+bool ResmedLoader::LoadEVE(Session *sess, ResMedEDFParser & edf)
+{
 #ifdef DEBUG_EFFICIENCY
-    int edfparsetime = time.elapsed();
+    QTime time;
     time.start();
 #endif
 
@@ -2429,8 +2631,6 @@ bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
 #ifdef DEBUG_EFFICIENCY
     timeMutex.lock();
     timeInLoadEVE += time.elapsed();
-    timeInEDFOpen += edfopentime;
-    timeInEDFParser += edfparsetime;
     timeMutex.unlock();
 #endif
 
@@ -2439,19 +2639,17 @@ bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadBRP(Session *sess, const QString & path)
 {
-#ifdef DEBUG_EFFICIENCY
-    QTime time;
-    time.start();
-#endif
-    ResMedEDFParser edf(path);
-#ifdef DEBUG_EFFICIENCY
-    int edfopentime = time.elapsed();
-    time.start();
-#endif
-    if (!edf.Parse())
+    ResMedEDFParser edf;
+    if (!OpenEDF(edf, path))
         return false;
+
+    return LoadBRP(sess, edf);
+}
+
+bool ResmedLoader::LoadBRP(Session *sess, ResMedEDFParser & edf)
+{
 #ifdef DEBUG_EFFICIENCY
-    int edfparsetime = time.elapsed();
+    QTime time;
     time.start();
     int AddWavetime = 0;
 #endif
@@ -2461,6 +2659,8 @@ bool ResmedLoader::LoadBRP(Session *sess, const QString & path)
     qint64 duration = edf.GetNumDataRecords() * edf.GetDuration();
     sess->updateLast(edf.startdate + duration);
 
+    QList<ResWaveformTask *> waveforms;
+
     for (auto & es : edf.edfsignals) {
         long recs = es.nr * edf.GetNumDataRecords();
         if (recs < 0)
@@ -2489,33 +2689,47 @@ bool ResmedLoader::LoadBRP(Session *sess, const QString & path)
             double rate = double(duration) / double(recs);
             EventList *a = sess->AddEventList(code, EVL_Waveform, es.gain, es.offset, 0, 0, rate);
             a->setDimension(es.physical_dimension);
+
+            waveforms.append(new ResWaveformTask(a, &es, code, edf.startdate, recs, duration));
+        }
+    }
+
+    // Session isn't thread safe, but filling separate EventLists is, so the long
+    // signals are converted side by side and the short ones are left to this thread
 #ifdef DEBUG_EFFICIENCY
-            time2.start();
+    time2.start();
 #endif
-            a->AddWaveform(edf.startdate, es.data, recs, duration);
+    SubTaskGroup group;
+    for (auto w : waveforms) {
+        if (w->recs >= BRP_parallel_samples) {
+            group.add(w);
+        } else {
+            w->run();
+        }
+    }
+    group.run();
 #ifdef DEBUG_EFFICIENCY
-            AddWavetime+= time2.elapsed();
+    AddWavetime += time2.elapsed();
 #endif
 
-            EventDataType min = a->Min();
-            EventDataType max = a->Max();
+    for (auto w : waveforms) {
+        EventDataType min = w->el->Min();
+        EventDataType max = w->el->Max();
 
-            // Cap to physical dimensions, because there can be ram glitches/whatever that throw really big outliers.
-            if (min < es.physical_minimum) min = es.physical_minimum;
-            if (max > es.physical_maximum) max = es.physical_maximum;
+        // Cap to physical dimensions, because there can be ram glitches/whatever that throw really big outliers.
+        if (min < w->es->physical_minimum) min = w->es->physical_minimum;
+        if (max > w->es->physical_maximum) max = w->es->physical_maximum;
 
-            sess->setMin(code, min);
-            sess->setMax(code, max);
-            sess->setPhysMin(code, es.physical_minimum);
-            sess->setPhysMax(code, es.physical_maximum);
-        }
+        sess->setMin(w->code, min);
+        sess->setMax(w->code, max);
+        sess->setPhysMin(w->code, w->es->physical_minimum);
+        sess->setPhysMax(w->code, w->es->physical_maximum);
     }
+    qDeleteAll(waveforms);
 
 #ifdef DEBUG_EFFICIENCY
     timeMutex.lock();
     timeInLoadBRP += time.elapsed();
-    timeInEDFOpen += edfopentime;
-    timeInEDFParser += edfparsetime;
     timeInAddWaveform += AddWavetime;
     timeMutex.unlock();
 #endif
@@ -2540,112 +2754,63 @@ void ResmedLoader::ToTimeDelta(Session *sess, ResMedEDFParser &edf, EDFSignal &e
     double rate = (duration / recs); // milliseconds per record
     double tt = edf.startdate;
 
-    EventStoreType c=0, last;
-
     int startpos = 0;
 
     if ((code == CPAP_Pressure) || (code == CPAP_IPAP) || (code == CPAP_EPAP)) {
         startpos = 20; // Shave the first 20 seconds of pressure data
-        tt += rate * startpos;
     }
 
-    qint16 *sptr = es.data;
-    qint16 *eptr = sptr + recs;
-    sptr += startpos;
+    const qint16 *data = es.data;
+    EventDataType gain = es.gain;
 
     EventDataType min = t_max, max = t_min, tmp;
 
     EventList *el = nullptr;
 
     if (recs > startpos + 1) {
+        bool found = false;
 
-        // Prime last with a good starting value
-        do {
-            last = *sptr++;
-            tmp = EventDataType(last) * es.gain;
-
-            if ((tmp >= t_min) && (tmp <= t_max)) {
-                min = tmp;
-                max = tmp;
-                el = sess->AddEventList(code, EVL_Event, es.gain, es.offset, 0, 0);
-
-                el->AddEvent(tt, last);
-                tt += rate;
-
-                break;
+        // Each run of in-range samples goes into its own EventList, added in one go by AddStepSignal
+        long i = startpos;
+        while (i < recs) {
+            // Out of bounds values are dropped, and split the signal
+            for (; i < recs; ++i) {
+                tmp = EventDataType(data[i]) * gain;
+                if ((tmp >= t_min) && (tmp <= t_max)) break;
             }
+            if (i >= recs) break;
 
-            tt += rate;
-
-        } while (sptr < eptr);
-
-        if (!el) {
-            return;
-        }
-
-        for (; sptr < eptr; sptr++) {
-            c = *sptr;
-
-            if (last != c) {
-                if (square) {
-                    tmp = EventDataType(last) * es.gain;
-
-                    if ((tmp >= t_min) && (tmp <= t_max)) {
-                        if (tmp < min) {
-                            min = tmp;
-                        }
-
-                        if (tmp > max) {
-                            max = tmp;
-                        }
-
-                        el->AddEvent(tt, last);
-                    } else {
-                        // Out of bounds value, start a new eventlist
-                        if (el->count() > 1) {
-                            // that should be in session, not the eventlist.. handy for debugging though
-                            el->setDimension(es.physical_dimension);
-
-                            el = sess->AddEventList(code, EVL_Event, es.gain, es.offset, 0, 0);
-                        } else {
-                            el->clear(); // reuse the object
-                        }
-                    }
-                }
-
-                tmp = EventDataType(c) * es.gain;
+            found = true;
+            long segstart = i;
+            bool changes = false;
 
-                if ((tmp >= t_min) && (tmp <= t_max)) {
-                    if (tmp < min) {
-                        min = tmp;
-                    }
+            for (; i < recs; ++i) {
+                tmp = EventDataType(data[i]) * gain;
+                if ((tmp < t_min) || (tmp > t_max)) break;
 
-                    if (tmp > max) {
-                        max = tmp;
-                    }
-
-                    el->AddEvent(tt, c);
-                } else {
-                    if (el->count() > 1) {
-                        el->setDimension(es.physical_dimension);
-
-                        // Create and attach new EventList
-                        el = sess->AddEventList(code, EVL_Event, es.gain, es.offset, 0, 0);
-                    } else { el->clear(); }
-                }
+                if (tmp < min) min = tmp;
+                if (tmp > max) max = tmp;
+                changes |= (data[i] != data[segstart]);
             }
 
-            tt += rate;
+            // The last run is closed off at the end of the signal. Square ones are closed where they stop too,
+            // and short of that, a run that never changes value isn't worth keeping.
+            bool toend = (i >= recs);
+            if (!toend && !square && !changes) {
+                continue;
+            }
 
-            last = c;
+            el = sess->AddEventList(code, EVL_Event, es.gain, es.offset, 0, 0);
+            el->setDimension(es.physical_dimension);
+            el->AddStepSignal(qint64(tt + rate * segstart), rate, data + segstart, i - segstart, square, square || toend);
         }
 
-        tmp = EventDataType(c) * es.gain;
-
-        if ((tmp >= t_min) && (tmp <= t_max)) {
-            el->AddEvent(tt, c);
+        if (!found) {
+            return;
         }
 
+        tt += rate * recs;
+
         sess->setMin(code, min);
         sess->setMax(code, max);
         sess->setPhysMin(code, es.physical_minimum);
@@ -2678,19 +2843,17 @@ void ResmedLoader::ToTimeDelta(Session *sess, ResMedEDFParser &edf, EDFSignal &e
 // Load SAD Oximetry Signals
 bool ResmedLoader::LoadSAD(Session *sess, const QString & path)
 {
-#ifdef DEBUG_EFFICIENCY
-    QTime time;
-    time.start();
-#endif
-    ResMedEDFParser edf(path);
-#ifdef DEBUG_EFFICIENCY
-    int edfopentime = time.elapsed();
-    time.start();
-#endif
-    if (!edf.Parse())
+    ResMedEDFParser edf;
+    if (!OpenEDF(edf, path))
         return false;
+
+    return LoadSAD(sess, edf);
+}
+
+bool ResmedLoader::LoadSAD(Session *sess, ResMedEDFParser & edf)
+{
 #ifdef DEBUG_EFFICIENCY
-    int edfparsetime = time.elapsed();
+    QTime time;
     time.start();
 #endif
 
@@ -2734,8 +2897,6 @@ bool ResmedLoader::LoadSAD(Session *sess, const QString & path)
 #ifdef DEBUG_EFFICIENCY
     timeMutex.lock();
     timeInLoadSAD += time.elapsed();
-    timeInEDFOpen += edfopentime;
-    timeInEDFParser += edfparsetime;
     timeMutex.unlock();
 #endif
     return true;
@@ -2744,19 +2905,17 @@ bool ResmedLoader::LoadSAD(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadPLD(Session *sess, const QString & path)
 {
-#ifdef DEBUG_EFFICIENCY
-    QTime time;
-    time.start();
-#endif
-    ResMedEDFParser edf(path);
-#ifdef DEBUG_EFFICIENCY
-    int edfopentime = time.elapsed();
-    time.start();
-#endif
-    if (!edf.Parse())
+    ResMedEDFParser edf;
+    if (!OpenEDF(edf, path))
         return false;
+
+    return LoadPLD(sess, edf);
+}
+
+bool ResmedLoader::LoadPLD(Session *sess, ResMedEDFParser & edf)
+{
 #ifdef DEBUG_EFFICIENCY
-    int edfparsetime = time.elapsed();
+    QTime time;
     time.start();
 #endif
 
@@ -2894,8 +3053,6 @@ bool ResmedLoader::LoadPLD(Session *sess, const QString & path)
 #ifdef DEBUG_EFFICIENCY
     timeMutex.lock();
     timeInLoadPLD += time.elapsed();
-    timeInEDFOpen += edfopentime;
-    timeInEDFParser += edfparsetime;
     timeMutex.unlock();
 #endif
 
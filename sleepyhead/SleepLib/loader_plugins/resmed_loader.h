@@ -10,10 +10,12 @@
 #define RESMED_LOADER_H
 
 #include <QVector>
+#include <QSet>
 #include "SleepLib/machine.h" // Base class: MachineLoader
 #include "SleepLib/machine_loader.h"
 #include "SleepLib/profiles.h"
 #include "SleepLib/loader_plugins/edfparser.h"
+#include "SleepLib/backupengine.h"
 
 //********************************************************************************************
 /// IMPORTANT!!!
@@ -358,6 +360,67 @@ struct STRFile {
     ResMedEDFParser * edf;
 };
 
+/*! \struct STRSignals
+    \brief The STR.edf signals ParseSTR reads, looked up by name once per file instead of for every record.
+    Any signal the file doesn't have is null. */
+struct STRSignals
+{
+    STRSignals(ResMedEDFParser & str);
+
+    //! \brief Fills R from record rec, which covers the day starting at noon on date. Returns false if there was no mask time that day.
+    bool read(int rec, const QDate & date, STRRecord & R) const;
+
+    EDFSignal *maskon, *maskoff, *mode;
+    EDFSignal *cStartPress, *asStartPress, *blStartPress, *vaStartPress;
+    EDFSignal *maskDur;
+    EDFSignal *leak50, *leakMax, *leak95;
+    EDFSignal *rr50, *rrMax, *rr95;
+    EDFSignal *mv50, *mvMax, *mv95;
+    EDFSignal *tv50, *tvMax, *tv95;
+    EDFSignal *mp50, *mpMax, *mp95;
+    EDFSignal *epap50, *epapMax, *epap95;
+    EDFSignal *ipap50, *ipapMax, *ipap95;
+    EDFSignal *ie50, *ieMax, *ie95;
+    EDFSignal *ipap, *epap;
+    EDFSignal *avStartPress, *avEPAP, *avMinPS, *avMaxPS;
+    EDFSignal *aaStartPress, *aaMinEPAP, *aaMaxEPAP, *aaMinPS, *aaMaxPS;
+    EDFSignal *pressureMax, *pressureMin, *setPressure;
+    EDFSignal *epapHi, *epapLo, *ipapHi, *ipapLo, *ps;
+
+    //! \brief Indexed by whether the mode is ASV with variable EPAP, which has its own pair with the same names
+    EDFSignal *maxPS[2], *minPS[2];
+
+    EDFSignal *epr, *eprLevel, *eprType, *eprEnable, *clinEnable;
+    EDFSignal *ahi, *ai, *hi, *uai, *cai, *oai, *csr;
+    EDFSignal *rampTime, *rampEnable, *abFilter, *climateControl, *mask, *ptAccess;
+    EDFSignal *smartStart, *humEnable, *humLevel, *tempEnable, *temp, *tube;
+};
+
+/*! \class STRParseTask
+    \brief Reads a range of STR.edf day records on a worker thread, for ParseSTR to merge in file order */
+class STRParseTask:public QRunnable
+{
+public:
+    STRParseTask(ResmedLoader * l, const STRSignals * sigs, QDate date, int first, int last, const QSet<QDate> * skip, QAtomicInt * progress) :
+        loader(l), sigs(sigs), date(date), first(first), last(last), skip(skip), progress(progress) {}
+    virtual ~STRParseTask() {}
+    virtual void run();
+
+    ResmedLoader * loader;
+    const STRSignals * sigs;
+
+    //! \brief Date of the file's first record
+    QDate date;
+    int first, last;
+
+    //! \brief Dates not worth reading
+    const QSet<QDate> * skip;
+    QAtomicInt * progress;
+
+    //! \brief The days in the range that had mask time, in record order
+    QList<STRRecord> records;
+};
+
 /*class ResmedImport:public ImportTask
 {
 public:
@@ -442,6 +505,16 @@ class ResmedLoader : public CPAPLoader
     //! This contains the Pressure, Leak, Respiratory Rate, Minute Ventilation, Tidal Volume, etc..
     bool LoadPLD(Session *sess, const QString & path);
 
+    //! \brief The same Load functions, for EDF files that have already been opened and parsed
+    bool LoadEVE(Session *sess, ResMedEDFParser & edf);
+    bool LoadCSL(Session *sess, ResMedEDFParser & edf);
+    bool LoadBRP(Session *sess, ResMedEDFParser & edf);
+    bool LoadSAD(Session *sess, ResMedEDFParser & edf);
+    bool LoadPLD(Session *sess, ResMedEDFParser & edf);
+
+    //! \brief Opens and parses the EDF file at path into edf. Safe to call from several threads at once.
+    bool OpenEDF(ResMedEDFParser & edf, const QString & path);
+
     virtual MachineInfo newInfo() {
         return MachineInfo(MT_CPAP, 0, resmed_class_name, QObject::tr("ResMed"), QString(), QString(), QString(), QObject::tr("S9"), QDateTime::currentDateTime(), resmed_data_version);
     }
@@ -467,9 +540,10 @@ protected:
 
 
     //! \brief Scan for new files to import, group into sessions and add to task que
-    int scanFiles(Machine * mach, const QString & datalog_path);
+    int scanFiles(Machine * mach, const QString & datalog_path, BackupEngine & backups);
 
-    QString backup(const QString & file, const QString & backup_path);
+    //! \brief Queues an EDF file's backup into the year folder, returning the path it's backed up to
+    QString backup(const QString & file, const QString & backup_path, BackupEngine & backups);
 
     QMap<SessionID, QStringList> sessfiles;
     QMap<quint32, STRRecord> strsess;
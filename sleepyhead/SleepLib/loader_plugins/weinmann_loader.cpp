@@ -353,6 +353,10 @@ int WeinmannLoader::Open(const QString & dirpath)
         EventList * H = sess->AddEventList(CPAP_Hypopnea, EVL_Event);
         EventList * FL = sess->AddEventList(CPAP_FlowLimit, EVL_Event);
 //        EventList * VS = sess->AddEventList(CPAP_VSnore, EVL_Event);
+
+        // Events are gathered for the whole session and added to each list in one go
+        EventBuffer oabuf, abuf, hbuf, flbuf;
+
         quint64 tt = ti;
         quint64 step = sess->length() / ci.event_recs;
         unsigned char *p = &ev[ci.event_start];
@@ -370,13 +374,13 @@ int WeinmannLoader::Open(const QString & dirpath)
             EventStoreType data = p[4] | p[5] << 8;
 
             if (evcode == '@') {
-                OA->AddEvent(ts,data/10.0);
+                oabuf.add(ts,data/10.0);
             } else if (evcode =='A') {
-                A->AddEvent(ts,data/10.0);
+                abuf.add(ts,data/10.0);
             } else if (evcode == 'F') {
-                FL->AddEvent(ts,data/10.0);
+                flbuf.add(ts,data/10.0);
             } else if (evcode == '*') {
-                H->AddEvent(ts,data/10.0);
+                hbuf.add(ts,data/10.0);
             }
 /*            switch (evcode) {
             case 0x03:
@@ -456,6 +460,10 @@ int WeinmannLoader::Open(const QString & dirpath)
             tt += step;
             p += 6;
         }
+        oabuf.commit(OA);
+        abuf.commit(A);
+        hbuf.commit(H);
+        flbuf.commit(FL);
 
         sess->UpdateSummaries();
         mach->AddSession(sess);
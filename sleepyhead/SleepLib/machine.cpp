@@ -225,7 +225,36 @@ QDate Machine::pickDate(qint64 first)
     return date;
 }
 
+NewSession::NewSession(Session * sess)
+    : sess(sess), first(sess->first()), summaryonly(sess->summaryOnly()), start(QDateTime::fromTime_t(first / 1000))
+{
+    QTime split_time;
+    int combine_sessions;
+    sess->machine()->daySplit(summaryonly, split_time, combine_sessions);
+
+    date = start.date();
+    if (start.time() < split_time) {
+        date = date.addDays(-1);
+    }
+}
+
+void Machine::daySplit(bool summaryonly, QTime & split_time, int & combine_sessions)
+{
+    if (profile->session->lockSummarySessions() && summaryonly) {
+        split_time = QTime(12,0,0);
+        combine_sessions = 0;
+    } else {
+        split_time = profile->session->daySplitTime();
+        combine_sessions = profile->session->combineCloseSessions();
+    }
+}
+
 bool Machine::AddSession(Session *s)
+{
+    return AddSession(s, s ? QDateTime::fromTime_t(s->first() / 1000) : QDateTime());
+}
+
+bool Machine::AddSession(Session *s, const QDateTime & start)
 {
     if (s == nullptr) {
         qCritical() << "AddSession() called with a null object";
@@ -255,13 +284,7 @@ bool Machine::AddSession(Session *s)
     int combine_sessions;
     bool locksessions = profile->session->lockSummarySessions();
 
-    if (locksessions) {
-        split_time = s->summaryOnly() ? QTime(12,0,0) : profile->session->daySplitTime();
-        combine_sessions = s->summaryOnly() ? 0 : profile->session->combineCloseSessions();
-    } else {
-        split_time = profile->session->daySplitTime();
-        combine_sessions = profile->session->combineCloseSessions();
-    }
+    daySplit(s->summaryOnly(), split_time, combine_sessions);
 
     int ignore_sessions = profile->session->ignoreShortSessions();
 
@@ -272,7 +295,7 @@ bool Machine::AddSession(Session *s)
 
     //int drift=profile->cpap->clockDrift();
 
-    QDateTime d2 = QDateTime::fromTime_t(s->first() / 1000);
+    const QDateTime & d2 = start;
 
     QDate date = d2.date();
     QTime time = d2.time();
@@ -373,6 +396,141 @@ bool Machine::AddSession(Session *s)
     return true;
 }
 
+// Finds the first or last session time of date, as Day::first() or Day::last() would, counting the
+// sessions AddSessions() has picked it for but not yet added. Returns false if date has no day at all
+static bool dayEdge(const QMap<QDate, Day *> & days, const QMap<QDate, QList<Session *> > & pending,
+                    QDate date, bool first, qint64 & edge)
+{
+    auto dit = days.find(date);
+    auto pit = pending.find(date);
+
+    if ((dit == days.end()) && (pit == pending.end())) {
+        return false;
+    }
+
+    edge = 0;
+    if (dit != days.end()) {
+        edge = first ? dit.value()->first() : dit.value()->last();
+    }
+
+    if (pit != pending.end()) {
+        for (const auto & sess : pit.value()) {
+            if ((sess->type() == MT_JOURNAL) || !sess->enabled()) continue;
+
+            qint64 tmp = first ? sess->first() : sess->last();
+            if (!tmp) continue;
+
+            if (!edge || (first ? (tmp < edge) : (tmp > edge))) {
+                edge = tmp;
+            }
+        }
+    }
+    return true;
+}
+
+void Machine::AddSessions(const QVector<NewSession> & sessions)
+{
+    if (profile == nullptr) {
+        qCritical() << "AddSessions() called without a valid profile";
+        return;
+    }
+
+    // Sessions picked for each day, not yet added to its Day record
+    QMap<QDate, QList<Session *> > pending;
+
+    // Puts the pending sessions into their days, in date order, creating and filling each Day once
+    auto place = [&]() {
+        for (auto pit = pending.begin(), pend = pending.end(); pit != pend; ++pit) {
+            auto dit = day.find(pit.key());
+            if (dit == day.end()) {
+                dit = day.insert(pit.key(), profile->addDay(pit.key()));
+            }
+            dit.value()->addSessions(pit.value());
+        }
+        pending.clear();
+    };
+
+    bool ignoreolder = profile->session->ignoreOlderSessions();
+    qint64 ignorebefore = ignoreolder ? profile->session->ignoreOlderSessionsDate().toMSecsSinceEpoch() : 0;
+    int ignore_sessions = profile->session->ignoreShortSessions();
+
+    for (const auto & handed : sessions) {
+        Session * s = handed.sess;
+
+        // Loaders may still have changed the session after handing it over
+        NewSession ns = ((s->first() == handed.first) && (s->summaryOnly() == handed.summaryonly)) ? handed : NewSession(s);
+
+        // What follows picks the same day AddSession() does, looking at the pending days as well as the day records
+        if (ignoreolder && (s->last() < ignorebefore)) {
+            skipped_sessions++;
+            continue;
+        }
+
+        QTime split_time;
+        int combine_sessions;
+        daySplit(s->summaryOnly(), split_time, combine_sessions);
+
+        const QDateTime & d2 = ns.start;
+        QDate date = ns.date;
+        QTime time = d2.time();
+
+        if (!(time < split_time) && (combine_sessions > 0)) {
+            qint64 edge;
+            if (dayEdge(day, pending, date.addDays(-1), false, edge)) { // Check Day Before
+                QDateTime lt = QDateTime::fromTime_t(edge / 1000);
+                int closest_session = lt.secsTo(d2) / 60;
+
+                if (closest_session < combine_sessions) {
+                    date = date.addDays(-1);
+                } else if ((split_time < time) && (split_time.secsTo(time) < 2)) {
+                    if (s->machine()->loaderName() == STR_MACH_ResMed) {
+                        date = date.addDays(-1);
+                    }
+                }
+            } else if (dayEdge(day, pending, date.addDays(1), true, edge)) { // Check Day Afterwards
+                QDateTime lt = QDateTime::fromTime_t(edge / 1000);
+                int closest_session = d2.secsTo(lt) / 60;
+
+                if (closest_session < combine_sessions) {
+                    // Pulling the next day's sessions back moves ones already placed, which AddSession() does
+                    place();
+                    AddSession(s, ns.start);
+                    continue;
+                }
+            }
+        }
+
+        updateChannels(s);
+
+        if (s->session() > highest_sessionid) {
+            highest_sessionid = s->session();
+        }
+
+        sessionlist[s->session()] = s; // To make sure it get's saved later even if it's not wanted.
+
+        int session_length = s->last() - s->first();
+        session_length /= 60000;
+
+        if (session_length < ignore_sessions) {
+            // keep the session to save importing it again, but don't add it to the day record this time
+            continue;
+        }
+
+        if (!firstsession) {
+            if (firstday > date) { firstday = date; }
+
+            if (lastday < date) { lastday = date; }
+        } else {
+            firstday = lastday = date;
+            firstsession = false;
+        }
+
+        pending[date].append(s);
+    }
+
+    place();
+}
+
 bool Machine::unlinkDay(Day * d)
 {
     return day.remove(day.key(d)) > 0;
@@ -393,6 +551,9 @@ QPixmap & Machine::getPixmap()
 
 bool Machine::unlinkSession(Session * sess)
 {
+    // Nothing in the background may still be reading the Day records this changes
+    Profile::cancelDayReaders();
+
     MachineType mt = sess->type();
 
     // Remove the object from the machine object's session list
@@ -417,6 +578,7 @@ bool Machine::unlinkSession(Session * sess)
     for (int i=0; i < days.size(); ++i) {
         d = days.at(i);
         if (d->sessions.removeAll(sess)) {
+            d->invalidate();
             b=true;
             if (!d->searchMachine(mt)) {
                 d->machines.remove(mt);
@@ -595,7 +757,7 @@ qint64 Machine::diskSpaceBackups()
     return dirSize(getBackupPath());
 }
 
-bool Machine::Load(ProgressDialog *progress)
+bool Machine::Load(ProgressDialog *progress, MachineLoadTask *preloaded)
 {
     QString path = getDataPath();
 
@@ -616,7 +778,17 @@ bool Machine::Load(ProgressDialog *progress)
         mainwin->connect(loader(), SIGNAL(setProgressValue(int)), progress, SLOT(setProgressValue(int)));
     }
 
-    if (!LoadSummary(progress)) {
+    bool loaded;
+    if (preloaded) {
+        loaded = preloaded->ok;
+        if (loaded) {
+            addSummarySessions(preloaded->sessions);
+        }
+    } else {
+        loaded = LoadSummary(progress);
+    }
+
+    if (!loaded) {
         // No XML index file, so assume upgrading, or it simply just got screwed up or deleted...
         progress->setMessage(QObject::tr("Scanning Files"));
         progress->setProgressValue(0);
@@ -948,17 +1120,42 @@ void LoadTask::run()
     sess->LoadSummary();
 }
 
-bool Machine::LoadSummary(ProgressDialog * progress)
+MachineLoadTask::~MachineLoadTask()
+{
+    qDeleteAll(sessions);
+}
+
+void MachineLoadTask::run()
 {
     QTime time;
     time.start();
+
+    ok = mach->readSummaryIndex(sessions);
+    if (!ok) return;
+
+    if (mach->profile->session->preloadSummaries()) {
+        // Spread the summary files over whatever threads the other machines leave idle
+        QList<LoadTask *> tasks;
+        SubTaskGroup group;
+        for (auto & sess : sessions) {
+            LoadTask * task = new LoadTask(sess, mach);
+            tasks.append(task);
+            group.add(task);
+        }
+        group.run();
+        qDeleteAll(tasks);
+    }
+
+    qDebug() << "Loaded" << mach->info.series.toLocal8Bit().data() << mach->info.model.toLocal8Bit().data() << "data in" << time.elapsed() << "ms";
+}
+
+bool Machine::readSummaryIndex(QMap<qint64, Session *> & sessions)
+{
     QString filename = getDataPath() + summaryFileName + ".gz";
 
     QDomDocument doc;
     QFile file(filename);
     qDebug() << "Loading" << filename.toLocal8Bit().data();
-    progress->setMessage(QObject::tr("Loading Summaries.xml.gz"));
-    QApplication::processEvents();
 
     if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "Could not open" << filename;
@@ -999,14 +1196,7 @@ bool Machine::LoadSummary(ProgressDialog * progress)
 
     int size = sessionlist.size();
 
-    QMap<qint64, Session *>  sess_order;
-
-    progress->setProgressMax(size);
     for (int s=0; s < size; ++s) {
-        if ((s % 20) == 0) {
-            progress->setProgressValue(s);
-            QApplication::processEvents();
-        }
         node = sessionlist.at(s);
         QDomElement e = node.toElement();
         SessionID sessid = e.attribute("id", "0").toLong(&s_ok);
@@ -1018,7 +1208,7 @@ bool Machine::LoadSummary(ProgressDialog * progress)
             Session * sess = new Session(this, sessid);
             sess->really_set_first(first);
             sess->really_set_last(last);
-            sess->setEnabled(enabled);
+            sess->really_set_enabled(enabled);
             sess->setSummaryOnly(!events);
 
             if (e.hasChildNodes()) {
@@ -1052,51 +1242,35 @@ bool Machine::LoadSummary(ProgressDialog * progress)
             }
 
 
-            sess_order[first] = sess;
+            sessions[first] = sess;
         }
     }
-    QMap<qint64, Session *>::iterator it_end = sess_order.end();
-    QMap<qint64, Session *>::iterator it;
-    int cnt = 0;
-    bool loadSummaries = profile->session->preloadSummaries();
-
-    //progress->setMessage(QObject::tr("Queueing Open Tasks"));
-    //QApplication::processEvents();
-
-  //  progress->setMaximum(sess_order.size());
-    for (it = sess_order.begin(); it != it_end; ++it, ++cnt) {
-        //
-/*        if ((cnt % 100) == 0) {
-            progress->setValue(cnt);
-            //QApplication::processEvents();
-        } */
-        Session * sess = it.value();
+    return true;
+}
+
+void Machine::addSummarySessions(QMap<qint64, Session *> & sessions)
+{
+    for (auto & sess : sessions) {
         if (!AddSession(sess)) {
             delete sess;
-        } else {
-            if (loadSummaries) {
-                if (loader()) {
-                    loader()->queTask(new LoadTask(sess,this));
-                } else {
-                    // no progress bar
-                    queTask(new LoadTask(sess,this));
-                }
-            }
         }
     }
-    progress->setMessage(QObject::tr("Loading Summary Data"));
-    QApplication::processEvents();
+    sessions.clear();
+}
 
-    if (loader()) {
-        loader()->runTasks();
-    } else {
-        runTasks();
-    }
-    progress->setProgressValue(sess_order.size());
+bool Machine::LoadSummary(ProgressDialog * progress)
+{
+    progress->setMessage(QObject::tr("Loading Summaries.xml.gz"));
     QApplication::processEvents();
 
-    qDebug() << "Loaded" << info.series.toLocal8Bit().data() << info.model.toLocal8Bit().data() << "data in" << time.elapsed() << "ms";
+    MachineLoadTask task(this);
+    task.run();
+
+    if (!task.ok) {
+        return false;
+    }
 
+    addSummarySessions(task.sessions);
     return true;
 }
 
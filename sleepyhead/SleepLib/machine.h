@@ -67,6 +67,49 @@ public:
     virtual void run() {}
 };
 
+/*! \class MachineLoadTask
+    \brief Reads a Machine's summary index, and preloads its Session summaries, on a worker thread,
+           so Profile::LoadMachineData can work on several machines at once
+    */
+class MachineLoadTask : public QRunnable
+{
+  public:
+    MachineLoadTask(Machine * mach) : mach(mach), ok(false) {}
+    //! \brief Deletes any Sessions that weren't claimed by Machine::Load
+    virtual ~MachineLoadTask();
+
+    virtual void run();
+
+    Machine * mach;
+
+    //! \brief False if there was no usable summary index, and the summary files have to be scanned instead
+    bool ok;
+
+    //! \brief The Sessions read, ordered by start time, not yet added to any Day
+    QMap<qint64, Session *> sessions;
+};
+
+/*! \struct NewSession
+    \brief A Session handed over by a loader thread, with its start converted to local time and its day
+           worked out as far as it can be without looking at other days
+    */
+struct NewSession
+{
+    NewSession() : sess(nullptr), first(0), summaryonly(false) {}
+    NewSession(Session * sess);
+
+    Session * sess;
+
+    //! \brief The sess->first() and sess->summaryOnly() the rest was worked out from
+    qint64 first;
+    bool summaryonly;
+
+    QDateTime start;
+
+    //! \brief The day start falls in going by the day split time alone. Combining close sessions may still move it
+    QDate date;
+};
+
 class MachineLoader;
 /*! \class Machine
     \brief This Machine class is the Heart of SleepyLib, representing a single Machine and holding it's data
@@ -75,6 +118,7 @@ class MachineLoader;
 class Machine
 {
     friend class SaveThread;
+    friend class MachineLoadTask;
     friend class MachineLaoder;
 
   public:
@@ -87,10 +131,18 @@ class Machine
     virtual ~Machine();
 
     //! \brief Load all Machine summary data
-    bool Load(ProgressDialog *progress);
+    //! \brief Loads this machine's data. If preloaded is given, its Sessions are used instead of reading the summary index again
+    bool Load(ProgressDialog *progress, MachineLoadTask *preloaded = nullptr);
 
     bool LoadSummary(ProgressDialog *progress);
 
+    //! \brief Reads the summary index into new Sessions, keyed by start time. Touches nothing shared, so it is safe on a worker thread
+    bool readSummaryIndex(QMap<qint64, Session *> & sessions);
+
+    //! \brief Adds Sessions read by readSummaryIndex to their Days in start time order, deleting any that aren't wanted.
+    //! Takes ownership of them all, leaving sessions empty
+    void addSummarySessions(QMap<qint64, Session *> & sessions);
+
     //! \brief Save all Sessions where changed bit is set.
     bool Save();
     bool SaveSummaryCache();
@@ -129,6 +181,16 @@ class Machine
     //! \brief Adds the session to this machine object, and the Master Profile list. (used during load)
     bool AddSession(Session *s);
 
+    //! \brief As above, with the session's first() already converted to local time, as loader threads do ahead of time
+    bool AddSession(Session *s, const QDateTime & start);
+
+    /*! \brief Adds sessions, in SessionID order, to the days AddSession() would pick for them one at a time.
+        Days are picked first, then each Day is created and filled once, in date order */
+    void AddSessions(const QVector<NewSession> & sessions);
+
+    //! \brief Returns the day split time, and the close sessions combining (in minutes), that apply to a session
+    void daySplit(bool summaryonly, QTime & split_time, int & combine_sessions);
+
     //! \brief Find the date this session belongs in, according to profile settings
     QDate pickDate(qint64 start);
 
@@ -10,6 +10,10 @@
 #include <QFile>
 #include <QDir>
 #include <QThreadPool>
+#include <QMutexLocker>
+#include <QHash>
+
+#include <algorithm>
 
 #include "machine_loader.h"
 
@@ -84,15 +88,108 @@ MachineLoader::~MachineLoader()
 {
 }
 
+void MachineLoader::addSession(Session * sess)
+{
+    // The local time conversion and split time bucketing are done here, on the calling worker
+    NewSession ns(sess);
+
+    SessionBufferSlot & slot = m_sessionslot.localData();
+    int generation = m_buffergeneration.load();
+
+    if ((slot.buffer == nullptr) || (slot.generation != generation)) {
+        // First session this thread hands over in this batch
+        slot.buffer = new QVector<NewSession>;
+        slot.generation = generation;
+
+        QMutexLocker locker(&sessionMutex);
+        m_sessionbuffers.append(slot.buffer);
+    }
+
+    slot.buffer->append(ns);
+}
+
+static bool sessionIdLess(const NewSession & a, const NewSession & b)
+{
+    return a.sess->session() < b.sess->session();
+}
+
+/*! \class SessionSortTask
+    \brief Sorts one loader thread's NewSession buffer by session ID
+    */
+class SessionSortTask : public QRunnable
+{
+  public:
+    SessionSortTask(QVector<NewSession> * buffer) : buffer(buffer) { setAutoDelete(false); }
+
+    virtual void run() {
+        std::stable_sort(buffer->begin(), buffer->end(), sessionIdLess);
+    }
+
+  protected:
+    QVector<NewSession> * buffer;
+};
+
 void MachineLoader::finishAddingSessions()
 {
-    // Using a map specifically so they are inserted in order.
-    for (auto it=new_sessions.begin(), end=new_sessions.end(); it != end; ++it) {
-        Session * sess = it.value();
-        Machine * mach = sess->machine();
-        mach->AddSession(sess);
+    QList<QVector<NewSession> *> buffers;
+    {
+        QMutexLocker locker(&sessionMutex);
+        buffers.swap(m_sessionbuffers);
+
+        // Any thread handing a session over from here on starts a fresh buffer
+        m_buffergeneration.fetchAndAddOrdered(1);
+    }
+
+    // Each thread's buffer is sorted on its own, in parallel
+    QList<SessionSortTask *> sorts;
+    SubTaskGroup group;
+    for (auto & buffer : buffers) {
+        SessionSortTask * task = new SessionSortTask(buffer);
+        sorts.append(task);
+        group.add(task);
+    }
+    group.run();
+    qDeleteAll(sorts);
+
+    // Then merged into session ID order. A session handed over more than once is only placed once
+    QVector<int> pos(buffers.size(), 0);
+    QHash<Machine *, QVector<NewSession> > permachine;
+    QList<Machine *> machines;
+
+    while (true) {
+        int best = -1;
+        for (int i = 0; i < buffers.size(); ++i) {
+            if (pos[i] >= buffers[i]->size()) continue;
+
+            if ((best < 0) || sessionIdLess(buffers[i]->at(pos[i]), buffers[best]->at(pos[best]))) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+
+        const NewSession & ns = buffers[best]->at(pos[best]++);
+        Machine * mach = ns.sess->machine();
+
+        auto it = permachine.find(mach);
+        if (it == permachine.end()) {
+            it = permachine.insert(mach, QVector<NewSession>());
+            machines.append(mach);
+        }
+
+        QVector<NewSession> & list = it.value();
+        if (!list.isEmpty() && (list.last().sess->session() == ns.sess->session())) {
+            list.last() = ns;
+        } else {
+            list.append(ns);
+        }
+    }
+    qDeleteAll(buffers);
+
+    // Placing sessions into days depends on the days already placed (close sessions are combined,
+    // and a following day can be pulled back), so each machine takes its sorted list in one go
+    for (auto & mach : machines) {
+        mach->AddSessions(permachine[mach]);
     }
-    new_sessions.clear();
 }
 
 bool uncompressFile(QString infile, QString outfile)
@@ -254,6 +351,73 @@ void MachineLoader::runTasks(bool threaded)
     }
 }
 
+// Lends a pool thread to a SubTaskGroup
+class SubTaskHelper : public QRunnable
+{
+  public:
+    SubTaskHelper(SubTaskGroup * group) : group(group) {}
+    virtual void run() {
+        group->work();
+
+        QMutexLocker locker(&group->m_mutex);
+        if (--group->m_helpers == 0) {
+            group->m_finished.wakeAll();
+        }
+    }
+  protected:
+    SubTaskGroup * group;
+};
+
+void SubTaskGroup::work()
+{
+    while (true) {
+        m_mutex.lock();
+        if (m_next >= m_tasks.size()) {
+            m_mutex.unlock();
+            return;
+        }
+        QRunnable * task = m_tasks.at(m_next++);
+        m_mutex.unlock();
+
+        task->run();
+    }
+}
+
+void SubTaskGroup::run()
+{
+    if (AppSetting->multithreading()) {
+        QThreadPool * threadpool = QThreadPool::globalInstance();
+
+        // The calling thread takes its share, so at most one helper per remaining task
+        for (int i = 1; i < m_tasks.size(); ++i) {
+            SubTaskHelper * helper = new SubTaskHelper(this);
+            helper->setAutoDelete(true);
+
+            m_mutex.lock();
+            m_helpers++;
+            m_mutex.unlock();
+
+            if (!threadpool->tryStart(helper)) {
+                // No idle threads left
+                delete helper;
+                m_mutex.lock();
+                m_helpers--;
+                m_mutex.unlock();
+                break;
+            }
+        }
+    }
+
+    work();
+
+    QMutexLocker locker(&m_mutex);
+    while (m_helpers > 0) {
+        m_finished.wait(&m_mutex);
+    }
+    m_tasks.clear();
+    m_next = 0;
+}
+
 
 QList<ChannelID> CPAPLoader::eventFlags(Day * day)
 {
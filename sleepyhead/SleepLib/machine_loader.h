@@ -10,7 +10,10 @@
 #define MACHINE_LOADER_H
 
 #include <QMutex>
+#include <QWaitCondition>
 #include <QRunnable>
+#include <QThreadStorage>
+#include <QAtomicInt>
 #include <QPixmap>
 
 
@@ -23,11 +26,53 @@
 #endif
 
 
+/*! \struct SessionBufferSlot
+    \brief A loader thread's own NewSession buffer, and the batch of sessions it was handed out for
+    */
+struct SessionBufferSlot
+{
+    SessionBufferSlot() : generation(-1), buffer(nullptr) {}
+
+    int generation;
+    QVector<NewSession> * buffer;
+};
+
 class MachineLoader;
 enum DeviceStatus { NEUTRAL, IMPORTING, LIVE, DETECTING };
 
 const QString genericPixmapPath = ":/icons/mask.png";
 
+/*! \class SubTaskGroup
+    \brief Runs a batch of QRunnables from within an ImportTask, on the calling thread plus any idle threads of the global pool.
+
+    Helpers are only taken with tryStart(), so while runTasks() still has ImportTasks queued up and every
+    thread is busy, the batch simply runs on the caller instead of piling more threads on top. The tasks
+    are not deleted, they still belong to the caller.
+    */
+class SubTaskGroup
+{
+    friend class SubTaskHelper;
+  public:
+    SubTaskGroup() : m_next(0), m_helpers(0) {}
+
+    //! \brief Adds task to the batch
+    void add(QRunnable * task) { m_tasks.append(task); }
+
+    //! \brief Runs all the tasks added, and returns once every one of them has finished
+    void run();
+
+  protected:
+    //! \brief Runs tasks off the batch until there are none left
+    void work();
+
+    QList<QRunnable *> m_tasks;
+    int m_next;
+    int m_helpers;
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+};
+
 
 /*! \class MachineLoader
     \brief Base class to derive a new Machine importer from
@@ -72,12 +117,8 @@ class MachineLoader: public QObject
 
     void queTask(ImportTask * task);
 
-    void addSession(Session * sess)
-    {
-        sessionMutex.lock();
-        new_sessions[sess->session()] = sess;
-        sessionMutex.unlock();
-    }
+    //! \brief Hands a new Session over to be placed into its day by finishAddingSessions(). Thread safe
+    void addSession(Session * sess);
 
     //! \brief Process Task list using all available threads.
     void runTasks(bool threaded=true);
@@ -134,8 +175,17 @@ protected:
 
     DeviceStatus m_status;
 
+    //! \brief Places every Session handed over since the last call into its machine's days, in session order
     void finishAddingSessions();
-    QMap<SessionID, Session *> new_sessions;
+
+    //! \brief Each loader thread's NewSession buffer for the current batch, so handing a session over takes no shared lock
+    QThreadStorage<SessionBufferSlot> m_sessionslot;
+
+    //! \brief Every buffer handed out for the current batch, guarded by sessionMutex
+    QList<QVector<NewSession> *> m_sessionbuffers;
+
+    //! \brief Bumped by finishAddingSessions(), so threads leave the buffers of an earlier batch alone
+    QAtomicInt m_buffergeneration;
 
     QHash<QString, QPixmap> m_pixmaps;
     QHash<QString, QString> m_pixmap_paths;
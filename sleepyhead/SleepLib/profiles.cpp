@@ -16,8 +16,12 @@
 #include <QHostInfo>
 #include <QApplication>
 #include <QSettings>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
 #include <algorithm>
 #include <cmath>
+#include <cfloat>
 
 #include "preferences.h"
 #include "profiles.h"
@@ -37,7 +41,8 @@ Profile *p_profile;
 Profile::Profile(QString path)
   : is_first_day(true),
      m_opened(false),
-     m_machopened(false)
+     m_machopened(false),
+     m_aggregates(this)
 {
     p_name = STR_GEN_Profile;
 
@@ -75,6 +80,7 @@ Profile::Profile(QString path)
 
 Profile::~Profile()
 {
+    cancelDayReaders();
     removeLock();
 
     delete user;
@@ -580,10 +586,13 @@ void Profile::UnloadMachineData()
         return;
     }
 
+    cancelDayReaders();
+
     for (auto & day : daylist) {
         delete day;
     }
     daylist.clear();
+    m_dayindex.clear();
 
     for (auto & mach : m_machlist) {
         mach->sessionlist.clear();
@@ -595,6 +604,40 @@ void Profile::LoadMachineData(ProgressDialog *progress)
 {
     addLock();
 
+    // Read every machine's summary index and summaries at once. Adding the Sessions to
+    // the day records still happens one machine after another, in the same order as before.
+    QHash<Machine *, MachineLoadTask *> preloaded;
+    QList<MachineLoadTask *> tasks;
+
+    for (auto & mach : m_machlist) {
+        MachineLoader *loader = lookupLoader(mach);
+        if (loader && (mach->version() < loader->Version())) {
+            continue;
+        }
+
+        MachineLoadTask * task = new MachineLoadTask(mach);
+        task->setAutoDelete(false);
+        tasks.append(task);
+        preloaded[mach] = task;
+    }
+
+    progress->setMessage(QObject::tr("Loading Summaries.xml.gz"));
+    QApplication::processEvents();
+
+    if (AppSetting->multithreading() && (tasks.size() > 1)) {
+        QThreadPool pool;
+        for (auto & task : tasks) {
+            pool.start(task);
+        }
+        while (!pool.waitForDone(50)) {
+            QApplication::processEvents();
+        }
+    } else {
+        for (auto & task : tasks) {
+            task->run();
+        }
+    }
+
     for (auto & mach : m_machlist) {
         MachineLoader *loader = lookupLoader(mach);
 
@@ -603,16 +646,17 @@ void Profile::LoadMachineData(ProgressDialog *progress)
                 DataFormatError(mach);
             } else {
                 try {
-                    mach->Load(progress);
+                    mach->Load(progress, preloaded.value(mach));
                 } catch (OldDBVersion& e) {
                     Q_UNUSED(e)
                     DataFormatError(mach);
                 }
             }
         } else {
-            mach->Load(progress);
+            mach->Load(progress, preloaded.value(mach));
         }
     }
+    qDeleteAll(tasks);
     progress->setMessage("Loading Channel Information");
     loadChannels();
 }
@@ -731,7 +775,8 @@ Day *Profile::addDay(QDate date)
 {
     auto dit = daylist.find(date);
     if (dit == daylist.end()) {
-        dit = daylist.insert(date, new Day());
+        dit = daylist.insert(date, new Day(this));
+        m_dayindex.insert(date, dit.value());
     }
     Day * day = dit.value();
     day->setDate(date);
@@ -755,47 +800,29 @@ Day *Profile::addDay(QDate date)
 // and has enabled session data, else return nullptr
 Day *Profile::GetGoodDay(QDate date, MachineType type)
 {
-    Day *day = GetDay(date, type);
-    if (!day)
+    // For a machine match, there must be at least one enabled Session.
+    if (!m_dayindex.isGood(date, type))
         return nullptr;
 
-    // For a machine match, find at least one enabled Session.
-
-    for (auto & sess : day->sessions) {
-        if (((type == MT_UNKNOWN) || (sess->type() == type)) && sess->enabled()) {
-            day->OpenSummary();
-            return day;
-        }
-    }
-
-    // No enabled Sessions were found.
-    return nullptr;
+    Day *day = m_dayindex.at(date);
+    day->OpenSummary();
+    return day;
 }
 
 Day *Profile::FindGoodDay(QDate date, MachineType type)
 {
-    Day *day = FindDay(date, type);
-    if (!day)
+    // For a machine match, there must be at least one enabled Session.
+    if (!m_dayindex.isGood(date, type))
         return nullptr;
 
-    // For a machine match, find at least one enabled Session.
-    for (auto & sess : day->sessions) {
-        if (((type == MT_UNKNOWN) || (sess->type() == type)) && sess->enabled()) {
-            return day;
-        }
-    }
-
-    // No enabled Sessions were found.
-    return nullptr;
+    return m_dayindex.at(date);
 }
 
 
 Day *Profile::GetDay(QDate date, MachineType type)
 {
-    auto di = daylist.find(date);
-    if (di == daylist.end()) return nullptr;
-
-    Day * day = di.value();
+    Day * day = m_dayindex.at(date);
+    if (!day) return nullptr;
 
     if (type == MT_UNKNOWN) {
         day->OpenSummary();
@@ -812,10 +839,8 @@ Day *Profile::GetDay(QDate date, MachineType type)
 
 Day *Profile::FindDay(QDate date, MachineType type)
 {
-    auto di = daylist.find(date);
-    if (di == daylist.end()) return nullptr;
-
-    Day * day = di.value();
+    Day * day = m_dayindex.at(date);
+    if (!day) return nullptr;
 
     if (type == MT_UNKNOWN) {
         return day; // just want the day record
@@ -928,11 +953,43 @@ Machine *Profile::GetMachine(MachineType t)
 
 //}
 
+void Profile::updateDayIndex(Day * day)
+{
+    if (day->date().isValid()) {
+        m_dayindex.update(day->date());
+    }
+}
+
+// Cancel functions of the background threads that read Day records
+static QList<void (*)()> dayReaders;
+static QMutex dayReadersMutex;
+
+void Profile::addDayReader(void (*cancel)())
+{
+    QMutexLocker locker(&dayReadersMutex);
+    if (!dayReaders.contains(cancel)) {
+        dayReaders.append(cancel);
+    }
+}
+
+void Profile::cancelDayReaders()
+{
+    QList<void (*)()> readers;
+    {
+        QMutexLocker locker(&dayReadersMutex);
+        readers = dayReaders;
+    }
+    for (auto cancel : readers) {
+        cancel();
+    }
+}
+
 bool Profile::unlinkDay(Day * day)
 {
     // Find the key...
     for (auto it = daylist.begin(), it_end = daylist.end(); it != it_end; ++it) {
         if (it.value() == day) {
+            m_dayindex.remove(it.key());
             daylist.erase(it);
             return true;
         }
@@ -1114,42 +1171,11 @@ void Scan()
 // Returns a list of all days records matching machine type between start and end date
 QList<Day *> Profile::getDays(MachineType mt, QDate start, QDate end)
 {
-    QList<Day *> list;
-
-    if (!start.isValid()) {
-        return list;
+    if (!start.isValid() || !end.isValid()) {
+        return QList<Day *>();
     }
 
-    if (!end.isValid()) {
-        return list;
-    }
-
-    QDate date = start;
-
-    if (date.isNull()) {
-        return list;
-    }
-
-    QMap<QDate, Day *>::iterator it;
-
-    do {
-        it = daylist.find(date);
-        if (it != daylist.end()) {
-            Day *day = it.value();
-            if (mt != MT_UNKNOWN) {
-                if (day->hasEnabledSessions(mt)) {
-                    list.push_back(day);
-                }
-            } else {
-                if (day->hasEnabledSessions()) {
-                    list.push_back(day);
-                }
-            }
-        }
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return list;
+    return m_dayindex.goodDays(mt, start, end);
 }
 
 int Profile::countDays(MachineType mt, QDate start, QDate end)
@@ -1162,26 +1188,7 @@ int Profile::countDays(MachineType mt, QDate start, QDate end)
         return 0;
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    int days = 0;
-
-    do {
-        Day *day = FindGoodDay(date, mt);
-
-        if (day) {
-            days++;
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return days;
-
+    return m_dayindex.count(mt, start, end);
 }
 
 int Profile::countCompliantDays(MachineType mt, QDate start, QDate end)
@@ -1196,25 +1203,7 @@ int Profile::countCompliantDays(MachineType mt, QDate start, QDate end)
         return 0;
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    int days = 0;
-
-    do {
-        Day *day = FindGoodDay(date, mt);
-
-        if (day) {
-            if (day->hours(mt) > compliance) { days++; }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return days;
+    return qRound(m_aggregates.sum(AggregateKey(AGG_CompliantDays, NoChannel, mt, compliance), start, end));
 }
 
 
@@ -1228,25 +1217,7 @@ EventDataType Profile::calcCount(ChannelID code, MachineType mt, QDate start, QD
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    double val = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->count(code);
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return m_aggregates.sum(AggregateKey(AGG_Count, code, mt), start, end);
 }
 
 double Profile::calcSum(ChannelID code, MachineType mt, QDate start, QDate end)
@@ -1259,21 +1230,7 @@ double Profile::calcSum(ChannelID code, MachineType mt, QDate start, QDate end)
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    double val = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->sum(code);
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return m_aggregates.sum(AggregateKey(AGG_Sum, code, mt), start, end);
 }
 
 EventDataType Profile::calcHours(MachineType mt, QDate start, QDate end)
@@ -1286,25 +1243,7 @@ EventDataType Profile::calcHours(MachineType mt, QDate start, QDate end)
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    double val = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->hours();
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return m_aggregates.sum(AggregateKey(AGG_Hours, NoChannel, mt), start, end);
 }
 
 EventDataType Profile::calcAboveThreshold(ChannelID code, EventDataType threshold, MachineType mt,
@@ -1318,25 +1257,7 @@ EventDataType Profile::calcAboveThreshold(ChannelID code, EventDataType threshol
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    EventDataType val = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->timeAboveThreshold(code, threshold);
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return m_aggregates.sum(AggregateKey(AGG_AboveThreshold, code, mt, threshold), start, end);
 }
 
 EventDataType Profile::calcBelowThreshold(ChannelID code, EventDataType threshold, MachineType mt,
@@ -1350,25 +1271,7 @@ EventDataType Profile::calcBelowThreshold(ChannelID code, EventDataType threshol
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    EventDataType val = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->timeBelowThreshold(code, threshold);
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return m_aggregates.sum(AggregateKey(AGG_BelowThreshold, code, mt, threshold), start, end);
 }
 
 Day * Profile::findSessionDay(Session * session)
@@ -1395,27 +1298,8 @@ EventDataType Profile::calcAvg(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    double val = 0;
-    int cnt = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_AVG)) {
-                val += day->sum(code);
-                cnt += day->count(code);
-            }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    double val, cnt;
+    m_aggregates.sum(AggregateKey(AGG_Avg, code, mt), start, end, val, cnt);
 
     if (!cnt) {
         return 0;
@@ -1434,28 +1318,8 @@ EventDataType Profile::calcWavg(ChannelID code, MachineType mt, QDate start, QDa
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    double val = 0, tmp, tmph, hours = 0;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_WAVG)) {
-                tmph = day->hours();
-                tmp = day->wavg(code);
-                val += tmp * tmph;
-                hours += tmph;
-            }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    double val, hours;
+    m_aggregates.sum(AggregateKey(AGG_Wavg, code, mt), start, end, val, hours);
 
     if (!hours) {
         return 0;
@@ -1475,38 +1339,12 @@ EventDataType Profile::calcMin(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
+    EventDataType min;
 
-    if (date.isNull()) {
+    if (!m_aggregates.extreme(AggregateKey(AGG_Min, code, mt), start, end, min)) {
         return 0;
     }
 
-    bool first = true;
-
-    double min = 0, tmp;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_MIN)) {
-                tmp = day->Min(code);
-
-                if (first || (min > tmp)) {
-                    min = tmp;
-                    first = false;
-                }
-            }
-
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    if (first) {
-        min = 0;
-    }
-
     return min;
 }
 EventDataType Profile::calcMax(ChannelID code, MachineType mt, QDate start, QDate end)
@@ -1519,30 +1357,10 @@ EventDataType Profile::calcMax(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    bool first = true;
-    double max = 0, tmp;
+    EventDataType max;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_MAX)) {
-                tmp = day->Max(code);
-
-                if (first || (max < tmp)) {
-                    max = tmp;
-                    first = false;
-                }
-            }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    if (first) {
-        max = 0;
+    if (!m_aggregates.extreme(AggregateKey(AGG_Max, code, mt), start, end, max)) {
+        return 0;
     }
 
     return max;
@@ -1557,32 +1375,11 @@ EventDataType Profile::calcSettingsMin(ChannelID code, MachineType mt, QDate sta
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
+    EventDataType min;
 
-    if (date.isNull()) {
-        return 0;
-    }
-
-    bool first = true;
-    double min = 0, tmp;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            tmp = day->settings_min(code);
-
-            if (first || (min > tmp)) {
-                min = tmp;
-                first = false;
-            }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    if (first) {
-        min = 0;
+    if (!m_aggregates.extreme(AggregateKey(AGG_SettingsMin, code, mt), start, end, min)) {
+        // Days without the setting report FLT_MAX from Day::settings_min, which the range loop passed on
+        return (countDays(mt, start, end) > 0) ? FLT_MAX : 0;
     }
 
     return min;
@@ -1598,32 +1395,11 @@ EventDataType Profile::calcSettingsMax(ChannelID code, MachineType mt, QDate sta
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
-
-    bool first = true;
-    double max = 0, tmp;
-
-    do {
-        Day *day = GetGoodDay(date, mt);
+    EventDataType max;
 
-        if (day) {
-            tmp = day->settings_max(code);
-
-            if (first || (max < tmp)) {
-                max = tmp;
-                first = false;
-            }
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    if (first) {
-        max = 0;
+    if (!m_aggregates.extreme(AggregateKey(AGG_SettingsMax, code, mt), start, end, max)) {
+        // As in calcSettingsMin, days without the setting report -FLT_MAX
+        return (countDays(mt, start, end) > 0) ? -FLT_MAX : 0;
     }
 
     return max;
@@ -1683,7 +1459,8 @@ EventDataType Profile::calcPercentile(ChannelID code, EventDataType percent, Mac
                         continue;
                     }
 
-                    gain = sess->m_gain[code];
+                    // value() rather than [], so concurrent statistics cells never insert
+                    gain = sess->m_gain.value(code);
 
                     if (!gain) { gain = 1; }
 
@@ -1910,17 +1687,12 @@ bool Profile::hasChannel(ChannelID code)
         return false;
     }
 
-    QMap<QDate, Day *>::iterator dit;
-
     bool found = false;
 
     do {
-        dit = daylist.find(d);
-
-        if (dit != daylist.end()) {
-            Day *day = dit.value();
-
+        Day *day = m_dayindex.at(d);
 
+        if (day) {
             if (day->channelHasData(code)) {
                 found = true;
                 break;
@@ -19,6 +19,8 @@
 #include "machine_loader.h"
 #include "preferences.h"
 #include "common.h"
+#include "dailyaggregates.h"
+#include "dayindex.h"
 
 class Machine;
 
@@ -93,6 +95,15 @@ class Profile : public Preferences
     //! \brief Removes a given day from the date, destroying the daylist date record if empty
     bool unlinkDay(Day * day);
 
+    //! \brief Called by day when its sessions are added, removed, enabled or disabled, to keep the day index in step
+    void updateDayIndex(Day * day);
+
+    //! \brief Registers cancel, which stops a background reader of Day records and waits for it to let go of them
+    static void addDayReader(void (*cancel)());
+
+    //! \brief Stops all background Day readers. Called before Day records or Sessions are deleted, or imports change them
+    static void cancelDayReaders();
+
 //    bool trashMachine(Machine * mach);
 
     //! \brief Add Day record to Profile Day list
@@ -127,6 +138,9 @@ class Profile : public Preferences
     //! \brief Get all days records of machine type between start and end dates
     QList<Day *> getDays(MachineType mt, QDate start, QDate end);
 
+    //! \brief Returns every date with a day record, in order. Safe from any thread, unlike walking daylist
+    QList<QDate> dayDates() { return m_dayindex.dates(); }
+
     //! \brief Returns a count of all days (with data) of machine type, between start and end dates
     int countDays(MachineType mt = MT_UNKNOWN, QDate start = QDate(), QDate end = QDate());
 
@@ -231,6 +245,9 @@ class Profile : public Preferences
     SessionSettings *session;
     QList<Machine *> m_machlist;
 
+    //! \brief The per-day statistics columns, whose generation() tells when any of this profile's day data changes
+    DailyAggregates &aggregates() { return m_aggregates; }
+
   protected:
     QDate m_first;
     QDate m_last;
@@ -240,6 +257,12 @@ class Profile : public Preferences
 
     QHash<QString, QHash<QString, Machine *> > MachineList;
 
+    //! \brief Per-day statistics columns the calc* functions answer their range queries from
+    DailyAggregates m_aggregates;
+
+    //! \brief daylist laid out by day number, for array lookups and range scans
+    DayIndex m_dayindex;
+
 };
 
 class MachineLoader;
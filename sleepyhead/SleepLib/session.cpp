@@ -8,6 +8,7 @@
  * for more details. */
 
 #include "session.h"
+#include "dailyaggregates.h"
 #include <cmath>
 #include <QDir>
 #include <QDebug>
@@ -88,10 +89,16 @@ void Session::TrashEvents()
 
 void Session::setEnabled(bool b)
 {
+    Day * day = p_profile->findSessionDay(this);
+
+    // Background readers of this day (like the Overview prefetch) have to stop before it changes
+    if (day && (b != s_enabled)) {
+        Profile::cancelDayReaders();
+    }
+
     s_enabled = b;
     // not so simple.. we have to invalidate the hours cache in the day record..
 
-    Day * day = p_profile->findSessionDay(this);
     if (day) {
         day->invalidate();
     }
@@ -786,6 +793,18 @@ bool Session::StoreEvents()
     return true;
 }
 bool Session::LoadEvents(QString filename)
+{
+    SessionEventData data;
+
+    if (!ReadEvents(filename, data, !s_evchecksum_checked)) {
+        return false;
+    }
+
+    AdoptEvents(data);
+    return true;
+}
+
+bool Session::ReadEvents(QString filename, SessionEventData &data, bool verify)
 {
     quint32 magicnum, machid, sessid;
     quint16 version, type, crc16, machtype, compmethod;
@@ -800,7 +819,7 @@ bool Session::LoadEvents(QString filename)
     QFile file(filename);
 
     if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "No Event/Waveform data available for" << s_session;
+        qDebug() << "No Event/Waveform data available in" << filename;
         return false;
     }
 
@@ -815,8 +834,8 @@ bool Session::LoadEvents(QString filename)
     header >> type;             // File type (quint16)
     header >> machid;           // Machine ID (quint32)
     header >> sessid;           //(quint32)
-    header >> s_first;          //(qint64)
-    header >> s_last;           //(qint64)
+    header >> data.first;       //(qint64)
+    header >> data.last;        //(qint64)
 
     if (type != filetype_data) {
         qDebug() << "Wrong File Type in " << filename;
@@ -849,7 +868,7 @@ bool Session::LoadEvents(QString filename)
         if (compmethod > 0) {
             databytes = qUncompress(temp);
 
-            if (!s_evchecksum_checked) {
+            if (verify) {
                 if (databytes.size() != datasize) {
                     qDebug() << "File" << filename << "has returned wrong datasize";
                     return false;
@@ -862,7 +881,7 @@ bool Session::LoadEvents(QString filename)
                     return false;
                 }
 
-                s_evchecksum_checked = true;
+                data.checked = true;
             }
         } else {
             databytes = temp;
@@ -917,7 +936,9 @@ bool Session::LoadEvents(QString filename)
                 in >> second_field;
             }
 
-            EventList *elist = AddEventList(code, elt, gain, offset, mn, mx, rate, second_field);
+            // Not AddEventList(), this may be running on another thread with data not yet ours
+            EventList *elist = new EventList(elt, gain, offset, mn, mx, rate, second_field);
+            data.eventlist[code].push_back(elist);
             elist->setDimension(dim);
 
             //eventlist[code].push_back(elist);
@@ -943,7 +964,7 @@ bool Session::LoadEvents(QString filename)
         size2 = sizevec[i];
 
         for (int j = 0; j < size2; j++) {
-            EventList &evec = *eventlist[code][j];
+            EventList &evec = *data.eventlist[code][j];
             evec.m_data.resize(evec.m_count);
             EventStoreType *ptr = evec.m_data.data();
 
@@ -982,13 +1003,37 @@ bool Session::LoadEvents(QString filename)
         }
     }
 
-    if (version < events_version) {
-        qDebug() << "Upgrading Events file" << filename << "to version" << events_version;
+    data.version = version;
+    data.filename = filename;
+
+    return true;
+}
+
+void Session::AdoptEvents(SessionEventData &data)
+{
+    // Anything already here is superseded by what was read from disk
+    for (auto it = eventlist.begin(), end = eventlist.end(); it != end; ++it) {
+        for (auto & el : it.value()) {
+            delete el;
+        }
+    }
+
+    eventlist.clear();
+    eventlist.swap(data.eventlist);
+
+    s_first = data.first;
+    s_last = data.last;
+    s_events_loaded = true;
+
+    if (data.checked) {
+        s_evchecksum_checked = true;
+    }
+
+    if (data.version < events_version) {
+        qDebug() << "Upgrading Events file" << data.filename << "to version" << events_version;
         UpdateSummaries();
         StoreEvents();
     }
-
-    return true;
 }
 
 void Session::destroyEvent(ChannelID code)
@@ -1106,6 +1151,11 @@ void Session::UpdateSummaries()
 {
     ChannelID id;
 
+    // Daily statistics built from the old summaries are stale now
+    if (s_machine && s_machine->profile) {
+        s_machine->profile->aggregates().touch();
+    }
+
     // Generate that AHI per hour graph in daily view.
     calcAHIGraph(this);
 
@@ -46,6 +46,37 @@ public:
     SliceStatus status;
 };
 
+/*! \struct SessionEventData
+    \brief The decoded contents of a Sessions events file, not yet attached to its Session.
+
+    Session::ReadEvents() fills this without touching the Session, so it can be run on a worker
+    thread, then Session::AdoptEvents() hands it over on the thread that owns the Session.
+    */
+struct SessionEventData
+{
+    SessionEventData() : version(0), first(0), last(0), checked(false) {}
+    ~SessionEventData() { clear(); }
+
+    //! \brief Deletes any EventLists that were never adopted
+    void clear() {
+        for (auto it = eventlist.begin(), end = eventlist.end(); it != end; ++it) {
+            for (auto & el : it.value()) {
+                delete el;
+            }
+        }
+        eventlist.clear();
+    }
+
+    QHash<ChannelID, QVector<EventList *> > eventlist;
+    QString filename;
+    quint16 version;
+    qint64 first, last;
+    bool checked;
+
+  private:
+    Q_DISABLE_COPY(SessionEventData)
+};
+
 /*! \class Session
     \brief Contains a single Sessions worth of machine event/waveform information.
 
@@ -90,6 +121,13 @@ class Session
     //! \brief Loads the Sessions EventLists from filename, from SleepLibs custom data format.
     bool LoadEvents(QString filename);
 
+    /*! \brief Decodes the EventLists in filename into data, without touching any Session.
+        Safe to call from any thread. If verify is set, the size and CRC are checked too. */
+    static bool ReadEvents(QString filename, SessionEventData &data, bool verify = true);
+
+    //! \brief Takes ownership of EventLists decoded by ReadEvents, replacing any already loaded
+    void AdoptEvents(SessionEventData &data);
+
     //! \brief Loads the events for this session when requested (only the summaries are loaded at startup)
     bool OpenEvents();
 
@@ -156,6 +194,9 @@ class Session
     //! \brief Just set the end of the timerange without comparing
     void really_set_last(qint64 d) { s_last = d; }
 
+    //! \brief Just set the enabled status, without looking for a Day to invalidate. Only for Sessions not added to a Day yet
+    void really_set_enabled(bool b) { s_enabled = b; }
+
     void set_first(qint64 d) {
         if (!s_first) { s_first = d; }
         else if (d < s_first) { s_first = d; }
@@ -1303,6 +1303,13 @@ void Daily::Load(QDate date)
         posit = day->machine(MT_POSITION);
     }
 
+    if (day) {
+        // Take whatever the prefetcher has ready, and load the rest here
+        prefetcher.adopt(day);
+        day->OpenEvents();
+        prefetcher.touch(day);
+    }
+
     if (!AppSetting->cacheSessions()) {
         // Getting trashed on purge last day...
 
@@ -1311,7 +1318,8 @@ void Daily::Load(QDate date)
             for (QMap<QDate, Day *>::iterator di = p_profile->daylist.begin(); di!= p_profile->daylist.end(); ++di) {
                 Day * d = di.value();
                 if (d->eventsLoaded()) {
-                    if (d->useCounter() == 0) {
+                    // Recently viewed days stay open so stepping back to them is instant
+                    if ((d->useCounter() == 0) && (d != day) && !prefetcher.isRetained(d)) {
                         d->CloseEvents();
                     }
                 }
@@ -1321,13 +1329,20 @@ void Daily::Load(QDate date)
 
     lastcpapday=day;
 
+    if (day) {
+        // Get the days either side ready for the calendar arrows
+        auto di = p_profile->daylist.find(date);
+        if (di != p_profile->daylist.end()) {
+            Day * prev = (di != p_profile->daylist.begin()) ? (di - 1).value() : nullptr;
+            Day * next = (++di != p_profile->daylist.end()) ? di.value() : nullptr;
+            prefetcher.prefetchNeighbours(prev, next);
+        }
+    }
+
     QString html="<html>"
     "</head>"
     "<body leftmargin=0 rightmargin=0 topmargin=0 marginwidth=0 marginheight=0>";
 
-    if (day) {
-        day->OpenEvents();
-    }
     GraphView->setDay(day);
 
 
@@ -1689,6 +1704,7 @@ void Daily::UnitsChanged()
 void Daily::clearLastDay()
 {
     lastcpapday=nullptr;
+    prefetcher.clear();
 }
 
 
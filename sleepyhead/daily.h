@@ -23,6 +23,7 @@
 #include <QTextBrowser>
 
 #include "SleepLib/profiles.h"
+#include "SleepLib/dayprefetch.h"
 #include "mainwindow.h"
 #include "Graphs/gSummaryChart.h"
 #include "Graphs/gGraphView.h"
@@ -329,6 +330,9 @@ private:
     MyTextBrowser * webView;
     Day * lastcpapday;
 
+    //! \brief Reads neighbouring days' events in the background and keeps recent ones open
+    DayPrefetcher prefetcher;
+
     gLineChart *leakchart;
 
     bool ZombieMeterMoved;
@@ -13,6 +13,8 @@
 #include <QDialog>
 #include "SleepLib/machine_common.h"
 
+class CSVExporter;
+
 namespace Ui {
 class ExportCSV;
 }
@@ -40,6 +42,10 @@ class ExportCSV : public QDialog
     explicit ExportCSV(QWidget *parent = 0);
     ~ExportCSV();
 
+  public slots:
+    //! \brief Cancels the export if one is running, otherwise closes the dialog
+    virtual void reject();
+
   private slots:
     void on_filenameBrowseButton_clicked();
 
@@ -56,6 +62,9 @@ class ExportCSV : public QDialog
 
     Ui::ExportCSV *ui;
     QList<DumpField> fields;
+
+    //! \brief The export under way, if any
+    CSVExporter *m_exporter;
 };
 
 #endif // EXPORTCSV_H
@@ -13,11 +13,15 @@
 #include <QSettings>
 #include <QFileDialog>
 #include <QFontDatabase>
+#include <QHostInfo>
 
 #include "version.h"
 #include "logger.h"
 #include "mainwindow.h"
 #include "SleepLib/profiles.h"
+#include "SleepLib/progressdialog.h"
+#include "SleepLib/csvexport.h"
+#include "SleepLib/eventexport.h"
 #include "translation.h"
 
 // Gah! I must add the real darn plugin system one day.
@@ -41,6 +45,92 @@ MainWindow *mainwin = nullptr;
 
 int compareVersion(QString version);
 
+//! \brief Reports why a command line export failed, on stderr for the caller and in the log
+static void exportError(const QString &msg)
+{
+    fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
+    qWarning() << msg.toLocal8Bit().data();
+}
+
+//! \brief Opens profilename (or the last used profile) without the GUI, for the command line exports.
+//! Prints why and returns false if it can't
+static bool openProfileForExport(QString profilename)
+{
+    if (profilename.isEmpty()) {
+        profilename = AppSetting->profileName();
+    }
+
+    Profile *prof = Profiles::Get(profilename);
+    if (!prof) {
+        exportError(QString("No profile named \"%1\"").arg(profilename));
+        return false;
+    }
+
+    // There's nobody to ask for it
+    if (prof->user->hasPassword()) {
+        exportError(QString("Profile \"%1\" is password protected, export it from within SleepyHead").arg(profilename));
+        return false;
+    }
+
+    QString lockhost = prof->checkLock();
+    if (!lockhost.isEmpty() && (lockhost.compare(QHostInfo::localHostName()) != 0)) {
+        exportError(QString("Profile \"%1\" is in use on %2").arg(profilename).arg(lockhost));
+        return false;
+    }
+
+    p_profile = prof;
+
+    // Loading reports its progress here, but it's never shown
+    ProgressDialog progress(nullptr);
+    p_profile->LoadMachineData(&progress);
+
+    return true;
+}
+
+//! \brief Exports profilename's CPAP days between start and end to filename. Returns the process exit code
+static int exportCSV(QString profilename, const QString &filename, CSVExportMode mode, QDate start, QDate end)
+{
+    if (!openProfileForExport(profilename)) {
+        return 1;
+    }
+
+    if (!start.isValid()) start = p_profile->FirstDay(MT_CPAP);
+    if (!end.isValid()) end = p_profile->LastDay(MT_CPAP);
+
+    CSVExporter exporter(mode, start, end);
+    bool ok = exporter.exportTo(filename);
+
+    p_profile->removeLock();
+
+    if (!ok) {
+        exportError(QString("Couldn't write %1").arg(filename));
+        return 1;
+    }
+    return 0;
+}
+
+//! \brief Exports the waveforms and events of profilename's sessions between start and end to filename
+//! and its lists file. Returns the process exit code
+static int exportEvents(QString profilename, const QString &filename, QDate start, QDate end)
+{
+    if (!openProfileForExport(profilename)) {
+        return 1;
+    }
+
+    if (!start.isValid()) start = p_profile->FirstDay();
+    if (!end.isValid()) end = p_profile->LastDay();
+
+    EventExporter exporter(start, end);
+    bool ok = exporter.exportTo(filename);
+
+    p_profile->removeLock();
+
+    if (!ok) {
+        exportError(QString("Couldn't write %1").arg(filename));
+        return 1;
+    }
+    return 0;
+}
 
 
 int main(int argc, char *argv[])
@@ -74,6 +164,10 @@ int main(int argc, char *argv[])
     bool changing_language = false;
     QString load_profile = "";
 
+    QString export_csv, export_events;
+    CSVExportMode export_mode = CSV_Summary;
+    QDate export_start, export_end;
+
     QApplication a(argc, argv);
     QStringList args = a.arguments();
 
@@ -98,6 +192,40 @@ int main(int argc, char *argv[])
                 fprintf(stderr, "Missing argument to --profile\n");
                 exit(1);
             }
+        } else if (args[i] == "--export-csv") {
+            if ((i+1) < args.size()) {
+                export_csv = args[++i];
+            } else {
+                fprintf(stderr, "Missing argument to --export-csv\n");
+                exit(1);
+            }
+        } else if (args[i] == "--export-events") {
+            if ((i+1) < args.size()) {
+                export_events = args[++i];
+            } else {
+                fprintf(stderr, "Missing argument to --export-events\n");
+                exit(1);
+            }
+        } else if (args[i] == "--export-mode") {
+            if (((i+1) >= args.size()) || !CSVExporter::parseMode(args[++i], export_mode)) {
+                fprintf(stderr, "--export-mode needs one of summary, sessions or details\n");
+                exit(1);
+            }
+        } else if ((args[i] == "--export-start") || (args[i] == "--export-end")) {
+            QDate date;
+            if ((i+1) < args.size()) {
+                date = QDate::fromString(args[i+1], Qt::ISODate);
+            }
+            if (!date.isValid()) {
+                fprintf(stderr, "%s needs a date in YYYY-MM-DD form\n", args[i].toLocal8Bit().data());
+                exit(1);
+            }
+            if (args[i] == "--export-start") {
+                export_start = date;
+            } else {
+                export_end = date;
+            }
+            i++;
         } else if (args[i] == "--datadir") { // mltam's idea
             QString datadir ;
             if ((i+1) < args.size()) {
@@ -353,6 +481,12 @@ retry_directory:
     Q_UNUSED(changing_language)
     Q_UNUSED(dont_load_profile)
 
+    if (!export_csv.isEmpty()) {
+        return exportCSV(load_profile, export_csv, export_mode, export_start, export_end);
+    }
+    if (!export_events.isEmpty()) {
+        return exportEvents(load_profile, export_events, export_start, export_end);
+    }
 
     if (check_updates) { mainwin->CheckForUpdates(); }
 
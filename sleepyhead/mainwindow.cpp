@@ -50,6 +50,7 @@
 #include "aboutdialog.h"
 #include "newprofile.h"
 #include "exportcsv.h"
+#include "SleepLib/eventexport.h"
 #include "SleepLib/schema.h"
 #include "Graphs/glcommon.h"
 #include "UpdaterWindow.h"
@@ -513,6 +514,7 @@ void MainWindow::CloseProfile()
         delete overview;
         overview = nullptr;
     }
+    gSummaryChart::clearSharedCache();
 
     if (p_profile) {
         p_profile->StoreMachines();
@@ -573,6 +575,9 @@ int MainWindow::importCPAP(ImportPath import, const QString &message)
     connect(import.loader, SIGNAL(setProgressValue(int)), progdlg, SLOT(setProgressValue(int)));
     connect(progdlg, SIGNAL(abortClicked()), import.loader, SLOT(abortImport()));
 
+    // Nothing in the background may be reading Day records the import is changing
+    Profile::cancelDayReaders();
+
     int c = import.loader->Open(import.path);
 
     if (c > 0) {
@@ -2436,6 +2441,42 @@ void MainWindow::on_actionExport_CSV_triggered()
     }
 }
 
+void MainWindow::on_actionExport_Events_triggered()
+{
+    if (!p_profile) return;
+
+    QString name = QFileDialog::getSaveFileName(this, tr("Choose where to save waveforms and events"),
+                   PREF.Get("{home}/") + tr("SleepyHead_%1_Events").arg(p_profile->user->userName()) + ".arrow",
+                   tr("Arrow Files (*.arrow)"));
+
+    if (name.isEmpty()) return;
+
+    if (!name.toLower().endsWith(".arrow")) {
+        name += ".arrow";
+    }
+
+    ProgressDialog * progdlg = new ProgressDialog(this);
+    progdlg->addAbortButton();
+    progdlg->setWindowModality(Qt::ApplicationModal);
+    progdlg->open();
+    progdlg->setMessage(tr("Exporting waveforms and events..."));
+
+    EventExporter exporter(p_profile->FirstDay(), p_profile->LastDay());
+
+    connect(&exporter, SIGNAL(setProgressMax(int)), progdlg, SLOT(setProgressMax(int)));
+    connect(&exporter, SIGNAL(setProgressValue(int)), progdlg, SLOT(setProgressValue(int)));
+    connect(progdlg, SIGNAL(abortClicked()), &exporter, SLOT(cancel()));
+
+    bool ok = exporter.exportTo(name);
+
+    progdlg->close();
+    delete progdlg;
+
+    if (!ok && !exporter.cancelled()) {
+        QMessageBox::warning(this, STR_MessageBox_Error, tr("Couldn't write to %1").arg(name), QMessageBox::Ok);
+    }
+}
+
 void MainWindow::on_actionExport_Review_triggered()
 {
     QMessageBox::information(nullptr, STR_MessageBox_Information, QObject::tr("Sorry, this feature is not implemented yet"), QMessageBox::Ok);
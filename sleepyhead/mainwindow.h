@@ -304,6 +304,8 @@ class MainWindow : public QMainWindow
 
     void on_actionExport_CSV_triggered();
 
+    void on_actionExport_Events_triggered();
+
     void on_actionExport_Review_triggered();
 
     void on_mainsplitter_splitterMoved(int pos, int index);
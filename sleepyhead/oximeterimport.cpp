@@ -1019,6 +1019,8 @@ void OximeterImport::on_saveButton_clicked()
 
     session->setOpened(true);
 
+    // Nothing in the background may be reading Day records this changes
+    Profile::cancelDayReaders();
     mach->AddSession(session);
     mach->Save();
     mach->SaveSummaryCache();
@@ -0,0 +1,205 @@
+#!/bin/bash
+#
+# Checks the command line exports (--export-csv and --export-events) against a fixture profile.
+#
+# Usage: check_exports.sh <SleepyHead binary> <data folder> [profile name]
+#
+# The data folder is a SleepyHead data folder (the one holding Profiles/) with at least one
+# profile that has CPAP data imported and no password.
+#
+# That fixture isn't kept in the tree. Session files are binary, written by the import code of
+# the build that made them, and the card data behind them is somebody's health record. Each
+# developer makes one once, from their own card or any card they may use:
+#
+#   1. Start the GUI on an empty folder, with scratch settings so your own are left alone:
+#        XDG_CONFIG_HOME="$(mktemp -d)" <SleepyHead binary> --datadir ~/sleepyhead-fixture
+#   2. Create a profile with no password, say "Export Check", and pass that as [profile name].
+#   3. Import a CPAP card, or a copy of one, with at least a few days on it. Flow rate and
+#      pressure data give the details and event exports something to check.
+#   4. Quit. ~/sleepyhead-fixture is then the <data folder>; keep a copy of it.
+#
+# The checks compare the exports with each other rather than with stored results, so any profile
+# with CPAP data works.
+#
+# Settings go to a scratch folder, so the user's own SleepyHead settings are left alone.
+# Exits non zero if any check fails.
+
+if [ $# -lt 2 ]
+then
+    echo "Usage: $0 <SleepyHead binary> <data folder> [profile name]"
+    exit 2
+fi
+
+BINARY="$1"
+DATADIR="$(cd "$2" && pwd)"
+PROFILE="$3"
+
+# Settings file name, which carries the git branch on development builds
+APPNAME="${SLEEPYHEAD_APPNAME:-SleepyHead}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+export XDG_CONFIG_HOME="$WORK/config"
+export QT_QPA_PLATFORM="${QT_QPA_PLATFORM:-offscreen}"
+
+# A language has to be set up front, or the language picker is shown
+mkdir -p "$XDG_CONFIG_HOME/Jedimark"
+printf "[Settings]\nLanguage=en_US\nAppRoot=%s\n" "$DATADIR" > "$XDG_CONFIG_HOME/Jedimark/$APPNAME.conf"
+
+FAILED=0
+
+fail()
+{
+    echo "FAIL: $*"
+    FAILED=1
+}
+
+pass()
+{
+    echo "ok:   $*"
+}
+
+# Runs an export, with the profile if one was given
+run_export()
+{
+    if [ -n "$PROFILE" ]
+    then
+        "$BINARY" --profile "$PROFILE" "$@" > "$WORK/stdout.txt" 2> "$WORK/stderr.txt"
+    else
+        "$BINARY" "$@" > "$WORK/stdout.txt" 2> "$WORK/stderr.txt"
+    fi
+}
+
+# Checks every row of a CSV file has as many fields as its header
+check_fields()
+{
+    awk -F, 'NR == 1 { n = NF; next } NF != n { bad++ } END { exit bad ? 1 : 0 }' "$1"
+}
+
+# Checks the dates in the first field never go backwards (after the header), strictly if $2 is "strict"
+check_order()
+{
+    awk -F, -v strict="$2" 'NR == 1 { next }
+        { d = substr($1, 1, 10) }
+        NR > 2 && (d < last || (strict == "strict" && d == last)) { bad++ }
+        { last = d }
+        END { exit bad ? 1 : 0 }' "$1"
+}
+
+##########################################################################################
+# Summary export
+##########################################################################################
+if run_export --export-csv "$WORK/summary.csv" --export-mode summary
+then
+    pass "summary export ran"
+    head -n 1 "$WORK/summary.csv" | grep -q "^Date,Session Count,Start,End,Total Time,AHI" && pass "summary header" || fail "summary header: $(head -n 1 "$WORK/summary.csv")"
+    [ "$(wc -l < "$WORK/summary.csv")" -gt 1 ] && pass "summary has rows" || fail "summary has no rows, the fixture profile needs CPAP data"
+    check_fields "$WORK/summary.csv" && pass "summary rows match the header" || fail "summary rows don't all match the header"
+    check_order "$WORK/summary.csv" strict && pass "summary days in order, once each" || fail "summary days out of order or repeated"
+else
+    fail "summary export exited with $?: $(cat "$WORK/stderr.txt")"
+fi
+
+# The workers must not change what's written, or its order
+if run_export --export-csv "$WORK/summary2.csv" --export-mode summary && cmp -s "$WORK/summary.csv" "$WORK/summary2.csv"
+then
+    pass "summary export repeats exactly"
+else
+    fail "summary export differs between runs"
+fi
+
+##########################################################################################
+# Sessions export
+##########################################################################################
+if run_export --export-csv "$WORK/sessions.csv" --export-mode sessions
+then
+    pass "sessions export ran"
+    head -n 1 "$WORK/sessions.csv" | grep -q "^Date,Session,Start,End,Total Time,AHI" && pass "sessions header" || fail "sessions header: $(head -n 1 "$WORK/sessions.csv")"
+    check_fields "$WORK/sessions.csv" && pass "sessions rows match the header" || fail "sessions rows don't all match the header"
+    check_order "$WORK/sessions.csv" && pass "sessions in date order" || fail "sessions out of date order"
+
+    # Every day in the summary has as many sessions listed as it counts
+    awk -F, 'FNR == 1 { next }
+        FILENAME == ARGV[1] { want[$1] = $2; next }
+        { got[$1]++ }
+        END { for (d in want) if (got[d] != want[d]) bad++; exit bad ? 1 : 0 }' "$WORK/summary.csv" "$WORK/sessions.csv" \
+        && pass "sessions agree with summary session counts" || fail "sessions don't agree with summary session counts"
+else
+    fail "sessions export exited with $?: $(cat "$WORK/stderr.txt")"
+fi
+
+##########################################################################################
+# Details export
+##########################################################################################
+if run_export --export-csv "$WORK/details.csv" --export-mode details
+then
+    pass "details export ran"
+    head -n 1 "$WORK/details.csv" | grep -q "^DateTime,Session,Event,Data/Duration$" && pass "details header" || fail "details header: $(head -n 1 "$WORK/details.csv")"
+    check_fields "$WORK/details.csv" && pass "details rows have four fields" || fail "details rows don't all have four fields"
+
+    # Details only come from sessions the sessions export listed
+    awk -F, 'FNR == 1 { next }
+        FILENAME == ARGV[1] { known[$2] = 1; next }
+        !($2 in known) { bad++ }
+        END { exit bad ? 1 : 0 }' "$WORK/sessions.csv" "$WORK/details.csv" \
+        && pass "details sessions are all known" || fail "details name sessions the sessions export doesn't have"
+else
+    fail "details export exited with $?: $(cat "$WORK/stderr.txt")"
+fi
+
+##########################################################################################
+# Date range
+##########################################################################################
+FIRST="$(awk -F, 'NR == 2 { print $1 }' "$WORK/summary.csv")"
+if [ -n "$FIRST" ] && run_export --export-csv "$WORK/range.csv" --export-mode summary --export-start "$FIRST" --export-end "$FIRST"
+then
+    [ "$(wc -l < "$WORK/range.csv")" -eq 2 ] && [ "$(sed -n 2p "$WORK/range.csv")" = "$(sed -n 2p "$WORK/summary.csv")" ] \
+        && pass "one day range gives just that day" || fail "one day range didn't give just $FIRST"
+else
+    fail "ranged summary export didn't run"
+fi
+
+##########################################################################################
+# Event export
+##########################################################################################
+if run_export --export-events "$WORK/events.arrow"
+then
+    pass "event export ran"
+    for f in "$WORK/events.arrow" "$WORK/events.lists.arrow"
+    do
+        if [ -f "$f" ] && [ "$(head -c 6 "$f")" = "ARROW1" ] && [ "$(tail -c 6 "$f")" = "ARROW1" ]
+        then
+            pass "$(basename "$f") is an Arrow file"
+        else
+            fail "$(basename "$f") is missing or not an Arrow file"
+        fi
+    done
+else
+    fail "event export exited with $?: $(cat "$WORK/stderr.txt")"
+fi
+
+##########################################################################################
+# Failures
+##########################################################################################
+if run_export --export-csv "$WORK/bad.csv" --export-mode nonsense
+then
+    fail "a bad --export-mode was accepted"
+else
+    pass "a bad --export-mode is refused"
+fi
+
+if "$BINARY" --profile "no-such-profile-$$" --export-csv "$WORK/missing.csv" > /dev/null 2>&1
+then
+    fail "exporting a missing profile succeeded"
+else
+    [ -e "$WORK/missing.csv" ] && fail "exporting a missing profile left a file" || pass "a missing profile is refused, leaving no file"
+fi
+
+if [ $FAILED -ne 0 ]
+then
+    echo "Export checks failed"
+    exit 1
+fi
+echo "All export checks passed"
+exit 0
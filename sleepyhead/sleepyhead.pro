@@ -195,6 +195,7 @@ SOURCES += \
     updateparser.cpp \
     UpdaterWindow.cpp \
     Graphs/gFlagsLine.cpp \
+    Graphs/gFlagBins.cpp \
     Graphs/gFooBar.cpp \
     Graphs/gGraph.cpp \
     Graphs/gGraphView.cpp \
@@ -209,9 +210,17 @@ SOURCES += \
     Graphs/gYAxis.cpp \
     Graphs/layer.cpp \
     SleepLib/calcs.cpp \
+    SleepLib/arrowwriter.cpp \
+    SleepLib/backupengine.cpp \
+    SleepLib/dailyaggregates.cpp \
+    SleepLib/dayindex.cpp \
     SleepLib/common.cpp \
+    SleepLib/csvexport.cpp \
     SleepLib/day.cpp \
+    SleepLib/dayprefetch.cpp \
     SleepLib/event.cpp \
+    SleepLib/eventexport.cpp \
+    SleepLib/exportqueue.cpp \
     SleepLib/machine.cpp \
     SleepLib/machine_loader.cpp \
     SleepLib/preferences.cpp \
@@ -261,6 +270,7 @@ HEADERS  += \
     UpdaterWindow.h \
     version.h \
     Graphs/gFlagsLine.h \
+    Graphs/gFlagBins.h \
     Graphs/gFooBar.h \
     Graphs/gGraph.h \
     Graphs/gGraphView.h \
@@ -275,9 +285,17 @@ HEADERS  += \
     Graphs/gYAxis.h \
     Graphs/layer.h \
     SleepLib/calcs.h \
+    SleepLib/arrowwriter.h \
+    SleepLib/backupengine.h \
+    SleepLib/dailyaggregates.h \
+    SleepLib/dayindex.h \
     SleepLib/common.h \
+    SleepLib/csvexport.h \
     SleepLib/day.h \
+    SleepLib/dayprefetch.h \
     SleepLib/event.h \
+    SleepLib/eventexport.h \
+    SleepLib/exportqueue.h \
     SleepLib/machine.h \
     SleepLib/machine_common.h \
     SleepLib/machine_loader.h \
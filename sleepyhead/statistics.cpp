@@ -10,10 +10,16 @@
 #include <QFile>
 #include <QDataStream>
 #include <QBuffer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
 #include <cmath>
 
 #include "mainwindow.h"
 #include "statistics.h"
+#include "SleepLib/appsettings.h"
+#include "SleepLib/dailyaggregates.h"
 
 extern MainWindow *mainwin;
 
@@ -34,6 +40,9 @@ QString formatTime(float time)
     return QString().sprintf("%02i:%02i", hours, minutes); //,seconds);
 }
 
+// Version 1 added settings fingerprints
+const quint16 rxchanges_version = 1;
+
 QDataStream & operator>>(QDataStream & in, RXItem & rx)
 {
     in >> rx.start;
@@ -71,6 +80,7 @@ QDataStream & operator>>(QDataStream & in, RXItem & rx)
 
     in >> rx.s_count;
     in >> rx.s_sum;
+    in >> rx.fingerprint;
 
     return in;
 }
@@ -92,6 +102,7 @@ QDataStream & operator<<(QDataStream & out, const RXItem & rx)
     out << rx.dates.keys();
     out << rx.s_count;
     out << rx.s_sum;
+    out << rx.fingerprint;
 
     return out;
 }
@@ -117,6 +128,11 @@ void Statistics::loadRXChanges()
     quint16 version;
     in >> version;
 
+    // Older caches have no settings fingerprints, so start again
+    if (version < rxchanges_version) {
+        return;
+    }
+
     in >> rxitems;
 
 }
@@ -131,7 +147,7 @@ void Statistics::saveRXChanges()
     out.setByteOrder(QDataStream::LittleEndian);
     out.setVersion(QDataStream::Qt_5_0);
     out << magic;
-    out << (quint16)0;
+    out << rxchanges_version;
     out << rxitems;
 
 }
@@ -158,6 +174,7 @@ void Statistics::updateRXChanges()
 
 
     quint64 tmp;
+    bool changed = false;
 
     // Scan through each daylist in ascending date order
     for (it = p_profile->daylist.begin(); it != it_end; ++it) {
@@ -168,302 +185,235 @@ void Statistics::updateRXChanges()
         if (mach == nullptr)
             continue;
 
-        bool fnd = false;
+        // rx cache entries never overlap, so the last one starting on or before this date is the only one that can hold it
+        ri = rxitems.upperBound(date);
+        if (ri == rxitems.begin()) {
+            ri = rxitems.end();
+        } else {
+            --ri;
+        }
 
+        // Days already in the cache are done with, without even loading their summaries
+        if ((ri != rxitems.end()) && ri.value().dates.contains(date)) {
+            continue;
+        }
+        changed = true;
 
-        // Scan through pre-existing rxitems list and see if this day is already there.
-        ri_end = rxitems.end();
-        for (ri = rxitems.begin(); ri != ri_end; ++ri) {
-            RXItem & rx = ri.value();
+        // Need summaries for this, so load them if not present.
+        day->OpenSummary();
 
-            // Is it date between this rxitems entry date range?
-            if ((date >= rx.start) && (date <= rx.end)) {
+        // Get list of Event Flags used in this day
+        QList<ChannelID> flags = day->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
 
-                if (rx.dates.contains(date)) {
-                    // Already there, abort.
-                    fnd = true;
-                    break;
-                }
+        // Compare settings by fingerprint; the strings are only made for new cache entries
+        quint32 fingerprint = day->settingsFingerprint();
 
-                // First up, check if fits in date range, but isn't loaded for some reason
+        bool fnd = false;
 
-                // Need summaries for this, so load them if not present.
-                day->OpenSummary();
+        if (ri != rxitems.end()) {
+            RXItem & rx = ri.value();
+            bool match = (rx.fingerprint == fingerprint) && (rx.machine == mach);
 
-                // Get list of Event Flags used in this day
-                QList<ChannelID> flags = day->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
+            if (match) {
+                // Update rx cache summaries for each event flag
+                for (int i=0; i < flags.size(); i++) {
+                    ChannelID code  = flags.at(i);
+                    rx.s_count[code] += day->count(code);
+                    rx.s_sum[code] += day->sum(code);
+                }
 
-                // Generate the pressure/mode/relief strings
-                QString relief = day->getPressureRelief();
-                QString mode = day->getCPAPMode();
-                QString pressure = day->getPressureSettings();
+                // Update AHI/RDI/Time counts
+                tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
+                rx.ahi += tmp;
+                rx.rdi += tmp + day->count(CPAP_RERA);
+                rx.hours += day->hours(MT_CPAP);
 
-                // Do this days settings match this rx cache entry?
-                if ((rx.relief == relief) && (rx.mode == mode) && (rx.pressure == pressure) && (rx.machine == mach)) {
+                // Add this date to RX cache, extending it if the day is newer
+                rx.dates[date] = day;
+                rx.end = qMax(rx.end, date);
+                rx.days = rx.dates.size();
 
-                    // Update rx cache summaries for each event flag
-                    for (int i=0; i < flags.size(); i++) {
-                        ChannelID code  = flags.at(i);
-                        rx.s_count[code] += day->count(code);
-                        rx.s_sum[code] += day->sum(code);
-                    }
+                fnd = true;
+            } else if (date <= rx.end) {
+                // In this case, the day is within the rx date range, but settings doesn't match the others
+                // So we need to split the rx cache record and insert the new record as it's own.
 
-                    // Update AHI/RDI/Time counts
-                    tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
-                    rx.ahi += tmp;
-                    rx.rdi += tmp + day->count(CPAP_RERA);
-                    rx.hours += day->hours(MT_CPAP);
+                RXItem rx1, rx2;
 
-                    // Add this date to RX cache
-                    rx.dates[date] = day;
-                    rx.days = rx.dates.size();
+                // So first create the new cache entry for current day we are looking at.
+                rx1.start = date;
+                rx1.end = date;
+                rx1.days = 1;
 
-                    // and we are done
-                    fnd = true;
-                    break;
-                } else {
-                    // In this case, the day is within the rx date range, but settings doesn't match the others
-                    // So we need to split the rx cache record and insert the new record as it's own.
-
-                    RXItem rx1, rx2;
-
-                    // So first create the new cache entry for current day we are looking at.
-                    rx1.start = date;
-                    rx1.end = date;
-                    rx1.days = 1;
-
-                    // Only this days AHI/RDI counts
-                    tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
-                    rx1.ahi = tmp;
-                    rx1.rdi = tmp + day->count(CPAP_RERA);
-
-                    // Sum and count event flags for this day
-                    for (int i=0; i < flags.size(); i++) {
-                        ChannelID code  = flags.at(i);
-                        rx1.s_count[code] = day->count(code);
-                        rx1.s_sum[code] = day->sum(code);
-                    }
+                // Only this days AHI/RDI counts
+                tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
+                rx1.ahi = tmp;
+                rx1.rdi = tmp + day->count(CPAP_RERA);
+
+                // Sum and count event flags for this day
+                for (int i=0; i < flags.size(); i++) {
+                    ChannelID code  = flags.at(i);
+                    rx1.s_count[code] = day->count(code);
+                    rx1.s_sum[code] = day->sum(code);
+                }
 
-                    //The rest of this cache record for this day
-                    rx1.hours = day->hours(MT_CPAP);
-                    rx1.relief = relief;
-                    rx1.mode = mode;
-                    rx1.pressure = pressure;
-                    rx1.machine = mach;
-                    rx1.dates[date] = day;
-
-                    // Insert new entry into rx cache
-                    rxitems.insert(date, rx1);
-
-                    // now zonk it so we can reuse the variable later
-                    //rx1 = RXItem();
-
-                    // Now that's out of the way, we need to splitting the old rx into two,
-                    // and recalculate everything before and after today
-
-                    // Copy the old rx.dates, which contains the list of Day records
-                    QMap<QDate, Day *> datecopy = rx.dates;
-
-                    // now zap it so we can start fresh
-                    rx.dates.clear();
-
-                    rx2.end = rx2.start = rx.end;
-                    rx.end = rx.start;
-
-                    // Zonk the summary data, as it needs redoing
-                    rx2.ahi = 0;
-                    rx2.rdi = 0;
-                    rx2.hours = 0;
-                    rx.ahi = 0;
-                    rx.rdi = 0;
-                    rx.hours = 0;
-                    rx.s_count.clear();
-                    rx2.s_count.clear();
-                    rx.s_sum.clear();
-                    rx2.s_sum.clear();
-
-                    // Now go through day list and recalculate according to split
-                    for (di = datecopy.begin(); di != datecopy.end(); ++di) {
-
-                        // Split everything before date
-                        if (di.key() < date) {
-                            // Get the day record for this date
-                            Day * dy = rx.dates[di.key()] = p_profile->GetDay(di.key(), MT_CPAP);
-
-                            // Update AHI/RDI counts
-                            tmp = dy->count(CPAP_Hypopnea) + dy->count(CPAP_Obstructive) + dy->count(CPAP_Apnea) + dy->count(CPAP_ClearAirway);;
-                            rx.ahi += tmp;
-                            rx.rdi += tmp + dy->count(CPAP_RERA);
-
-                            // Get Event Flags list
-                            QList<ChannelID> flags2 = dy->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
-
-                            // Update flags counts and sums
-                            for (int i=0; i < flags2.size(); i++) {
-                                ChannelID code  = flags2.at(i);
-                                rx.s_count[code] += dy->count(code);
-                                rx.s_sum[code] += dy->sum(code);
-                            }
-
-                            // Update time sum
-                            rx.hours += dy->hours(MT_CPAP);
-
-                            // Update the last date of this cache entry
-                            // (Max here should be unnessary, this should be sequential because we are processing a QMap.)
-                            rx.end = di.key(); //qMax(di.key(), rx.end);
+                //The rest of this cache record for this day
+                rx1.hours = day->hours(MT_CPAP);
+                rx1.relief = day->getPressureRelief();
+                rx1.mode = day->getCPAPMode();
+                rx1.pressure = day->getPressureSettings();
+                rx1.machine = mach;
+                rx1.fingerprint = fingerprint;
+                rx1.dates[date] = day;
+
+                // Insert new entry into rx cache
+                rxitems.insert(date, rx1);
+
+                // now zonk it so we can reuse the variable later
+                //rx1 = RXItem();
+
+                // Now that's out of the way, we need to splitting the old rx into two,
+                // and recalculate everything before and after today
+
+                // Copy the old rx.dates, which contains the list of Day records
+                QMap<QDate, Day *> datecopy = rx.dates;
+
+                // now zap it so we can start fresh
+                rx.dates.clear();
+
+                rx2.end = rx2.start = rx.end;
+                rx.end = rx.start;
+
+                // Zonk the summary data, as it needs redoing
+                rx2.ahi = 0;
+                rx2.rdi = 0;
+                rx2.hours = 0;
+                rx.ahi = 0;
+                rx.rdi = 0;
+                rx.hours = 0;
+                rx.s_count.clear();
+                rx2.s_count.clear();
+                rx.s_sum.clear();
+                rx2.s_sum.clear();
+
+                // Now go through day list and recalculate according to split
+                for (di = datecopy.begin(); di != datecopy.end(); ++di) {
+
+                    // Split everything before date
+                    if (di.key() < date) {
+                        // Get the day record for this date
+                        Day * dy = rx.dates[di.key()] = p_profile->GetDay(di.key(), MT_CPAP);
+
+                        // Update AHI/RDI counts
+                        tmp = dy->count(CPAP_Hypopnea) + dy->count(CPAP_Obstructive) + dy->count(CPAP_Apnea) + dy->count(CPAP_ClearAirway);;
+                        rx.ahi += tmp;
+                        rx.rdi += tmp + dy->count(CPAP_RERA);
+
+                        // Get Event Flags list
+                        QList<ChannelID> flags2 = dy->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
+
+                        // Update flags counts and sums
+                        for (int i=0; i < flags2.size(); i++) {
+                            ChannelID code  = flags2.at(i);
+                            rx.s_count[code] += dy->count(code);
+                            rx.s_sum[code] += dy->sum(code);
                         }
 
-                        // Split everything after date
-                        if (di.key() > date) {
-                            // Get the day record for this date
-                            Day * dy = rx2.dates[di.key()] = p_profile->GetDay(di.key(), MT_CPAP);
-
-                            // Update AHI/RDI counts
-                            tmp = dy->count(CPAP_Hypopnea) + dy->count(CPAP_Obstructive) + dy->count(CPAP_Apnea) + dy->count(CPAP_ClearAirway);;
-                            rx2.ahi += tmp;
-                            rx2.rdi += tmp + dy->count(CPAP_RERA);
-
-                            // Get Event Flags list
-                            QList<ChannelID> flags2 = dy->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
-
-                            // Update flags counts and sums
-                            for (int i=0; i < flags2.size(); i++) {
-                                ChannelID code  = flags2.at(i);
-                                rx2.s_count[code] += dy->count(code);
-                                rx2.s_sum[code] += dy->sum(code);
-                            }
+                        // Update time sum
+                        rx.hours += dy->hours(MT_CPAP);
 
-                            // Update time sum
-                            rx2.hours += dy->hours(MT_CPAP);
-
-                            // Update start and end
-                            //rx2.end = qMax(di.key(), rx2.end); // don't need to do this, the end won't change from what the old one was.
-
-                            // technically only need to capture the first??
-                            rx2.start = qMin(di.key(), rx2.start);
-                        }
+                        // Update the last date of this cache entry
+                        // (Max here should be unnessary, this should be sequential because we are processing a QMap.)
+                        rx.end = di.key(); //qMax(di.key(), rx.end);
                     }
 
-                    // Set rx records day counts
-                    rx.days = rx.dates.size();
-                    rx2.days = rx2.dates.size();
-
-                    // Copy the pressure/mode/etc settings, because they haven't changed.
-                    rx2.pressure = rx.pressure;
-                    rx2.mode = rx.mode;
-                    rx2.relief = rx.relief;
-                    rx2.machine = rx.machine;
-
-                    // Insert the newly split rx record
-                    rxitems.insert(rx2.start, rx2);  // hmmm. this was previously set to the end date.. that was a silly plan.
-                    fnd = true;
-
-                    break;
-                }
-            }
-        }
-
+                    // Split everything after date
+                    if (di.key() > date) {
+                        // Get the day record for this date
+                        Day * dy = rx2.dates[di.key()] = p_profile->GetDay(di.key(), MT_CPAP);
 
-        if (fnd) continue; // already in rx list, move onto the next daylist entry
+                        // Update AHI/RDI counts
+                        tmp = dy->count(CPAP_Hypopnea) + dy->count(CPAP_Obstructive) + dy->count(CPAP_Apnea) + dy->count(CPAP_ClearAirway);;
+                        rx2.ahi += tmp;
+                        rx2.rdi += tmp + dy->count(CPAP_RERA);
 
-        // So in this condition, daylist isn't in rx cache, and doesn't match date range of any previous rx cache entry.
-
-
-        // Need to bring in summaries for this
-        day->OpenSummary();
-
-        // Get Event flags list
-        QList<ChannelID> flags3 = day->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
-
-        // Generate pressure/mode/relief strings
-        QString relief = day->getPressureRelief();
-        QString mode = day->getCPAPMode();
-        QString pressure = day->getPressureSettings();
-
-        // Now scan the rxcache to find the most previous entry, and the right place to insert
-
-        QMap<QDate, RXItem>::iterator lastri = rxitems.end();
-
-        for (ri = rxitems.begin(); ri != ri_end; ++ri) {
-//            RXItem & rx = ri.value();
+                        // Get Event Flags list
+                        QList<ChannelID> flags2 = dy->getSortedMachineChannels(MT_CPAP, schema::FLAG | schema::MINOR_FLAG | schema::SPAN);
 
-            // break after any date newer
-            if (ri.key() > date)
-                break;
-
-            // Keep this.. we need the last one.
-            lastri = ri;
-        }
+                        // Update flags counts and sums
+                        for (int i=0; i < flags2.size(); i++) {
+                            ChannelID code  = flags2.at(i);
+                            rx2.s_count[code] += dy->count(code);
+                            rx2.s_sum[code] += dy->sum(code);
+                        }
 
-        // lastri should no be the last entry before this date, or the end
-        if (lastri != rxitems.end()) {
-            RXItem & rx = lastri.value();
+                        // Update time sum
+                        rx2.hours += dy->hours(MT_CPAP);
 
-            // Does it match here?
-            if ((rx.relief == relief) && (rx.mode == mode) && (rx.pressure == pressure) && (rx.machine == mach) ) {
+                        // Update start and end
+                        //rx2.end = qMax(di.key(), rx2.end); // don't need to do this, the end won't change from what the old one was.
 
-                // Update AHI/RDI
-                tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
-                rx.ahi += tmp;
-                rx.rdi += tmp + day->count(CPAP_RERA);
-
-                // Update event flags
-                for (int i=0; i < flags3.size(); i++) {
-                    ChannelID code  = flags3.at(i);
-                    rx.s_count[code] += day->count(code);
-                    rx.s_sum[code] += day->sum(code);
+                        // technically only need to capture the first??
+                        rx2.start = qMin(di.key(), rx2.start);
+                    }
                 }
 
-                // Update hours
-                rx.hours += day->hours(MT_CPAP);
-
-                // Add day to this RX Cache
-                rx.dates[date] = day;
-                rx.end = date;
+                // Set rx records day counts
                 rx.days = rx.dates.size();
+                rx2.days = rx2.dates.size();
+
+                // Copy the pressure/mode/etc settings, because they haven't changed.
+                rx2.pressure = rx.pressure;
+                rx2.mode = rx.mode;
+                rx2.relief = rx.relief;
+                rx2.machine = rx.machine;
+                rx2.fingerprint = rx.fingerprint;
 
+                // Insert the newly split rx record
+                rxitems.insert(rx2.start, rx2);  // hmmm. this was previously set to the end date.. that was a silly plan.
                 fnd = true;
             }
         }
 
-        if (!fnd) {
-            // Okay, couldn't find a match, create a new rx cache record for this day.
+        if (fnd) continue;
 
-            RXItem rx;
-            rx.start = date;
-            rx.end = date;
-            rx.days = 1;
+        // Okay, couldn't find a match, create a new rx cache record for this day.
+        RXItem rx;
+        rx.start = date;
+        rx.end = date;
+        rx.days = 1;
 
-            // Set AHI/RDI for just this day
-            tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
-            rx.ahi = tmp;
-            rx.rdi = tmp + day->count(CPAP_RERA);
-
-            // Set counts and sums for this day
-            for (int i=0; i < flags3.size(); i++) {
-                ChannelID code  = flags3.at(i);
-                rx.s_count[code] = day->count(code);
-                rx.s_sum[code] = day->sum(code);
-            }
+        // Set AHI/RDI for just this day
+        tmp = day->count(CPAP_Hypopnea) + day->count(CPAP_Obstructive) + day->count(CPAP_Apnea) + day->count(CPAP_ClearAirway);
+        rx.ahi = tmp;
+        rx.rdi = tmp + day->count(CPAP_RERA);
 
-            rx.hours = day->hours();
+        // Set counts and sums for this day
+        for (int i=0; i < flags.size(); i++) {
+            ChannelID code  = flags.at(i);
+            rx.s_count[code] = day->count(code);
+            rx.s_sum[code] = day->sum(code);
+        }
 
-            // Store settings, etc..
-            rx.relief = relief;
-            rx.mode = mode;
-            rx.pressure = pressure;
-            rx.machine = mach;
+        rx.hours = day->hours();
 
-            // add this day to this rx record
-            rx.dates.insert(date, day);
+        // Store settings, etc..
+        rx.relief = day->getPressureRelief();
+        rx.mode = day->getCPAPMode();
+        rx.pressure = day->getPressureSettings();
+        rx.machine = mach;
+        rx.fingerprint = fingerprint;
 
-            // And insert into rx record into the rx cache
-            rxitems.insert(date, rx);
-        }
+        // add this day to this rx record
+        rx.dates.insert(date, day);
 
+        // And insert into rx record into the rx cache
+        rxitems.insert(date, rx);
+    }
+    // Store RX cache to disk, if anything new was added
+    if (changed) {
+        saveRXChanges();
     }
-    // Store RX cache to disk
-    saveRXChanges();
 
 
     // Now do the setup for the best worst highlighting
@@ -944,6 +894,61 @@ QString Statistics::GenerateRXChanges()
     return html;
 }
 
+// Cell values survive between reports until the day data changes
+static QHash<QString, QString> stat_cell_cache;
+static int stat_cell_generation = 0;
+static QMutex stat_cell_mutex;
+
+void StatisticsCellTask::run()
+{
+    result = row.value(start, end);
+
+    QMutexLocker locker(&stat_cell_mutex);
+    if (stat_cell_generation == p_profile->aggregates().generation()) {
+        stat_cell_cache[key] = result;
+    }
+}
+
+bool Statistics::cachedCell(const QString &key, QString &value)
+{
+    QMutexLocker locker(&stat_cell_mutex);
+
+    int generation = p_profile->aggregates().generation();
+    if (stat_cell_generation != generation) {
+        stat_cell_cache.clear();
+        stat_cell_generation = generation;
+        return false;
+    }
+
+    auto it = stat_cell_cache.find(key);
+    if (it == stat_cell_cache.end()) {
+        return false;
+    }
+    value = it.value();
+    return true;
+}
+
+QString Statistics::cellKey(StatisticsRow &row, QDate start, QDate end)
+{
+    // Besides the day data, which the generation covers, values depend on these preferences
+    QString key = QString("%1|%2|%3|%4|%5|%6|%7|%8|%9")
+            .arg(quintptr(p_profile))
+            .arg(p_profile->aggregates().generation())
+            .arg(row.src).arg(row.calc).arg(row.type)
+            .arg(start.toJulianDay()).arg(end.toJulianDay())
+            .arg(p_profile->general->prefCalcPercentile())
+            .arg(p_profile->general->calculateRDI());
+
+    if (row.calc == SC_COMPLIANCE) {
+        key += QString("|%1").arg(p_profile->cpap->complianceHours());
+    } else if ((row.calc == SC_ABOVE) || (row.calc == SC_BELOW)) {
+        schema::Channel &chan = schema::channel[row.channel()];
+        key += QString("|%1|%2").arg(chan.upperThreshold()).arg(chan.lowerThreshold());
+    }
+
+    return key;
+}
+
 QString Statistics::GenerateHTML()
 {
     QList<Machine *> cpap_machines = p_profile->GetMachines(MT_CPAP);
@@ -1033,6 +1038,9 @@ QString Statistics::GenerateHTML()
 
     QList<Period> periods;
 
+    // Cells are worked out after the page is laid out, so html is kept in chunks with a cell between each
+    QStringList chunks;
+    QList<StatisticsCellTask *> cells;
 
     bool skipsection = false;;
     for (QList<StatisticsRow>::iterator i = rows.begin(); i != rows.end(); ++i) {
@@ -1161,7 +1169,18 @@ QString Statistics::GenerateHTML()
 
             line += QString("<td width=%1%>").arg(width);
             if (!periods.at(j).header.isEmpty()) {
-                line += row.value(periods.at(j).start, periods.at(j).end);
+                const Period & period = periods.at(j);
+                QString key = cellKey(row, period.start, period.end);
+                QString value;
+
+                if (cachedCell(key, value)) {
+                    line += value;
+                } else {
+                    chunks.append(html + line);
+                    html.clear();
+                    line.clear();
+                    cells.append(new StatisticsCellTask(row, period.start, period.end, key));
+                }
             } else {
                 line +="&nbsp;";
             }
@@ -1174,6 +1193,38 @@ QString Statistics::GenerateHTML()
     html += "</table>";
     html += "</div>";
 
+    if (!cells.isEmpty()) {
+        // Calculations only read summaries, so load them all up front rather than from the workers
+        for (auto & day : p_profile->daylist) {
+            day->OpenSummary();
+        }
+
+        if (AppSetting->multithreading()) {
+            QThreadPool pool;
+            pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), 1));
+            for (auto & cell : cells) {
+                cell->setAutoDelete(false);
+                pool.start(cell);
+            }
+            // No event processing while the workers hold Day records, or a purge or import
+            // started from the GUI could delete them underneath
+            pool.waitForDone(-1);
+        } else {
+            for (auto & cell : cells) {
+                cell->run();
+            }
+        }
+
+        chunks.append(html);
+        html.clear();
+        for (int i = 0; i < cells.size(); ++i) {
+            html += chunks.at(i);
+            html += cells.at(i)->result;
+        }
+        html += chunks.last();
+
+        qDeleteAll(cells);
+    }
 
     html += GenerateRXChanges();
     html += GenerateMachineList();
@@ -12,6 +12,7 @@
 #include <QObject>
 #include <QHash>
 #include <QList>
+#include <QRunnable>
 #include "SleepLib/schema.h"
 #include "SleepLib/machine.h"
 
@@ -94,6 +95,27 @@ struct StatisticsRow {
     QString value(QDate start, QDate end);
 };
 
+/*! \class StatisticsCellTask
+    \brief Works out one row's value for one period, on a worker thread
+    */
+class StatisticsCellTask : public QRunnable
+{
+  public:
+    StatisticsCellTask(const StatisticsRow &row, QDate start, QDate end, const QString &key)
+        : row(row), start(start), end(end), key(key) {}
+    virtual ~StatisticsCellTask() {}
+
+    virtual void run();
+
+    StatisticsRow row;
+    QDate start;
+    QDate end;
+
+    //! \brief Key the result is cached under
+    QString key;
+    QString result;
+};
+
 class RXItem {
 public:
     RXItem() {
@@ -101,6 +123,7 @@ public:
         ahi = rdi = 0;
         highlight = 0;
         hours = 0;
+        fingerprint = 0;
     }
     RXItem(const RXItem & copy) {
         start = copy.start;
@@ -117,6 +140,7 @@ public:
         pressure = copy.pressure;
         dates = copy.dates;
         highlight = copy.highlight;
+        fingerprint = copy.fingerprint;
     }
     inline quint64 count(ChannelID id) const {
         QHash<ChannelID, quint64>::const_iterator it = s_count.find(id);
@@ -142,6 +166,9 @@ public:
     QString pressure;
     QMap<QDate, Day *> dates;
     short highlight;
+
+    //! \brief Day::settingsFingerprint() of the days in this period
+    quint32 fingerprint;
 };
 
 
@@ -167,6 +194,12 @@ class Statistics : public QObject
     QString htmlHeader(bool showheader);
     QString htmlFooter(bool showinfo=true);
 
+    //! \brief Returns the cache key for row's value between start and end, which changes whenever anything the value depends on does
+    QString cellKey(StatisticsRow &row, QDate start, QDate end);
+
+    //! \brief Looks up a cached cell value. Returns false if it has to be worked out
+    static bool cachedCell(const QString &key, QString &value);
+
     // Using a map to maintain order
     QList<StatisticsRow> rows;
     QMap<StatCalcType, QString> calcnames;